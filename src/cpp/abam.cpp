@@ -0,0 +1,507 @@
+//------------------------------------------------------------------------------------
+//
+// abam.cpp - module for reading the fusion-relevant read pairs of an aligned Bam file
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "abam.h"
+#include "kmer.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+//------------------------------------------------------------------------------------
+
+struct BamRegionCompare // orders regions by reference and then by first position
+{
+   bool operator()(const BamRegion& a, const BamRegion& b) const
+   { return (a.refID != b.refID ? a.refID < b.refID : a.begin < b.begin); }
+};
+
+//------------------------------------------------------------------------------------
+// getSequence() returns the sequence of a read as it was sequenced, undoing the
+// reverse complement of a read aligned to the reverse strand
+
+static std::string getSequence(const BamRead& read)
+{
+   std::string *seq = read.sequence();
+   std::string sequence = (read.isReverseStrand() ? stringReverseComplement(*seq) :
+                                                    *seq);
+   delete seq;
+
+   return sequence;
+}
+
+//------------------------------------------------------------------------------------
+// isPrimaryMate() returns true if the read is the primary alignment of a paired read
+
+static bool isPrimaryMate(const BamRead& read)
+{
+   return (read.isPaired() && !read.isSecondary() && !read.isSupplementary());
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::open() opens the Bam file and prepares the regions to be read;
+// regions on references absent from the file are ignored, and overlapping regions
+// are merged
+
+void AbamPairReader::open()
+{
+   reader.open(filename);
+
+   BamRegionVector found;
+   int numRegions = region.size();
+
+   for (int i = 0; i < numRegions; i++)
+   {
+      BamRegion r = region[i];
+
+      if ((r.refID = reader.getRefIDAlt(r.refName)) < 0)
+         continue;
+
+      r.end = std::min(r.end, reader.getRefLen(r.refID));
+
+      if (r.begin <= r.end)
+         found.push_back(r);
+   }
+
+   std::sort(found.begin(), found.end(), BamRegionCompare());
+
+   region.clear();
+   numRegions = found.size();
+
+   for (int i = 0; i < numRegions; i++)
+      if (!region.empty() && region.back().refID == found[i].refID &&
+          found[i].begin <= region.back().end + 1)
+         region.back().end = std::max(region.back().end, found[i].end);
+      else
+         region.push_back(found[i]);
+
+   // without regions the whole file is read from the start, otherwise nextSource()
+   // jumps to the first region
+   scanning = (numRegions == 0);
+   active   = scanning;
+   finished = false;
+   source   = -1;
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::nextSource() jumps to the next region, or to the unplaced reads
+// after the last region, and returns false when there is nothing more to read
+
+bool AbamPairReader::nextSource()
+{
+   if (scanning)
+      return false; // the whole file has been read
+
+   int numRegions = region.size();
+
+   if (++source < numRegions)
+      reader.jump(region[source].refID, region[source].begin);
+   else if (source == numRegions)
+      reader.jumpUnplaced();
+   else
+      return false;
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::nextRead() gets the next read of the current source, moving on to
+// the next source as each one is exhausted; a read overlapping two regions is not
+// returned the second time; false is returned when there are no more reads
+
+bool AbamPairReader::nextRead(BamRead& read)
+{
+   int numRegions = region.size();
+
+   while (true)
+   {
+      if (!active)
+      {
+         if (!nextSource())
+	    return false;
+
+	 active = true;
+      }
+
+      if (!reader.getNext(read))
+      {
+         active = false;
+	 continue;
+      }
+
+      if (scanning || source == numRegions)
+         return true;
+
+      const BamRegion& r = region[source];
+
+      if (read.refID() != r.refID || read.position() > r.end)
+      {
+         active = false; // past the end of the region
+	 continue;
+      }
+
+      if (source > 0 && region[source - 1].refID == r.refID &&
+          read.position() <= region[source - 1].end)
+         continue; // this read was returned with the previous region
+
+      return true;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::isRelevant() returns true if the read makes its pair relevant to
+// fusion detection: a read or its mate is unmapped, the pair is not properly
+// aligned, or the read is soft-clipped by at least ABAM_MIN_CLIP bases
+
+bool AbamPairReader::isRelevant(const BamRead& read) const
+{
+   if (read.isUnmapped() || read.isMateUnmapped() || !read.isProperPair())
+      return true;
+
+   int numOps = read.numCigarOps();
+   if (numOps == 0)
+      return false;
+
+   char op;
+   int  len;
+
+   read.cigarOp(0, op, len);
+   if (op == 'S' && len >= ABAM_MIN_CLIP)
+      return true;
+
+   read.cigarOp(numOps - 1, op, len);
+   return (op == 'S' && len >= ABAM_MIN_CLIP);
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::addPair() queues the read pair formed by a held read and the
+// sequence of its mate
+
+void AbamPairReader::addPair(const std::string& name, const HeldRead& held,
+                             const std::string& sequence)
+{
+   ready.push_back(ReadyPair());
+
+   ReadyPair& pair = ready.back();
+   pair.name       = name;
+   pair.sequence1  = (held.isRead1 ? held.sequence : sequence);
+   pair.sequence2  = (held.isRead1 ? sequence : held.sequence);
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::holdRead() holds a read until its mate is read; the oldest reads
+// are evicted if too many are held
+
+void AbamPairReader::holdRead(const std::string& name, const HeldRead& read)
+{
+   held[name] = read;
+   heldOrder.push_back(std::make_pair(name, read.arrival));
+
+   // forget the oldest names whose reads have been paired
+   while (!heldOrder.empty())
+   {
+      std::unordered_map<std::string, HeldRead>::iterator it =
+         held.find(heldOrder.front().first);
+
+      if (it != held.end() && it->second.arrival == heldOrder.front().second)
+         break;
+
+      heldOrder.pop_front();
+   }
+
+   if (held.size() > ABAM_MAX_PENDING || heldOrder.size() > 2 * ABAM_MAX_PENDING)
+      evictHeld();
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::evictHeld() removes the oldest held reads, whose mates are far
+// away; the relevant ones become orphans whose mates are fetched at the end
+
+void AbamPairReader::evictHeld()
+{
+   while (!heldOrder.empty() &&
+          (held.size() > ABAM_MAX_PENDING / 2 || heldOrder.size() > ABAM_MAX_PENDING))
+   {
+      std::unordered_map<std::string, HeldRead>::iterator it =
+         held.find(heldOrder.front().first);
+
+      if (it != held.end() && it->second.arrival == heldOrder.front().second)
+      {
+         if (it->second.relevant)
+	 {
+            orphan.push_back(Orphan());
+	    orphan.back().name = it->first;
+	    orphan.back().read = it->second;
+	 }
+
+	 held.erase(it);
+      }
+
+      heldOrder.pop_front();
+   }
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::releaseHeld() turns the relevant reads still held at the end of
+// the sources into orphans
+
+void AbamPairReader::releaseHeld()
+{
+   std::unordered_map<std::string, HeldRead>::const_iterator it;
+
+   for (it = held.begin(); it != held.end(); ++it)
+      if (it->second.relevant)
+      {
+         orphan.push_back(Orphan());
+	 orphan.back().name = it->first;
+	 orphan.back().read = it->second;
+      }
+
+   held.clear();
+   heldOrder.clear();
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::addRead() pairs a read with its held mate, or holds it until its
+// mate is read; in a sequential scan, a read whose mate was passed over is an orphan
+// if it is relevant
+
+void AbamPairReader::addRead(const BamRead& read)
+{
+   if (!isPrimaryMate(read))
+      return;
+
+   std::string name = read.constName();
+
+   std::unordered_map<std::string, HeldRead>::iterator it = held.find(name);
+
+   if (it != held.end())
+   {
+      if (it->second.isRead1 == read.isRead1())
+         return; // the same read was seen twice
+
+      if (it->second.relevant || isRelevant(read))
+         addPair(name, it->second, getSequence(read));
+
+      held.erase(it);
+      return;
+   }
+
+   HeldRead h;
+   h.isRead1      = read.isRead1();
+   h.relevant     = (!scanning || isRelevant(read));
+   h.mateRefID    = read.mateRefID();
+   h.matePosition = read.matePosition();
+   h.arrival      = arrival++;
+
+   bool mateBehind = (scanning && read.refID() >= 0 && h.mateRefID >= 0 &&
+                      (h.mateRefID < read.refID() ||
+		       (h.mateRefID == read.refID() &&
+		        h.matePosition < read.position())));
+
+   if (mateBehind && !h.relevant)
+      return; // the pair is relevant only if its mate is, and then the mate fetches
+              // this read
+
+   h.sequence = getSequence(read);
+
+   if (mateBehind)
+   {
+      orphan.push_back(Orphan());
+      orphan.back().name = name;
+      orphan.back().read = h;
+   }
+   else
+      holdRead(name, h);
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::resolveOrphans() finds the mates of the orphans; orphans that are
+// mates of each other are paired directly, and the others are sorted by the position
+// of the mate so that each jump finds the mates within ABAM_ORPHAN_SPAN bases
+
+void AbamPairReader::resolveOrphans()
+{
+   int numOrphans = orphan.size();
+
+   std::unordered_map<std::string, int> firstOrphan;
+   std::vector<Orphan> unresolved;
+
+   for (int i = 0; i < numOrphans; i++)
+   {
+      std::unordered_map<std::string, int>::iterator it =
+         firstOrphan.find(orphan[i].name);
+
+      if (it == firstOrphan.end())
+         firstOrphan[orphan[i].name] = i;
+      else if (orphan[it->second].read.isRead1 != orphan[i].read.isRead1)
+      {
+         addPair(orphan[i].name, orphan[i].read, orphan[it->second].read.sequence);
+	 orphan[it->second].name.clear(); // resolved
+	 orphan[i].name.clear();
+      }
+   }
+
+   for (int i = 0; i < numOrphans; i++)
+      if (orphan[i].name != "" && orphan[i].read.mateRefID >= 0)
+         unresolved.push_back(orphan[i]);
+
+   orphan.clear();
+
+   std::sort(unresolved.begin(), unresolved.end());
+
+   int numUnresolved = unresolved.size();
+   BamRead read;
+
+   for (int i = 0; i < numUnresolved; )
+   {
+      int refID = unresolved[i].read.mateRefID;
+      int first = unresolved[i].read.matePosition;
+
+      std::unordered_map<std::string, int> wanted; // keyed by name
+      int j = i;
+
+      for ( ; j < numUnresolved && unresolved[j].read.mateRefID == refID &&
+              unresolved[j].read.matePosition - first <= ABAM_ORPHAN_SPAN; j++)
+         wanted[unresolved[j].name] = j;
+
+      int last = unresolved[j - 1].read.matePosition;
+
+      reader.jump(refID, first);
+
+      while (!wanted.empty() && reader.getNext(read) && read.refID() == refID &&
+             read.position() <= last)
+      {
+         if (!isPrimaryMate(read))
+	    continue;
+
+	 std::unordered_map<std::string, int>::iterator it =
+	    wanted.find(read.constName());
+
+	 if (it == wanted.end())
+	    continue;
+
+	 const Orphan& o = unresolved[it->second];
+
+	 if (o.read.isRead1 != read.isRead1())
+	 {
+            addPair(o.name, o.read, getSequence(read));
+	    wanted.erase(it);
+	 }
+      }
+
+      i = j;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::getNextPair() gets the next read pair and returns true, or returns
+// false when there are no more pairs; both reads have the same name
+
+bool AbamPairReader::getNextPair(std::string& name1, std::string& sequence1,
+                                 std::string& name2, std::string& sequence2)
+{
+   BamRead read;
+
+   while (ready.empty())
+   {
+      if (finished)
+         return false;
+
+      if (nextRead(read))
+         addRead(read);
+      else
+      {
+         releaseHeld();
+	 resolveOrphans();
+	 finished = true;
+      }
+   }
+
+   ReadyPair& pair = ready.front();
+
+   name1 = pair.name;
+   name2 = pair.name;
+
+   sequence1.swap(pair.sequence1);
+   sequence2.swap(pair.sequence2);
+
+   ready.pop_front();
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// AbamPairReader::close() closes the Bam file and forgets the reads not yet paired
+
+void AbamPairReader::close()
+{
+   reader.close();
+
+   held.clear();
+   heldOrder.clear();
+   orphan.clear();
+   ready.clear();
+}
+
+//------------------------------------------------------------------------------------
+// readBamRegions() reads the named file of gene regions and returns those of the
+// genes named in the annotations of the patterns; each line of the file has a gene
+// name, reference name, first position and last position, separated by tabs, and
+// lines starting with # are ignored
+
+BamRegionVector readBamRegions(const std::string& filename,
+                               const PatternVector *patternVector)
+{
+   std::unordered_set<std::string> gene;
+   int numPatterns = patternVector->size();
+
+   for (int i = 0; i < numPatterns; i++)
+   {
+      const StringVector& annotation = (*patternVector)[i].annotation;
+      gene.insert(annotation.begin(), annotation.end());
+   }
+
+   std::ifstream infile(filename.c_str());
+   if (!infile.is_open())
+      throw std::runtime_error("unable to open " + filename);
+
+   BamRegionVector region;
+   std::string line;
+
+   while (getline(infile, line))
+   {
+      if (line == "" || line[0] == '#')
+         continue;
+
+      StringVector col;
+      BamRegion    r;
+
+      if (splitString(line, col) < 4 || col[0] == "" || col[1] == "" ||
+          (r.begin = stringToNonnegInt(col[2])) <= 0 ||
+	  (r.end   = stringToNonnegInt(col[3])) < r.begin)
+         throw std::runtime_error("invalid region in " + filename + ": " + line);
+
+      if (gene.find(col[0]) == gene.end())
+         continue; // no pattern names this gene
+
+      r.gene    = col[0];
+      r.refName = col[1];
+      r.refID   = -1;
+
+      region.push_back(r);
+   }
+
+   infile.close();
+
+   if (region.empty())
+      throw std::runtime_error("no genes of the patterns are in " + filename);
+
+   return region;
+}
@@ -0,0 +1,125 @@
+//------------------------------------------------------------------------------------
+//
+// abam.h - module for reading the fusion-relevant read pairs of an aligned Bam file
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef ABAM_H
+#define ABAM_H
+
+#include "bamread.h"
+#include "pairread.h"
+#include "pattern.h"
+#include <deque>
+#include <unordered_map>
+
+const int ABAM_MAX_PENDING = 1 << 18; // max reads held while waiting for their mates
+const int ABAM_MIN_CLIP    = 5;       // min soft-clipped bases of a relevant read
+const int ABAM_ORPHAN_SPAN = 1 << 12; // max bases scanned for mates after one jump
+
+//------------------------------------------------------------------------------------
+
+struct BamRegion // a gene region to be read from an aligned Bam file
+{
+   std::string gene;    // name of the gene
+   std::string refName; // name of the reference sequence
+   int         begin;   // first position, 1-based, inclusive
+   int         end;     // last  position, 1-based, inclusive
+   int         refID;   // ID of the reference sequence in the Bam file, or (-1)
+};
+
+typedef std::vector<BamRegion> BamRegionVector;
+
+//------------------------------------------------------------------------------------
+
+// this gets read pairs from a coordinate-sorted aligned Bam (or Cram) file having an
+// index; if regions are given, only the pairs overlapping them and the unplaced
+// unmapped pairs are read, through the index; otherwise the whole file is scanned
+// but only the pairs having an unmapped read, a discordant mate or a soft clip are
+// returned; mates are paired by name in a bounded buffer, and a read whose mate is
+// not found this way gets its mate by jumping to the mate's position at the end
+
+class AbamPairReader : public PairReader
+{
+public:
+   AbamPairReader(const std::string& inFilename, const BamRegionVector& inRegion)
+      : filename(inFilename), reader(), region(inRegion), source(-1),
+	scanning(false), active(false), finished(false), arrival(0) { }
+
+   virtual ~AbamPairReader() { }
+
+   void open();
+
+   bool getNextPair(std::string& name1, std::string& sequence1,
+                    std::string& name2, std::string& sequence2);
+
+   void close();
+
+   std::string filename;
+   BamReader   reader;
+
+private:
+   struct HeldRead // a read waiting for its mate
+   {
+      std::string sequence;     // as sequenced
+      bool        isRead1;      // true if this is the first read of the pair
+      bool        relevant;     // true if the read makes its pair relevant
+      int         mateRefID;    // where the mate is aligned
+      int         matePosition;
+      uint64_t    arrival;      // order in which the read was held
+   };
+
+   struct Orphan // a relevant read whose mate must be fetched
+   {
+      std::string name;
+      HeldRead    read;
+
+      bool operator<(const Orphan& other) const
+      {
+         return (read.mateRefID != other.read.mateRefID ?
+	         read.mateRefID < other.read.mateRefID :
+		 read.matePosition < other.read.matePosition);
+      }
+   };
+
+   struct ReadyPair // a read pair to be returned
+   {
+      std::string name, sequence1, sequence2;
+   };
+
+   bool nextSource();
+   bool nextRead(BamRead& read);
+   bool isRelevant(const BamRead& read) const;
+   void addRead(const BamRead& read);
+   void addPair(const std::string& name, const HeldRead& held,
+                const std::string& sequence);
+   void holdRead(const std::string& name, const HeldRead& read);
+   void evictHeld();
+   void releaseHeld();
+   void resolveOrphans();
+
+   BamRegionVector region;   // sorted, merged regions found in the Bam file
+   int             source;   // index of the region being read, or region.size()
+                             // while reading the unplaced reads
+   bool            scanning; // true if the whole file is read sequentially
+   bool            active;   // true while the current source has reads
+   bool            finished; // true once every source has been read
+
+   std::unordered_map<std::string, HeldRead> held; // reads keyed by name
+   std::deque<std::pair<std::string, uint64_t> > heldOrder; // for eviction
+   uint64_t                                      arrival;
+
+   std::vector<Orphan>   orphan;
+   std::deque<ReadyPair> ready;
+};
+
+//------------------------------------------------------------------------------------
+
+BamRegionVector readBamRegions(const std::string& filename,
+                               const PatternVector *patternVector);
+
+#endif
@@ -9,6 +9,7 @@
 //------------------------------------------------------------------------------------
 
 #include "bamread.h"
+#include "htslib/bgzf.h"
 #include "htslib/sam.h"
 #include <cstring>
 #include <map>
@@ -54,6 +55,26 @@ void InternalData::reinitialize()
    filename = "";
 }
 
+//------------------------------------------------------------------------------------
+
+struct NibblePairTable // the two bases packed in each byte of a Bam sequence
+{
+   NibblePairTable()
+   {
+      for (int b = 0; b < 256; b++)
+      {
+         base[b][0] = seq_nt16_str[b >> 4];
+         base[b][1] = seq_nt16_str[b & 15];
+      }
+   }
+
+   char base[256][2];
+};
+
+static const NibblePairTable nibblePairTable;
+
+int BamReader::inflateThreads = 1;
+
 //------------------------------------------------------------------------------------
 // BamRead::BamRead() allocates the data structure used by htslib to represent a read
 
@@ -303,16 +324,37 @@ int BamRead::length() const
 // de-allocate it
 
 std::string *BamRead::sequence() const
+{
+   std::string *seq = new std::string();
+   appendSequence(*seq);
+
+   return seq;
+}
+
+//------------------------------------------------------------------------------------
+// BamRead::appendSequence() appends the read sequence to the given string, decoding
+// the packed bases a byte (two bases) at a time; unlike BamRead::sequence(), nothing
+// is allocated once the string has grown
+
+void BamRead::appendSequence(std::string& s) const
 {
    const uint8_t *qseq = bam_get_seq(bam1_ptr);
 
-   int readlen = length();
-   std::string *seq = new std::string(readlen, ' ');
+   int    readlen  = length();
+   int    numBytes = readlen >> 1; // bytes holding two bases
+   size_t start    = s.length();
 
-   for (int i = 0; i < readlen; i++)
-      (*seq)[i] = seq_nt16_str[bam_seqi(qseq, i)];
+   s.resize(start + readlen);
+   char *out = &s[start];
 
-   return seq;
+   for (int i = 0; i < numBytes; i++)
+   {
+      out[2 * i]     = nibblePairTable.base[qseq[i]][0];
+      out[2 * i + 1] = nibblePairTable.base[qseq[i]][1];
+   }
+
+   if (readlen & 1)
+      out[readlen - 1] = seq_nt16_str[qseq[numBytes] >> 4];
 }
 
 //------------------------------------------------------------------------------------
@@ -364,6 +406,10 @@ void BamReader::open(const std::string& filename)
    if (!(data_ptr->file = hts_open(filename.c_str(), "r")))
       throw std::runtime_error("unable to open " + filename);
 
+   // a pool of threads decompresses the BGZF blocks ahead of the reader
+   if (inflateThreads > 1 && hts_set_threads(data_ptr->file, inflateThreads) != 0)
+      throw std::runtime_error("unable to start threads for " + filename);
+
    if (!(data_ptr->header = sam_hdr_read(data_ptr->file)))
       throw std::runtime_error("unable to read header in " + filename);
 
@@ -477,6 +523,28 @@ void BamReader::jump(int refID, int startPosition)
                                getRefName(refID) + " in " + data_ptr->filename);
 }
 
+//------------------------------------------------------------------------------------
+// BamReader::jumpUnplaced() does a seek operation to the unmapped reads that have no
+// reference position, which are at the end of a sorted Bam file
+
+void BamReader::jumpUnplaced()
+{
+   if (!data_ptr->file)
+      throw std::runtime_error("attempt to jump in Bam file that is not open");
+
+   if (!data_ptr->index &&
+       (!(data_ptr->index = sam_index_load(data_ptr->file,
+                                           data_ptr->filename.c_str()))))
+      throw std::runtime_error("unable to read index file for " + data_ptr->filename);
+
+   if (data_ptr->iter)
+      hts_itr_destroy(data_ptr->iter);
+
+   if (!(data_ptr->iter = sam_itr_queryi(data_ptr->index, HTS_IDX_NOCOOR, 0, 0)))
+      throw std::runtime_error("disk seek failed on unplaced reads in " +
+                               data_ptr->filename);
+}
+
 //------------------------------------------------------------------------------------
 // BamReader::getNext() reads the next read from the Bam file; true is returned if
 // successful; false is returned when there are no more reads (if a jump was
@@ -505,6 +573,30 @@ bool BamReader::getNext(BamRead& read)
    throw std::runtime_error("error reading " + data_ptr->filename);
 }
 
+//------------------------------------------------------------------------------------
+// BamReader::tell() returns the virtual file offset of the next read, which is the
+// file offset of its BGZF block shifted left 16 bits plus its offset in the block
+
+uint64_t BamReader::tell() const
+{
+   if (!data_ptr->file)
+      throw std::runtime_error("attempt to tell position in unopened Bam file");
+
+   return bgzf_tell(data_ptr->file->fp.bgzf);
+}
+
+//------------------------------------------------------------------------------------
+// BamReader::seek() moves to the given virtual file offset, where a read begins
+
+void BamReader::seek(uint64_t offset)
+{
+   if (!data_ptr->file)
+      throw std::runtime_error("attempt to seek in Bam file that is not open");
+
+   if (bgzf_seek(data_ptr->file->fp.bgzf, offset, SEEK_SET) != 0)
+      throw std::runtime_error("unable to seek in " + data_ptr->filename);
+}
+
 //------------------------------------------------------------------------------------
 // BamReader::close() closes the Bam file and reinitializes the data fields
 
@@ -11,6 +11,7 @@
 #ifndef BAMREAD_H
 #define BAMREAD_H
 
+#include <cstdint>
 #include <string>
 
 //------------------------------------------------------------------------------------
@@ -56,6 +57,7 @@ public:
    int  length()               const;
 
    std::string *sequence()     const;
+   void appendSequence(std::string& s) const;
    std::string *qualities()    const;
 
 protected:
@@ -84,11 +86,19 @@ public:
    std::string getRefName(int refID) const;
 
    void jump(int refID, int startPosition=1);
+   void jumpUnplaced();
 
    bool getNext(BamRead& read);
 
+   // tell() returns the virtual file offset of the next read in the Bam file, and
+   // seek() moves to a virtual file offset where a read begins
+   uint64_t tell() const;
+   void     seek(uint64_t offset);
+
    void close();
 
+   static int inflateThreads; // number of threads decompressing each Bam file
+
 protected:
    void *rptr; // opaque pointer to internal data structure
 };
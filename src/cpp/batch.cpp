@@ -0,0 +1,178 @@
+//------------------------------------------------------------------------------------
+//
+// batch.cpp - module supporting batches of read pairs passed between threads
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "batch.h"
+#include <algorithm>
+
+//------------------------------------------------------------------------------------
+// ReadBatch::add() appends a read pair to the batch
+
+void ReadBatch::add(const std::string& name1, const std::string& seq1,
+                    const std::string& name2, const std::string& seq2)
+{
+   append(name1);
+   append(seq1);
+   append(name2);
+   append(seq2);
+
+   count++;
+}
+
+//------------------------------------------------------------------------------------
+// ReadBatch::get() copies the ith read pair of the batch into the given strings,
+// whose capacity is reused from one read pair to the next
+
+void ReadBatch::get(int i, std::string& name1, std::string& seq1,
+                           std::string& name2, std::string& seq2) const
+{
+   int f = NUM_FIELDS * i;
+
+   extract(f,     name1);
+   extract(f + 1, seq1);
+   extract(f + 2, name2);
+   extract(f + 3, seq2);
+}
+
+//------------------------------------------------------------------------------------
+// BatchQueue::push() adds a batch to the end of the queue and wakes a waiting thread
+
+void BatchQueue::push(ReadBatch *batch)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(batch);
+   }
+
+   ready.notify_one();
+}
+
+//------------------------------------------------------------------------------------
+// BatchQueue::pop() removes and returns the batch at the front of the queue, waiting
+// until one is available; NULL is returned when the queue is closed and empty
+
+ReadBatch *BatchQueue::pop()
+{
+   std::unique_lock<std::mutex> lock(mutex);
+
+   while (queue.empty() && !closed)
+      ready.wait(lock);
+
+   if (queue.empty())
+      return NULL;
+
+   ReadBatch *batch = queue.front();
+   queue.pop_front();
+
+   return batch;
+}
+
+//------------------------------------------------------------------------------------
+// BatchQueue::close() indicates that no more batches will be pushed and wakes all
+// waiting threads
+
+void BatchQueue::close()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+   }
+
+   ready.notify_all();
+}
+
+//------------------------------------------------------------------------------------
+// BatchQueue::reopen() allows the queue to be used again after it has been closed and
+// drained, e.g., for the next input in a sequence of inputs
+
+void BatchQueue::reopen()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   closed = false;
+}
+
+//------------------------------------------------------------------------------------
+// RangeQueue::push() adds a full batch to the end of the queue and wakes the waiting
+// threads, which may all share its ranges
+
+void RangeQueue::push(ReadBatch *batch)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(batch);
+   }
+
+   ready.notify_all();
+}
+
+//------------------------------------------------------------------------------------
+// RangeQueue::claim() sets range to the next unclaimed range of the batch at the front
+// of the queue, waiting until there is one; false is returned when the queue is
+// closed and empty
+
+bool RangeQueue::claim(BatchRange& range)
+{
+   std::unique_lock<std::mutex> lock(mutex);
+
+   while (queue.empty() && !closed)
+      ready.wait(lock);
+
+   if (queue.empty())
+      return false;
+
+   ReadBatch *batch = queue.front();
+
+   range.batch = batch;
+   range.begin = batch->claimed;
+   range.end   = std::min(batch->count, batch->claimed + rangeSize);
+
+   batch->claimed = range.end;
+
+   if (batch->claimed == batch->count)
+      queue.pop_front(); // its last range has been claimed
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// RangeQueue::finish() records that the matching of the given range is finished and
+// returns true if the whole batch is finished, so that it can be recycled
+
+bool RangeQueue::finish(const BatchRange& range)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   range.batch->done += range.end - range.begin;
+
+   return (range.batch->done == range.batch->count);
+}
+
+//------------------------------------------------------------------------------------
+// RangeQueue::close() indicates that no more batches will be pushed and wakes all
+// waiting threads
+
+void RangeQueue::close()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+   }
+
+   ready.notify_all();
+}
+
+//------------------------------------------------------------------------------------
+// RangeQueue::reopen() allows the queue to be used again after it has been closed and
+// drained
+
+void RangeQueue::reopen()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   closed = false;
+}
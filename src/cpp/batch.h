@@ -0,0 +1,132 @@
+//------------------------------------------------------------------------------------
+//
+// batch.h - module supporting batches of read pairs passed between threads
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "util.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------------
+
+class ReadBatch // holds a batch of read pairs packed into one arena
+{
+public:
+   ReadBatch(int inCapacity)
+      : capacity(inCapacity), limit(inCapacity), count(0), claimed(0), done(0)
+   { offset.reserve(NUM_FIELDS * inCapacity + 1); clear(); }
+
+   virtual ~ReadBatch() { }
+
+   void clear()
+   { count = claimed = done = 0; arena.clear(); offset.assign(1, 0); }
+
+   void add(const std::string& name1, const std::string& seq1,
+            const std::string& name2, const std::string& seq2);
+
+   void get(int i, std::string& name1, std::string& seq1,
+                   std::string& name2, std::string& seq2) const;
+
+   // a read pair can instead be decoded straight into the arena: append each of
+   // name1, seq1, name2 and seq2 to fieldArena() and call endField() after each,
+   // then call endPair()
+   std::string& fieldArena() { return arena; }
+   void endField() { offset.push_back(arena.length()); }
+   void endPair()  { count++; }
+
+   int capacity; // maximum number of read pairs
+   int limit;    // number of read pairs the reader fills it to, at most capacity
+   int count;    // number of read pairs in the batch
+
+   int claimed;  // read pairs claimed by matching threads, kept by RangeQueue
+   int done;     // read pairs whose matching is finished, kept by RangeQueue
+
+private:
+   static const int NUM_FIELDS = 4; // name1, seq1, name2, seq2
+
+   void append(const std::string& field)
+   { arena.append(field); offset.push_back(arena.length()); }
+
+   void extract(int i, std::string& field) const
+   { field.assign(arena.data() + offset[i], offset[i + 1] - offset[i]); }
+
+   std::string         arena;  // names and sequences of the read pairs
+   std::vector<size_t> offset; // offset[f] is where field f begins in the arena
+};
+
+//------------------------------------------------------------------------------------
+
+class BatchQueue // a queue of batches shared by threads; pop() waits for a batch
+{
+public:
+   BatchQueue() : closed(false) { }
+
+   virtual ~BatchQueue() { }
+
+   void push(ReadBatch *batch);
+
+   ReadBatch *pop(); // returns NULL when the queue is closed and empty
+
+   void close();     // no more batches will be pushed
+   void reopen();    // allows batches to be pushed again after close()
+
+private:
+   std::mutex              mutex;
+   std::condition_variable ready;
+   std::deque<ReadBatch *> queue;
+   bool                    closed;
+};
+
+//------------------------------------------------------------------------------------
+
+struct BatchRange // a range of the read pairs of a batch, claimed by one thread
+{
+   BatchRange() : batch(NULL), begin(0), end(0) { }
+
+   ReadBatch *batch;
+   int        begin; // first read pair of the range
+   int        end;   // one past the last read pair of the range
+};
+
+// this is a queue of full batches whose read pairs are claimed by the matching
+// threads a range at a time; a batch stays at the front of the queue until all of its
+// ranges are claimed, so a thread that runs out of work shares in the batch started
+// by another thread instead of sitting idle while that thread finishes it
+
+class RangeQueue
+{
+public:
+   RangeQueue(int inRangeSize) : rangeSize(inRangeSize), closed(false) { }
+
+   virtual ~RangeQueue() { }
+
+   void push(ReadBatch *batch);
+
+   bool claim(BatchRange& range); // waits for a range; returns false when the queue
+                                  // is closed and every range has been claimed
+
+   bool finish(const BatchRange& range); // returns true if it was the last range of
+                                         // its batch to finish
+
+   void close();  // no more batches will be pushed
+   void reopen(); // allows batches to be pushed again after close()
+
+private:
+   int                     rangeSize; // read pairs of a range
+   std::mutex              mutex;
+   std::condition_variable ready;
+   std::deque<ReadBatch *> queue;
+   bool                    closed;
+};
+
+#endif
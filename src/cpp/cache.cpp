@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------------
+//
+// cache.cpp - module for caching the matches of duplicate read pairs
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "cache.h"
+#include <algorithm>
+
+//------------------------------------------------------------------------------------
+// MatchCache::MatchCache() divides the capacity of the cache among its shards
+
+MatchCache::MatchCache(int capacity)
+   : shardCapacity(std::max(1, capacity / MATCH_CACHE_SHARDS))
+{
+   for (int i = 0; i < MATCH_CACHE_SHARDS; i++)
+      shard[i].entry.reserve(shardCapacity);
+}
+
+//------------------------------------------------------------------------------------
+// MatchCache::hash() returns the hash of the sequences of a read pair; the length of
+// the first sequence is included so that the sequences cannot be shifted between
+// the reads without changing the hash
+
+uint64_t MatchCache::hash(const std::string& sequence1, const std::string& sequence2)
+{
+   uint32_t length1 = sequence1.length();
+
+   uint64_t h = hashBytes(&length1, sizeof(length1));
+   h = hashBytes(sequence1.data(), sequence1.length(), h);
+
+   return hashBytes(sequence2.data(), sequence2.length(), h);
+}
+
+//------------------------------------------------------------------------------------
+// MatchCache::find() looks for the read pair in its shard; the sequences are compared
+// so that a read pair whose hash collides with another's is not taken for it
+
+bool MatchCache::find(const std::string& sequence1, const std::string& sequence2,
+                      MatchVector& matches1, MatchVector& matches2, bool& located)
+{
+   uint64_t key = hash(sequence1, sequence2);
+   Shard&   s   = shard[key % MATCH_CACHE_SHARDS];
+
+   std::lock_guard<std::mutex> lock(s.mutex);
+
+   std::unordered_map<uint64_t, Entry>::const_iterator it = s.entry.find(key);
+
+   if (it == s.entry.end() || it->second.sequence1 != sequence1 ||
+       it->second.sequence2 != sequence2)
+      return false;
+
+   matches1 = it->second.matches1;
+   matches2 = it->second.matches2;
+   located  = it->second.located;
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// MatchCache::add() adds the read pair to its shard, discarding the oldest read pair
+// of the shard if it is full; a read pair whose hash is already present is not added
+
+void MatchCache::add(const std::string& sequence1, const std::string& sequence2,
+                     const MatchVector& matches1, const MatchVector& matches2,
+		     bool located)
+{
+   uint64_t key = hash(sequence1, sequence2);
+   Shard&   s   = shard[key % MATCH_CACHE_SHARDS];
+
+   std::lock_guard<std::mutex> lock(s.mutex);
+
+   if (s.entry.count(key) > 0)
+      return; // added by another thread, or a colliding read pair
+
+   if (s.entry.size() >= shardCapacity)
+   {
+      s.entry.erase(s.order.front());
+      s.order.pop_front();
+   }
+
+   Entry& e = s.entry[key];
+
+   e.sequence1 = sequence1;
+   e.sequence2 = sequence2;
+   e.matches1  = matches1;
+   e.matches2  = matches2;
+   e.located   = located;
+
+   s.order.push_back(key);
+}
@@ -0,0 +1,71 @@
+//------------------------------------------------------------------------------------
+//
+// cache.h - module for caching the matches of duplicate read pairs
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "match.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+const int MATCH_CACHE_SHARDS = 64; // number of independently locked parts of a cache
+
+//------------------------------------------------------------------------------------
+
+// this holds the valid matches of the most recently added read pairs, keyed by the
+// sequences of the pair, so that an exact duplicate of a pair need not be matched
+// again; the cache is shared by the matching threads and is divided into shards, each
+// with its own lock, so that the threads seldom contend; once a shard is full, adding
+// a read pair discards the oldest read pair of the shard
+
+class MatchCache
+{
+public:
+   MatchCache(int capacity); // maximum number of read pairs held
+
+   virtual ~MatchCache() { }
+
+   // find() returns true if the read pair is in the cache and sets the matches of its
+   // two orientations, which are empty if the pair has no valid matches, and whether
+   // a minimizer of the pair was located in a pattern
+   bool find(const std::string& sequence1, const std::string& sequence2,
+             MatchVector& matches1, MatchVector& matches2, bool& located);
+
+   // add() adds a read pair, the valid matches of its two orientations and whether a
+   // minimizer of the pair was located in a pattern
+   void add(const std::string& sequence1, const std::string& sequence2,
+            const MatchVector& matches1, const MatchVector& matches2, bool located);
+
+private:
+   MatchCache(const MatchCache&);            // not copyable
+   MatchCache& operator=(const MatchCache&);
+
+   struct Entry // a read pair and its valid matches
+   {
+      std::string sequence1, sequence2;
+      MatchVector matches1,  matches2;
+      bool        located;
+   };
+
+   struct Shard
+   {
+      std::mutex                          mutex;
+      std::unordered_map<uint64_t, Entry> entry; // keyed by hash of the sequences
+      std::deque<uint64_t>                order; // keys in order of addition
+   };
+
+   static uint64_t hash(const std::string& sequence1, const std::string& sequence2);
+
+   size_t shardCapacity; // maximum number of read pairs held by a shard
+   Shard  shard[MATCH_CACHE_SHARDS];
+};
+
+#endif
@@ -0,0 +1,243 @@
+//------------------------------------------------------------------------------------
+//
+// candidate.cpp - module for saving the candidate read pairs of a run to a binary
+//                 file and reading them back, so that they can be matched again
+//                 under other thresholds without reading the whole input
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "candidate.h"
+#include "util.h"
+#include <algorithm>
+#include <stdexcept>
+
+// the signature identifies a candidate file and its byte ordering
+const uint32_t CANDIDATE_FILE_SIGNATURE_NOSWAP = 0x43A5D217;
+const uint32_t CANDIDATE_FILE_SIGNATURE_SWAP   = 0x17D2A543;
+
+const uint32_t CANDIDATE_FILE_VERSION = 2; // incremented when the layout changes
+
+// each record of a candidate file starts with one of these tags
+const uint8_t CANDIDATE_PAIR_RECORD       = 'P'; // followed by a read pair
+const uint8_t CANDIDATE_READ_PAIRS_RECORD = 'R'; // followed by the number of read
+                                                 // pairs of the input; last record
+
+const uint32_t MAX_CANDIDATE_FIELD = 1 << 20; // longest name or sequence accepted
+
+//------------------------------------------------------------------------------------
+// getCandidateKey() returns the key of the candidate read pairs found with the given
+// pattern map inputs; a pattern is identified by a hash of its display sequence,
+// which shows its delimiters
+
+CandidateKey getCandidateKey(const PatternVector *patternVector,
+                             const KmerRankTable *rankTable, MinimizerWindowLength w,
+			     Minimizer maxMinimizer, int maxLocations,
+			     WindowScheme scheme, bool single)
+{
+   CandidateKey key;
+
+   key.rankFingerprint = rankTable->fingerprint();
+   key.maxMinimizer    = maxMinimizer;
+   key.maxLocations    = maxLocations;
+   key.windowLength    = w;
+   key.windowScheme    = scheme;
+   key.single          = (single ? 1 : 0);
+
+   int numPatterns = patternVector->size();
+
+   for (int i = 0; i < numPatterns; i++)
+   {
+      const std::string& display = (*patternVector)[i].displaySequence;
+      key.patternHash.push_back(hashBytes(display.data(), display.length()));
+   }
+
+   std::sort(key.patternHash.begin(), key.patternHash.end());
+
+   return key;
+}
+
+//------------------------------------------------------------------------------------
+// CandidateWriter::open() creates the named candidate file and writes its heading,
+// which holds the key
+
+void CandidateWriter::open(const std::string& filename, const CandidateKey& key)
+{
+   writer.open(filename);
+
+   writer.writeUint32(CANDIDATE_FILE_SIGNATURE_NOSWAP);
+   writer.writeUint32(CANDIDATE_FILE_VERSION);
+   writer.writeUint64(key.rankFingerprint);
+   writer.writeUint32(key.maxMinimizer);
+   writer.writeUint32(key.maxLocations);
+   writer.writeUint8 (key.windowLength);
+   writer.writeUint8 (key.windowScheme);
+   writer.writeUint8 (key.single);
+   writer.writeUint8 (0); // unused
+   writer.writeUint32(key.patternHash.size());
+
+   for (size_t i = 0; i < key.patternHash.size(); i++)
+      writer.writeUint64(key.patternHash[i]);
+}
+
+//------------------------------------------------------------------------------------
+// CandidateWriter::appendPair() appends a record holding a read pair to a buffer; the
+// length of each field precedes it, in native byte order like the rest of the file
+
+void CandidateWriter::appendPair(std::string& buffer,
+                                 const std::string& name1,
+				 const std::string& sequence1,
+                                 const std::string& name2,
+				 const std::string& sequence2)
+{
+   const std::string *field[4] = { &name1, &sequence1, &name2, &sequence2 };
+
+   buffer += static_cast<char>(CANDIDATE_PAIR_RECORD);
+
+   for (int i = 0; i < 4; i++)
+   {
+      uint32_t length = field[i]->length();
+
+      buffer.append(reinterpret_cast<const char *>(&length), sizeof(length));
+      buffer.append(*field[i]);
+   }
+}
+
+//------------------------------------------------------------------------------------
+// CandidateWriter::write() writes a buffer of records to the candidate file
+
+void CandidateWriter::write(const std::string& buffer)
+{
+   writer.writeBuffer(buffer.data(), buffer.length());
+}
+
+//------------------------------------------------------------------------------------
+// CandidateWriter::close() writes the number of read pairs of the input as the last
+// record and closes the candidate file
+
+void CandidateWriter::close(uint64_t numReadPairs)
+{
+   writer.writeUint8(CANDIDATE_READ_PAIRS_RECORD);
+   writer.writeUint64(numReadPairs);
+
+   writer.close();
+}
+
+//------------------------------------------------------------------------------------
+// CandidatePairReader::open() opens the candidate file and reads its heading; an
+// exception is raised unless the file holds every read pair that could match in this
+// run: the minimizers must be found the same way, with no more of them ignored as
+// common or treated as common in the patterns than when the file was saved, and
+// every pattern must have been searched
+
+void CandidatePairReader::open()
+{
+   reader.open(filename);
+
+   uint32_t signature, version, maxMinimizer, maxLocations, numPatterns;
+   uint64_t rankFingerprint;
+   uint8_t  windowLength, windowScheme, single, unused;
+
+   if (!reader.readUint32(signature) ||
+       (signature != CANDIDATE_FILE_SIGNATURE_NOSWAP &&
+        signature != CANDIDATE_FILE_SIGNATURE_SWAP))
+      throw std::runtime_error(filename + " is not a candidate file");
+
+   reader.swap = (signature == CANDIDATE_FILE_SIGNATURE_SWAP);
+
+   if (!reader.readUint32(version) || version != CANDIDATE_FILE_VERSION)
+      throw std::runtime_error("unsupported version of candidate file " + filename);
+
+   if (!reader.readUint64(rankFingerprint) || !reader.readUint32(maxMinimizer) ||
+       !reader.readUint32(maxLocations) || !reader.readUint8(windowLength) ||
+       !reader.readUint8(windowScheme) || !reader.readUint8(single) ||
+       !reader.readUint8(unused) || !reader.readUint32(numPatterns))
+      throw std::runtime_error("truncated candidate file " + filename);
+
+   std::vector<uint64_t> patternHash(numPatterns);
+
+   for (uint32_t i = 0; i < numPatterns; i++)
+      if (!reader.readUint64(patternHash[i]))
+         throw std::runtime_error("truncated candidate file " + filename);
+
+   std::string error = "";
+
+   if (rankFingerprint != key.rankFingerprint || windowLength != key.windowLength ||
+       windowScheme != key.windowScheme)
+      error = filename + " was saved with a different rank table, -w or -sliding";
+   else if (maxMinimizer < key.maxMinimizer)
+      error = filename + " was saved with a lower -maxrank";
+   else if (key.maxLocations == 0 ? maxLocations != 0 :
+            maxLocations != 0 && maxLocations < key.maxLocations)
+      error = filename + " was saved with a lower -maxlocs";
+   else if (single < key.single)
+      error = filename + " was saved without -single=1";
+   else
+   {
+      for (size_t i = 0; i < key.patternHash.size(); i++)
+         if (!std::binary_search(patternHash.begin(), patternHash.end(),
+	                         key.patternHash[i]))
+	 {
+            error = filename + " was saved without some of the patterns";
+	    break;
+	 }
+   }
+
+   if (error != "")
+   {
+      reader.close();
+      throw std::runtime_error(error);
+   }
+
+   inputPairs = 0;
+}
+
+//------------------------------------------------------------------------------------
+// CandidatePairReader::readField() reads a name or sequence of a read pair
+
+void CandidatePairReader::readField(std::string& field)
+{
+   uint32_t length;
+
+   if (!reader.readUint32(length) || length > MAX_CANDIDATE_FIELD)
+      throw std::runtime_error("invalid candidate file " + filename);
+
+   field.resize(length);
+
+   if (length > 0 && !reader.readBuffer(&field[0], length))
+      throw std::runtime_error("truncated candidate file " + filename);
+}
+
+//------------------------------------------------------------------------------------
+// CandidatePairReader::getNextPair() gets the next read pair and returns true, or
+// returns false when the last record is reached
+
+bool CandidatePairReader::getNextPair(std::string& name1, std::string& sequence1,
+                                      std::string& name2, std::string& sequence2)
+{
+   uint8_t tag;
+
+   if (!reader.readUint8(tag))
+      throw std::runtime_error("truncated candidate file " + filename);
+
+   if (tag == CANDIDATE_READ_PAIRS_RECORD)
+   {
+      if (!reader.readUint64(inputPairs))
+         throw std::runtime_error("truncated candidate file " + filename);
+
+      return false;
+   }
+
+   if (tag != CANDIDATE_PAIR_RECORD)
+      throw std::runtime_error("invalid candidate file " + filename);
+
+   readField(name1);
+   readField(sequence1);
+   readField(name2);
+   readField(sequence2);
+
+   return true;
+}
@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------------
+//
+// candidate.h - module for saving the candidate read pairs of a run to a binary file
+//               and reading them back, so that they can be matched again under other
+//               thresholds without reading the whole input
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef CANDIDATE_H
+#define CANDIDATE_H
+
+#include "bin.h"
+#include "minimizer.h"
+#include "pairread.h"
+#include "pattern.h"
+#include "rank.h"
+
+//------------------------------------------------------------------------------------
+
+struct CandidateKey // identifies the read pairs that a candidate file holds: every
+                    // read pair having a minimizer found in one of the patterns
+{
+   uint64_t              rankFingerprint; // fingerprint of the k-mer rank table
+   uint32_t              maxMinimizer;    // limit used to identify common minimizers
+   uint32_t              maxLocations;    // limit of PatternMap, or 0 if none
+   uint8_t               windowLength;    // length of each minimizer window
+   uint8_t               windowScheme;    // WindowScheme of the minimizer windows
+   uint8_t               single;          // 1 if single-read matches were sought
+   std::vector<uint64_t> patternHash;     // sorted hashes of the patterns
+};
+
+CandidateKey getCandidateKey(const PatternVector *patternVector,
+                             const KmerRankTable *rankTable, MinimizerWindowLength w,
+			     Minimizer maxMinimizer, int maxLocations,
+			     WindowScheme scheme, bool single);
+
+//------------------------------------------------------------------------------------
+
+class CandidateWriter // writes the candidate read pairs of a run to a binary file
+{
+public:
+   CandidateWriter() : writer() { }
+
+   virtual ~CandidateWriter() { }
+
+   void open(const std::string& filename, const CandidateKey& key);
+
+   // appendPair() appends a read pair to a buffer that is later passed to write()
+   static void appendPair(std::string& buffer,
+                          const std::string& name1, const std::string& sequence1,
+                          const std::string& name2, const std::string& sequence2);
+
+   void write(const std::string& buffer);
+
+   void close(uint64_t numReadPairs); // the number of read pairs of the whole input
+
+private:
+   BinWriter writer;
+};
+
+//------------------------------------------------------------------------------------
+
+// this gets the read pairs of a candidate file; open() raises an exception unless
+// every read pair that could match under the given key is in the file
+
+class CandidatePairReader : public PairReader
+{
+public:
+   CandidatePairReader(const std::string& inFilename, const CandidateKey& inKey)
+      : filename(inFilename), key(inKey), reader(), inputPairs(0) { }
+
+   virtual ~CandidatePairReader() { }
+
+   void open();
+
+   bool getNextPair(std::string& name1, std::string& sequence1,
+                    std::string& name2, std::string& sequence2);
+
+   void close() { reader.close(); }
+
+   std::string  filename;
+   CandidateKey key;        // of the run reading the file
+   BinReader    reader;
+   uint64_t     inputPairs; // read pairs of the input the candidates were saved
+                            // from, set once the end of the file is reached
+
+private:
+   void readField(std::string& field);
+};
+
+#endif
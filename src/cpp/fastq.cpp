@@ -9,34 +9,20 @@
 //------------------------------------------------------------------------------------
 
 #include "fastq.h"
+#include <cctype>
 #include <stdexcept>
+#include <vector>
 
 //------------------------------------------------------------------------------------
-// FastqReader::open() opens a file for input; if the filename ends with ".gz", the
-// file is assumed to be gzipped and it is uncompressed
+// FastqReader::open() opens a file for input; if the file is gzipped, it is
+// uncompressed as it is read
 
-void FastqReader::open()
+void FastqReader::open(const BgzfRange *range)
 {
-   if (f)
+   if (input)
       throw std::runtime_error("FASTQ file already open");
 
-   int len = filename.length();
-
-   if (len > 3 && filename.substr(len - 3, 3) == ".gz") // gzipped file
-   {
-      std::string command = "gunzip -c " + filename;    // we will uncompress it
-
-      f = popen(command.c_str(), "r");
-      isPipe = true;
-   }
-   else // file is uncompressed
-   {
-      f = std::fopen(filename.c_str(), "r");
-      isPipe = false;
-   }
-
-   if (!f)
-      throw std::runtime_error("unable to open " + filename);
+   input = new InputFile(filename, range);
 }
 
 //------------------------------------------------------------------------------------
@@ -45,38 +31,37 @@ void FastqReader::open()
 
 bool FastqReader::getNext(std::string& name, std::string& sequence)
 {
-   if (!f)
+   if (!input)
       throw std::runtime_error("attempt to read from unopened FASTQ file " +
                                filename);
 
-   const int MAX_LINE_LEN = 100000;
-   typedef char Line[MAX_LINE_LEN];
+   const int NAME = 0, SEQ = 1, PLUS = 2, NUM_LINES = 4; // lines of a FASTQ record
 
-   Line nameLine, seqLine, plusLine, qualLine;
+   LineSpan line[NUM_LINES];
 
-   if (!std::fgets(nameLine, MAX_LINE_LEN, f))
+   int numLines = input->getLines(NUM_LINES, line);
+
+   if (numLines == 0)
       return false; // reached end-of-file
 
-   if (!std::fgets(seqLine,  MAX_LINE_LEN, f) ||
-       !std::fgets(plusLine, MAX_LINE_LEN, f) ||
-       !std::fgets(qualLine, MAX_LINE_LEN, f) ||
-       nameLine[0] != '@' || plusLine[0] != '+')
+   if (numLines < NUM_LINES ||
+       line[NAME].length == 0 || line[NAME].data[0] != '@' ||
+       line[PLUS].length == 0 || line[PLUS].data[0] != '+')
       throw std::runtime_error("unexpected format in FASTQ file " + filename);
 
+   // the name follows '@' and the name and sequence end at the first white space
+
    int i = 1;
-   while (nameLine[i] && !isspace(nameLine[i]))
+   while (i < line[NAME].length && !isspace(line[NAME].data[i]))
       i++;
 
-   nameLine[i] = 0;
+   name.assign(&line[NAME].data[1], i - 1);
 
    i = 0;
-   while (seqLine[i] && !isspace(seqLine[i]))
+   while (i < line[SEQ].length && !isspace(line[SEQ].data[i]))
       i++;
 
-   seqLine[i] = 0;
-
-   name     = &nameLine[1];
-   sequence = seqLine;
+   sequence.assign(line[SEQ].data, i);
 
    return true;
 }
@@ -86,16 +71,9 @@ bool FastqReader::getNext(std::string& name, std::string& sequence)
 
 void FastqReader::close()
 {
-   if (!f) // no file is open
-      return;
+   delete input; // closes the file, if any
 
-   if (isPipe)
-      pclose(f);
-   else
-      std::fclose(f);
-
-   f      = NULL;
-   isPipe = false;
+   input = NULL;
 }
 
 //------------------------------------------------------------------------------------
@@ -123,6 +101,97 @@ bool FastqPairReader::getNextPair(std::string& name1, std::string& sequence1,
 			       " and " + reader2.filename);
 }
 
+//------------------------------------------------------------------------------------
+// fastqLineName() returns the read name on a FASTQ name line that begins at the given
+// offset of the data and ends before the given offset
+
+static std::string fastqLineName(const std::string& data, size_t begin, size_t end)
+{
+   size_t i = begin + 1;
+   while (i < end && !isspace(data[i]))
+      i++;
+
+   return data.substr(begin + 1, i - begin - 1);
+}
+
+//------------------------------------------------------------------------------------
+// findFastqPair() is the BgzfSyncFunction of an interleaved FASTQ file: a record
+// begins on a line starting with '@' whose next line but one starts with '+', which
+// a quality line starting with '@' cannot satisfy, and pairPhase() tells whether a
+// read pair begins at this record or at the next one
+
+static bool findFastqPair(const std::string& data, bool atEnd, size_t& start)
+{
+   const int PLUS = 2, RECORD_LINES = 4;
+
+   std::vector<size_t> line; // offset of each line start, but the first is partial
+   size_t length = data.length();
+
+   for (size_t pos = data.find('\n'); pos != std::string::npos && pos + 1 < length;
+        pos = data.find('\n', pos + 1))
+      line.push_back(pos + 1);
+
+   int numLines = line.size();
+   int k = 0;
+
+   while (k + PLUS < numLines &&
+          !(data[line[k]] == '@' && data[line[k + PLUS]] == '+'))
+      k++;
+
+   std::vector<std::string> name;
+
+   for (int i = k; i + PLUS < numLines && name.size() < SYNC_NAMES;
+        i += RECORD_LINES)
+      name.push_back(fastqLineName(data, line[i], line[i + 1] - 1));
+
+   if (name.size() < SYNC_NAMES && !atEnd)
+      return false; // more data is needed
+
+   int numNames = name.size();
+
+   int phase = pairPhase(name, atEnd && numNames < SYNC_NAMES);
+   if (phase < 0)
+      return false;
+
+   start = (phase < numNames ? line[k + phase * RECORD_LINES] : length);
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// InterleavedFastqPairReader::open() opens the file; if a shard is selected, only the
+// part of the file holding the read pairs of that shard is read
+
+void InterleavedFastqPairReader::open()
+{
+   if (numShards == 1)
+   {
+      reader.open();
+      return;
+   }
+
+   BgzfRange range;
+
+   range.start = findBgzfShard(reader.filename, shard,     numShards, findFastqPair);
+   range.stop  = findBgzfShard(reader.filename, shard + 1, numShards, findFastqPair);
+
+   reader.open(&range);
+}
+
+//------------------------------------------------------------------------------------
+// InterleavedFastqPairReader::selectShard() selects shard i of N of a BGZF-compressed
+// file, whose shards are found by file offset; other files are not sharded here
+
+bool InterleavedFastqPairReader::selectShard(int inShard, int inNumShards)
+{
+   if (!isBgzfFile(reader.filename))
+      return false;
+
+   shard     = inShard;
+   numShards = inNumShards;
+
+   return true;
+}
+
 //------------------------------------------------------------------------------------
 // InterleavedFastqPairReader::getNextPair() gets the next read pair and returns true,
 // or returns false when end-of-file is reached
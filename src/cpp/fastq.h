@@ -11,8 +11,8 @@
 #ifndef FASTQ_H
 #define FASTQ_H
 
+#include "infile.h"
 #include "pairread.h"
-#include <cstdio>
 
 //------------------------------------------------------------------------------------
 
@@ -20,19 +20,18 @@ class FastqReader // for reading a single FASTQ file
 {
 public:
    FastqReader(const std::string& inFilename)
-      : filename(inFilename), f(NULL), isPipe(false) { }
+      : filename(inFilename), input(NULL) { }
 
-   virtual ~FastqReader() { }
+   virtual ~FastqReader() { close(); }
 
-   void open();
+   void open(const BgzfRange *range = NULL); // reads only the range, if given
 
    bool getNext(std::string& name, std::string& sequence);
 
    void close();
 
    std::string  filename; // name of file to read
-   std::FILE   *f;        // is non-NULL when the file is open
-   bool         isPipe;   // is true when reading from a pipe
+   InputFile   *input;    // is non-NULL when the file is open
 };
 
 //------------------------------------------------------------------------------------
@@ -61,18 +60,24 @@ class InterleavedFastqPairReader : public PairReader
 {
 public:
    InterleavedFastqPairReader(const std::string& filename)
-      : reader(filename) { }
+      : reader(filename), shard(0), numShards(1) { }
 
    virtual ~InterleavedFastqPairReader() { }
 
-   void open()  { reader.open(); }
+   void open();
 
    bool getNextPair(std::string& name1, std::string& sequence1,
                     std::string& name2, std::string& sequence2);
 
+   bool selectShard(int inShard, int inNumShards);
+
    void close() { reader.close(); }
 
    FastqReader reader;
+
+private:
+   int shard;     // 0-based index of the shard read from a BGZF-compressed file
+   int numShards; // 1 unless a shard is selected
 };
 
 //------------------------------------------------------------------------------------
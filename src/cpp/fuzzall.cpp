@@ -12,11 +12,17 @@
 #include "summary.h"
 #include "version.h"
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <queue>
 #include <stdexcept>
+#include <thread>
 
 const std::string VERSION_NAME = "fuzzall " + CURRENT_VERSION;
 
+const int DEFAULT_THREADS = 8; // default number of threads reading summary files
+
+int          numThreads  = DEFAULT_THREADS;
 std::string  datasetName = "";
 StringVector fuzzumFilename;
 
@@ -32,8 +38,11 @@ void showUsage(const char *progname)
 
    std::cerr
       << NEWLINE
-      << "The following is optional:" << NEWLINE
-      << "  -dataset=name   name associated with this dataset" << NEWLINE;
+      << "The following are optional:" << NEWLINE
+      << "  -dataset=name   name associated with this dataset" << NEWLINE
+      << "  -threads=N      "
+             << "number of threads reading files, default is " << DEFAULT_THREADS
+	     << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
@@ -58,13 +67,144 @@ bool parseArgs(int argc, char *argv[])
       if (splitString(arg, opt, '=') != 2)
          return false; // incorrect option format
 
-      if (stringOpt(opt, "dataset", datasetName))
+      if (stringOpt(opt, "dataset", datasetName) ||
+          intOpt   (opt, "threads", numThreads))
          continue;  // this option has been recognized
 
       return false; // unrecognized option
    }
 
-   return (fuzzumFilename.size() > 0);
+   return (fuzzumFilename.size() > 0 && numThreads > 0);
+}
+
+//------------------------------------------------------------------------------------
+
+struct SummaryFile // the sorted summaries read from one input file
+{
+   SummaryFile()
+      : headingLine(), annotationHeading(), summaryVector(), message() { }
+
+   std::string   headingLine;
+   StringVector  annotationHeading;
+   SummaryVector summaryVector;
+   std::string   message; // error message, or empty if the file was read
+};
+
+std::atomic<int> nextFile(0); // index of the next file to be read by a thread
+
+//------------------------------------------------------------------------------------
+// readerWork() contains the work of each reader thread, which reads files until none
+// remain; an exception is recorded in the file being read
+
+void readerWork(std::vector<SummaryFile> *summaryFile)
+{
+   int numFiles = fuzzumFilename.size();
+   int i;
+
+   while ((i = nextFile++) < numFiles)
+   {
+      SummaryFile& file = (*summaryFile)[i];
+
+      try
+      {
+         readSummaryFile(fuzzumFilename[i], file.headingLine, file.annotationHeading,
+	                 file.summaryVector);
+      }
+      catch (const std::runtime_error& error)
+      {
+         file.message = error.what();
+      }
+   }
+}
+
+//------------------------------------------------------------------------------------
+
+struct FileSummary // the next summary of a file being merged
+{
+   FileSummary(Summary *inSummary, int inFile) : summary(inSummary), file(inFile) { }
+
+   Summary *summary;
+   int      file;
+};
+
+struct FileSummaryCompare // orders the heap of the merge so that the first summary is
+                          // on top; equal summaries are taken in file order
+{
+   bool operator()(const FileSummary& a, const FileSummary& b) const
+   {
+      if (compare(b.summary, a.summary))
+         return true;
+
+      if (compare(a.summary, b.summary))
+         return false;
+
+      return (a.file > b.file);
+   }
+
+   SummaryCompare compare;
+};
+
+typedef std::priority_queue<FileSummary, std::vector<FileSummary>,
+                            FileSummaryCompare> FileSummaryHeap;
+
+//------------------------------------------------------------------------------------
+// readSummaries() reads the hit summaries from the input files concurrently, sorting
+// those of each file, and merges them in sorted order into summaryVector
+
+void readSummaries(StringVector& annotationHeading, SummaryVector& summaryVector)
+{
+   int numFiles = fuzzumFilename.size();
+   int numReaders = std::min(numThreads, numFiles);
+
+   std::vector<SummaryFile> summaryFile(numFiles);
+   std::thread **thread = new std::thread *[numReaders];
+
+   for (int i = 0; i < numReaders; i++)
+      thread[i] = new std::thread(readerWork, &summaryFile);
+
+   for (int i = 0; i < numReaders; i++)
+   {
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   delete[] thread;
+
+   // report the first error in file order
+
+   for (int i = 0; i < numFiles; i++)
+   {
+      if (i > 0 && summaryFile[i].headingLine != "" &&
+          summaryFile[i].headingLine != summaryFile[0].headingLine)
+         throw std::runtime_error("inconsistent heading lines in input files");
+
+      if (summaryFile[i].message != "")
+         throw std::runtime_error(summaryFile[i].message);
+   }
+
+   annotationHeading = summaryFile[0].annotationHeading;
+
+   // merge the sorted summaries of the files
+
+   IntVector next(numFiles, 0); // index of the next summary of each file
+   FileSummaryHeap heap;
+
+   for (int i = 0; i < numFiles; i++)
+      if (!summaryFile[i].summaryVector.empty())
+         heap.push(FileSummary(summaryFile[i].summaryVector[next[i]++], i));
+
+   while (!heap.empty())
+   {
+      FileSummary top = heap.top();
+      heap.pop();
+
+      summaryVector.push_back(top.summary);
+
+      int i = top.file;
+
+      if (next[i] < summaryFile[i].summaryVector.size())
+         heap.push(FileSummary(summaryFile[i].summaryVector[next[i]++], i));
+   }
 }
 
 //------------------------------------------------------------------------------------
@@ -294,7 +434,7 @@ int main(int argc, char *argv[])
       StringVector  annotationHeading;
       SummaryVector summaryVector;
 
-      readSummaries(fuzzumFilename, annotationHeading, summaryVector);
+      readSummaries(annotationHeading, summaryVector);
 
       writeHeadingLine(annotationHeading);
       aggregateAll(summaryVector);
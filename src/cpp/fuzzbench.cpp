@@ -0,0 +1,905 @@
+//------------------------------------------------------------------------------------
+//
+// fuzzbench.cpp - this program measures the speed of the matching hot path of
+//                 fuzzion2 on read pairs synthesized from a pattern file, and
+//                 compares the rates with those of a stored baseline
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "fastq.h"
+#include "hit.h"
+#include "match.h"
+#include "rank.h"
+#include "ubam.h"
+#include "version.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+const std::string VERSION_NAME = "fuzzbench " + CURRENT_VERSION;
+
+const double DEFAULT_MAX_RANK    = 99.9;  // default max rank percentile of minimizers
+const double DEFAULT_MIN_BASES   = 90.0;  // default min percentile of matching bases
+const double DEFAULT_TOLERANCE   = 10.0;  // default percent slower that regresses
+const int    DEFAULT_K           = 11;    // default length of k-mers ranked
+const int    DEFAULT_MATCHING    = 50;    // default percent of pairs from patterns
+const int    DEFAULT_MAX_INSERT  = 500;   // default max insert size in bases
+const int    DEFAULT_MAX_TRIM    = 5;     // default max bases, second ahead of first
+const int    DEFAULT_MIN_MINS    = 1;     // default min number of matching minimizers
+const int    DEFAULT_MIN_OVERLAP = 5;     // default min length of overlap in #bases
+const int    DEFAULT_PAIRS       = 20000; // default number of synthetic read pairs
+const int    DEFAULT_READ_LEN    = 100;   // default length of synthetic reads
+const int    DEFAULT_REPEAT      = 3;     // default number of runs of each benchmark
+const int    DEFAULT_SAVE        = 0;     // default setting of -save option
+const int    DEFAULT_SEED        = 1;     // default seed of the random generator
+const int    DEFAULT_WINDOW_LEN  = 10;    // default length of windows in #bases
+
+const int    MIN_INSERT          = 150;   // smallest insert of a synthetic read pair
+const double ERROR_RATE          = 0.01;  // fraction of bases of a read substituted
+
+double maxRank    = DEFAULT_MAX_RANK;
+double tolerance  = DEFAULT_TOLERANCE;
+int    k          = DEFAULT_K;
+int    matching   = DEFAULT_MATCHING;
+int    numPairs   = DEFAULT_PAIRS;
+int    readLen    = DEFAULT_READ_LEN;
+int    repeat     = DEFAULT_REPEAT;
+int    save       = DEFAULT_SAVE;
+int    seed       = DEFAULT_SEED;
+int    w          = DEFAULT_WINDOW_LEN;
+
+std::string patternFilename  = "";
+std::string baselineFilename = "";
+std::string ubamFilename     = "";
+std::string tempDir          = "";
+
+StringVector tempFilename; // temporary files that have been created
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------------
+// showUsage() writes the program's usage to stderr
+
+void showUsage(const char *progname)
+{
+   std::cerr
+      << VERSION_NAME << ", " << COPYRIGHT << NEWLINE << NEWLINE
+      << "Usage: " << progname << " -pattern=filename OPTION ..." << NEWLINE;
+
+   std::cerr
+      << NEWLINE
+      << "The following are optional:" << NEWLINE
+      << "  -baseline=filename  "
+             << "file of baseline rates, written if it does not exist" << NEWLINE
+      << "  -save=N             "
+             << "1 = replace the baseline with these rates, default is "
+	     << DEFAULT_SAVE << NEWLINE
+      << "  -tolerance=N        "
+             << "percent slower than baseline that is a regression, default is "
+	     << doubleToString(DEFAULT_TOLERANCE) << NEWLINE
+      << "  -ubam=filename      "
+             << "unaligned Bam file for timing UbamPairReader, default is none"
+	     << NEWLINE
+      << "  -k=N                "
+             << "length of k-mers of the rank table, default is " << DEFAULT_K
+	     << NEWLINE
+      << "  -w=N                "
+             << "length of minimizer windows, default is " << DEFAULT_WINDOW_LEN
+	     << NEWLINE
+      << "  -pairs=N            "
+             << "number of synthetic read pairs, default is " << DEFAULT_PAIRS
+	     << NEWLINE
+      << "  -matching=N         "
+             << "percent of read pairs taken from patterns, default is "
+	     << DEFAULT_MATCHING << NEWLINE
+      << "  -readlen=N          "
+             << "length of synthetic reads, default is " << DEFAULT_READ_LEN
+	     << NEWLINE
+      << "  -repeat=N           "
+             << "runs of each benchmark, the fastest is kept, default is "
+	     << DEFAULT_REPEAT << NEWLINE
+      << "  -seed=N             "
+             << "seed of the random generator, default is " << DEFAULT_SEED
+	     << NEWLINE
+      << "  -tmpdir=string      "
+             << "directory of temporary files, default is $TMPDIR or /tmp"
+	     << NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// parseArgs() parses the command-line arguments and returns true if all are valid
+
+bool parseArgs(int argc, char *argv[])
+{
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg = argv[i];
+      if (arg.length() == 0)
+         continue;
+
+      if (arg[0] != '-')
+         return false; // not an option
+
+      StringVector opt;
+
+      if (splitString(arg, opt, '=') != 2)
+         return false; // incorrect option format
+
+      if (stringOpt(opt, "pattern",   patternFilename)  ||
+          stringOpt(opt, "baseline",  baselineFilename) ||
+          intOpt   (opt, "save",      save)             ||
+          doubleOpt(opt, "tolerance", tolerance)        ||
+          stringOpt(opt, "ubam",      ubamFilename)     ||
+          intOpt   (opt, "k",         k)                ||
+          intOpt   (opt, "w",         w)                ||
+          intOpt   (opt, "pairs",     numPairs)         ||
+          intOpt   (opt, "matching",  matching)         ||
+          intOpt   (opt, "readlen",   readLen)          ||
+          intOpt   (opt, "repeat",    repeat)           ||
+          intOpt   (opt, "seed",      seed)             ||
+          stringOpt(opt, "tmpdir",    tempDir))
+         continue;  // this option has been recognized
+
+      return false; // unrecognized option
+   }
+
+   if (tempDir == "")
+   {
+      const char *env = std::getenv("TMPDIR");
+      tempDir = (env && *env ? env : "/tmp");
+   }
+
+   return (patternFilename != "" && save >= 0 && save <= 1 && tolerance >= 0.0 &&
+           k >= 2 && k <= MAX_KMER_LENGTH && w >= 1 && w <= 255 && numPairs > 0 &&
+	   matching >= 0 && matching <= 100 && readLen > k + w && repeat > 0 &&
+	   seed >= 0 && tempDir != "");
+}
+
+//------------------------------------------------------------------------------------
+// secondsSince() returns the number of seconds elapsed since the given time
+
+inline double secondsSince(const Clock::time_point& start)
+{
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------------------
+// createTempFile() creates an empty temporary file and returns its name
+
+static std::string createTempFile()
+{
+   std::string pattern = tempDir + "/fuzzbench.XXXXXX";
+
+   std::vector<char> name(pattern.begin(), pattern.end());
+   name.push_back('\0');
+
+   int fd = mkstemp(&name[0]);
+   if (fd == -1)
+      throw std::runtime_error("unable to create a temporary file in " + tempDir);
+
+   ::close(fd);
+
+   tempFilename.push_back(&name[0]);
+   return tempFilename.back();
+}
+
+//------------------------------------------------------------------------------------
+// removeTempFiles() removes the temporary files that remain
+
+static void removeTempFiles()
+{
+   int numFiles = tempFilename.size();
+
+   for (int i = 0; i < numFiles; i++)
+      std::remove(tempFilename[i].c_str());
+
+   tempFilename.clear();
+}
+
+//------------------------------------------------------------------------------------
+
+struct KmerCounter // counts the k-mers found by findKmers()
+{
+   KmerCounter(KmerRank *inCount) : count(inCount) { }
+
+   void addKmer(Kmer kmer, int startIndex) { count[kmer]++; }
+   void finish(int numStarts) { }
+
+   KmerRank *count;
+};
+
+struct KmerCountCompare // orders k-mers by ascending count, then by ascending k-mer
+{
+   KmerCountCompare(const KmerRank *inCount) : count(inCount) { }
+
+   bool operator()(Kmer a, Kmer b) const
+   { return (count[a] != count[b] ? count[a] < count[b] : a < b); }
+
+   const KmerRank *count;
+};
+
+//------------------------------------------------------------------------------------
+// createPatternRankTable() returns a rank table of the given small k whose ranks are
+// derived from the k-mers of the pattern sequences rather than a reference genome,
+// so that the frequent k-mers of the patterns are not chosen as minimizers; it is
+// the caller's obligation to de-allocate the returned object
+
+static KmerRankTable *createPatternRankTable(KmerLength k,
+                                             const PatternVector *patternVector)
+{
+   KmerRankTable *table = new KmerRankTable(k); // the entries are zeroed
+
+   KmerCounter counter(table->rank);
+   int numPatterns = patternVector->size();
+
+   for (int i = 0; i < numPatterns; i++)
+   {
+      const std::string& sequence = (*patternVector)[i].sequence;
+      findKmers(sequence.c_str(), sequence.length(), k, counter);
+   }
+
+   Kmer n = numKmers(k);
+   std::vector<Kmer> kmer(n);
+
+   for (Kmer i = 0; i < n; i++)
+      kmer[i] = i;
+
+   std::sort(kmer.begin(), kmer.end(), KmerCountCompare(table->rank));
+
+   for (Kmer i = 0; i < n; i++)
+      table->rank[kmer[i]] = i;
+
+   return table;
+}
+
+//------------------------------------------------------------------------------------
+
+struct SyntheticPair // a read pair synthesized from a pattern or at random
+{
+   std::string name1, sequence1;
+   std::string name2, sequence2;
+   int index;  // index of the pattern, or (-1) if the pair is random
+   int offset; // offset of read 1 within the pattern sequence
+};
+
+typedef std::vector<SyntheticPair> SyntheticPairVector;
+
+//------------------------------------------------------------------------------------
+// mutate() substitutes a random base at ERROR_RATE of the positions of a read
+
+static void mutate(std::string& sequence, std::mt19937& random)
+{
+   std::uniform_real_distribution<double> chance(0.0, 1.0);
+   std::uniform_int_distribution<int>     base(0, 3);
+
+   int len = sequence.length();
+
+   for (int i = 0; i < len; i++)
+      if (chance(random) < ERROR_RATE)
+         sequence[i] = BASE_CHAR[base(random)];
+}
+
+//------------------------------------------------------------------------------------
+// synthesizePairs() creates numPairs read pairs; the given percent of them are taken
+// from random fragments of random patterns, with read 2 on the opposite strand, and
+// the rest are random sequences that resemble the reads matching no pattern
+
+static void synthesizePairs(const PatternVector *patternVector,
+                            SyntheticPairVector& pair)
+{
+   std::mt19937 random(seed);
+
+   std::uniform_int_distribution<int> percent(0, 99);
+   std::uniform_int_distribution<int> patternIndex(0, patternVector->size() - 1);
+   std::uniform_int_distribution<int> insertSize(MIN_INSERT, DEFAULT_MAX_INSERT - 1);
+   std::uniform_int_distribution<int> base(0, 3);
+
+   pair.resize(numPairs);
+
+   for (int i = 0; i < numPairs; i++)
+   {
+      SyntheticPair& p = pair[i];
+
+      p.name1 = "bench" + intToString(i) + "/1";
+      p.name2 = "bench" + intToString(i) + "/2";
+
+      p.index  = -1;
+      p.offset = 0;
+
+      if (percent(random) < matching)
+      {
+         int index = patternIndex(random);
+         const std::string& sequence = (*patternVector)[index].sequence;
+
+	 int seqlen  = sequence.length();
+	 int fragLen = std::min(insertSize(random), seqlen);
+	 int len     = std::min(readLen, fragLen);
+
+	 if (len > k + w)
+	 {
+            std::uniform_int_distribution<int> fragStart(0, seqlen - fragLen);
+	    int start = fragStart(random);
+
+	    p.index     = index;
+	    p.offset    = start;
+	    p.sequence1 = sequence.substr(start, len);
+	    p.sequence2 = stringReverseComplement(
+	                     sequence.substr(start + fragLen - len, len));
+
+	    mutate(p.sequence1, random);
+	    mutate(p.sequence2, random);
+	    continue;
+	 }
+      }
+
+      p.sequence1.resize(readLen);
+      p.sequence2.resize(readLen);
+
+      for (int j = 0; j < readLen; j++)
+      {
+         p.sequence1[j] = BASE_CHAR[base(random)];
+	 p.sequence2[j] = BASE_CHAR[base(random)];
+      }
+   }
+}
+
+//------------------------------------------------------------------------------------
+// writeFastq() writes read 1 or read 2 of the pairs to a new temporary FASTQ file,
+// whose name is returned
+
+static std::string writeFastq(const SyntheticPairVector& pair, bool second)
+{
+   std::string filename = createTempFile();
+
+   std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary);
+   if (!outfile.is_open())
+      throw std::runtime_error("unable to open " + filename);
+
+   int n = pair.size();
+
+   for (int i = 0; i < n; i++)
+   {
+      const std::string& name     = (second ? pair[i].name2 : pair[i].name1);
+      const std::string& sequence = (second ? pair[i].sequence2 : pair[i].sequence1);
+
+      outfile << '@' << name << NEWLINE << sequence << NEWLINE << '+' << NEWLINE
+              << std::string(sequence.length(), 'F') << NEWLINE;
+   }
+
+   outfile.close();
+
+   if (outfile.fail())
+      throw std::runtime_error("unable to write " + filename);
+
+   return filename;
+}
+
+//------------------------------------------------------------------------------------
+
+struct BenchResult // the rate of a benchmark
+{
+   std::string name;  // benchmark name
+   double      rate;  // items per second; higher is better
+   std::string unit;  // items per second, e.g., "pairs/s"
+};
+
+typedef std::vector<BenchResult> BenchResultVector;
+
+//------------------------------------------------------------------------------------
+
+struct BenchContext // the inputs shared by the benchmarks
+{
+   const PatternVector *patternVector;
+   PatternMap          *patternMap;
+   KmerRankTable       *rankTable;
+   Minimizer            maxMinimizer;
+   SyntheticPairVector  pair;
+   std::vector<EncodedRead> read1, read2; // encoded reads of each pair
+   std::string fastqFilename1, fastqFilename2;
+   std::string hitText; // text of the hits found by the end-to-end benchmark
+};
+
+//------------------------------------------------------------------------------------
+// runBench() runs fn the specified number of times and records the fastest rate;
+// fn returns the number of items it processed, and its result is accumulated in sink
+// so that the work cannot be optimized away
+
+static uint64_t sink = 0;
+
+template <class Function>
+void runBench(const std::string& name, const std::string& unit, Function fn,
+              BenchResultVector& result)
+{
+   double best = 0.0;
+
+   for (int i = 0; i < repeat; i++)
+   {
+      Clock::time_point start = Clock::now();
+      uint64_t items = fn();
+      double seconds = secondsSince(start);
+
+      if (seconds > 0.0)
+         best = std::max(best, items / seconds);
+   }
+
+   BenchResult r;
+   r.name = name;
+   r.rate = best;
+   r.unit = unit;
+   result.push_back(r);
+
+   std::cerr << "  " << name << NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// benchLCS() computes the LCS of each read synthesized from a pattern against the
+// pattern substring it came from
+
+static uint64_t benchLCS(BenchContext& c)
+{
+   uint64_t calls = 0;
+   int n = c.pair.size();
+
+   for (int i = 0; i < n; i++)
+      if (c.pair[i].index >= 0)
+      {
+         const ReadStrand&  read    = c.read1[i].forward;
+	 const std::string& pattern = (*c.patternVector)[c.pair[i].index].sequence;
+
+	 sink += lengthOfLCS(read, 0, read.length(), pattern, c.pair[i].offset,
+	                     std::min(read.length(),
+			              static_cast<int>(pattern.length()) -
+				      c.pair[i].offset));
+	 calls++;
+      }
+
+   return calls;
+}
+
+//------------------------------------------------------------------------------------
+// benchWindows() finds the minimizer windows of both strands of every read
+
+static uint64_t benchWindows(BenchContext& c)
+{
+   int n = c.pair.size();
+
+   for (int i = 0; i < n; i++)
+   {
+      EncodedRead *read[2] = { &c.read1[i], &c.read2[i] };
+
+      for (int j = 0; j < 2; j++)
+      {
+         read[j]->forward.clearWindows();
+	 read[j]->reverse.clearWindows();
+
+	 sink += read[j]->forward.getWindows(w, c.rankTable).size() +
+	         read[j]->reverse.getWindows(w, c.rankTable).size();
+      }
+   }
+
+   return 4 * static_cast<uint64_t>(n);
+}
+
+//------------------------------------------------------------------------------------
+// benchPatternMap() builds the map of the minimizers of the patterns
+
+static uint64_t benchPatternMap(BenchContext& c)
+{
+   PatternMap *patternMap = createPatternMap(c.patternVector, w, c.rankTable,
+                                             c.maxMinimizer);
+   sink += patternMap->size();
+   delete patternMap;
+
+   return c.patternVector->size();
+}
+
+//------------------------------------------------------------------------------------
+// benchMatches() matches every encoded read pair in both orientations, as fuzzion2
+// does
+
+static uint64_t benchMatches(BenchContext& c)
+{
+   MatchScratch scratch;
+   int n = c.pair.size();
+
+   for (int i = 0; i < n; i++)
+      for (int j = 0; j < 2; j++)
+      {
+         scratch.matchVector.clear();
+
+	 getMatches((j == 0 ? c.read1[i] : c.read2[i]),
+	            (j == 0 ? c.read2[i] : c.read1[i]), c.patternVector,
+		    c.patternMap, w, FIXED_WINDOWS, c.rankTable, c.maxMinimizer,
+		    DEFAULT_MIN_BASES, DEFAULT_MIN_MINS, DEFAULT_MAX_INSERT,
+		    DEFAULT_MAX_TRIM, true, false, scratch, scratch.matchVector);
+
+	 sink += scratch.matchVector.size();
+      }
+
+   return n;
+}
+
+//------------------------------------------------------------------------------------
+// benchFastq() reads the FASTQ file of the first reads
+
+static uint64_t benchFastq(BenchContext& c)
+{
+   FastqReader reader(c.fastqFilename1);
+   reader.open();
+
+   std::string name, sequence;
+   uint64_t reads = 0;
+
+   while (reader.getNext(name, sequence))
+   {
+      sink += sequence.length();
+      reads++;
+   }
+
+   reader.close();
+   return reads;
+}
+
+//------------------------------------------------------------------------------------
+// benchUbam() reads the read pairs of the unaligned Bam file
+
+static uint64_t benchUbam(BenchContext& c)
+{
+   UbamPairReader reader(ubamFilename);
+   reader.open();
+
+   std::string name1, sequence1, name2, sequence2;
+   uint64_t pairs = 0;
+
+   while (reader.getNextPair(name1, sequence1, name2, sequence2))
+   {
+      sink += sequence1.length() + sequence2.length();
+      pairs++;
+   }
+
+   reader.close();
+   return pairs;
+}
+
+//------------------------------------------------------------------------------------
+// appendHit() appends a match to the hit text in the way fuzzion2 writes it
+
+static void appendHit(const BenchContext& c, const std::string& name1,
+                      const std::string& sequence1, const std::string& name2,
+		      const std::string& sequence2, const Match& match,
+		      std::string& output)
+{
+   const Pattern& pattern = (*c.patternVector)[match.c1.index];
+
+   int offset1 = match.c1.offset;
+   int offset2 = match.c2.offset;
+
+   int leftOffset = std::min(offset1, offset2);
+   int fullLength = pattern.displaySequence.length();
+   int displayLen = std::min(match.insertSize() + 2, fullLength - leftOffset);
+
+   int leading1 = 0, leading2 = 0; // number of leading blanks
+
+   if (offset1 < offset2)
+      leading2 = offset2 - offset1 +
+                 (offset2 >= pattern.sequence.length() - pattern.rightBases ? 2 :
+		 (offset2 >= pattern.leftBases ? 1 : 0));
+   else if (offset2 < offset1)
+      leading1 = offset1 - offset2 +
+                 (offset1 >= pattern.sequence.length() - pattern.rightBases ? 2 :
+		 (offset1 >= pattern.leftBases ? 1 : 0));
+
+   appendHitPattern(output, pattern.name,
+                    pattern.displaySequence.c_str() + leftOffset, displayLen,
+		    pattern.annotation, match.matchingBases(), match.possible(),
+		    match.numSpanning(), match.insertSize());
+
+   appendHitRead(output, name1, leading1, sequence1, match.c1.matchingBases,
+                 match.c1.junctionSpanning, match.c1.leftOverlap,
+		 match.c1.rightOverlap);
+
+   appendHitRead(output, name2, leading2, sequence2, match.c2.matchingBases,
+                 match.c2.junctionSpanning, match.c2.leftOverlap,
+		 match.c2.rightOverlap);
+}
+
+//------------------------------------------------------------------------------------
+// benchEndToEnd() reads the FASTQ pairs, encodes them and matches them in both
+// orientations, checking the overlaps as fuzzion2 does in one thread; the hits are
+// kept as text for benchReadHits()
+
+static uint64_t benchEndToEnd(BenchContext& c)
+{
+   FastqPairReader reader(c.fastqFilename1, c.fastqFilename2);
+   reader.open();
+
+   std::string name1, seq1, name2, seq2;
+   EncodedRead read1, read2;
+   MatchScratch scratch;
+   MatchVector& matchVector = scratch.matchVector;
+
+   c.hitText.clear();
+   appendHitHeadingLine(c.hitText, CURRENT_VERSION, StringVector());
+
+   uint64_t pairs = 0;
+
+   while (reader.getNextPair(name1, seq1, name2, seq2))
+   {
+      read1.encode(seq1, c.rankTable->k);
+      read2.encode(seq2, c.rankTable->k);
+
+      for (int j = 0; j < 2; j++)
+      {
+         const EncodedRead& a = (j == 0 ? read1 : read2);
+	 const EncodedRead& b = (j == 0 ? read2 : read1);
+
+	 matchVector.clear();
+
+	 getMatches(a, b, c.patternVector, c.patternMap, w, FIXED_WINDOWS,
+	            c.rankTable, c.maxMinimizer, DEFAULT_MIN_BASES,
+		    DEFAULT_MIN_MINS, DEFAULT_MAX_INSERT, DEFAULT_MAX_TRIM, true,
+		    false, scratch, matchVector);
+
+	 int numMatches = matchVector.size();
+
+	 for (int i = 0; i < numMatches &&
+	      matchVector[i].validOverlaps(a.forward, b.reverse, c.patternVector,
+	                                   DEFAULT_MIN_BASES, DEFAULT_MIN_OVERLAP);
+	      i++)
+            appendHit(c, (j == 0 ? name1 : name2), a.forward.sequence,
+	              (j == 0 ? name2 : name1), b.reverse.sequence, matchVector[i],
+		      c.hitText);
+      }
+
+      pairs++;
+   }
+
+   reader.close();
+   return pairs;
+}
+
+//------------------------------------------------------------------------------------
+// benchReadHits() reads and sorts the hits found by benchEndToEnd()
+
+static uint64_t benchReadHits(BenchContext& c)
+{
+   std::istringstream istream(c.hitText);
+
+   std::string  version;
+   StringVector annotationHeading;
+   HitPool      hitPool;
+   HitVector    hitVector;
+
+   readHits(istream, version, annotationHeading, hitPool, hitVector);
+
+   sink += hitVector.size();
+   return hitVector.size();
+}
+
+//------------------------------------------------------------------------------------
+// runBenchmarks() prepares the inputs and runs each benchmark
+
+static void runBenchmarks(BenchResultVector& result)
+{
+   BenchContext c;
+
+   StringVector annotationHeading;
+
+   c.patternVector = readPatterns(patternFilename, annotationHeading);
+   if (c.patternVector->size() == 0)
+      throw std::runtime_error("no patterns in " + patternFilename);
+
+   c.rankTable    = createPatternRankTable(k, c.patternVector);
+   c.maxMinimizer = (maxRank / 100) * numKmers(k);
+   c.patternMap   = createPatternMap(c.patternVector, w, c.rankTable,
+                                     c.maxMinimizer);
+
+   synthesizePairs(c.patternVector, c.pair);
+
+   c.read1.resize(numPairs);
+   c.read2.resize(numPairs);
+
+   for (int i = 0; i < numPairs; i++)
+   {
+      c.read1[i].encode(c.pair[i].sequence1, k);
+      c.read2[i].encode(c.pair[i].sequence2, k);
+   }
+
+   c.fastqFilename1 = writeFastq(c.pair, false);
+   c.fastqFilename2 = writeFastq(c.pair, true);
+
+   runBench("lengthOfLCS", "calls/s",
+            [&c]() { return benchLCS(c); }, result);
+   runBench("getWindows", "strands/s",
+            [&c]() { return benchWindows(c); }, result);
+   runBench("createPatternMap", "patterns/s",
+            [&c]() { return benchPatternMap(c); }, result);
+   runBench("getMatches", "pairs/s",
+            [&c]() { return benchMatches(c); }, result);
+   runBench("FastqReader::getNext", "reads/s",
+            [&c]() { return benchFastq(c); }, result);
+
+   if (ubamFilename != "")
+      runBench("UbamPairReader::getNextPair", "pairs/s",
+               [&c]() { return benchUbam(c); }, result);
+
+   runBench("end-to-end", "pairs/s",
+            [&c]() { return benchEndToEnd(c); }, result);
+   runBench("readHits", "hits/s",
+            [&c]() { return benchReadHits(c); }, result);
+
+   delete c.patternMap;
+   delete c.rankTable;
+   delete c.patternVector;
+}
+
+//------------------------------------------------------------------------------------
+// readBaseline() reads the rates of a baseline file, returning false if the file
+// does not exist
+
+static bool readBaseline(BenchResultVector& baseline)
+{
+   std::ifstream infile(baselineFilename.c_str());
+   if (!infile.is_open())
+      return false;
+
+   std::string line;
+
+   while (getline(infile, line))
+   {
+      if (line == "" || line[0] == '#')
+         continue;
+
+      StringVector col;
+      BenchResult  r;
+
+      if (splitString(line, col) != 3 || (r.rate = stringToNonnegDouble(col[1])) < 0)
+         throw std::runtime_error("invalid line in " + baselineFilename);
+
+      r.name = col[0];
+      r.unit = col[2];
+      baseline.push_back(r);
+   }
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// writeBaseline() writes the rates to the baseline file
+
+static void writeBaseline(const BenchResultVector& result)
+{
+   std::ofstream outfile(baselineFilename.c_str());
+   if (!outfile.is_open())
+      throw std::runtime_error("unable to open " + baselineFilename);
+
+   outfile << "# " << VERSION_NAME << NEWLINE;
+
+   int n = result.size();
+
+   for (int i = 0; i < n; i++)
+      outfile << result[i].name << TAB << std::fixed << std::setprecision(1)
+              << result[i].rate << TAB << result[i].unit << NEWLINE;
+
+   outfile.close();
+
+   if (outfile.fail())
+      throw std::runtime_error("unable to write " + baselineFilename);
+}
+
+//------------------------------------------------------------------------------------
+// reportResults() writes the rates to stdout, compared with the baseline if there is
+// one, and returns the number of regressions
+
+static int reportResults(const BenchResultVector& result,
+                         const BenchResultVector& baseline)
+{
+   int regressions = 0;
+   int n = result.size();
+
+   std::cout << std::left << std::setw(30) << "benchmark"
+             << std::right << std::setw(16) << "rate" << "  ";
+
+   if (!baseline.empty())
+      std::cout << std::left << std::setw(12) << "unit"
+                << std::right << std::setw(16) << "baseline" << std::setw(10)
+                << "change";
+   else
+      std::cout << "unit";
+
+   std::cout << NEWLINE;
+
+   for (int i = 0; i < n; i++)
+   {
+      const BenchResult& r = result[i];
+
+      std::cout << std::left << std::setw(30) << r.name
+                << std::right << std::setw(16) << std::fixed << std::setprecision(1)
+		<< r.rate << "  " << std::left
+		<< std::setw(baseline.empty() ? 0 : 12) << r.unit;
+
+      const BenchResult *b = NULL;
+
+      for (size_t j = 0; j < baseline.size() && !b; j++)
+         if (baseline[j].name == r.name && baseline[j].unit == r.unit)
+	    b = &baseline[j];
+
+      if (b && b->rate > 0.0)
+      {
+         double change = 100.0 * (r.rate - b->rate) / b->rate;
+	 bool regressed = (change < -tolerance);
+
+	 std::cout << std::right << std::setw(16) << b->rate << std::setw(9)
+	           << std::showpos << change << std::noshowpos << '%'
+		   << (regressed ? "  REGRESSION" : "");
+
+	 if (regressed)
+	    regressions++;
+      }
+      else if (!baseline.empty())
+         std::cout << std::right << std::setw(16) << "none";
+
+      std::cout << NEWLINE;
+   }
+
+   return regressions;
+}
+
+//------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+   if (!parseArgs(argc, argv))
+   {
+      showUsage(argv[0]);
+      return 1;
+   }
+
+   int regressions = 0;
+
+   try
+   {
+      BenchResultVector result, baseline;
+
+      std::cerr << VERSION_NAME << ": " << numPairs << " read pairs, k=" << k
+                << ", w=" << w << NEWLINE;
+
+      runBenchmarks(result);
+      removeTempFiles();
+
+      bool haveBaseline = (baselineFilename != "" && readBaseline(baseline));
+
+      regressions = reportResults(result, baseline);
+
+      if (baselineFilename != "" && (!haveBaseline || save == 1))
+      {
+         writeBaseline(result);
+	 std::cerr << "baseline written to " << baselineFilename << NEWLINE;
+      }
+
+      if (regressions > 0)
+         std::cerr << regressions << " benchmark(s) more than "
+	           << doubleToString(tolerance) << "% slower than baseline"
+		   << NEWLINE;
+   }
+   catch (const std::runtime_error& error)
+   {
+      removeTempFiles();
+      std::cerr << argv[0] << ": " << error.what() << std::endl;
+      return 1;
+   }
+
+   return (regressions > 0 ? 1 : 0);
+}
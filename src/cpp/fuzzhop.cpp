@@ -11,20 +11,71 @@
 
 #include "hit.h"
 #include "version.h"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
 
 const std::string VERSION_NAME = "fuzzhop " + CURRENT_VERSION;
 
+const int DEFAULT_THREADS = 8; // default number of threads reading fuzzion2 files
+
+int numThreads = DEFAULT_THREADS;
+
 StringVector fuzzion2Filename;
 int numFuzzion2Files;
 
 //------------------------------------------------------------------------------------
 
-typedef std::map<std::string, IntVector> FlowcellLaneMap; // flowcell lane,
-                                                          // #hits in each file
+class LaneTable // assigns an integer ID to each distinct flowcell lane
+{
+public:
+   LaneTable() : id(), name() { }
+
+   virtual ~LaneTable() { }
+
+   int intern(const std::string& lane);
+
+   int size() const { return name.size(); }
+
+   std::unordered_map<std::string, int> id; // ID of each flowcell lane
+   StringVector name;                       // flowcell lane of each ID
+};
+
+//------------------------------------------------------------------------------------
+
+struct FileHitCount // the hits of one pattern in one fuzzion2 file
+{
+   FileHitCount() : hitCount(0), laneCount() { }
+
+   int hitCount;        // #hits of the pattern
+   IntVector laneCount; // #hits of the pattern in each flowcell lane, by lane ID
+};
+
+struct Fuzzion2File // the hit counts obtained from one fuzzion2 file by a thread
+{
+   Fuzzion2File()
+      : annotationHeading(), patternTable(), laneTable(), message(),
+        patternCount() { }
+
+   StringVector annotationHeading;
+   PatternTable patternTable; // patterns of the hits in this file
+   LaneTable    laneTable;    // flowcell lanes of the hits in this file
+   std::string  message;      // error message, or empty if the file was read
+
+   std::vector<FileHitCount> patternCount; // indexed by pattern table index
+};
+
+std::atomic<int> nextFile(0); // index of the next file to be read by a thread
+
+//------------------------------------------------------------------------------------
+
+typedef std::map<int, IntVector> FlowcellLaneMap; // flowcell lane ID,
+                                                  // #hits in each file
 
 class PatternHitCount
 {
@@ -34,7 +85,7 @@ public:
 
    virtual ~PatternHitCount() { }
 
-   void addHit(const std::string& readName, int fileIndex);
+   void addHits(int laneID, int count, int fileIndex);
 
    StringVector annotation; // pattern annotations
    IntVector hitCount;      // holds #hits of a pattern in each file
@@ -51,8 +102,15 @@ void showUsage(const char *progname)
    std::cerr
       << VERSION_NAME << ", " << COPYRIGHT << NEWLINE << NEWLINE
       << "Usage: " << progname
-      << " fuzzion2_filename1 fuzzion2_filename2 ... > possible_index_hops"
+      << " OPTION fuzzion2_filename1 fuzzion2_filename2 ... > possible_index_hops"
       << NEWLINE;
+
+   std::cerr
+      << NEWLINE
+      << "The following is optional:" << NEWLINE
+      << "  -threads=N      "
+             << "number of threads reading files, default is " << DEFAULT_THREADS
+	     << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
@@ -72,113 +130,231 @@ bool parseArgs(int argc, char *argv[])
 	 continue;
       }
 
+      StringVector opt;
+
+      if (splitString(arg, opt, '=') != 2)
+         return false; // incorrect option format
+
+      if (intOpt(opt, "threads", numThreads))
+         continue;  // this option has been recognized
+
       return false; // unrecognized option
    }
 
    numFuzzion2Files = fuzzion2Filename.size();
 
-   return (numFuzzion2Files > 1);
+   return (numFuzzion2Files > 1 && numThreads > 0);
+}
+
+//------------------------------------------------------------------------------------
+// LaneTable::intern() returns the ID of the given flowcell lane, assigning the next
+// ID if the lane is new
+
+int LaneTable::intern(const std::string& lane)
+{
+   std::unordered_map<std::string, int>::iterator pos = id.find(lane);
+   if (pos != id.end())
+      return pos->second;
+
+   int newID = name.size();
+
+   id.insert(std::make_pair(lane, newID));
+   name.push_back(lane);
+
+   return newID;
 }
 
 //------------------------------------------------------------------------------------
-// getFlowcellLane() returns the flowcell lane that is embedded in the given read
-// name, or returns the empty string if the flowcell lane cannot be determined; it is
+// getFlowcellLane() copies to flowcellLane the flowcell lane that is embedded in the
+// given read name, returning false if the flowcell lane cannot be determined; it is
 // assumed that a read name contains a series of values separated by colons, and that
 // the flowcell and lane are identified by all but the last three values of the series
 
-std::string getFlowcellLane(const std::string& readName)
+bool getFlowcellLane(const std::string& readName, std::string& flowcellLane)
+{
+   size_t end = readName.length();
+
+   for (int i = 0; i < 3; i++) // find the third colon from the end
+      if (end == 0 || (end = readName.rfind(':', end - 1)) == std::string::npos)
+         return false;
+
+   flowcellLane.assign(readName, 0, end);
+   return (end > 0);
+}
+
+//------------------------------------------------------------------------------------
+// countHits() reads the hits from the fuzzion2 file having the given index and
+// counts them by pattern and flowcell lane
+
+void countHits(int fileIndex, Fuzzion2File& file)
 {
-   StringVector part;
+   std::ifstream infile(fuzzion2Filename[fileIndex].c_str(),
+                        std::ios::in | std::ios::binary);
+   if (!infile.is_open())
+      throw std::runtime_error("unable to open " + fuzzion2Filename[fileIndex]);
+
+   HitReader reader(infile, file.patternTable);
+   Hit hit;
+   std::string flowcellLane; // reused for every hit
+
+   while (reader.next(hit))
+   {
+      if (!getFlowcellLane(hit.read1.name, flowcellLane))
+         throw std::runtime_error("unable to obtain flowcell lane from read name " +
+                                  hit.read1.name + " in " +
+				  fuzzion2Filename[fileIndex]);
+
+      int patternIndex = hit.pattern.index();
+
+      if (patternIndex >= file.patternCount.size())
+         file.patternCount.resize(patternIndex + 1);
 
-   int numParts = splitString(readName, part, ':');
-   if (numParts < 4)
-      return "";
+      FileHitCount& count = file.patternCount[patternIndex];
+      count.hitCount++;
 
-   int numKeep = numParts - 3;
+      int laneID = file.laneTable.intern(flowcellLane);
 
-   std::string flowcellLane = part[0];
+      if (laneID >= count.laneCount.size())
+         count.laneCount.resize(laneID + 1, 0);
 
-   for (int i = 1; i < numKeep; i++)
-      flowcellLane += ":" + part[i];
+      count.laneCount[laneID]++;
+   }
+
+   infile.close();
 
-   return flowcellLane;
+   file.annotationHeading = reader.annotationHeading;
 }
 
 //------------------------------------------------------------------------------------
-// PatternHitCount::addHit() increments the #hits for the file having the specified
-// index from 0 to (numFuzzion2Files - 1)
+// readerWork() contains the work of each reader thread, which counts the hits of
+// files until none remain; an exception is recorded in the file being read
 
-void PatternHitCount::addHit(const std::string& readName, int fileIndex)
+void readerWork(std::vector<Fuzzion2File *> *fuzzion2File)
 {
-   std::string flowcellLane = getFlowcellLane(readName);
-   if (flowcellLane == "")
-      throw std::runtime_error("unable to obtain flowcell lane from read name " +
-                               readName + " in " + fuzzion2Filename[fileIndex]);
+   int i;
 
-   hitCount[fileIndex]++; // increment the overall hit count
+   while ((i = nextFile++) < numFuzzion2Files)
+   {
+      Fuzzion2File& file = *(*fuzzion2File)[i];
+
+      try
+      {
+         countHits(i, file);
+      }
+      catch (const std::runtime_error& error)
+      {
+         file.message = error.what();
+      }
+   }
+}
+
+//------------------------------------------------------------------------------------
+// PatternHitCount::addHits() adds the given number of hits in a flowcell lane to the
+// file having the specified index from 0 to (numFuzzion2Files - 1)
+
+void PatternHitCount::addHits(int laneID, int count, int fileIndex)
+{
+   hitCount[fileIndex] += count; // increment the overall hit count
 
    // now increment the hit count for this flowcell and lane
 
-   FlowcellLaneMap::iterator fpos = fmap.find(flowcellLane);
+   FlowcellLaneMap::iterator fpos = fmap.find(laneID);
    if (fpos == fmap.end())
-   {
-      fmap.insert(std::make_pair(flowcellLane, IntVector(numFuzzion2Files, 0)));
-      fpos = fmap.find(flowcellLane);
-   }
+      fpos = fmap.insert(std::make_pair(laneID,
+                                        IntVector(numFuzzion2Files, 0))).first;
 
    IntVector& flowcellLaneCount = fpos->second;
-   flowcellLaneCount[fileIndex]++;
+   flowcellLaneCount[fileIndex] += count;
 }
 
 //------------------------------------------------------------------------------------
-// addPatternHit() increments the #hits for the file having the specified index from
-// 0 to (numFuzzion2Files - 1); this is done for the pattern and read name of the
-// given hit
+// addFileHits() adds the hit counts of the file having the specified index to the
+// PatternHitMap, translating its flowcell lanes to the IDs of laneTable
 
-void addPatternHit(PatternHitMap& pmap, const Hit *hit, int fileIndex)
+void addFileHits(PatternHitMap& pmap, LaneTable& laneTable, const Fuzzion2File& file,
+                 int fileIndex)
 {
-   const std::string& patternName = hit->pattern->name;
+   int numLanes = file.laneTable.size();
+   IntVector laneID(numLanes);
+
+   for (int j = 0; j < numLanes; j++)
+      laneID[j] = laneTable.intern(file.laneTable.name[j]);
+
+   int numPatterns = file.patternCount.size();
 
-   PatternHitMap::iterator ppos = pmap.find(patternName);
-   if (ppos == pmap.end())
+   for (int j = 0; j < numPatterns; j++)
    {
-      pmap.insert(std::make_pair(patternName,
-                  PatternHitCount(hit->pattern->annotation, numFuzzion2Files)));
-      ppos = pmap.find(patternName);
-   }
+      const FileHitCount& count = file.patternCount[j];
+      if (count.hitCount == 0)
+         continue;
+
+      const InternedPattern& pattern = file.patternTable[j];
 
-   PatternHitCount& patternHitCount = ppos->second;
-   patternHitCount.addHit(hit->read1->name, fileIndex);
+      PatternHitMap::iterator ppos = pmap.find(pattern.name);
+      if (ppos == pmap.end())
+         ppos = pmap.insert(std::make_pair(pattern.name,
+	                    PatternHitCount(pattern.annotation,
+			                    numFuzzion2Files))).first;
+
+      PatternHitCount& patternHitCount = ppos->second;
+
+      int numCounts = count.laneCount.size();
+
+      for (int k = 0; k < numCounts; k++)
+         if (count.laneCount[k] > 0)
+            patternHitCount.addHits(laneID[k], count.laneCount[k], fileIndex);
+   }
 }
 
 //------------------------------------------------------------------------------------
-// initializePatternHitMap() reads the hits from the input files and updates the
-// PatternHitMap
+// initializePatternHitMap() reads the hits from the input files concurrently and
+// updates the PatternHitMap and the table of flowcell lanes
 
-void initializePatternHitMap(PatternHitMap& pmap, StringVector& annotationHeading)
+void initializePatternHitMap(PatternHitMap& pmap, LaneTable& laneTable,
+                             StringVector& annotationHeading)
 {
-   for (int i = 0; i < numFuzzion2Files; i++) // i is the file index
-   {
-      std::ifstream infile(fuzzion2Filename[i].c_str());
-      if (!infile.is_open())
-         throw std::runtime_error("unable to open " + fuzzion2Filename[i]);
+   int numReaders = std::min(numThreads, numFuzzion2Files);
+
+   std::vector<Fuzzion2File *> fuzzion2File(numFuzzion2Files, NULL);
 
-      std::string version;
-      HitVector   hitVector;
+   for (int i = 0; i < numFuzzion2Files; i++)
+      fuzzion2File[i] = new Fuzzion2File();
 
-      readHits(infile, version, annotationHeading, hitVector);
+   std::thread **thread = new std::thread *[numReaders];
 
-      infile.close();
+   for (int i = 0; i < numReaders; i++)
+      thread[i] = new std::thread(readerWork, &fuzzion2File);
 
-      int numHits = hitVector.size();
+   for (int i = 0; i < numReaders; i++)
+   {
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   delete[] thread;
+
+   // the files are added in order, and the first error in file order is reported
 
-      for (int j = 0; j < numHits; j++)
+   std::string error = "";
+
+   for (int i = 0; i < numFuzzion2Files; i++) // i is the file index
+   {
+      if (error == "")
       {
-         Hit *hit = hitVector[j];
-	 addPatternHit(pmap, hit, i);
-	 delete hit;
+         error = fuzzion2File[i]->message;
+
+	 if (error == "")
+	 {
+            addFileHits(pmap, laneTable, *fuzzion2File[i], i);
+	    annotationHeading = fuzzion2File[i]->annotationHeading;
+	 }
       }
+
+      delete fuzzion2File[i];
    }
+
+   if (error != "")
+      throw std::runtime_error(error);
 }
 
 //------------------------------------------------------------------------------------
@@ -200,22 +376,71 @@ void writeHeadingLine(const StringVector& annotationHeading)
    std::cout << NEWLINE;
 }
 
+//------------------------------------------------------------------------------------
+// LaneNameCompare orders flowcell lane IDs by the names of the lanes, and
+// LaneRankCompare orders positions of a FlowcellLaneMap by the ranks of their lanes
+
+struct LaneNameCompare
+{
+   LaneNameCompare(const LaneTable& inLaneTable) : laneTable(inLaneTable) { }
+
+   bool operator()(int a, int b) const
+   { return (laneTable.name[a] < laneTable.name[b]); }
+
+   const LaneTable& laneTable;
+};
+
+struct LaneRankCompare
+{
+   LaneRankCompare(const IntVector& inLaneRank) : laneRank(inLaneRank) { }
+
+   bool operator()(const FlowcellLaneMap::iterator& a,
+                   const FlowcellLaneMap::iterator& b) const
+   { return (laneRank[a->first] < laneRank[b->first]); }
+
+   const IntVector& laneRank;
+};
+
 //------------------------------------------------------------------------------------
 // writePossibleHops() writes to stdout each detected possible instance of index
 // hopping
 
-void writePossibleHops(PatternHitMap& pmap)
+void writePossibleHops(PatternHitMap& pmap, const LaneTable& laneTable)
 {
+   // the flowcell lanes of each pattern are written in order of their names
+
+   int numLanes = laneTable.size();
+   IntVector laneOrder(numLanes);
+
+   for (int i = 0; i < numLanes; i++)
+      laneOrder[i] = i;
+
+   std::sort(laneOrder.begin(), laneOrder.end(), LaneNameCompare(laneTable));
+
+   IntVector laneRank(numLanes);
+
+   for (int i = 0; i < numLanes; i++)
+      laneRank[laneOrder[i]] = i;
+
    for (PatternHitMap::iterator ppos = pmap.begin(); ppos != pmap.end(); ++ppos)
    {
       const std::string& patternName     = ppos->first;
       PatternHitCount&   patternHitCount = ppos->second;
       FlowcellLaneMap&   fmap            = patternHitCount.fmap;
 
+      std::vector<FlowcellLaneMap::iterator> lanePos;
+
       for (FlowcellLaneMap::iterator fpos = fmap.begin(); fpos != fmap.end(); ++fpos)
+         lanePos.push_back(fpos);
+
+      std::sort(lanePos.begin(), lanePos.end(), LaneRankCompare(laneRank));
+
+      int numPatternLanes = lanePos.size();
+
+      for (int lane = 0; lane < numPatternLanes; lane++)
       {
-         const std::string& flowcellLane      = fpos->first;
-	 const IntVector&   flowcellLaneCount = fpos->second;
+         const std::string& flowcellLane      = laneTable.name[lanePos[lane]->first];
+	 const IntVector&   flowcellLaneCount = lanePos[lane]->second;
 
 	 IntVector positiveFileIndex;  // indices of files having hits
 
@@ -262,12 +487,13 @@ int main(int argc, char *argv[])
    try
    {
       PatternHitMap pmap;
+      LaneTable     laneTable;
       StringVector  annotationHeading;
 
-      initializePatternHitMap(pmap, annotationHeading);
+      initializePatternHitMap(pmap, laneTable, annotationHeading);
 
       writeHeadingLine(annotationHeading);
-      writePossibleHops(pmap);
+      writePossibleHops(pmap, laneTable);
    }
    catch (const std::runtime_error& error)
    {
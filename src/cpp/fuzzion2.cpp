@@ -9,65 +9,143 @@
 //
 //------------------------------------------------------------------------------------
 
+#include "abam.h"
+#include "batch.h"
+#include "cache.h"
+#include "candidate.h"
 #include "fastq.h"
 #include "hit.h"
+#include "index.h"
 #include "match.h"
+#include "numa.h"
 #include "ubam.h"
 #include "version.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
+#include <queue>
 #include <stdexcept>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <thread>
+#include <unistd.h>
 
 const std::string VERSION_NAME   = FUZZION2 + CURRENT_VERSION;
 
-const int    THREAD_BATCH_SIZE   = 100000; // number of read pairs in a full batch
+const int    THREAD_BATCH_SIZE   = 100000; // maximum number of read pairs in a batch
+const int    MIN_BATCH_SIZE      = 2000;   // minimum read pairs the reader fills to
+const double BATCH_SECONDS       = 0.05;   // matching time sought for each batch
+const int    BATCH_RANGE_SIZE    = 500;    // read pairs a matching thread claims
+const int    EXTRA_BATCHES       = 2;      // batches the reader can fill ahead
+const int    MAX_INFLATE_THREADS = 4;      // threads inflating a BGZF file
+const size_t OUTPUT_BUFFER_SIZE  = 1 << 20; // bytes of hits a thread buffers
 
 const double DEFAULT_MAX_RANK    = 99.9; // default max rank percentile of minimizers
+const int    DEFAULT_BAM_THREADS = 4;    // default threads decompressing each Bam
+const int    DEFAULT_DUP_CACHE   = 0;    // default read pairs in the match cache
+const int    DEFAULT_MAX_LOCS    = 0;    // default max locations of a minimizer
 const double DEFAULT_MIN_BASES   = 90.0; // default min percentile of matching bases
 const int    DEFAULT_MAX_INSERT  = 500;  // default max insert size in bases
 const int    DEFAULT_MAX_TRIM    = 5;    // default max bases, second ahead of first
 const int    DEFAULT_MIN_MINS    = 1;    // default min number of matching minimizers
 const int    DEFAULT_MIN_OVERLAP = 5;    // default min length of overlap in #bases
+const int    DEFAULT_NUMA        = 0;    // default setting of -numa option
+const int    DEFAULT_POPULATE    = 0;    // default setting of -populate option
 const int    DEFAULT_SHOW        = 1;    // default setting of -show option
 const int    DEFAULT_SINGLE      = 0;    // default setting of -single option
+const int    DEFAULT_SLIDING     = 0;    // default setting of -sliding option
+const int    DEFAULT_SORTED      = 0;    // default setting of -sorted option
 const int    DEFAULT_THREADS     = 8;    // default number of threads
 const int    DEFAULT_WINDOW_LEN  = 10;   // default length of windows in #bases
 
+const std::string TEXT_FORMAT    = "text"; // hits written as lines of text
+const std::string BINARY_FORMAT  = "bin";  // hits written as a binary stream
+const std::string DEFAULT_FORMAT = TEXT_FORMAT;
+
 double maxRank    = DEFAULT_MAX_RANK;
 double minBases   = DEFAULT_MIN_BASES;
+int    bamThreads = DEFAULT_BAM_THREADS;
+int    dupCache   = DEFAULT_DUP_CACHE;
 int    maxInsert  = DEFAULT_MAX_INSERT;
+int    maxLocs    = DEFAULT_MAX_LOCS;
 int    maxTrim    = DEFAULT_MAX_TRIM;
 int    minMins    = DEFAULT_MIN_MINS;
 int    minOverlap = DEFAULT_MIN_OVERLAP;
+int    numa       = DEFAULT_NUMA;
+int    populate   = DEFAULT_POPULATE;
 int    show       = DEFAULT_SHOW;
 int    single     = DEFAULT_SINGLE;
+int    sliding    = DEFAULT_SLIDING;
+int    sorted     = DEFAULT_SORTED;
 int    numThreads = DEFAULT_THREADS;
 int    w          = DEFAULT_WINDOW_LEN;
 
 std::string    patternFilename = ""; // name of pattern input file
 std::string    rankFilename    = ""; // name of k-mer rank table binary input file
+std::string    indexFilename   = ""; // name of pattern index input file
+std::string    buildIndexFilename = ""; // name of pattern index output file
 
 std::string    fastqFilename1  = ""; // name of FASTQ input file containing Read 1
 std::string    fastqFilename2  = ""; // name of FASTQ input file containing Read 2
 std::string    ifastqFilename  = ""; // name of interleaved FASTQ input file
 std::string    ubamFilename    = ""; // name of unaligned Bam input file
+std::string    abamFilename    = ""; // name of aligned Bam input file
+std::string    regionsFilename = ""; // name of gene regions input file for -abam
+std::string    samplesFilename = ""; // name of sample manifest input file
+std::string    serveSocket     = ""; // path of Unix socket on which jobs are served
+std::string    format          = DEFAULT_FORMAT; // output format of hits
+std::string    statsFilename   = ""; // name of JSON output file of run statistics
+std::string    candidatesFilename = ""; // name of candidate read pairs input file
+std::string    saveCandidatesFilename = ""; // name of candidate read pairs output
+std::string    shardOption     = ""; // value of -shard option, i/N
+int            shardIndex      = 1;  // 1-based index of the shard processed
+int            numShards       = 1;  // number of shards of the input
 StringVector   inputFilename;        // names of input files listed on command line
 
 KmerRankTable *rankTable;            // holds the k-mer rank table
 Minimizer      maxMinimizer;         // limit used to identify common minimizers
+WindowScheme   scheme;               // how the minimizer windows are formed
 
 PatternVector *patternVector;        // holds the input patterns
 PatternMap    *patternMap;           // index of pattern minimizers
+NumaTopology  *numaTopology = NULL;  // NUMA nodes of the machine, if -numa=1
+MatchCache    *matchCache   = NULL;  // matches of recent read pairs, if -dupcache
 
 PairReader    *pairReader;           // used to get read pairs from input files
-bool           endOfInput = false;   // set to true when done getting read pairs
+CandidatePairReader *candidateReader = NULL; // pairReader, if -candidates is given
+CandidateWriter     *candidateWriter = NULL; // if -savecandidates is given
+
+std::atomic<bool> endOfInput(false); // set to true to stop getting read pairs
+
+BatchQueue     emptyBatches;         // batches available to the reader thread
+RangeQueue     fullBatches(BATCH_RANGE_SIZE); // batches of read pairs being matched
+
+std::atomic<uint64_t> matchedPairs(0); // read pairs matched by all of the threads,
+std::atomic<uint64_t> matchNanos(0);   // and the nanoseconds spent matching them
 
-std::mutex     inputMutex;           // for getting read pairs
 std::mutex     outputMutex;          // for writing hits to std::cout
+std::mutex     candidateMutex;       // for writing to candidateWriter
+
+std::vector<uint8_t> patternWritten; // indexed by pattern; 1 once a binary record
+                                     // defining the pattern has been buffered
+
+IntVector      patternRank;          // indexed by pattern; rank of its name among the
+                                     // distinct pattern names, for sorted output
 
 uint64_t       numReadPairs = 0;     // number of read pairs found in the input
 
+typedef std::chrono::steady_clock Clock;
+
+Clock::time_point startTime = Clock::now(); // when the program started
+
 //------------------------------------------------------------------------------------
 // showUsage() writes the program's usage to stderr
 
@@ -85,12 +163,23 @@ void showUsage(const char *progname)
              << "name of pattern input file" << NEWLINE
       << "  -rank=filename      "
              << "name of binary  input file containing the k-mer rank table"
+	     << NEWLINE
+      << NEWLINE
+      << "These options are for a prebuilt pattern index:" << NEWLINE
+      << "  -buildindex=filename  "
+             << "write pattern index file for -pattern, -rank, -maxrank,"
+	     << NEWLINE
+      << "                        "
+             << "-sliding and -w, then stop without reading any input" << NEWLINE
+      << "  -index=filename       "
+             << "name of pattern index file built with the same options"
 	     << NEWLINE;
 
    std::cerr
       << NEWLINE
-      << "Specify -fastq1 and -fastq2, or -ifastq or -ubam, "
-      << "or list filenames on command line" << NEWLINE
+      << "Specify -fastq1 and -fastq2, or -ifastq or -ubam or -abam or -candidates,"
+      << NEWLINE << "or -samples or -serve, or list filenames on command line"
+      << NEWLINE
       << "  -fastq1=filename    "
              << "name of FASTQ Read 1 input file" << NEWLINE
       << "  -fastq2=filename    "
@@ -98,15 +187,70 @@ void showUsage(const char *progname)
       << "  -ifastq=filename    "
              << "name of interleaved FASTQ input file (may be /dev/stdin)" << NEWLINE
       << "  -ubam=filename      "
-             << "name of unaligned Bam input file" << NEWLINE;
+             << "name of unaligned Bam input file" << NEWLINE
+      << "  -abam=filename      "
+             << "name of aligned Bam or Cram input file, sorted and indexed;"
+	     << NEWLINE
+      << "                      "
+             << "only pairs with an unmapped read, discordant mate or soft clip"
+	     << NEWLINE
+      << "                      "
+             << "are read, unless -regions is given" << NEWLINE
+      << "  -regions=filename   "
+             << "gene regions to read from -abam via its index; each line has a"
+	     << NEWLINE
+      << "                      "
+             << "gene, reference name, first and last position (tab-separated);"
+	     << NEWLINE
+      << "                      "
+             << "regions of genes named in pattern annotations are read, plus"
+	     << NEWLINE
+      << "                      "
+             << "the unmapped pairs and the mates of the reads in the regions"
+	     << NEWLINE
+      << "  -candidates=filename" << NEWLINE
+      << "                      "
+             << "name of candidate file saved by -savecandidates; its read pairs"
+	     << NEWLINE
+      << "                      "
+             << "are matched again, e.g., under other thresholds or to a subset"
+	     << NEWLINE
+      << "                      "
+             << "of the patterns" << NEWLINE
+      << "  -samples=filename   "
+             << "name of sample manifest; each line has an output filename"
+	     << NEWLINE
+      << "                      "
+             << "followed by input filenames, separated by tabs" << NEWLINE
+      << "  -serve=filename     "
+             << "path of Unix socket on which to serve jobs; each job is a line"
+	     << NEWLINE
+      << "                      "
+             << "like that of a sample manifest, optionally preceded by -maxins,"
+	     << NEWLINE
+      << "                      "
+             << "-maxtrim, -minbases, -minmins, -minov, -show and -single options"
+	     << NEWLINE;
 
    std::cerr
       << NEWLINE
       << "The following are optional:" << NEWLINE
       << "   N is a numeric value, e.g., -threads=4" << NEWLINE
+      << "  -bamthreads=N "
+             << "threads decompressing each Bam file . . . . . . . . default "
+	     << DEFAULT_BAM_THREADS << NEWLINE
+      << "  -dupcache=N   "
+             << "read pairs cached to skip matching duplicates . . . default "
+	     << DEFAULT_DUP_CACHE << NEWLINE
+      << "  -format=name  "
+             << "output format of hits (text or bin) . . . . . . . . default "
+	     << DEFAULT_FORMAT << NEWLINE
       << "  -maxins=N     "
              << "maximum insert size in bases. . . . . . . . . . . . default "
 	     << DEFAULT_MAX_INSERT << NEWLINE
+      << "  -maxlocs=N    "
+             << "max pattern locations of a seeding minimizer. . . . default "
+	     << DEFAULT_MAX_LOCS << NEWLINE
       << "  -maxrank=N    "
              << "maximum rank percentile of minimizers . . . . . . . default "
              << doubleToString(DEFAULT_MAX_RANK) << NEWLINE
@@ -122,12 +266,34 @@ void showUsage(const char *progname)
       << "  -minov=N      "
              << "minimum overlap in number of bases. . . . . . . . . default "
              << DEFAULT_MIN_OVERLAP << NEWLINE
+      << "  -numa=N       "
+             << "spread threads and tables over NUMA nodes (1) . . . default "
+             << DEFAULT_NUMA << NEWLINE
+      << "  -populate=N   "
+             << "prefault pages of a memory-mapped rank table (1). . default "
+             << DEFAULT_POPULATE << NEWLINE
+      << "  -shard=i/N    "
+             << "process only shard i of N of the read pairs . . . . default "
+	     << "1/1" << NEWLINE
+      << "  -savecandidates=file" << NEWLINE
+      << "                "
+             << "write candidate read pairs for -candidates to file. default "
+	     << "none" << NEWLINE
       << "  -show=N       "
              << "show best only (1) or all patterns (0) that match . default "
 	     << DEFAULT_SHOW << NEWLINE
       << "  -single=N     "
              << "show single-read (1) or just read-pair (0) matches. default "
 	     << DEFAULT_SINGLE << NEWLINE
+      << "  -sliding=N    "
+             << "use sliding (1) or fixed (0) minimizer windows. . . default "
+	     << DEFAULT_SLIDING << NEWLINE
+      << "  -sorted=N     "
+             << "write hits in sorted (1) or found (0) order . . . . default "
+	     << DEFAULT_SORTED << NEWLINE
+      << "  -stats=file   "
+             << "write time and counts of the run to file as JSON. . default "
+	     << "none" << NEWLINE
       << "  -threads=N    "
              << "number of threads . . . . . . . . . . . . . . . . . default "
 	     << DEFAULT_THREADS << NEWLINE
@@ -136,6 +302,17 @@ void showUsage(const char *progname)
              << DEFAULT_WINDOW_LEN << NEWLINE;
 }
 
+//------------------------------------------------------------------------------------
+// validThresholds() returns true if the options that may be given per job have valid
+// values
+
+bool validThresholds()
+{
+   return (minBases > 0.0 && minBases <= 100.0 && maxInsert > 0 && maxTrim >= 0 &&
+           minMins > 0 && minOverlap > 0 && (show == 0 || show == 1) &&
+	   (single == 0 || single == 1));
+}
+
 //------------------------------------------------------------------------------------
 // parseArgs() parses the command-line arguments and returns true if all are valid
 
@@ -161,42 +338,91 @@ bool parseArgs(int argc, char *argv[])
 
       if (doubleOpt(opt, "maxrank",  maxRank)         ||
           doubleOpt(opt, "minbases", minBases)        ||
+	  intOpt   (opt, "bamthreads", bamThreads)    ||
+	  intOpt   (opt, "dupcache", dupCache)        ||
 	  intOpt   (opt, "maxins",   maxInsert)       ||
+	  intOpt   (opt, "maxlocs",  maxLocs)         ||
 	  intOpt   (opt, "maxtrim",  maxTrim)         ||
 	  intOpt   (opt, "minmins",  minMins)         ||
           intOpt   (opt, "minov",    minOverlap)      ||
+          intOpt   (opt, "numa",     numa)            ||
+          intOpt   (opt, "populate", populate)        ||
           intOpt   (opt, "show",     show)            ||
 	  intOpt   (opt, "single",   single)          ||
+	  intOpt   (opt, "sliding",  sliding)         ||
+	  intOpt   (opt, "sorted",   sorted)          ||
 	  intOpt   (opt, "threads",  numThreads)      ||
           intOpt   (opt, "w",        w)               ||
           stringOpt(opt, "pattern",  patternFilename) ||
 	  stringOpt(opt, "rank",     rankFilename)    ||
+	  stringOpt(opt, "index",    indexFilename)   ||
+	  stringOpt(opt, "buildindex", buildIndexFilename) ||
 	  stringOpt(opt, "fastq1",   fastqFilename1)  ||
 	  stringOpt(opt, "fastq2",   fastqFilename2)  ||
 	  stringOpt(opt, "ifastq",   ifastqFilename)  ||
-	  stringOpt(opt, "ubam",     ubamFilename))
+	  stringOpt(opt, "ubam",     ubamFilename)    ||
+	  stringOpt(opt, "abam",     abamFilename)    ||
+	  stringOpt(opt, "regions",  regionsFilename) ||
+	  stringOpt(opt, "candidates", candidatesFilename) ||
+	  stringOpt(opt, "savecandidates", saveCandidatesFilename) ||
+	  stringOpt(opt, "samples",  samplesFilename) ||
+	  stringOpt(opt, "serve",    serveSocket)     ||
+	  stringOpt(opt, "stats",    statsFilename)   ||
+	  stringOpt(opt, "shard",    shardOption)     ||
+	  stringOpt(opt, "format",   format))
          continue;  // this option has been recognized
 
       return false; // unrecognized option
    }
 
-   if (inputFilename.size() > 0)  // list of file names on the command line
+   if (buildIndexFilename != "")  // write pattern index file and stop
+   {
+      if (indexFilename != "" || samplesFilename != "" || serveSocket != "" ||
+          inputFilename.size() > 0 || fastqFilename1 != "" || fastqFilename2 != "" ||
+          ifastqFilename != "" || ubamFilename != "" || abamFilename != "" ||
+	  candidatesFilename != "" || saveCandidatesFilename != "")
+         return false;
+   }
+   else if (samplesFilename != "" || serveSocket != "") // sample manifest or jobs
+   {
+      if (samplesFilename != "" && serveSocket != "")
+         return false;
+
+      if (inputFilename.size() > 0 || fastqFilename1 != "" || fastqFilename2 != "" ||
+          ifastqFilename != "" || ubamFilename != "" || abamFilename != "" ||
+	  candidatesFilename != "" || saveCandidatesFilename != "")
+         return false;
+   }
+   else if (candidatesFilename != "") // candidate read pairs saved by an earlier run
+   {
+      if (inputFilename.size() > 0 || fastqFilename1 != "" || fastqFilename2 != "" ||
+          ifastqFilename != "" || ubamFilename != "" || abamFilename != "" ||
+	  shardOption != "")
+         return false;
+   }
+   else if (inputFilename.size() > 0) // list of file names on the command line
    {
       if (fastqFilename1 != "" || fastqFilename2 != "" || ifastqFilename != "" ||
-          ubamFilename != "")
+          ubamFilename != "" || abamFilename != "")
          return false;
    }
    else if (fastqFilename1 != "") // pair of FASTQ input files
    {
-      if (fastqFilename2 == "" || ifastqFilename != "" || ubamFilename != "")
+      if (fastqFilename2 == "" || ifastqFilename != "" || ubamFilename != "" ||
+          abamFilename != "")
          return false;
    }
    else if (ifastqFilename != "") // interleaved FASTQ input file
    {
-      if (fastqFilename2 != "" || ubamFilename != "")
+      if (fastqFilename2 != "" || ubamFilename != "" || abamFilename != "")
          return false;
    }
    else if (ubamFilename != "")   // unaligned Bam input file
+   {
+      if (fastqFilename2 != "" || abamFilename != "")
+         return false;
+   }
+   else if (abamFilename != "")   // aligned Bam input file
    {
       if (fastqFilename2 != "")
          return false;
@@ -204,10 +430,26 @@ bool parseArgs(int argc, char *argv[])
    else // missing input file names
       return false;
 
-   return (maxRank > 0.0 && maxRank <= 100.0 && minBases > 0.0 && minBases <= 100.0 &&
-	   maxInsert > 0 && maxTrim >= 0 && minMins > 0 && minOverlap > 0 &&
-	   (show == 0 || show == 1) && (single == 0 || single == 1) &&
-	   numThreads > 0 && numThreads <= 64 && w > 0 && w < 256 &&
+   if (regionsFilename != "" && abamFilename == "")
+      return false;
+
+   if (shardOption != "")
+   {
+      StringVector part;
+
+      if (splitString(shardOption, part, '/') != 2 ||
+          (shardIndex = stringToNonnegInt(part[0])) < 1 ||
+          (numShards  = stringToNonnegInt(part[1])) < shardIndex)
+         return false;
+   }
+
+   return (maxRank > 0.0 && maxRank <= 100.0 && validThresholds() &&
+	   (numa == 0 || numa == 1) && (populate == 0 || populate == 1) &&
+	   (sliding == 0 || sliding == 1) && (sorted == 0 || sorted == 1) &&
+	   (format == TEXT_FORMAT || format == BINARY_FORMAT) &&
+	   numThreads > 0 && numThreads <= 64 && bamThreads > 0 && bamThreads <= 64 &&
+	   dupCache >= 0 && maxLocs >= 0 &&
+	   w > 0 && w < 256 &&
 	   patternFilename != "" && rankFilename != "");
 }
 
@@ -271,13 +513,189 @@ InputReader *createInputReader(const StringVector& inputFilename)
 }
 
 //------------------------------------------------------------------------------------
-// writeMatch() writes a match to stdout showing the alignment of reads to a pattern;
-// pattern delimiters (i.e., brackets and braces) are accounted for
+
+struct HeldHit // a hit held in the output of a thread for sorted output, with the
+	       // fields by which HitCompare orders hits
+{
+   int      patternRank;   // rank of the pattern name
+   int      patternIndex;  // index of the pattern in patternVector
+   int      leftBases;     // #bases in left side of the displayed pattern
+   int      rightBases;    // #bases in right side of the displayed pattern
+   int      spanningCount; // number of junction-spanning reads
+   uint32_t nameLength;    // length of the read1 name
+   uint64_t nameOffset;    // offset of the read1 name in ThreadOutput::names
+   uint64_t dataOffset;    // offset of the formatted hit in ThreadOutput::buffer
+   uint64_t dataLength;    // length of the formatted hit
+};
+
+struct ThreadOutput // the hits of a matching thread that are not yet written
+{
+   ThreadOutput() : buffer(), names(), held(), candidates() { }
+
+   std::string buffer;         // formatted hits
+   std::string names;          // read1 names of the held hits
+   std::vector<HeldHit> held;  // hits held until the end of input when sorting
+   std::string candidates;     // candidate read pairs for -savecandidates
+};
+
+//------------------------------------------------------------------------------------
+
+struct ThreadStats // the time and counts of a matching thread, which accumulates its
+                   // own and adds them to the run totals when it finishes
+{
+   ThreadStats()
+      : batchWait(0.0), process(0.0), outputWait(0.0), ranges(0), readPairs(0),
+        matches(0), validPass(0), validFail(0), cacheLookups(0), cacheHits(0),
+	match() { }
+
+   void add(const ThreadStats& other);
+
+   double   batchWait;  // seconds waiting for a range of a full batch
+   double   process;    // seconds in processRange()
+   double   outputWait; // seconds waiting for outputMutex
+   uint64_t ranges;     // ranges of batches processed
+   uint64_t readPairs;  // read pairs processed
+   uint64_t matches;    // matches of read pairs found by getMatches()
+   uint64_t validPass;  // matches passing validOverlaps(), each written as a hit
+   uint64_t validFail;  // matches failing validOverlaps() or ranked after one that
+                        // fails, none of which is written; pass + fail = matches
+   uint64_t cacheLookups; // read pairs looked up in the match cache
+   uint64_t cacheHits;    // read pairs found there, which were not matched again
+   MatchStats match;    // counts of the matching work
+};
+
+struct ReaderStats // the time and counts of the reader thread
+{
+   ReaderStats() : fill(0.0), wait(0.0), batches(0) { }
+
+   double   fill;    // seconds filling batches with read pairs
+   double   wait;    // seconds waiting for an empty batch
+   uint64_t batches; // batches filled
+};
+
+std::vector<ThreadStats> threadStats; // totals of each matching thread, by thread
+ReaderStats readerStats;              // totals of the reader thread
+uint64_t    totalReadPairs = 0;       // read pairs of all inputs processed
+
+//------------------------------------------------------------------------------------
+// secondsSince() returns the number of seconds that have elapsed since the given time
+
+inline double secondsSince(const Clock::time_point& start)
+{
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------------------
+// ThreadStats::add() adds the time and counts of another thread to these
+
+void ThreadStats::add(const ThreadStats& other)
+{
+   batchWait  += other.batchWait;
+   process    += other.process;
+   outputWait += other.outputWait;
+   ranges     += other.ranges;
+   readPairs  += other.readPairs;
+   matches    += other.matches;
+   validPass  += other.validPass;
+   validFail  += other.validFail;
+
+   cacheLookups += other.cacheLookups;
+   cacheHits    += other.cacheHits;
+
+   match.add(other.match);
+}
+
+//------------------------------------------------------------------------------------
+// HeldHitCompare orders the held hits of a thread as HitCompare orders hits
+
+struct HeldHitCompare
+{
+   HeldHitCompare(const ThreadOutput& inOutput) : output(inOutput) { }
+
+   bool operator()(const HeldHit& a, const HeldHit& b) const
+   {
+      if (a.patternRank != b.patternRank)
+         return (a.patternRank < b.patternRank);
+
+      if (a.leftBases != b.leftBases)
+         return (a.leftBases < b.leftBases);
+
+      if (a.rightBases != b.rightBases)
+         return (a.rightBases < b.rightBases);
+
+      if (a.spanningCount != b.spanningCount)
+         return (a.spanningCount > b.spanningCount);
+
+      return (output.names.compare(a.nameOffset, a.nameLength, output.names,
+                                   b.nameOffset, b.nameLength) < 0);
+   }
+
+   const ThreadOutput& output;
+};
+
+//------------------------------------------------------------------------------------
+// rankPatterns() ranks the patterns by name, giving equal names equal ranks
+
+void rankPatterns()
+{
+   int numPatterns = patternVector->size();
+
+   std::vector<std::pair<std::string, int> > byName(numPatterns);
+
+   for (int i = 0; i < numPatterns; i++)
+      byName[i] = std::make_pair((*patternVector)[i].name, i);
+
+   std::sort(byName.begin(), byName.end());
+
+   patternRank.assign(numPatterns, 0);
+
+   for (int i = 1; i < numPatterns; i++)
+   {
+      int rank = patternRank[byName[i - 1].second];
+
+      if (byName[i].first != byName[i - 1].first)
+         rank++;
+
+      patternRank[byName[i].second] = rank;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// holdHit() records the hit most recently appended to the output buffer of a thread,
+// starting at the given offset, so that it can be written in sorted order
+
+void holdHit(ThreadOutput& output, uint64_t dataOffset, const Match& match,
+             const Pattern& pattern, int leftOffset, int displayLen,
+	     const std::string& name1)
+{
+   HeldHit h;
+
+   h.patternRank   = patternRank[match.c1.index];
+   h.patternIndex  = match.c1.index;
+   h.leftBases     = pattern.leftBases - leftOffset;
+   h.rightBases    = leftOffset + displayLen - pattern.delim2 - 1;
+   h.spanningCount = match.numSpanning();
+   h.nameLength    = name1.length();
+   h.nameOffset    = output.names.size();
+   h.dataOffset    = dataOffset;
+   h.dataLength    = output.buffer.size() - dataOffset;
+
+   output.names += name1;
+   output.held.push_back(h);
+}
+
+//------------------------------------------------------------------------------------
+// writeMatch() appends a match to the output buffer of a thread, showing the
+// alignment of reads to a pattern; pattern delimiters (i.e., brackets and braces) are
+// accounted for; when sorting, the hit is held until the end of input
 
 void writeMatch(const std::string& name1, const std::string& sequence1,
                 const std::string& name2, const std::string& sequence2,
-		const Match& match)
+		const Match& match, ThreadOutput& threadOutput)
 {
+   std::string& output     = threadOutput.buffer;
+   uint64_t     dataOffset = output.size();
+
    const Pattern& pattern = (*patternVector)[match.c1.index];
 
    int offset1 = match.c1.offset;
@@ -287,8 +705,6 @@ void writeMatch(const std::string& name1, const std::string& sequence1,
    int fullLength = pattern.displaySequence.length();
    int displayLen = std::min(match.insertSize() + 2, fullLength - leftOffset);
 
-   std::string displaySeq = pattern.displaySequence.substr(leftOffset, displayLen);
-
    int leading1 = 0, leading2 = 0; // number of leading blanks
 
    if (offset1 < offset2)      // first read aligns ahead of second read
@@ -300,161 +716,950 @@ void writeMatch(const std::string& name1, const std::string& sequence1,
                  (offset1 >= pattern.sequence.length() - pattern.rightBases ? 2 :
 		 (offset1 >= pattern.leftBases ? 1 : 0));
 
-   HitPattern *hitPattern =
-      new HitPattern(pattern.name, displaySeq, pattern.annotation,
-                     match.matchingBases(), match.possible(), match.numSpanning(),
-		     match.insertSize());
+   if (format == BINARY_FORMAT)
+   {
+      // the first thread to write a hit of the pattern also writes its definition,
+      // unless the definitions are written as the held hits are merged
+      if (sorted == 0 &&
+          __atomic_exchange_n(&patternWritten[match.c1.index], 1,
+                              __ATOMIC_RELAXED) == 0)
+         appendBinaryPattern(output, match.c1.index, pattern);
+
+      appendBinaryHitPattern(output, match.c1.index, leftOffset, displayLen,
+                             match.matchingBases(), match.possible(),
+			     match.numSpanning(), match.insertSize());
+
+      appendBinaryHitRead(output, name1, leading1, sequence1,
+                          match.c1.matchingBases, match.c1.junctionSpanning,
+		          match.c1.leftOverlap, match.c1.rightOverlap);
+
+      appendBinaryHitRead(output, name2, leading2, sequence2,
+                          match.c2.matchingBases, match.c2.junctionSpanning,
+		          match.c2.leftOverlap, match.c2.rightOverlap);
+   }
+   else
+   {
+      appendHitPattern(output, pattern.name,
+                       pattern.displaySequence.c_str() + leftOffset, displayLen,
+		       pattern.annotation, match.matchingBases(), match.possible(),
+		       match.numSpanning(), match.insertSize());
+
+      appendHitRead(output, name1, leading1, sequence1,
+                    match.c1.matchingBases, match.c1.junctionSpanning,
+		    match.c1.leftOverlap, match.c1.rightOverlap);
+
+      appendHitRead(output, name2, leading2, sequence2,
+                    match.c2.matchingBases, match.c2.junctionSpanning,
+		    match.c2.leftOverlap, match.c2.rightOverlap);
+   }
 
-   HitRead *hitRead1 =
-      new HitRead(name1, leading1, sequence1,
-                  match.c1.matchingBases, match.c1.junctionSpanning,
-		  match.c1.leftOverlap, match.c1.rightOverlap);
+   if (sorted == 1)
+      holdHit(threadOutput, dataOffset, match, pattern, leftOffset, displayLen,
+              name1);
+}
 
-   HitRead *hitRead2 =
-      new HitRead(name2, leading2, sequence2,
-                  match.c2.matchingBases, match.c2.junctionSpanning,
-		  match.c2.leftOverlap, match.c2.rightOverlap);
+//------------------------------------------------------------------------------------
+// writeHeading() writes the heading of the hits to stdout in the selected format; in
+// binary format, every pattern is yet to be defined in the output
 
-   Hit hit(hitPattern, hitRead1, hitRead2);
-   hit.write();
+void writeHeading(const StringVector& annotationHeading)
+{
+   if (format == BINARY_FORMAT)
+   {
+      patternWritten.assign(patternVector->size(), 0);
+      writeBinaryHitHeading(CURRENT_VERSION, annotationHeading);
+   }
+   else
+      writeHitHeadingLine(CURRENT_VERSION, annotationHeading);
 }
 
 //------------------------------------------------------------------------------------
-// processOrientation() matches the given read pair to the set of patterns
+// flushOutput() writes the hits in the output buffer of a thread to stdout and empties
+// the buffer
 
-void processOrientation(const std::string& name1, const std::string& sequence1,
-                        const std::string& name2, const std::string& sequence2)
+void flushOutput(std::string& output, ThreadStats& stats)
 {
-   MatchVector matchVector;
+   if (output.empty())
+      return;
 
-   getMatches(sequence1, sequence2, patternVector, patternMap, w, rankTable,
+   if (numThreads > 1)
+   {
+      Clock::time_point start = Clock::now();
+      outputMutex.lock();
+      stats.outputWait += secondsSince(start);
+   }
+
+   std::cout.write(output.data(), output.size());
+
+   if (numThreads > 1)
+      outputMutex.unlock();
+
+   output.clear();
+}
+
+//------------------------------------------------------------------------------------
+// flushCandidates() writes the given buffer of candidate read pairs to the candidate
+// file and clears the buffer
+
+void flushCandidates(std::string& candidates)
+{
+   if (candidates.empty())
+      return;
+
+   candidateMutex.lock();
+   candidateWriter->write(candidates);
+   candidateMutex.unlock();
+
+   candidates.clear();
+}
+
+//------------------------------------------------------------------------------------
+// findValidMatches() matches the given read pair to the set of patterns, using the
+// storage in scratch, and sets valid to the matches with valid overlaps
+
+void findValidMatches(const EncodedRead& read1, const EncodedRead& read2,
+                      MatchScratch& scratch, ThreadStats& stats, MatchVector& valid)
+{
+   MatchVector& matchVector = scratch.matchVector;
+   matchVector.clear();
+   valid.clear();
+
+   getMatches(read1, read2, patternVector, patternMap, w, scheme, rankTable,
               maxMinimizer, minBases, minMins, maxInsert, maxTrim, (show == 1),
-	      (single == 1), matchVector);
+	      (single == 1), scratch, matchVector);
 
    int numMatches = matchVector.size();
    if (numMatches == 0)
       return; // no matches
 
-   std::string revcomp = stringReverseComplement(sequence2);
-
    // determine the number of matches with valid overlaps
    int numValid = 0;
 
    while (numValid < numMatches &&
-          matchVector[numValid].validOverlaps(sequence1, revcomp, patternVector,
-                                              minBases, minOverlap))
+          matchVector[numValid].validOverlaps(read1.forward, read2.reverse,
+                                              patternVector, minBases, minOverlap))
       numValid++;
 
-   if (numValid == 0)
-      return; // no valid matches
+   stats.matches   += numMatches;
+   stats.validPass += numValid;
+   stats.validFail += numMatches - numValid;
 
-   // write valid matches
+   valid.assign(matchVector.begin(), matchVector.begin() + numValid);
+}
 
-   if (numThreads > 1)
-      outputMutex.lock();
+//------------------------------------------------------------------------------------
+// writeMatches() appends the given valid matches of a read pair to the output buffer
+
+void writeMatches(const std::string& name1, const EncodedRead& read1,
+                  const std::string& name2, const EncodedRead& read2,
+		  const MatchVector& valid, ThreadOutput& output)
+{
+   int numValid = valid.size();
 
    for (int i = 0; i < numValid; i++)
-      writeMatch(name1, sequence1, name2, revcomp, matchVector[i]);
+      writeMatch(name1, read1.forward.sequence, name2, read2.reverse.sequence,
+                 valid[i], output);
+}
 
-   if (numThreads > 1)
-      outputMutex.unlock();
+//------------------------------------------------------------------------------------
+// processRange() processes the given range of the read pairs of a batch, using the
+// storage in scratch, and appends the hits to the output buffer; a read pair found in
+// the match cache is not matched again, only its names are put in its hits; when
+// saving candidates, a read pair having a minimizer found in a pattern is appended to
+// the candidates of the output, whether or not it matches under the thresholds; if an
+// exception is raised, its message is provided and the reader thread is told to stop
+
+void processRange(const BatchRange& range, MatchScratch& scratch,
+                  ThreadOutput& output, ThreadStats& stats, std::string& message)
+{
+   std::string name1, seq1, name2, seq2;
+   EncodedRead read1, read2;   // reused for each read pair of the range
+   MatchVector valid1, valid2; // valid matches of the two orientations of a pair
+
+   try
+   {
+      for (int i = range.begin; i < range.end; i++)
+      {
+         range.batch->get(i, name1, seq1, name2, seq2);
+
+	 bool cached  = false;
+	 bool located = false; // true if a minimizer of the pair is in a pattern
+
+	 if (matchCache)
+	 {
+            stats.cacheLookups++;
+
+	    if ((cached = matchCache->find(seq1, seq2, valid1, valid2, located)))
+               stats.cacheHits++;
+	 }
+
+	 if (cached && valid1.empty() && valid2.empty())
+	 {
+            if (located && candidateWriter)
+               CandidateWriter::appendPair(output.candidates, name1, seq1,
+	                                   name2, seq2);
+            continue; // a duplicate of a read pair without hits
+	 }
+
+         read1.encode(seq1, rankTable->k);
+	 read2.encode(seq2, rankTable->k);
+
+	 if (!cached)
+	 {
+            uint64_t locations = scratch.stats.locations;
+
+            findValidMatches(read1, read2, scratch, stats, valid1);
+            findValidMatches(read2, read1, scratch, stats, valid2);
+
+	    located = (scratch.stats.locations > locations);
+
+	    if (matchCache)
+               matchCache->add(seq1, seq2, valid1, valid2, located);
+	 }
+
+	 if (located && candidateWriter)
+            CandidateWriter::appendPair(output.candidates, name1, seq1, name2, seq2);
+
+         writeMatches(name1, read1, name2, read2, valid1, output);
+         writeMatches(name2, read2, name1, read1, valid2, output);
+      }
+   }
+   catch (const std::runtime_error& error)
+   {
+      message    = error.what();
+      endOfInput = true;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// batchLimit() returns the number of read pairs to put in the next batch: as many as
+// the matching threads together match in BATCH_SECONDS at the cost per read pair
+// measured so far, so that a costly input gets smaller batches; until a cost has
+// been measured, batches are kept small so that every thread starts promptly
+
+int batchLimit()
+{
+   uint64_t pairs = matchedPairs;
+   uint64_t nanos = matchNanos;
+
+   if (pairs == 0 || nanos == 0)
+      return MIN_BATCH_SIZE;
+
+   double limit = numThreads * BATCH_SECONDS * 1e9 * pairs / nanos;
+
+   return (limit < MIN_BATCH_SIZE    ? MIN_BATCH_SIZE :
+           limit > THREAD_BATCH_SIZE ? THREAD_BATCH_SIZE : static_cast<int>(limit));
 }
 
 //------------------------------------------------------------------------------------
-// processBatch() processes the given batch of read pairs; if an exception is raised,
+// fillBatch() fills the given batch up to its limit with the next read pairs from the
+// input; if fewer are obtained, end-of-input was reached; if an exception was raised,
 // its message is provided
 
-void processBatch(int count,
-                  const StringVector& name1, const StringVector& seq1,
-                  const StringVector& name2, const StringVector& seq2,
-		  std::string& message)
+void fillBatch(ReadBatch *batch, std::string& message)
 {
+   batch->clear();
+   batch->limit = std::min(batch->capacity, batchLimit());
+
    try
    {
-      for (int i = 0; i < count; i++)
-      {
-         processOrientation(name1[i], seq1[i], name2[i], seq2[i]);
-         processOrientation(name2[i], seq2[i], name1[i], seq1[i]);
-      }
+      while (batch->count < batch->limit && pairReader->addNextPair(*batch))
+         ;
    }
    catch (const std::runtime_error& error)
    {
       message = error.what();
+   }
 
-      if (numThreads > 1)
-         inputMutex.lock();
+   numReadPairs += batch->count;
+}
 
-      endOfInput = true;
+//------------------------------------------------------------------------------------
+// readerWork() contains the work of the reader thread, which fills empty batches with
+// read pairs and queues them for the matching threads until end-of-input is reached;
+// if an exception occurs, its message is provided
+
+void readerWork(std::string *message)
+{
+   while (!endOfInput)
+   {
+      Clock::time_point start = Clock::now();
+
+      ReadBatch *batch = emptyBatches.pop();
+
+      readerStats.wait += secondsSince(start);
+      start = Clock::now();
+
+      fillBatch(batch, *message);
+
+      readerStats.fill += secondsSince(start);
+      readerStats.batches++;
+
+      if (*message != "" || batch->count < batch->limit)
+         endOfInput = true;
+
+      if (batch->count > 0)
+         fullBatches.push(batch);
+      else
+         emptyBatches.push(batch);
+   }
+
+   fullBatches.close(); // the matching threads finish when the queue is drained
+}
+
+//------------------------------------------------------------------------------------
+// threadWork() contains the work that each matching thread performs, processing
+// ranges of the batches of read pairs until the reader thread is done; a batch is
+// recycled by the thread finishing its last range; the hits of the thread are
+// buffered and written to stdout in large chunks, so that the threads seldom contend
+// for the output; when sorting, the hits are held in output and sorted by the thread
+// at the end of input; the time and counts of the thread are accumulated in stats;
+// if an exception occurs, its message is provided; if node is not (-1), the thread
+// first binds itself to that NUMA node so that its scratch memory is local to it
+
+void threadWork(std::string *message, ThreadOutput *output, ThreadStats *stats,
+                int node)
+{
+   if (node >= 0)
+      numaTopology->bindThread(node); // advisory; the thread runs anywhere otherwise
+
+   BatchRange   range;
+   MatchScratch scratch; // reused for every read pair matched by this thread
+
+   if (sorted == 0)
+      output->buffer.reserve(OUTPUT_BUFFER_SIZE + OUTPUT_BUFFER_SIZE / 4);
+
+   Clock::time_point start = Clock::now();
+
+   while (fullBatches.claim(range))
+   {
+      stats->batchWait += secondsSince(start);
+      start = Clock::now();
+
+      if (*message == "")
+         processRange(range, scratch, *output, *stats, *message);
+
+      double seconds  = secondsSince(start);
+      int    numPairs = range.end - range.begin;
+
+      stats->process += seconds;
+      stats->ranges++;
+      stats->readPairs += numPairs;
+
+      matchedPairs += numPairs;
+      matchNanos   += static_cast<uint64_t>(seconds * 1e9);
+
+      if (fullBatches.finish(range))
+         emptyBatches.push(range.batch); // recycle the batch
+
+      if (sorted == 0 && output->buffer.size() >= OUTPUT_BUFFER_SIZE)
+         flushOutput(output->buffer, *stats);
+
+      if (output->candidates.size() >= OUTPUT_BUFFER_SIZE)
+         flushCandidates(output->candidates);
+
+      start = Clock::now();
+   }
 
-      if (numThreads > 1)
-         inputMutex.unlock();
+   stats->batchWait += secondsSince(start);
+   stats->match      = scratch.stats;
+
+   if (candidateWriter)
+      flushCandidates(output->candidates);
+
+   if (sorted == 0)
+      flushOutput(output->buffer, *stats);
+   else if (*message == "")
+      std::sort(output->held.begin(), output->held.end(), HeldHitCompare(*output));
+}
+
+//------------------------------------------------------------------------------------
+
+struct HeldHitRef // refers to the next held hit of a thread in the merge
+{
+   HeldHitRef(int inThread, size_t inIndex) : thread(inThread), index(inIndex) { }
+
+   int    thread; // index of the thread
+   size_t index;  // index of the hit in the thread's held hits
+};
+
+struct HeldHitRefCompare // orders the heap of the merge so that the first hit is on
+                         // top; equal hits are taken in thread order
+{
+   HeldHitRefCompare(const std::vector<ThreadOutput>& inOutput) : output(inOutput) { }
+
+   bool operator()(const HeldHitRef& a, const HeldHitRef& b) const
+   {
+      const HeldHit& ha = output[a.thread].held[a.index];
+      const HeldHit& hb = output[b.thread].held[b.index];
+
+      if (ha.patternRank != hb.patternRank)
+         return (ha.patternRank > hb.patternRank);
+
+      if (ha.leftBases != hb.leftBases)
+         return (ha.leftBases > hb.leftBases);
+
+      if (ha.rightBases != hb.rightBases)
+         return (ha.rightBases > hb.rightBases);
+
+      if (ha.spanningCount != hb.spanningCount)
+         return (ha.spanningCount < hb.spanningCount);
+
+      int key5 = output[a.thread].names.compare(ha.nameOffset, ha.nameLength,
+                                                output[b.thread].names,
+						hb.nameOffset, hb.nameLength);
+      if (key5 != 0)
+         return (key5 > 0);
+
+      return (a.thread > b.thread);
    }
+
+   const std::vector<ThreadOutput>& output;
+};
+
+//------------------------------------------------------------------------------------
+// writeHeldHits() merges the sorted hits held by the threads and writes them to
+// stdout; in binary format, the definition of each pattern is written ahead of its
+// first hit
+
+void writeHeldHits(std::vector<ThreadOutput>& output)
+{
+   std::priority_queue<HeldHitRef, std::vector<HeldHitRef>, HeldHitRefCompare>
+      heap((HeldHitRefCompare(output)));
+
+   for (int i = 0; i < numThreads; i++)
+      if (!output[i].held.empty())
+         heap.push(HeldHitRef(i, 0));
+
+   std::string buffer;
+   buffer.reserve(OUTPUT_BUFFER_SIZE + OUTPUT_BUFFER_SIZE / 4);
+
+   while (!heap.empty())
+   {
+      HeldHitRef next = heap.top();
+      heap.pop();
+
+      const ThreadOutput& threadOutput = output[next.thread];
+      const HeldHit& hit = threadOutput.held[next.index];
+
+      if (format == BINARY_FORMAT && patternWritten[hit.patternIndex] == 0)
+      {
+         patternWritten[hit.patternIndex] = 1;
+         appendBinaryPattern(buffer, hit.patternIndex,
+	                     (*patternVector)[hit.patternIndex]);
+      }
+
+      buffer.append(threadOutput.buffer, hit.dataOffset, hit.dataLength);
+
+      if (buffer.size() >= OUTPUT_BUFFER_SIZE)
+      {
+         std::cout.write(buffer.data(), buffer.size());
+	 buffer.clear();
+      }
+
+      if (++next.index < threadOutput.held.size())
+         heap.push(next);
+   }
+
+   std::cout.write(buffer.data(), buffer.size());
+}
+
+//------------------------------------------------------------------------------------
+// threadNode() returns the index of the NUMA node of the ith matching thread, or (-1)
+// if the threads are not bound to nodes; the threads are dealt to the nodes in turn
+
+int threadNode(int i)
+{
+   return (numaTopology ? i % numaTopology->numNodes() : -1);
 }
 
 //------------------------------------------------------------------------------------
-// getBatch() gets the next batch of read pairs and returns the number of read pairs
-// obtained; if less than a full batch, end-of-input was reached; if an exception was
-// raised, its message is provided
+// writeThreadStats() writes the members of a JSON object holding the given time and
+// counts of one or more matching threads
 
-int getBatch(StringVector& name1, StringVector& seq1,
-             StringVector& name2, StringVector& seq2, std::string& message)
+void writeThreadStats(std::ostream& out, const ThreadStats& stats,
+                      const std::string& indent)
 {
-   int count = 0;
+   const MatchStats& match = stats.match;
+
+   double perRead = (match.strands > 0 ? match.strands : 1);
+
+   out << indent << "\"batch_wait_seconds\": "  << stats.batchWait  << "," << NEWLINE
+       << indent << "\"process_seconds\": "     << stats.process    << "," << NEWLINE
+       << indent << "\"output_wait_seconds\": " << stats.outputWait << "," << NEWLINE
+       << indent << "\"ranges\": "              << stats.ranges     << "," << NEWLINE
+       << indent << "\"read_pairs\": "          << stats.readPairs  << "," << NEWLINE
+       << indent << "\"read_pairs_per_second\": "
+                 << (stats.process > 0.0 ? stats.readPairs / stats.process : 0.0)
+		 << "," << NEWLINE
+       << indent << "\"reads_looked_up\": "     << match.strands    << "," << NEWLINE
+       << indent << "\"windows\": "             << match.windows    << "," << NEWLINE
+       << indent << "\"pattern_map_lookups\": " << match.lookups    << "," << NEWLINE
+       << indent << "\"pattern_map_hits\": "    << match.lookupHits << "," << NEWLINE
+       << indent << "\"common_in_patterns\": "  << match.commonLookups << ","
+                 << NEWLINE
+       << indent << "\"locations\": "           << match.locations  << "," << NEWLINE
+       << indent << "\"locations_per_read\": "  << match.locations / perRead
+                 << "," << NEWLINE
+       << indent << "\"lcs_tests\": "           << match.lcsTests   << "," << NEWLINE
+       << indent << "\"min_matches_rejects\": " << match.minMatchesRejects << ","
+                 << NEWLINE
+       << indent << "\"matches\": "             << stats.matches    << "," << NEWLINE
+       << indent << "\"valid_overlaps_pass\": " << stats.validPass  << "," << NEWLINE
+       << indent << "\"valid_overlaps_fail\": " << stats.validFail  << "," << NEWLINE
+       << indent << "\"dup_cache_lookups\": "   << stats.cacheLookups << "," << NEWLINE
+       << indent << "\"dup_cache_hits\": "      << stats.cacheHits  << "," << NEWLINE
+       << indent << "\"dup_cache_hit_rate\": "
+                 << (stats.cacheLookups > 0 ?
+		     static_cast<double>(stats.cacheHits) / stats.cacheLookups : 0.0)
+		 << NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// writeStats() writes the time and counts of the run so far to the -stats file as a
+// JSON object, with the totals followed by those of each matching thread and, if the
+// threads are bound to NUMA nodes, those of each node
+
+void writeStats()
+{
+   std::ofstream outfile(statsFilename.c_str());
+   if (!outfile.is_open())
+      throw std::runtime_error("unable to open " + statsFilename);
+
+   ThreadStats total;
+   int numStatsThreads = threadStats.size();
+
+   for (int i = 0; i < numStatsThreads; i++)
+      total.add(threadStats[i]);
+
+   double elapsed = secondsSince(startTime);
+
+   struct rusage usage;
+   long peakRSS = (getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0);
+
+   outfile << std::fixed << std::setprecision(3)
+           << "{" << NEWLINE
+           << "  \"version\": \"" << VERSION_NAME << "\"," << NEWLINE
+	   << "  \"threads\": " << numThreads << "," << NEWLINE
+	   << "  \"elapsed_seconds\": " << elapsed << "," << NEWLINE
+	   << "  \"read_pairs\": " << totalReadPairs << "," << NEWLINE
+	   << "  \"read_pairs_per_second\": "
+	          << (elapsed > 0.0 ? totalReadPairs / elapsed : 0.0) << "," << NEWLINE
+	   << "  \"peak_rss_kb\": " << peakRSS << "," << NEWLINE
+	   << "  \"reader\": {" << NEWLINE
+	   << "    \"fill_seconds\": " << readerStats.fill << "," << NEWLINE
+	   << "    \"wait_seconds\": " << readerStats.wait << "," << NEWLINE
+	   << "    \"batches\": " << readerStats.batches << NEWLINE
+	   << "  }," << NEWLINE
+	   << "  \"total\": {" << NEWLINE;
+
+   writeThreadStats(outfile, total, "    ");
+
+   outfile << "  }," << NEWLINE
+           << "  \"per_thread\": [";
+
+   for (int i = 0; i < numStatsThreads; i++)
+   {
+      outfile << (i > 0 ? "," : "") << NEWLINE << "    {" << NEWLINE;
+
+      if (numaTopology)
+         outfile << "      \"node\": " << numaTopology->nodeID[threadNode(i)] << ","
+	         << NEWLINE;
+
+      writeThreadStats(outfile, threadStats[i], "      ");
+      outfile << "    }";
+   }
+
+   outfile << NEWLINE << "  ]";
 
-   if (!endOfInput)
+   if (numaTopology)
    {
-      if (numThreads > 1)
-         inputMutex.lock();
+      int numNodes = numaTopology->numNodes();
 
-      if (!endOfInput)
+      std::vector<ThreadStats> nodeStats(numNodes);
+      IntVector                nodeThreads(numNodes, 0);
+
+      for (int i = 0; i < numStatsThreads; i++)
       {
-         try
-	 {
-            while (count < THREAD_BATCH_SIZE &&
-                   pairReader->getNextPair(name1[count], seq1[count],
-                                           name2[count], seq2[count]))
-               count++;
+         nodeStats[threadNode(i)].add(threadStats[i]);
+	 nodeThreads[threadNode(i)]++;
+      }
 
-	    numReadPairs += count;
-	 }
-	 catch (const std::runtime_error& error)
-	 {
-            message = error.what();
-	 }
+      outfile << "," << NEWLINE << "  \"per_node\": [";
 
-	 if (message != "" || count < THREAD_BATCH_SIZE)
-            endOfInput = true;
+      for (int n = 0; n < numNodes; n++)
+      {
+         outfile << (n > 0 ? "," : "") << NEWLINE << "    {" << NEWLINE
+	         << "      \"node\": " << numaTopology->nodeID[n] << "," << NEWLINE
+	         << "      \"threads\": " << nodeThreads[n] << "," << NEWLINE;
+         writeThreadStats(outfile, nodeStats[n], "      ");
+         outfile << "    }";
       }
 
-      if (numThreads > 1)
-         inputMutex.unlock();
+      outfile << NEWLINE << "  ]";
    }
 
-   return count;
+   outfile << NEWLINE << "}" << NEWLINE;
+
+   outfile.close();
+
+   if (outfile.fail())
+      throw std::runtime_error("unable to write " + statsFilename);
 }
 
 //------------------------------------------------------------------------------------
-// threadWork() contains the work that each thread performs, processing read pairs
-// until end-of-input is detected; if an exception occurs, its message is provided
+// processInput() matches all read pairs obtained by pairReader, using a reader thread
+// and the matching threads, and writes the hits followed by the number of read pairs;
+// the batches are back in emptyBatches when it returns, ready for the next input
 
-void threadWork(std::string *message)
+void processInput()
 {
-   StringVector name1(THREAD_BATCH_SIZE, "");
-   StringVector seq1 (THREAD_BATCH_SIZE, "");
-   StringVector name2(THREAD_BATCH_SIZE, "");
-   StringVector seq2 (THREAD_BATCH_SIZE, "");
+   pairReader->open();
+
+   if (dupCache > 0) // the matches depend on the thresholds, which a job may change
+      matchCache = new MatchCache(dupCache);
+
+   endOfInput   = false;
+   numReadPairs = 0;
+
+   fullBatches.reopen();
+
+   std::string **message = new std::string *[numThreads];
+   std::thread **thread  = new std::thread *[numThreads];
 
-   int count;
+   std::vector<ThreadOutput> output(numThreads); // of each matching thread
+   std::vector<ThreadStats>  stats(numThreads);  // of each matching thread
 
-   // keep going until an exception is raised or end-of-input is reached
-   do
+   // start the reader thread, which overlaps input with matching
+   std::string readerMessage = "";
+   std::thread readerThread(readerWork, &readerMessage);
+
+   // start all matching threads
+   for (int i = 0; i < numThreads; i++)
    {
-      count = getBatch(name1, seq1, name2, seq2, *message);
+      message[i] = new std::string("");
+      thread[i]  = new std::thread(threadWork, message[i], &output[i], &stats[i],
+                                   threadNode(i));
+   }
+
+   // wait for each thread to finish
+   readerThread.join();
+
+   for (int i = 0; i < numThreads; i++)
+   {
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   delete[] thread;
+
+   delete matchCache;
+   matchCache = NULL;
+
+   // all of the threads have finished; check for any exceptions
+   std::string error = readerMessage;
+
+   for (int i = 0; i < numThreads; i++)
+   {
+      if (error == "")
+         error = *message[i];
+
+      delete message[i];
+   }
 
-      if (*message == "" && count > 0)
-         processBatch(count, name1, seq1, name2, seq2, *message);
+   delete[] message;
+
+   if (error != "")
+      throw std::runtime_error(error);
+
+   if (sorted == 1)
+      writeHeldHits(output);
+
+   threadStats.resize(numThreads);
+
+   for (int i = 0; i < numThreads; i++)
+      threadStats[i].add(stats[i]);
+
+   if (candidateReader) // count the read pairs of the input the file was saved from
+   {
+      numReadPairs    = candidateReader->inputPairs;
+      candidateReader = NULL;
    }
-   while (*message == "" && count == THREAD_BATCH_SIZE);
+
+   totalReadPairs += numReadPairs;
+
+   pairReader->close();
+
+   delete pairReader;
+   pairReader = NULL;
+
+   if (format == BINARY_FORMAT)
+      writeBinaryReadPairs(numReadPairs);
+   else
+      writeReadPairLine(numReadPairs);
+
+   if (statsFilename != "")
+      writeStats();
+}
+
+//------------------------------------------------------------------------------------
+// shardReader() returns the given pair reader, restricted to the read pairs of the
+// selected shard when the input is sharded; a reader that cannot select the shard
+// by file offset is wrapped so that the read pairs are dealt to the shards in chunks
+
+PairReader *shardReader(PairReader *reader)
+{
+   if (numShards == 1 || reader->selectShard(shardIndex - 1, numShards))
+      return reader;
+
+   return new ShardPairReader(reader, shardIndex - 1, numShards);
+}
+
+//------------------------------------------------------------------------------------
+// processSample() processes the named input files of one sample, writing its hits to
+// the named output file instead of stdout; the output file is created only once the
+// input files are known, and it is removed if the sample cannot be processed, so a
+// failed sample never leaves behind an output that looks complete
+
+void processSample(const std::string& outputFilename, const StringVector& sampleInput,
+                   const StringVector& annotationHeading)
+{
+   pairReader = shardReader(createInputReader(sampleInput));
+
+   std::ofstream outfile(outputFilename.c_str());
+   if (!outfile.is_open())
+   {
+      delete pairReader; // not yet opened
+      pairReader = NULL;
+
+      throw std::runtime_error("unable to open " + outputFilename);
+   }
+
+   std::streambuf *stdoutBuffer = std::cout.rdbuf(outfile.rdbuf());
+
+   try
+   {
+      writeHeading(annotationHeading);
+
+      processInput();
+   }
+   catch (const std::runtime_error& error)
+   {
+      std::cout.rdbuf(stdoutBuffer);
+
+      if (pairReader) // processInput() did not get to close it
+      {
+         pairReader->close();
+         delete pairReader;
+         pairReader = NULL;
+      }
+
+      outfile.close();
+      std::remove(outputFilename.c_str());
+
+      throw;
+   }
+
+   std::cout.rdbuf(stdoutBuffer);
+
+   outfile.close();
+
+   if (outfile.fail())
+   {
+      std::remove(outputFilename.c_str());
+      throw std::runtime_error("unable to write " + outputFilename);
+   }
+}
+
+//------------------------------------------------------------------------------------
+// processSamples() reads the named sample manifest and processes the input files of
+// each sample in turn, writing its hits to the sample's output file; the rank table
+// and pattern index are shared by all of the samples
+
+void processSamples(const std::string& manifestFilename,
+                    const StringVector& annotationHeading)
+{
+   std::ifstream manifest(manifestFilename.c_str());
+   if (!manifest.is_open())
+      throw std::runtime_error("unable to open " + manifestFilename);
+
+   std::vector<StringVector> sample; // output filename and input filenames
+   std::string line;
+
+   while (getline(manifest, line))
+   {
+      if (line == "")
+         continue;
+
+      StringVector col;
+
+      if (splitString(line, col) < 2 || col[0] == "")
+         throw std::runtime_error("invalid line in " + manifestFilename + ": " +
+                                  line);
+
+      sample.push_back(col);
+   }
+
+   manifest.close();
+
+   if (sample.size() == 0)
+      throw std::runtime_error("no samples in " + manifestFilename);
+
+   int numSamples = sample.size();
+
+   for (int i = 0; i < numSamples; i++)
+      processSample(sample[i][0],
+                    StringVector(sample[i].begin() + 1, sample[i].end()),
+		    annotationHeading);
+}
+
+//------------------------------------------------------------------------------------
+// processJob() carries out a job received by the server and returns the reply; the
+// job is a line of tab-separated fields: options that override the thresholds for
+// this job only, then the output filename and the input filenames
+
+std::string processJob(const std::string& job, const StringVector& annotationHeading)
+{
+   StringVector col;
+   int numCols = splitString(job, col);
+
+   // save the thresholds so they can be restored after the job
+   double saveMinBases = minBases;
+   int    saveMaxInsert = maxInsert, saveMaxTrim = maxTrim, saveMinMins = minMins,
+          saveMinOverlap = minOverlap, saveShow = show, saveSingle = single;
+
+   std::string reply;
+
+   try
+   {
+      int i = 0;
+
+      for (; i < numCols && col[i].length() > 0 && col[i][0] == '-'; i++)
+      {
+         StringVector opt;
+
+	 if (splitString(col[i], opt, '=') != 2 ||
+	     !(doubleOpt(opt, "minbases", minBases)   ||
+	       intOpt   (opt, "maxins",   maxInsert)  ||
+	       intOpt   (opt, "maxtrim",  maxTrim)    ||
+	       intOpt   (opt, "minmins",  minMins)    ||
+	       intOpt   (opt, "minov",    minOverlap) ||
+	       intOpt   (opt, "show",     show)       ||
+	       intOpt   (opt, "single",   single)))
+            throw std::runtime_error("invalid job option " + col[i]);
+      }
+
+      if (!validThresholds())
+         throw std::runtime_error("invalid job option value");
+
+      if (numCols - i < 2 || col[i] == "")
+         throw std::runtime_error("job needs an output filename and input files");
+
+      processSample(col[i], StringVector(col.begin() + i + 1, col.end()),
+                    annotationHeading);
+
+      reply = "ok " + col[i] + " read-pairs " + uint64ToString(numReadPairs);
+   }
+   catch (const std::runtime_error& error)
+   {
+      reply = std::string("error ") + error.what();
+   }
+
+   minBases   = saveMinBases;
+   maxInsert  = saveMaxInsert;
+   maxTrim    = saveMaxTrim;
+   minMins    = saveMinMins;
+   minOverlap = saveMinOverlap;
+   show       = saveShow;
+   single     = saveSingle;
+
+   return reply + NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// serve() listens on the named Unix socket and carries out one job per connection,
+// in the order the connections are accepted; the client sends a job as a line of
+// text and receives a one-line reply beginning with "ok" or "error"; the job "quit"
+// stops the server; the socket is accessible to the owner of the server only
+
+void serve(const std::string& socketPath, const StringVector& annotationHeading)
+{
+   const size_t MAX_JOB_LENGTH = 1 << 20; // longest job line accepted
+
+   struct sockaddr_un address;
+   std::memset(&address, 0, sizeof(address));
+   address.sun_family = AF_UNIX;
+
+   if (socketPath.length() >= sizeof(address.sun_path))
+      throw std::runtime_error("socket path too long: " + socketPath);
+
+   std::strcpy(address.sun_path, socketPath.c_str());
+
+   // remove a socket left behind by an earlier server, but nothing else
+   struct stat status;
+   if (stat(socketPath.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+      unlink(socketPath.c_str());
+
+   int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (listener == -1)
+      throw std::runtime_error("unable to create socket");
+
+   // a job may read and write any file the server can, so only the owner of the
+   // server may connect; the umask covers the socket from the moment it is created
+   mode_t saveMask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+
+   bool bound = (bind(listener, reinterpret_cast<struct sockaddr *>(&address),
+                      sizeof(address)) == 0);
+
+   umask(saveMask);
+
+   if (!bound || chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) == -1 ||
+       listen(listener, SOMAXCONN) == -1)
+   {
+      ::close(listener);
+      throw std::runtime_error("unable to listen on " + socketPath);
+   }
+
+   bool quit = false;
+
+   while (!quit)
+   {
+      int connection = accept(listener, NULL, NULL);
+      if (connection == -1)
+         continue;
+
+      std::string job;
+      char buffer[4096];
+      ssize_t n;
+
+      while (job.find(NEWLINE) == std::string::npos &&
+             job.length() < MAX_JOB_LENGTH &&
+             (n = recv(connection, buffer, sizeof(buffer), 0)) > 0)
+         job.append(buffer, n);
+
+      job = job.substr(0, job.find(NEWLINE));
+
+      if (job.length() > 0 && job[job.length() - 1] == CRETURN)
+         job.erase(job.length() - 1);
+
+      std::string reply;
+
+      if (job == "quit")
+      {
+         quit  = true;
+	 reply = "ok quit\n";
+      }
+      else
+         reply = processJob(job, annotationHeading);
+
+      // MSG_NOSIGNAL keeps a client that has gone away from stopping the server
+      send(connection, reply.data(), reply.length(), MSG_NOSIGNAL);
+
+      ::close(connection);
+   }
+
+   ::close(listener);
+   unlink(socketPath.c_str());
 }
 
 //------------------------------------------------------------------------------------
@@ -469,10 +1674,12 @@ int main(int argc, char *argv[])
 
    try
    {
-      rankTable = readRankTable(rankFilename);
+      rankTable = readRankTable(rankFilename, (populate == 1));
 
       maxMinimizer = (maxRank / 100) * numKmers(rankTable->k);
 
+      scheme = (sliding == 1 ? SLIDING_WINDOWS : FIXED_WINDOWS);
+
       StringVector annotationHeading;
 
       patternVector = readPatterns(patternFilename, annotationHeading);
@@ -480,46 +1687,102 @@ int main(int argc, char *argv[])
       if (patternVector->size() == 0)
          throw std::runtime_error("no patterns in " + patternFilename);
 
-      writeHitHeadingLine(CURRENT_VERSION, annotationHeading);
+      if (sorted == 1)
+         rankPatterns();
 
-      patternMap = createPatternMap(patternVector, w, rankTable, maxMinimizer);
-
-      if (fastqFilename1 != "")
-         pairReader = new FastqPairReader(fastqFilename1, fastqFilename2);
-      else if (ifastqFilename != "")
-         pairReader = new InterleavedFastqPairReader(ifastqFilename);
-      else if (ubamFilename != "")
-         pairReader = new UbamPairReader(ubamFilename);
+      if (indexFilename != "")
+         patternMap = mapPatternIndex(indexFilename,
+                                      getPatternIndexKey(patternFilename,
+                                                         patternVector, rankTable,
+							 w, maxMinimizer, scheme));
       else
-         pairReader = createInputReader(inputFilename);
+         patternMap = createPatternMap(patternVector, w, rankTable, maxMinimizer,
+                                       scheme);
 
-      pairReader->open();
+      patternMap->maxLocations = maxLocs; // not part of the index, which suits any
 
-      std::string **message = new std::string *[numThreads];
-      std::thread **thread  = new std::thread *[numThreads];
+      if (buildIndexFilename != "")
+      {
+         writePatternIndex(buildIndexFilename, patternMap,
+                           getPatternIndexKey(patternFilename, patternVector,
+                                              rankTable, w, maxMinimizer, scheme));
+         return 0;
+      }
 
-      // start all threads
-      for (int i = 0; i < numThreads; i++)
+      if (numa == 1) // spread the rank table, which every thread reads, across nodes
       {
-         message[i] = new std::string("");
-	 thread[i]  = new std::thread(threadWork, message[i]);
+         numaTopology = new NumaTopology();
+
+	 if (rankTable->isMapped())
+            numaTopology->interleave(rankTable->mapAddress, rankTable->mapLength);
+	 else
+            numaTopology->interleave(rankTable->rank, rankTable->allocSize);
       }
 
-      // wait for each thread to finish
-      for (int i = 0; i < numThreads; i++)
+      InputFile::inflateThreads = std::min(numThreads, MAX_INFLATE_THREADS);
+      BamReader::inflateThreads = bamThreads;
+
+      int numBatches = numThreads + EXTRA_BATCHES;
+
+      for (int i = 0; i < numBatches; i++)
+         emptyBatches.push(new ReadBatch(THREAD_BATCH_SIZE));
+
+      if (samplesFilename != "")
+         processSamples(samplesFilename, annotationHeading);
+      else if (serveSocket != "")
+         serve(serveSocket, annotationHeading);
+      else
       {
-         thread[i]->join();
-	 delete thread[i];
+         if (fastqFilename1 != "")
+            pairReader = new FastqPairReader(fastqFilename1, fastqFilename2);
+         else if (ifastqFilename != "")
+            pairReader = new InterleavedFastqPairReader(ifastqFilename);
+         else if (ubamFilename != "")
+            pairReader = new UbamPairReader(ubamFilename);
+         else if (abamFilename != "")
+            pairReader = new AbamPairReader(abamFilename,
+	                                    (regionsFilename == "" ? BamRegionVector() :
+					     readBamRegions(regionsFilename,
+					                    patternVector)));
+         else if (candidatesFilename != "")
+            pairReader = candidateReader =
+	       new CandidatePairReader(candidatesFilename,
+	                               getCandidateKey(patternVector, rankTable, w,
+				                       maxMinimizer, maxLocs, scheme,
+						       (single == 1)));
+         else
+            pairReader = createInputReader(inputFilename);
+
+         pairReader = shardReader(pairReader);
+
+         if (saveCandidatesFilename != "")
+         {
+            candidateWriter = new CandidateWriter();
+	    candidateWriter->open(saveCandidatesFilename,
+	                          getCandidateKey(patternVector, rankTable, w,
+				                  maxMinimizer, maxLocs, scheme,
+						  (single == 1)));
+         }
+
+         writeHeading(annotationHeading);
+
+         processInput();
+
+         if (candidateWriter)
+         {
+            candidateWriter->close(totalReadPairs);
+
+	    delete candidateWriter;
+	    candidateWriter = NULL;
+         }
       }
 
-      // all of the threads have finished; check for any exceptions
-      for (int i = 0; i < numThreads; i++)
-         if (*message[i] != "")
-            throw std::runtime_error(*message[i]);
+      ReadBatch *batch;
 
-      pairReader->close();
+      emptyBatches.close();
 
-      writeReadPairLine(numReadPairs);
+      while ((batch = emptyBatches.pop()) != NULL)
+         delete batch;
    }
    catch (const std::runtime_error& error)
    {
@@ -11,8 +11,14 @@
 
 #include "group.h"
 #include "version.h"
+#include <atomic>
+#include <cerrno>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
 
 const std::string VERSION_NAME    = "fuzzion2html " + CURRENT_VERSION;
 
@@ -37,10 +43,18 @@ const std::string STRONG_MATCH    = "strong";
 const std::string WEAK_MATCH      = "weak";
 const std::string DUPLICATE_MATCH = "dup";
 
-int minStrong = DEFAULT_MIN_STRONG; // minimum overlap for a strong match
+const std::string INDEX_PAGE      = "index.html"; // name of the index of the pages
+const std::string DIGEST_META     = "fuzzion2html-digest";
+
+const int DEFAULT_THREADS         = 8;  // default number of threads writing pages
+
+int minStrong  = DEFAULT_MIN_STRONG; // minimum overlap for a strong match
+int maxReads   = 0;                  // maximum read pairs shown, or 0 if no limit
+int numThreads = DEFAULT_THREADS;    // number of threads writing pages
 
 std::string title = "";             // optional title
 std::string groupColList = "";      // comma-separated list of group column headings
+std::string pageDir = "";           // directory of pages, or empty for one document
 
 //------------------------------------------------------------------------------------
 // showUsage() writes the program's usage to stderr
@@ -58,9 +72,20 @@ void showUsage(const char *progname)
       << "  -group=string   "
              << "comma-separated list of column headings, default is no grouping"
              << NEWLINE
+      << "  -maxreads=N     "
+             << "maximum read pairs shown per pattern or group, default is no limit"
+             << NEWLINE
+      << "  -pages=string   "
+             << "directory of an index page and one page per pattern or group,"
+	     << NEWLINE
+      << "                  "
+             << "default is one HTML document written to stdout" << NEWLINE
       << "  -strong=N       "
              << "minimum overlap of a strong match in #bases, default is "
 	     << DEFAULT_MIN_STRONG << NEWLINE
+      << "  -threads=N      "
+             << "number of threads writing pages, default is " << DEFAULT_THREADS
+	     << NEWLINE
       << "  -title=string   "
              << "string to include in the title of the HTML page" << NEWLINE;
 }
@@ -84,15 +109,18 @@ bool parseArgs(int argc, char *argv[])
       if (splitString(arg, opt, '=') != 2)
          return false; // incorrect option format
 
-      if (intOpt   (opt, "strong", minStrong)    ||
-          stringOpt(opt, "group",  groupColList) ||
-          stringOpt(opt, "title",  title))
+      if (intOpt   (opt, "strong",   minStrong)    ||
+          intOpt   (opt, "maxreads", maxReads)     ||
+          intOpt   (opt, "threads",  numThreads)   ||
+          stringOpt(opt, "group",    groupColList) ||
+          stringOpt(opt, "pages",    pageDir)      ||
+          stringOpt(opt, "title",    title))
          continue;  // this option has been recognized
 
       return false; // unrecognized option
    }
 
-   return (minStrong > 0);
+   return (minStrong > 0 && maxReads >= 0 && numThreads > 0);
 }
 
 //------------------------------------------------------------------------------------
@@ -123,134 +151,161 @@ std::string wrap(std::string content, std::string tag, std::string style="")
 }
 
 //------------------------------------------------------------------------------------
-// writeHtmlBegin() writes to stdout the opening lines of the HTML document
+// digestLine() returns the line of the head of a page that records its digest
+
+std::string digestLine(uint64_t digest)
+{
+   return "<meta name=\"" + DIGEST_META + "\" content=\"" + uint64ToString(digest) +
+          "\">";
+}
+
+//------------------------------------------------------------------------------------
+// writeHtmlHead() writes to out the opening lines of an HTML document through its
+// heading; the head records the given digest of a page if it is nonzero
 
-void writeHtmlBegin(const std::string& fuzzion2Version, uint64_t numReadPairs,
-                    int numMatches, int numMatched, bool grouping)
+void writeHtmlHead(std::ostream& out, const std::string& fuzzion2Version,
+                   uint64_t digest=0)
 {
    std::string fullTitle = FUZZION2 + fuzzion2Version + " results";
 
    if (title != "")
       fullTitle += " : " + title;
 
-   std::cout << openTag("!DOCTYPE html") << NEWLINE
-             << openTag("html")   << NEWLINE
-	     << openTag("head")   << NEWLINE
-	     << wrap(fullTitle, "title") << NEWLINE
-	     << openTag("style")  << NEWLINE
-	     << "table { color:black; background-color:ghostwhite; "
-                "font-family:'Lucida Console', monospace; }" << NEWLINE
-	     << closeTag("style") << NEWLINE
-	     << closeTag("head")  << NEWLINE
-	     << openTag("body")   << NEWLINE
-	     << openTag("main", "font-family:arial") << NEWLINE
-	     << wrap(fullTitle, "h2") << NEWLINE
-	     << openTag("p") << numReadPairs << " read pairs processed; ";
+   out << openTag("!DOCTYPE html") << NEWLINE
+       << openTag("html")   << NEWLINE
+       << openTag("head")   << NEWLINE;
+
+   if (digest != 0)
+      out << digestLine(digest) << NEWLINE;
+
+   out << wrap(fullTitle, "title") << NEWLINE
+       << openTag("style")  << NEWLINE
+       << "table { color:black; background-color:ghostwhite; "
+          "font-family:'Lucida Console', monospace; }" << NEWLINE
+       << closeTag("style") << NEWLINE
+       << closeTag("head")  << NEWLINE
+       << openTag("body")   << NEWLINE
+       << openTag("main", "font-family:arial") << NEWLINE
+       << wrap(fullTitle, "h2") << NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// writeHtmlBegin() writes to out the opening lines of the HTML document
+
+void writeHtmlBegin(std::ostream& out, const std::string& fuzzion2Version,
+                    uint64_t numReadPairs, int numMatches, int numMatched,
+		    bool grouping)
+{
+   writeHtmlHead(out, fuzzion2Version);
+
+   out << openTag("p") << numReadPairs << " read pairs processed; ";
 
    if (numMatches == 0)
-      std::cout << "no matches";
+      out << "no matches";
    else
    {
       if (numMatches == 1)
-         std::cout << "1 read pair matches 1 ";
+         out << "1 read pair matches 1 ";
       else
-         std::cout << numMatches << " read pairs match " << numMatched << " ";
+         out << numMatches << " read pairs match " << numMatched << " ";
 
       if (grouping)
-         std::cout << (numMatched == 1 ? "pattern group" : "pattern groups");
+         out << (numMatched == 1 ? "pattern group" : "pattern groups");
       else
-         std::cout << (numMatched == 1 ? "pattern" : "patterns");
+         out << (numMatched == 1 ? "pattern" : "patterns");
    }
 
-   std::cout << NEWLINE;
+   out << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeHtmlEnd() writes to stdout the closing lines of the HTML document
+// writeHtmlEnd() writes to out the closing lines of the HTML document
 
-void writeHtmlEnd()
+void writeHtmlEnd(std::ostream& out)
 {
-   std::cout << closeTag("main") << NEWLINE
-             << closeTag("body") << NEWLINE
-	     << closeTag("html") << NEWLINE;
+   out << closeTag("main") << NEWLINE
+       << closeTag("body") << NEWLINE
+       << closeTag("html") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeSummaryBegin() writes to stdout the opening lines of a pattern or group
+// writeSummaryBegin() writes to out the opening lines of a pattern or group
 
-void writeSummaryBegin(const Summary *summary, bool grouping)
+void writeSummaryBegin(std::ostream& out, const Summary *summary, bool grouping,
+                       bool isOpen=false)
 {
-   std::cout << openTag("p") << NEWLINE
-             << openTag("details") << NEWLINE
-	     << openTag("summary")
-	     << openTag("b")
-	     << (grouping ? "group" : "pattern")
-	     << "<a id=\"" << summary->name << "\">" << BLANK << closeTag("a")
-	     << wrap(summary->name, "span", NAME_COLOR)
-	     << " has " << summary->readPairs << " matching read "
-	     << (summary->readPairs == 1 ? "pair" : "pairs")
-	     << closeTag("b") << " ("
-	     << summary->distinct()   << " distinct, "
-	     << summary->weak         << " weak, "
-	     << summary->strongNospan << " strong-, "
-	     << summary->strongSpan   << " strong+)"
-	     << closeTag("summary") << NEWLINE;
+   out << openTag("p") << NEWLINE
+       << (isOpen ? "<details open>" : openTag("details")) << NEWLINE
+       << openTag("summary")
+       << openTag("b")
+       << (grouping ? "group" : "pattern")
+       << "<a id=\"" << summary->name << "\">" << BLANK << closeTag("a")
+       << wrap(summary->name, "span", NAME_COLOR)
+       << " has " << summary->readPairs << " matching read "
+       << (summary->readPairs == 1 ? "pair" : "pairs")
+       << closeTag("b") << " ("
+       << summary->distinct()   << " distinct, "
+       << summary->weak         << " weak, "
+       << summary->strongNospan << " strong-, "
+       << summary->strongSpan   << " strong+)"
+       << closeTag("summary") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeSummaryEnd() writes to stdout the closing line of a pattern or group
+// writeSummaryEnd() writes to out the closing line of a pattern or group
 
-void writeSummaryEnd()
+void writeSummaryEnd(std::ostream& out)
 {
-   std::cout << closeTag("details") << NEWLINE;
+   out << closeTag("details") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeAnnotationSectionBegin() writes to stdout the opening lines of an annotation
+// writeAnnotationSectionBegin() writes to out the opening lines of an annotation
 // section
 
-void writeAnnotationSectionBegin(bool grouping)
+void writeAnnotationSectionBegin(std::ostream& out, bool grouping)
 {
-   std::cout << openTag("details", "color:darkred") << NEWLINE
-             << openTag("summary");
+   out << openTag("details", "color:darkred") << NEWLINE
+       << openTag("summary");
 
    for (int i = 1; i <= SECTION_INDENT; i++)
-      std::cout << BLANK;
+      out << BLANK;
 
-   std::cout << (grouping ? "group" : "pattern") << " annotations"
-             << closeTag("summary") << NEWLINE;
+   out << (grouping ? "group" : "pattern") << " annotations"
+       << closeTag("summary") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeAnnotationSectionEnd() writes to stdout the closing line of an annotation
+// writeAnnotationSectionEnd() writes to out the closing line of an annotation
 // section
 
-void writeAnnotationSectionEnd()
+void writeAnnotationSectionEnd(std::ostream& out)
 {
-   std::cout << closeTag("details") << NEWLINE;
+   out << closeTag("details") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeAnnotation() writes an annotation to stdout
+// writeAnnotation() writes an annotation to out
 
-void writeAnnotation(const std::string& name, const std::string& value)
+void writeAnnotation(std::ostream& out, const std::string& name,
+                     const std::string& value)
 {
    if (value == "")
       return;
 
    for (int i = 1; i <= ANNOTATION_INDENT; i++)
-      std::cout << BLANK;
+      out << BLANK;
 
    if (name != "")
-      std::cout << wrap(name, "i") << " : ";
+      out << wrap(name, "i") << " : ";
   
-   std::cout << value << openTag("br") << NEWLINE;
+   out << value << openTag("br") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeAllAnnotations() writes the given annotations to stdout
+// writeAllAnnotations() writes the given annotations to out
 
-void writeAllAnnotations(const StringVector& annotationHeading,
+void writeAllAnnotations(std::ostream& out, const StringVector& annotationHeading,
                          const StringVector& annotation, bool grouping)
 {
    int numAnnotationHeadings = annotationHeading.size();
@@ -265,7 +320,7 @@ void writeAllAnnotations(const StringVector& annotationHeading,
    if (!hasValue)
       return; // there are no annotations
 
-   writeAnnotationSectionBegin(grouping);
+   writeAnnotationSectionBegin(out, grouping);
 
    const std::string NO_HEADING = "";
 
@@ -274,106 +329,118 @@ void writeAllAnnotations(const StringVector& annotationHeading,
       const std::string& heading =
          (i < numAnnotationHeadings ? annotationHeading[i] : NO_HEADING);
 
-      writeAnnotation(heading, annotation[i]);
+      writeAnnotation(out, heading, annotation[i]);
    }
 
-   writeAnnotationSectionEnd();
+   writeAnnotationSectionEnd(out);
 }
 
 //------------------------------------------------------------------------------------
-// writeMatchSectionBegin() writes to stdout the opening lines of a match section
+// writeMatchSectionBegin() writes to out the opening lines of a match section
 
-void writeMatchSectionBegin()
+void writeMatchSectionBegin(std::ostream& out)
 {
-   std::cout << openTag("details", "color:darkblue") << NEWLINE
-             << openTag("summary");
+   out << openTag("details", "color:darkblue") << NEWLINE
+       << openTag("summary");
 
    for (int i = 1; i <= SECTION_INDENT; i++)
-      std::cout << BLANK;
+      out << BLANK;
 
-   std::cout << "matching read pairs" << closeTag("summary") << NEWLINE
-             << openTag("table") << NEWLINE;
+   out << "matching read pairs" << closeTag("summary") << NEWLINE
+       << openTag("table") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeMatchSectionEnd() writes to stdout the closing lines of a match section
+// writeMatchSectionEnd() writes to out the closing lines of a match section
 
-void writeMatchSectionEnd()
+void writeMatchSectionEnd(std::ostream& out)
 {
-   std::cout << closeTag("table")   << NEWLINE
-             << closeTag("details") << NEWLINE;
+   out << closeTag("table")   << NEWLINE
+       << closeTag("details") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeBlankColumn() writes to stdout a blank column
+// writeBlankColumn() writes to out a blank column
 
-void writeBlankColumn()
+void writeBlankColumn(std::ostream& out)
 {
-   std::cout << openTag("td") << BLANK << closeTag("td") << NEWLINE;
+   out << openTag("td") << BLANK << closeTag("td") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeBlankRow() writes to stdout a blank row
+// writeBlankRow() writes to out a blank row
 
-void writeBlankRow()
+void writeBlankRow(std::ostream& out)
 {
    const int NUM_COLS = 6;
 
-   std::cout << openTag("tr") << NEWLINE;
+   out << openTag("tr") << NEWLINE;
 
    for (int i = 1; i <= NUM_COLS; i++)
-      writeBlankColumn();
+      writeBlankColumn(out);
+
+   out << closeTag("tr") << NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// writeHiddenRow() writes to out a row noting the number of read pairs not shown
 
-   std::cout << closeTag("tr") << NEWLINE;
+void writeHiddenRow(std::ostream& out, int numHidden)
+{
+   out << openTag("tr") << NEWLINE
+       << "<td colspan=\"6\">" << BLANK << numHidden << " more matching read "
+       << (numHidden == 1 ? "pair is" : "pairs are") << " not shown"
+       << closeTag("td") << NEWLINE
+       << closeTag("tr") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
-// writeMatchRow() writes to stdout one row of a match; if number is positive, it is a
+// writeMatchRow() writes to out one row of a match; if number is positive, it is a
 // pattern row; otherwise, it is a read row
 
-void writeMatchRow(std::string matchLabel, int number, int qualifier,
-                   double percentMatch, const std::string& sequence, int length,
-		   std::string name)
+void writeMatchRow(std::ostream& out, std::string matchLabel, int number,
+                   int qualifier, double percentMatch, const std::string& sequence,
+		   int length, std::string name)
 {
-   std::cout << openTag("tr") << NEWLINE;
+   out << openTag("tr") << NEWLINE;
 
    // column 1 of 6
-   std::cout << openTag("td", ALIGN_CENTER) << matchLabel
-             << closeTag("td") << NEWLINE;
+   out << openTag("td", ALIGN_CENTER) << matchLabel
+       << closeTag("td") << NEWLINE;
 
    // column 2 of 6
    if (number <= 0)
-      writeBlankColumn();
+      writeBlankColumn(out);
    else
-      std::cout << openTag("td", ALIGN_CENTER)
-	        << BLANK << openTag("b")
-		<< number << (qualifier > 0 ? HYPHEN + intToString(qualifier) : "")
-	       	<< closeTag("b")
-		<< closeTag("td") << NEWLINE;
+      out << openTag("td", ALIGN_CENTER)
+          << BLANK << openTag("b")
+          << number << (qualifier > 0 ? HYPHEN + intToString(qualifier) : "")
+          << closeTag("b")
+          << closeTag("td") << NEWLINE;
 
    // column 3 of 6
-   std::cout << openTag("td", ALIGN_RIGHT)
-	     << BLANK << (percentMatch == 0.0 ? NA : doubleToString(percentMatch))
-             << closeTag("td") << NEWLINE;
+   out << openTag("td", ALIGN_RIGHT)
+       << BLANK << (percentMatch == 0.0 ? NA : doubleToString(percentMatch))
+       << closeTag("td") << NEWLINE;
 
    // column 4 of 6
-   std::cout << openTag("td")
-             << openTag("nobr") << BLANK << sequence << closeTag("nobr")
-	     << closeTag("td") << NEWLINE;
+   out << openTag("td")
+       << openTag("nobr") << BLANK << sequence << closeTag("nobr")
+       << closeTag("td") << NEWLINE;
 
    // column 5 of 6
-   std::cout << openTag("td", ALIGN_RIGHT)
-	     << openTag("nobr")
-             << BLANK << (number > 0 ? "isize=" : "length=") << length
-	     << closeTag("nobr")
-	     << closeTag("td") << NEWLINE;
+   out << openTag("td", ALIGN_RIGHT)
+       << openTag("nobr")
+       << BLANK << (number > 0 ? "isize=" : "length=") << length
+       << closeTag("nobr")
+       << closeTag("td") << NEWLINE;
 
    // column 6 of 6
-   std::cout << openTag("td")
-	     << openTag("nobr") << BLANK << name << closeTag("nobr")
-             << closeTag("td") << NEWLINE;
+   out << openTag("td")
+       << openTag("nobr") << BLANK << name << closeTag("nobr")
+       << closeTag("td") << NEWLINE;
 
-   std::cout << closeTag("tr") << NEWLINE;
+   out << closeTag("tr") << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
@@ -525,107 +592,127 @@ std::string highlightReadSequence(int numLeadingBlanks,
 }
 
 //------------------------------------------------------------------------------------
-// writeMatch() writes to stdout four rows representing a match: one pattern row
+// writeMatch() writes to out four rows representing a match: one pattern row
 // followed by two read rows representing the matching read pair and one blank row
 // for spacing
 
-void writeMatch(int number, int qualifier, const Hit& hit, int maxPatternLen)
+void writeMatch(std::ostream& out, int number, int qualifier, const Hit& hit,
+                int maxPatternLen)
 {
    std::string highlightPattern =
-      highlightPatternSequence(hit.pattern->displaySequence, hit.pattern->leftBases,
-                               hit.pattern->delim2, maxPatternLen);
+      highlightPatternSequence(hit.pattern.displaySequence, hit.pattern.leftBases,
+                               hit.pattern.delim2, maxPatternLen);
 
    std::string highlightRead1 =
-      highlightReadSequence(hit.read1->leadingBlanks,  hit.read1->sequence,
-                            hit.read1->percentMatch(), hit.pattern->displaySequence,
-			    hit.pattern->leftBases, hit.pattern->delim2);
+      highlightReadSequence(hit.read1.leadingBlanks,  hit.read1.sequence,
+                            hit.read1.percentMatch(), hit.pattern.displaySequence,
+			    hit.pattern.leftBases, hit.pattern.delim2);
 
    std::string highlightRead2 =
-      highlightReadSequence(hit.read2->leadingBlanks,  hit.read2->sequence,
-                            hit.read2->percentMatch(), hit.pattern->displaySequence,
-			    hit.pattern->leftBases, hit.pattern->delim2);
+      highlightReadSequence(hit.read2.leadingBlanks,  hit.read2.sequence,
+                            hit.read2.percentMatch(), hit.pattern.displaySequence,
+			    hit.pattern.leftBases, hit.pattern.delim2);
 
-   writeMatchRow(hit.label(minStrong), number, qualifier, hit.pattern->percentMatch(),
-                 highlightPattern, hit.pattern->insertSize, hit.pattern->name);
+   writeMatchRow(out, hit.label(minStrong), number, qualifier,
+                 hit.pattern.percentMatch(), highlightPattern, hit.pattern.insertSize,
+		 hit.pattern.name());
 
-   writeMatchRow((hit.read1->isSpanning ? "+" : "-"), 0, 0, hit.read1->percentMatch(),
-		 highlightRead1, hit.read1->sequence.length(), hit.read1->name);
+   writeMatchRow(out, (hit.read1.isSpanning ? "+" : "-"), 0, 0,
+                 hit.read1.percentMatch(), highlightRead1,
+		 hit.read1.sequence.length(), hit.read1.name);
 
-   writeMatchRow((hit.read2->isSpanning ? "+" : "-"), 0, 0, hit.read2->percentMatch(),
-		 highlightRead2, hit.read2->sequence.length(), hit.read2->name);
+   writeMatchRow(out, (hit.read2.isSpanning ? "+" : "-"), 0, 0,
+                 hit.read2.percentMatch(), highlightRead2,
+		 hit.read2.sequence.length(), hit.read2.name);
 
-   writeBlankRow();
+   writeBlankRow(out);
 }
 
 //------------------------------------------------------------------------------------
-// writePattern() writes to stdout the annotations and matches of a pattern; the
-// matches are given in hitVector from begin (inclusive) to end (exclusive)
+// writePattern() writes to out the annotations and matches of a pattern; the
+// matches are given in hitVector from begin (inclusive) to end (exclusive), and no
+// more than maxReads of them are shown if there is a limit
 
-void writePattern(const StringVector& annotationHeading, const HitVector& hitVector,
-                  int begin, int end)
+void writePattern(std::ostream& out, const StringVector& annotationHeading,
+                  const HitVector& hitVector, int begin, int end, bool isOpen=false)
 {
    Summary *summary = summarizeHits(hitVector, begin, end, minStrong);
-   writeSummaryBegin(summary, false);
+   writeSummaryBegin(out, summary, false, isOpen);
    delete summary;
 
-   writeAllAnnotations(annotationHeading, hitVector[begin]->pattern->annotation,
+   writeAllAnnotations(out, annotationHeading, hitVector[begin]->pattern.annotation(),
                        false);
 
-   writeMatchSectionBegin();
+   writeMatchSectionBegin(out);
 
-   int maxPatternLen = maxDisplayLength(hitVector, begin, end);
+   int shownEnd = (maxReads > 0 ? std::min(end, begin + maxReads) : end);
 
-   for (int i = begin; i < end; i++)
+   int maxPatternLen = maxDisplayLength(hitVector, begin, shownEnd);
+
+   for (int i = begin; i < shownEnd; i++)
    {
       const Hit *hit = hitVector[i];
-      writeMatch(i - begin + 1, 0, *hit, maxPatternLen);
+      writeMatch(out, i - begin + 1, 0, *hit, maxPatternLen);
    }
 
-   writeMatchSectionEnd();
+   if (shownEnd < end)
+      writeHiddenRow(out, end - shownEnd);
+
+   writeMatchSectionEnd(out);
 
-   writeSummaryEnd();
+   writeSummaryEnd(out);
 }
 
 //------------------------------------------------------------------------------------
-// writeGroup() writes to stdout the annotations and matches of a group
+// writeGroup() writes to out the annotations and matches of a group, showing no more
+// than maxReads read pairs if there is a limit
 
-void writeGroup(const StringVector& annotationHeading, Group& group)
+void writeGroup(std::ostream& out, const StringVector& annotationHeading,
+                Group& group, bool isOpen=false)
 {
    Summary *summary = group.summarize(minStrong);
-   writeSummaryBegin(summary, true);
+   writeSummaryBegin(out, summary, true, isOpen);
    delete summary;
 
-   writeAllAnnotations(annotationHeading, group.annotation, true);
+   writeAllAnnotations(out, annotationHeading, group.annotation, true);
+
+   writeMatchSectionBegin(out);
 
-   writeMatchSectionBegin();
+   int readPairs = group.readPairCount();
+   int shownPairs = (maxReads > 0 ? std::min(readPairs, maxReads) : readPairs);
 
-   int maxPatternLen = group.maxGroupDisplayLength();
+   int maxPatternLen = (shownPairs == readPairs ? group.maxGroupDisplayLength() :
+                        maxDisplayLength(group.hitVector, 0,
+			                 group.readBegin(shownPairs)));
 
    int number = 1;
 
-   for (ReadMap::iterator rpos = group.rmap.begin(); rpos != group.rmap.end(); ++rpos)
+   for (int pair = 0; pair < shownPairs; pair++)
    {
-      const HitVector& hitVector = rpos->second;
-      int numHits = hitVector.size();
+      int begin   = group.readBegin(pair);
+      int numHits = group.readEnd(pair) - begin;
 
       for (int i = 0; i < numHits; i++)
       {
-         const Hit *hit = hitVector[i];
-         writeMatch(number, (numHits > 1 ? i + 1 : 0), *hit, maxPatternLen);
+         const Hit *hit = group.hitVector[begin + i];
+         writeMatch(out, number, (numHits > 1 ? i + 1 : 0), *hit, maxPatternLen);
       }
 
       number++;
    }
 
-   writeMatchSectionEnd();
+   if (shownPairs < readPairs)
+      writeHiddenRow(out, readPairs - shownPairs);
 
-   writeSummaryEnd();
+   writeMatchSectionEnd(out);
+
+   writeSummaryEnd(out);
 }
 
 //------------------------------------------------------------------------------------
-// writeAllPatterns() writes to stdout an HTML document displaying matches of patterns
+// writeAllPatterns() writes to out an HTML document displaying matches of patterns
 
-void writeAllPatterns(const std::string& fuzzion2Version,
+void writeAllPatterns(std::ostream& out, const std::string& fuzzion2Version,
                       const StringVector& annotationHeading,
                       const HitVector& hitVector, uint64_t numReadPairs)
 {
@@ -633,7 +720,7 @@ void writeAllPatterns(const std::string& fuzzion2Version,
    getPatternIndices(hitVector, index);
    int numPatterns = index.size();
 
-   writeHtmlBegin(fuzzion2Version, numReadPairs, hitVector.size(), numPatterns,
+   writeHtmlBegin(out, fuzzion2Version, numReadPairs, hitVector.size(), numPatterns,
                   false);
 
    for (int i = 0; i < numPatterns; i++)
@@ -641,27 +728,340 @@ void writeAllPatterns(const std::string& fuzzion2Version,
       int begin = index[i];
       int end   = (i + 1 < numPatterns ? index[i + 1] : hitVector.size());
 
-      writePattern(annotationHeading, hitVector, begin, end);
+      writePattern(out, annotationHeading, hitVector, begin, end);
+   }
+
+   writeHtmlEnd(out);
+}
+
+//------------------------------------------------------------------------------------
+// writeAllGroups() writes to out an HTML document displaying matches of groups
+
+void writeAllGroups(std::ostream& out, const std::string& fuzzion2Version,
+                    uint64_t numReadPairs, GroupManager& groupManager)
+{
+   writeHtmlBegin(out, fuzzion2Version, numReadPairs, groupManager.readPairCount(),
+                  groupManager.group.size(), true);
+
+   int numGroups = groupManager.group.size();
+
+   for (int i = 0; i < numGroups; i++)
+      writeGroup(out, groupManager.annotationHeading, groupManager.group[i]);
+
+   writeHtmlEnd(out);
+}
+
+//------------------------------------------------------------------------------------
+
+struct Page // a pattern or group written to its own file
+{
+   Page()
+      : filename(), summary(NULL), begin(0), end(0), group(NULL), digest(0),
+        message() { }
+
+   std::string filename; // in pageDir
+   Summary *summary;     // summary of the pattern or group
+   int begin, end;       // hits of a pattern in hitVector, from begin to end
+   Group *group;         // the group, or NULL if this is a pattern
+   uint64_t digest;      // digest of the content of the page
+   std::string message;  // error message, or empty if the page was written
+};
+
+struct PageSet // the pages of a run in which each pattern or group has its own page
+{
+   PageSet(const std::string& inVersion, const StringVector& inAnnotationHeading,
+           const HitVector& inHitVector)
+      : fuzzion2Version(inVersion), annotationHeading(inAnnotationHeading),
+        hitVector(inHitVector), page(), nextPage(0), numWritten(0) { }
+
+   const std::string&  fuzzion2Version;
+   const StringVector& annotationHeading;
+   const HitVector&    hitVector;
+
+   std::vector<Page> page;
+   std::atomic<int>  nextPage;   // index of the next page for a thread to write
+   std::atomic<int>  numWritten; // number of pages written, excluding current ones
+};
+
+//------------------------------------------------------------------------------------
+// pageDigest() returns a digest of everything shown on a page: the options, the
+// summary, and the hits shown for the pattern or group, along with their labels
+
+uint64_t pageDigest(const PageSet& pageSet, const Page& page)
+{
+   const Summary *summary = page.summary;
+
+   std::string content = VERSION_NAME + TAB + pageSet.fuzzion2Version + TAB + title +
+                         TAB + summary->name;
+
+   int numHeadings = pageSet.annotationHeading.size();
+
+   for (int i = 0; i < numHeadings; i++)
+      content += TAB + pageSet.annotationHeading[i];
+
+   int numAnnotations = summary->annotation.size();
+
+   for (int i = 0; i < numAnnotations; i++)
+      content += TAB + summary->annotation[i];
+
+   content += TAB + intToString(summary->readPairs) +
+              TAB + intToString(summary->weak) +
+	      TAB + intToString(summary->strongNospan) +
+	      TAB + intToString(summary->strongSpan) + NEWLINE;
+
+   // the hits shown, from begin to end, and the number of read pairs not shown
+
+   const HitVector *hitVector = &pageSet.hitVector;
+   int begin = page.begin, end = page.end, numHidden = 0;
+
+   if (page.group)
+   {
+      hitVector = &page.group->hitVector;
+      begin     = 0;
+      end       = hitVector->size();
+
+      int readPairs = page.group->readPairCount();
+
+      if (maxReads > 0 && maxReads < readPairs)
+      {
+         end       = page.group->readBegin(maxReads);
+	 numHidden = readPairs - maxReads;
+      }
+   }
+   else if (maxReads > 0 && maxReads < end - begin)
+   {
+      numHidden = end - begin - maxReads;
+      end       = begin + maxReads;
+   }
+
+   for (int i = begin; i < end; i++)
+   {
+      content += (*hitVector)[i]->label(minStrong) + NEWLINE;
+      (*hitVector)[i]->append(content);
    }
 
-   writeHtmlEnd();
+   content += intToString(numHidden) + NEWLINE;
+
+   return hashBytes(content.data(), content.length());
 }
 
 //------------------------------------------------------------------------------------
-// writeAllGroups() writes to stdout an HTML document displaying matches of groups
+// isCurrentPage() returns true if the named file is a page having the given digest,
+// as written by a previous run
 
-void writeAllGroups(const std::string& fuzzion2Version, uint64_t numReadPairs,
-                    GroupManager& groupManager)
+bool isCurrentPage(const std::string& filename, uint64_t digest)
 {
-   writeHtmlBegin(fuzzion2Version, numReadPairs, groupManager.readPairCount(),
-                  groupManager.gmap.size(), true);
+   std::ifstream infile(filename.c_str());
+   if (!infile.is_open())
+      return false;
 
-   GroupMap& gmap = groupManager.gmap;
+   std::string expected = digestLine(digest), line;
 
-   for (GroupMap::iterator gpos = gmap.begin(); gpos != gmap.end(); ++gpos)
-      writeGroup(groupManager.annotationHeading, gpos->second);
+   while (getline(infile, line) && line != closeTag("head"))
+      if (line == expected)
+         return true;
 
-   writeHtmlEnd();
+   return false;
+}
+
+//------------------------------------------------------------------------------------
+// writePage() writes a page to its file unless the file is current
+
+void writePage(PageSet& pageSet, Page& page)
+{
+   std::string filename = pageDir + "/" + page.filename;
+
+   page.digest = pageDigest(pageSet, page);
+
+   if (isCurrentPage(filename, page.digest))
+      return;
+
+   std::ostringstream out;
+
+   writeHtmlHead(out, pageSet.fuzzion2Version, page.digest);
+
+   out << openTag("p") << "<a href=\"" << INDEX_PAGE << "\">all "
+       << (page.group ? "pattern groups" : "patterns") << "</a>" << NEWLINE;
+
+   if (page.group)
+      writeGroup(out, pageSet.annotationHeading, *page.group, true);
+   else
+      writePattern(out, pageSet.annotationHeading, pageSet.hitVector, page.begin,
+                   page.end, true);
+
+   writeHtmlEnd(out);
+
+   std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary);
+   if (!outfile.is_open())
+      throw std::runtime_error("unable to open " + filename);
+
+   std::string html = out.str();
+
+   outfile.write(html.data(), html.length());
+   outfile.close();
+
+   if (outfile.fail())
+      throw std::runtime_error("unable to write " + filename);
+
+   pageSet.numWritten++;
+}
+
+//------------------------------------------------------------------------------------
+// pageWork() contains the work of each thread writing pages, which takes the next
+// page until none remain; an exception is recorded in the page being written
+
+void pageWork(PageSet *pageSet)
+{
+   int numPages = pageSet->page.size();
+   int i;
+
+   while ((i = pageSet->nextPage++) < numPages)
+   {
+      Page& page = pageSet->page[i];
+
+      try
+      {
+         writePage(*pageSet, page);
+      }
+      catch (const std::runtime_error& error)
+      {
+         page.message = error.what();
+      }
+   }
+}
+
+//------------------------------------------------------------------------------------
+// writeIndex() writes to out the index page, which has a line for each pattern or
+// group linking to its page
+
+void writeIndex(std::ostream& out, const PageSet& pageSet, uint64_t numReadPairs,
+                int numMatches, bool grouping)
+{
+   int numPages = pageSet.page.size();
+
+   writeHtmlBegin(out, pageSet.fuzzion2Version, numReadPairs, numMatches, numPages,
+                  grouping);
+
+   for (int i = 0; i < numPages; i++)
+   {
+      const Summary *summary = pageSet.page[i].summary;
+
+      out << openTag("p")
+          << openTag("b")
+          << (grouping ? "group" : "pattern") << BLANK
+          << "<a href=\"" << pageSet.page[i].filename << "\">"
+          << wrap(summary->name, "span", NAME_COLOR) << closeTag("a")
+          << " has " << summary->readPairs << " matching read "
+          << (summary->readPairs == 1 ? "pair" : "pairs")
+          << closeTag("b") << " ("
+          << summary->distinct()   << " distinct, "
+          << summary->weak         << " weak, "
+          << summary->strongNospan << " strong-, "
+          << summary->strongSpan   << " strong+)"
+          << closeTag("p") << NEWLINE;
+   }
+
+   writeHtmlEnd(out);
+}
+
+//------------------------------------------------------------------------------------
+// writeAllPages() writes each pattern, or each group if groupManager is not NULL, to
+// its own page in pageDir, using multiple threads, and then writes the index page;
+// pages whose content has not changed since a previous run are not rewritten
+
+void writeAllPages(const std::string& fuzzion2Version,
+                   const StringVector& annotationHeading, const HitVector& hitVector,
+		   uint64_t numReadPairs, GroupManager *groupManager)
+{
+   if (mkdir(pageDir.c_str(), 0777) != 0 && errno != EEXIST)
+      throw std::runtime_error("unable to create directory " + pageDir);
+
+   PageSet pageSet(fuzzion2Version, annotationHeading, hitVector);
+   int numMatches;
+
+   if (groupManager)
+   {
+      int numGroups = groupManager->group.size();
+      pageSet.page.resize(numGroups);
+
+      for (int i = 0; i < numGroups; i++)
+      {
+         Page& page = pageSet.page[i];
+
+	 page.filename = "group_" + intToStringLeadingZeros(i + 1, 6) + ".html";
+	 page.group    = &groupManager->group[i];
+	 page.summary  = page.group->summarize(minStrong);
+      }
+
+      numMatches = groupManager->readPairCount();
+   }
+   else
+   {
+      IntVector index;
+      getPatternIndices(hitVector, index);
+      int numPatterns = index.size();
+      pageSet.page.resize(numPatterns);
+
+      for (int i = 0; i < numPatterns; i++)
+      {
+         Page& page = pageSet.page[i];
+
+	 page.filename = "pattern_" + intToStringLeadingZeros(i + 1, 6) + ".html";
+	 page.begin    = index[i];
+	 page.end      = (i + 1 < numPatterns ? index[i + 1] : hitVector.size());
+	 page.summary  = summarizeHits(hitVector, page.begin, page.end, minStrong);
+      }
+
+      numMatches = hitVector.size();
+   }
+
+   int numPages = pageSet.page.size();
+   int numPageThreads = std::max(1, std::min(numThreads, numPages));
+
+   std::thread **thread = new std::thread *[numPageThreads];
+
+   for (int i = 0; i < numPageThreads; i++)
+      thread[i] = new std::thread(pageWork, &pageSet);
+
+   for (int i = 0; i < numPageThreads; i++)
+   {
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   delete[] thread;
+
+   std::string error = "";
+
+   for (int i = 0; i < numPages; i++)
+      if (error == "")
+         error = pageSet.page[i].message;
+
+   if (error == "")
+   {
+      std::string filename = pageDir + "/" + INDEX_PAGE;
+
+      std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary);
+      if (!outfile.is_open())
+         error = "unable to open " + filename;
+      else
+      {
+         writeIndex(outfile, pageSet, numReadPairs, numMatches, groupManager != NULL);
+	 outfile.close();
+
+	 if (outfile.fail())
+            error = "unable to write " + filename;
+      }
+   }
+
+   for (int i = 0; i < numPages; i++)
+      delete pageSet.page[i].summary;
+
+   if (error != "")
+      throw std::runtime_error(error);
+
+   std::cerr << pageSet.numWritten << " of " << numPages << " pages written to "
+             << pageDir << std::endl;
 }
 
 //------------------------------------------------------------------------------------
@@ -678,18 +1078,28 @@ int main(int argc, char *argv[])
    {
       std::string  fuzzion2Version;
       StringVector annotationHeading;
+      HitPool      hitPool;
       HitVector    hitVector;
 
       uint64_t numReadPairs =
-         readHits(std::cin, fuzzion2Version, annotationHeading, hitVector);
+         readHits(std::cin, fuzzion2Version, annotationHeading, hitPool, hitVector);
 
       if (groupColList == "")
-         writeAllPatterns(fuzzion2Version, annotationHeading, hitVector,
-                          numReadPairs);
+         if (pageDir != "")
+            writeAllPages(fuzzion2Version, annotationHeading, hitVector,
+	                  numReadPairs, NULL);
+	 else
+            writeAllPatterns(std::cout, fuzzion2Version, annotationHeading,
+	                     hitVector, numReadPairs);
       else
       {
          GroupManager groupManager(groupColList, annotationHeading, hitVector);
-	 writeAllGroups(fuzzion2Version, numReadPairs, groupManager);
+
+	 if (pageDir != "")
+            writeAllPages(fuzzion2Version, annotationHeading, hitVector,
+	                  numReadPairs, &groupManager);
+	 else
+	    writeAllGroups(std::cout, fuzzion2Version, numReadPairs, groupManager);
       }
    }
    catch (const std::runtime_error& error)
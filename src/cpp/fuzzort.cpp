@@ -1,7 +1,7 @@
 //------------------------------------------------------------------------------------
 //
-// fuzzort.cpp - this program reads fuzzion2 hits from stdin, sorts them, and writes
-//               them to stdout
+// fuzzort.cpp - this program reads fuzzion2 hits from stdin or the named files, sorts
+//               them, and writes them to stdout
 //
 // Author: Stephen V. Rice, Ph.D.
 //
@@ -11,11 +11,31 @@
 
 #include "hit.h"
 #include "version.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <queue>
 #include <stdexcept>
+#include <unistd.h>
 
 const std::string VERSION_NAME = "fuzzort " + CURRENT_VERSION;
 
+const int DEFAULT_MEMORY = 512; // default megabytes of hits held in memory
+
+const int MAX_MERGE_RUNS = 64;  // maximum number of runs merged at one time
+
+const int OUTPUT_BUFFER_SIZE = 1 << 20; // bytes of hits written at a time
+
+const uint64_t MEGABYTE = 1 << 20;
+
+int memoryLimit = DEFAULT_MEMORY; // megabytes of hits held in memory
+std::string tempDir = "";         // directory of temporary files
+StringVector inputFilename;       // files of hits to be merged, or empty for stdin
+
+StringVector tempFilename;        // temporary files that have been created
+
 //------------------------------------------------------------------------------------
 // showUsage() writes the program's usage to stderr
 
@@ -23,43 +43,452 @@ void showUsage(const char *progname)
 {
    std::cerr
       << VERSION_NAME << ", " << COPYRIGHT << NEWLINE << NEWLINE
-      << "Usage: " << progname << " < fuzzion2_hits > sorted_hits"
-      << NEWLINE;
+      << "Usage: " << progname << " OPTION ... < fuzzion2_hits > sorted_hits"
+      << NEWLINE
+      << "   or: " << progname << " OPTION ... hit_file ... > sorted_hits"
+      << NEWLINE << NEWLINE
+      << "The hits of several files, such as the outputs of the shards of a run, are"
+      << NEWLINE
+      << "merged and their read-pair counts are summed" << NEWLINE;
+
+   std::cerr
+      << NEWLINE
+      << "The following are optional:" << NEWLINE
+      << "  -mem=N          "
+             << "megabytes of hits to sort in memory, default is "
+	     << DEFAULT_MEMORY << NEWLINE
+      << "  -tmpdir=string  "
+             << "directory of temporary files, default is $TMPDIR or /tmp"
+	     << NEWLINE;
 }
 
 //------------------------------------------------------------------------------------
+// parseArgs() parses the command-line arguments and returns true if all are valid
 
-int main(int argc, char *argv[])
+bool parseArgs(int argc, char *argv[])
 {
-   if (argc > 1)
+   for (int i = 1; i < argc; i++)
    {
-      showUsage(argv[0]);
-      return 1;
+      std::string arg = argv[i];
+      if (arg.length() == 0)
+         continue;
+
+      if (arg[0] != '-')
+      {
+         inputFilename.push_back(arg);
+	 continue;
+      }
+
+      StringVector opt;
+
+      if (splitString(arg, opt, '=') != 2)
+         return false; // incorrect option format
+
+      if (intOpt   (opt, "mem",    memoryLimit) ||
+          stringOpt(opt, "tmpdir", tempDir))
+         continue;  // this option has been recognized
+
+      return false; // unrecognized option
+   }
+
+   if (tempDir == "")
+   {
+      const char *env = std::getenv("TMPDIR");
+      tempDir = (env && *env ? env : "/tmp");
+   }
+
+   return (memoryLimit > 0 && tempDir != "");
+}
+
+//------------------------------------------------------------------------------------
+// hitBytes() returns the approximate number of bytes of memory occupied by a hit,
+// excluding its interned pattern name and annotations
+
+static uint64_t hitBytes(const Hit& hit)
+{
+   return sizeof(Hit *) + sizeof(Hit) + hit.pattern.displaySequence.capacity() +
+          hit.read1.name.capacity() + hit.read1.sequence.capacity() +
+	  hit.read2.name.capacity() + hit.read2.sequence.capacity();
+}
+
+//------------------------------------------------------------------------------------
+// createTempFile() creates an empty temporary file and returns its name
+
+static std::string createTempFile()
+{
+   std::string pattern = tempDir + "/fuzzort.XXXXXX";
+
+   std::vector<char> name(pattern.begin(), pattern.end());
+   name.push_back('\0');
+
+   int fd = mkstemp(&name[0]);
+   if (fd == -1)
+      throw std::runtime_error("unable to create a temporary file in " + tempDir);
+
+   ::close(fd);
+
+   tempFilename.push_back(&name[0]);
+   return tempFilename.back();
+}
+
+//------------------------------------------------------------------------------------
+// removeTempFiles() removes the temporary files that remain
+
+static void removeTempFiles()
+{
+   int numFiles = tempFilename.size();
+
+   for (int i = 0; i < numFiles; i++)
+      std::remove(tempFilename[i].c_str());
+
+   tempFilename.clear();
+}
+
+//------------------------------------------------------------------------------------
+
+class HitWriter // writes hits in text format to an output stream, a buffer at a time
+{
+public:
+   HitWriter(std::ostream& inStream) : ostream(inStream), buffer()
+   { buffer.reserve(OUTPUT_BUFFER_SIZE); }
+
+   virtual ~HitWriter() { }
+
+   void writeHeading(const std::string& version, const StringVector& heading)
+   { appendHitHeadingLine(buffer, version, heading); }
+
+   void writeHit(const Hit& hit)
+   {
+      hit.append(buffer);
+
+      if (buffer.length() >= OUTPUT_BUFFER_SIZE)
+         flush();
+   }
+
+   void flush()
+   {
+      if (!ostream.write(buffer.data(), buffer.length()))
+         throw std::runtime_error("unable to write hits");
+
+      buffer.clear();
+   }
+
+   std::ostream& ostream;
+   std::string   buffer;
+};
+
+//------------------------------------------------------------------------------------
+// writeRun() sorts the hits in the given vector and writes them to a new temporary
+// file as a run; the name of the file is returned
+
+static std::string writeRun(HitVector& hitVector, const std::string& version,
+                            const StringVector& annotationHeading)
+{
+   std::sort(hitVector.begin(), hitVector.end(), HitCompare());
+
+   std::string filename = createTempFile();
+
+   std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary);
+   if (!outfile.is_open())
+      throw std::runtime_error("unable to open " + filename);
+
+   HitWriter writer(outfile);
+   writer.writeHeading(version, annotationHeading);
+
+   int numHits = hitVector.size();
+
+   for (int i = 0; i < numHits; i++)
+      writer.writeHit(*hitVector[i]);
+
+   writer.flush();
+   outfile.close();
+
+   if (outfile.fail())
+      throw std::runtime_error("unable to write " + filename);
+
+   return filename;
+}
+
+//------------------------------------------------------------------------------------
+
+struct RunHit // the next hit of a run being merged
+{
+   RunHit(Hit *inHit, int inRun) : hit(inHit), run(inRun) { }
+
+   Hit *hit;
+   int  run;
+};
+
+struct RunHitCompare // orders the heap of a merge so that the first hit is on top;
+                     // equal hits are taken in run order
+{
+   bool operator()(const RunHit& a, const RunHit& b) const
+   {
+      if (compare(b.hit, a.hit))
+         return true;
+
+      if (compare(a.hit, b.hit))
+         return false;
+
+      return (a.run > b.run);
+   }
+
+   HitCompare compare;
+};
+
+typedef std::priority_queue<RunHit, std::vector<RunHit>, RunHitCompare> RunHeap;
+
+//------------------------------------------------------------------------------------
+// deleteReaders() de-allocates the readers of the runs being merged and closes their
+// files
+
+static void deleteReaders(std::vector<HitReader *>& reader,
+                          std::vector<std::ifstream *>& infile)
+{
+   int numRuns = reader.size();
+
+   for (int i = 0; i < numRuns; i++)
+   {
+      delete reader[i];
+      delete infile[i];
    }
+}
+
+//------------------------------------------------------------------------------------
+// mergeRuns() merges the runs in the named temporary files, which are removed, and
+// writes the hits to writer in sorted order; duplicate hits are marked as they are
+// merged
+
+static void mergeRuns(const StringVector& runFilename, HitWriter& writer)
+{
+   int numRuns = runFilename.size();
+
+   std::vector<std::ifstream *> infile(numRuns, NULL);
+   std::vector<HitReader *>     reader(numRuns, NULL);
+
+   // each run alternates between two hits so that the hit most recently written
+   // remains intact for the comparison of duplicates
+   std::vector<Hit> runHit(2 * numRuns);
+   IntVector        nextSlot(numRuns, 0);
+
+   PatternTable patternTable;
+   RunHeap heap;
+   Hit *previous = NULL;
 
    try
    {
-      std::string fuzzion2Version;
-      StringVector annotationHeading;
-      HitVector hitVector;
+      for (int i = 0; i < numRuns; i++)
+      {
+         infile[i] = new std::ifstream(runFilename[i].c_str(),
+	                               std::ios::in | std::ios::binary);
+	 if (!infile[i]->is_open())
+            throw std::runtime_error("unable to open " + runFilename[i]);
+
+	 std::remove(runFilename[i].c_str()); // the open file remains readable
+
+	 reader[i] = new HitReader(*infile[i], patternTable);
+
+	 Hit *hit = &runHit[2 * i];
+	 if (reader[i]->next(*hit))
+            heap.push(RunHit(hit, i));
+      }
+
+      while (!heap.empty())
+      {
+         RunHit next = heap.top();
+	 heap.pop();
 
-      uint64_t numReadPairs = readHits(std::cin, fuzzion2Version, annotationHeading,
-                                       hitVector);
+	 if (previous && next.hit->sameAs(*previous))
+            next.hit->duplicate = true;
 
-      writeHitHeadingLine(fuzzion2Version, annotationHeading);
+	 previous = next.hit;
+	 writer.writeHit(*previous);
+
+	 int run = next.run;
+	 nextSlot[run] = 1 - nextSlot[run];
+
+	 Hit *hit = &runHit[2 * run + nextSlot[run]];
+	 hit->duplicate = false;
+
+	 if (reader[run]->next(*hit))
+            heap.push(RunHit(hit, run));
+      }
+   }
+   catch (const std::runtime_error& error)
+   {
+      deleteReaders(reader, infile);
+      throw;
+   }
+
+   deleteReaders(reader, infile);
+}
+
+//------------------------------------------------------------------------------------
+// reduceRuns() merges groups of runs into longer runs until no more than
+// MAX_MERGE_RUNS remain
+
+static void reduceRuns(StringVector& runFilename, const std::string& version,
+                       const StringVector& annotationHeading)
+{
+   while (runFilename.size() > MAX_MERGE_RUNS)
+   {
+      StringVector mergedFilename;
+
+      for (size_t i = 0; i < runFilename.size(); i += MAX_MERGE_RUNS)
+      {
+         size_t end = std::min(runFilename.size(), i + MAX_MERGE_RUNS);
+
+	 StringVector group(runFilename.begin() + i, runFilename.begin() + end);
+
+	 std::string filename = createTempFile();
+
+	 std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary);
+	 if (!outfile.is_open())
+            throw std::runtime_error("unable to open " + filename);
+
+	 HitWriter writer(outfile);
+	 writer.writeHeading(version, annotationHeading);
+
+	 mergeRuns(group, writer);
+
+	 writer.flush();
+	 outfile.close();
+
+	 if (outfile.fail())
+            throw std::runtime_error("unable to write " + filename);
+
+	 mergedFilename.push_back(filename);
+      }
+
+      runFilename = mergedFilename;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// sortHits() reads hits from stdin, or from each of the named input files in turn,
+// and writes them in sorted order to stdout; the hits are sorted in memory unless
+// they exceed the memory limit, in which case runs of sorted hits are written to
+// temporary files and merged
+
+static void sortHits()
+{
+   HitPool hitPool; // hits of the current run
+
+   const uint64_t maxBytes = memoryLimit * MEGABYTE;
+
+   HitVector    hitVector;
+   uint64_t     numBytes = 0;
+   StringVector runFilename;
+
+   std::string  version;
+   StringVector annotationHeading;
+   uint64_t     numReadPairs = 0;
+
+   int numInputs = std::max(1, static_cast<int>(inputFilename.size()));
+
+   for (int i = 0; i < numInputs; i++)
+   {
+      std::ifstream infile;
+
+      if (!inputFilename.empty())
+      {
+         infile.open(inputFilename[i].c_str(), std::ios::in | std::ios::binary);
+	 if (!infile.is_open())
+            throw std::runtime_error("unable to open " + inputFilename[i]);
+      }
+
+      HitReader reader(inputFilename.empty() ? std::cin : infile,
+                       hitPool.patternTable);
+
+      if (i == 0)
+      {
+         version           = reader.version;
+	 annotationHeading = reader.annotationHeading;
+      }
+      else if (reader.version != version ||
+               reader.annotationHeading != annotationHeading)
+         throw std::runtime_error("inconsistent heading in " + inputFilename[i]);
+
+      while (true)
+      {
+         if (numBytes >= maxBytes || hitVector.size() == MAX_HITS)
+         {
+            runFilename.push_back(writeRun(hitVector, version, annotationHeading));
+	    hitVector.clear();
+	    hitPool.clear();
+	    numBytes = 0;
+         }
+
+         Hit *hit = hitPool.add();
+
+         if (!reader.next(*hit))
+         {
+            hitPool.removeLast();
+	    break;
+         }
+
+         hitVector.push_back(hit);
+         numBytes += hitBytes(*hit);
+      }
+
+      numReadPairs += reader.numReadPairs;
+   }
+
+   HitWriter writer(std::cout);
+   writer.writeHeading(version, annotationHeading);
+
+   if (runFilename.empty()) // all of the hits fit in memory
+   {
+      std::sort(hitVector.begin(), hitVector.end(), HitCompare());
 
       int numHits = hitVector.size();
 
       for (int i = 0; i < numHits; i++)
-         hitVector[i]->write();
+      {
+         if (i > 0 && hitVector[i]->sameAs(*hitVector[i - 1]))
+            hitVector[i]->duplicate = true;
+
+         writer.writeHit(*hitVector[i]);
+      }
+   }
+   else
+   {
+      if (!hitVector.empty())
+         runFilename.push_back(writeRun(hitVector, version, annotationHeading));
+
+      hitVector.clear();
+      hitPool.clear();
 
-      writeReadPairLine(numReadPairs);
+      reduceRuns(runFilename, version, annotationHeading);
+      mergeRuns(runFilename, writer);
+   }
+
+   writer.flush();
+
+   writeReadPairLine(numReadPairs);
+}
+
+//------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+   if (!parseArgs(argc, argv))
+   {
+      showUsage(argv[0]);
+      return 1;
+   }
+
+   try
+   {
+      sortHits();
    }
    catch (const std::runtime_error& error)
    {
+      removeTempFiles();
       std::cerr << argv[0] << ": " << error.what() << std::endl;
       return 1;
    }
 
+   removeTempFiles();
    return 0;
 }
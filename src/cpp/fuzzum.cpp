@@ -12,11 +12,15 @@
 #include "group.h"
 #include "version.h"
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
 const std::string VERSION_NAME = FUZZUM + CURRENT_VERSION;
 
+const int DEFAULT_SORTED = 0;
+
 int minStrong  = DEFAULT_MIN_STRONG; // minimum overlap for a strong match
+int sorted     = DEFAULT_SORTED;     // 1 if the hits are read in sorted order
 
 std::string id = "";                 // identifies the sample
 std::string groupColList = "";       // comma-separated list of group column headings
@@ -43,6 +47,9 @@ void showUsage(const char *progname)
       << "  -group=string   "
              << "comma-separated list of column headings, default is no grouping"
 	     << NEWLINE
+      << "  -sorted=N       "
+             << "1 to summarize sorted hits as they are read, default is "
+	     << DEFAULT_SORTED << NEWLINE
       << "  -strong=N       "
              << "minimum overlap of a strong match in #bases, default is "
 	     << DEFAULT_MIN_STRONG << NEWLINE;
@@ -69,13 +76,14 @@ bool parseArgs(int argc, char *argv[])
 
       if (stringOpt(opt, "id",     id)           ||
           stringOpt(opt, "group",  groupColList) ||
+          intOpt   (opt, "sorted", sorted)       ||
           intOpt   (opt, "strong", minStrong))
          continue;  // this option has been recognized
 
       return false; // unrecognized option
    }
 
-   return (id != "" && minStrong > 0);
+   return (id != "" && minStrong > 0 && sorted >= 0 && sorted <= 1);
 }
 
 //------------------------------------------------------------------------------------
@@ -109,11 +117,11 @@ void writeGroupSummaries(GroupManager& groupManager)
 {
    writeSummaryHeadingLine(CURRENT_VERSION, true, groupManager.annotationHeading);
 
-   GroupMap& gmap = groupManager.gmap;
+   int numGroups = groupManager.group.size();
 
-   for (GroupMap::iterator gpos = gmap.begin(); gpos != gmap.end(); ++gpos)
+   for (int i = 0; i < numGroups; i++)
    {
-      Group& group = gpos->second;
+      Group& group = groupManager.group[i];
 
       Summary *summary = group.summarize(minStrong, id);
       summary->write();
@@ -121,6 +129,107 @@ void writeGroupSummaries(GroupManager& groupManager)
    }
 }
 
+//------------------------------------------------------------------------------------
+// summarizePattern() writes a summary of the given hits of one pattern to stdout, or
+// tallies them in their group if groupManager is not NULL
+
+void summarizePattern(const HitVector& hitVector, GroupManager *groupManager)
+{
+   if (!groupManager)
+   {
+      Summary *summary = summarizeHits(hitVector, 0, hitVector.size(), minStrong, id);
+      summary->write();
+      delete summary;
+      return;
+   }
+
+   int numHits = hitVector.size();
+
+   for (int i = 0; i < numHits; i++)
+   {
+      int index = groupManager->groupOf(*hitVector[i]);
+
+      if (index >= 0)
+         groupManager->group[index].tallyHit(*hitVector[i], minStrong);
+   }
+}
+
+//------------------------------------------------------------------------------------
+// streamSummaries() reads sorted hits from stdin one pattern at a time, and
+// summarizes and discards the hits of each pattern before reading the next; memory
+// is thus proportional to the hits of the largest pattern, plus the tallies of the
+// groups when grouping; the summary lines are held until all of the hits have been
+// read, so nothing is written if the hits turn out not to be sorted
+
+void streamSummaries()
+{
+   HitPool   hitPool; // hits of the current pattern
+   HitReader reader(std::cin, hitPool.patternTable);
+
+   GroupManager *groupManager = NULL;
+
+   std::ostringstream summaries;
+   std::streambuf *stdoutBuffer = std::cout.rdbuf(summaries.rdbuf());
+
+   try
+   {
+      if (groupColList == "")
+         writeSummaryHeadingLine(CURRENT_VERSION, false, reader.annotationHeading);
+      else
+         groupManager = new GroupManager(groupColList, reader.annotationHeading);
+
+      HitVector hitVector;
+      Hit next;
+
+      while (reader.next(next))
+      {
+         if (!hitVector.empty())
+	 {
+            Hit *previous = hitVector.back();
+
+            if (HitCompare()(&next, previous))
+               throw std::runtime_error("hits are not sorted, use fuzzort");
+
+	    if (next.pattern.interned != previous->pattern.interned &&
+	        next.pattern.name() != previous->pattern.name())
+	    {
+               summarizePattern(hitVector, groupManager);
+	       hitVector.clear();
+	       hitPool.clear();
+	    }
+	    else if (next.sameAs(*previous))
+               next.duplicate = true;
+	 }
+
+	 Hit *hit = hitPool.add();
+	 *hit = next;
+	 hitVector.push_back(hit);
+
+	 next.duplicate = false;
+      }
+
+      if (!hitVector.empty())
+         summarizePattern(hitVector, groupManager);
+
+      if (groupManager)
+      {
+         groupManager->finish();
+	 writeGroupSummaries(*groupManager);
+      }
+   }
+   catch (const std::runtime_error& error)
+   {
+      std::cout.rdbuf(stdoutBuffer);
+      delete groupManager;
+      throw;
+   }
+
+   std::cout.rdbuf(stdoutBuffer);
+   delete groupManager;
+
+   std::cout << summaries.str();
+}
+
 //------------------------------------------------------------------------------------
 
 int main(int argc, char *argv[])
@@ -133,11 +242,18 @@ int main(int argc, char *argv[])
 
    try
    {
+      if (sorted)
+      {
+         streamSummaries();
+	 return 0;
+      }
+
       std::string  fuzzion2Version;
       StringVector annotationHeading;
+      HitPool      hitPool;
       HitVector    hitVector;
 
-      readHits(std::cin, fuzzion2Version, annotationHeading, hitVector);
+      readHits(std::cin, fuzzion2Version, annotationHeading, hitPool, hitVector);
 
       if (groupColList == "")
          writePatternSummaries(annotationHeading, hitVector);
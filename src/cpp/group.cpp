@@ -9,68 +9,110 @@
 //------------------------------------------------------------------------------------
 
 #include "group.h"
+#include <algorithm>
 #include <stdexcept>
 
 //------------------------------------------------------------------------------------
-// Group::addHit() saves the given hit
+// Read1Compare orders hits by the name of the first read
 
-void Group::addHit(Hit *hit)
+struct Read1Compare
 {
-   const std::string& read1Name = hit->read1->name;
+   bool operator()(Hit* const& a, Hit* const& b) const
+   {
+      return (a->read1.name < b->read1.name);
+   }
+};
+
+//------------------------------------------------------------------------------------
+// GroupCompare orders groups by name
 
-   ReadMap::iterator rpos = rmap.find(read1Name);
-   if (rpos == rmap.end())
+struct GroupCompare
+{
+   bool operator()(const Group& a, const Group& b) const
    {
-      rmap.insert(std::make_pair(read1Name, HitVector()));
-      rpos = rmap.find(read1Name);
+      return (a.name < b.name);
    }
+};
 
-   HitVector& hitVector = rpos->second;
-   hitVector.push_back(hit);
+//------------------------------------------------------------------------------------
+// Group::finish() is called after all of the hits have been added; the hits of each
+// read pair are made consecutive, keeping the order in which they were added
+
+void Group::finish()
+{
+   std::stable_sort(hitVector.begin(), hitVector.end(), Read1Compare());
+
+   readIndex.clear();
+
+   int numHits = hitVector.size();
+
+   for (int i = 0; i < numHits; i++)
+      if (i == 0 || hitVector[i]->read1.name != hitVector[i - 1]->read1.name)
+         readIndex.push_back(i);
 }
 
 //------------------------------------------------------------------------------------
-// Group::summarize() returns a pointer to a newly-allocated Summary of the group
+// hitCategory() returns the category of a hit, ordered so that a "better" hit has a
+// higher category: 0 (duplicate) < weak < strongNospan < strongSpan
 
-Summary *Group::summarize(int minStrong, std::string sampleID)
+static int hitCategory(const Hit& hit, int minStrong)
 {
-   int readPairs = rmap.size();
-   int weak = 0, strongNospan = 0, strongSpan = 0;
+   std::string label = hit.label(minStrong);
 
-   for (ReadMap::iterator rpos = rmap.begin(); rpos != rmap.end(); ++rpos)
-   {
-      const HitVector& hitVector = rpos->second;
-      int numHits = hitVector.size();
+   if (label == HIT_STRONG_SPAN)
+      return 3;
+
+   if (label == HIT_STRONG_NOSPAN)
+      return 2;
 
-      // find the "best" hit, assuming weak < strongNospan < strongSpan
+   if (label == HIT_WEAK)
+      return 1;
 
-      bool isWeak = false, isStrongNospan = false, isStrongSpan = false;
+   return 0;
+}
+
+//------------------------------------------------------------------------------------
+// Group::tallyHit() counts a hit toward the summary of the group without keeping the
+// hit; only the category of the best hit of its read pair is retained
+
+void Group::tallyHit(const Hit& hit, int minStrong)
+{
+   int category = hitCategory(hit, minStrong);
 
-      for (int i = 0; i < numHits; i++)
+   std::pair<std::unordered_map<std::string, int>::iterator, bool> result =
+      readBest.insert(std::make_pair(hit.read1.name, category));
+
+   if (!result.second && category > result.first->second)
+      result.first->second = category;
+}
+
+//------------------------------------------------------------------------------------
+// Group::summarize() returns a pointer to a newly-allocated Summary of the group,
+// whose hits have either been added or tallied
+
+Summary *Group::summarize(int minStrong, std::string sampleID)
+{
+   int readPairs = readPairCount();
+   int count[4] = { 0, 0, 0, 0 }; // number of read pairs in each category
+
+   if (!readBest.empty())
+      for (std::unordered_map<std::string, int>::const_iterator pos =
+              readBest.begin(); pos != readBest.end(); ++pos)
+         count[pos->second]++;
+   else
+      for (int pair = 0; pair < readPairs; pair++)
       {
-         std::string label = hitVector[i]->label(minStrong);
+         // find the "best" hit of the read pair
 
-	 if (label == HIT_STRONG_SPAN)
-	 {
-            isStrongSpan = true;
-	    break;
-	 }
+         int best = 0, end = readEnd(pair);
 
-	 if (label == HIT_STRONG_NOSPAN)
-            isStrongNospan = true;
-	 else if (label == HIT_WEAK)
-            isWeak = true;
-      }
+         for (int i = readBegin(pair); i < end && best < 3; i++)
+            best = std::max(best, hitCategory(*hitVector[i], minStrong));
 
-      if (isStrongSpan)
-         strongSpan++;
-      else if (isStrongNospan)
-         strongNospan++;
-      else if (isWeak)
-         weak++;
-   }
+         count[best]++;
+      }
 
-   return new Summary(sampleID, readPairs, weak, strongNospan, strongSpan, name,
+   return new Summary(sampleID, readPairs, count[1], count[2], count[3], name,
                       annotation);
 }
 
@@ -80,29 +122,19 @@ Summary *Group::summarize(int minStrong, std::string sampleID)
 
 int Group::maxGroupDisplayLength()
 {
-   int overallMaxLength = 0;
-
-   for (ReadMap::iterator rpos = rmap.begin(); rpos != rmap.end(); ++rpos)
-   {
-      const HitVector& hitVector = rpos->second;
-
-      int maxLength = maxDisplayLength(hitVector, 0, hitVector.size());
-      if (maxLength > overallMaxLength)
-         overallMaxLength = maxLength;
-   }
-
-   return overallMaxLength;
+   return maxDisplayLength(hitVector, 0, hitVector.size());
 }
 
 //------------------------------------------------------------------------------------
 // GroupManager::GroupManager() parses a comma-separated list of column headings
 // identifying the group key column first, followed by zero or more group annotation
-// columns, and initializes the group map to contain the given hits
+// columns; groups are added as groupOf() is called, and finish() is called after all
+// of the hits have been assigned to groups
 
 GroupManager::GroupManager(const std::string& groupColList,
-                           const StringVector& patternAnnotationHeading,
-			   const HitVector& hitVector)
-   : annotationHeading(), gmap()
+                           const StringVector& patternAnnotationHeading)
+   : annotationHeading(), group(), keyIndex(0), annotationIndex(), patternGroup(),
+     groupIndex()
 {
    StringVector groupCol;
    int numGroupCols = splitString(groupColList, groupCol, ',');
@@ -111,10 +143,6 @@ GroupManager::GroupManager(const std::string& groupColList,
       if (groupCol[i].find_first_not_of(' ') == std::string::npos)
          throw std::runtime_error("invalid group column list");
 
-   int keyIndex;
-   IntVector annotationIndex;
-
-   int numGroupAnnotations   = numGroupCols - 1;
    int numPatternAnnotations = patternAnnotationHeading.size();
 
    for (int i = 0; i < numGroupCols; i++)
@@ -134,66 +162,122 @@ GroupManager::GroupManager(const std::string& groupColList,
       else
          throw std::runtime_error("missing group column " + groupCol[i]);
    }
+}
+
+//------------------------------------------------------------------------------------
+// this GroupManager::GroupManager() also assigns the given hits to groups and
+// finishes the groups
 
+GroupManager::GroupManager(const std::string& groupColList,
+                           const StringVector& patternAnnotationHeading,
+			   const HitVector& hitVector)
+   : GroupManager(groupColList, patternAnnotationHeading)
+{
    int numHits = hitVector.size();
 
    for (int i = 0; i < numHits; i++)
    {
-      Hit *hit = hitVector[i];
+      int index = groupOf(*hitVector[i]);
 
-      const StringVector& patternAnnotation = hit->pattern->annotation;
-      numPatternAnnotations = patternAnnotation.size();
+      if (index >= 0)
+         group[index].addHit(hitVector[i]);
+   }
+
+   finish();
+}
 
-      if (keyIndex >= numPatternAnnotations)
-         continue; // no group name
+//------------------------------------------------------------------------------------
+// GroupManager::groupOf() returns the index in group of the group of the hit's
+// pattern, adding the group if it is new, or returns -1 if the pattern has no group
 
-      std::string groupName = patternAnnotation[keyIndex];
+int GroupManager::groupOf(const Hit& hit)
+{
+   int patternIndex = hit.pattern.index();
 
-      int first = groupName.find_first_not_of(' ');
-      if (first == std::string::npos)
-         continue; // no group name
+   if (patternIndex >= patternGroup.size())
+      patternGroup.resize(patternIndex + 1, -2);
 
-      int last  = groupName.find_last_not_of(' ');
-      groupName = groupName.substr(first, last - first + 1); // trim blanks from name
+   if (patternGroup[patternIndex] == -2)
+      patternGroup[patternIndex] = findGroup(hit.pattern.annotation());
 
-      GroupMap::iterator gpos = gmap.find(groupName);
+   return patternGroup[patternIndex];
+}
 
-      if (gpos == gmap.end())
-      {
-         StringVector groupAnnotation;
+//------------------------------------------------------------------------------------
+// GroupManager::finish() orders the groups by name and finishes each of them; group
+// indices previously returned by groupOf() are no longer valid
 
-	 for (int j = 0; j < numGroupAnnotations; j++)
-	 {
-            int k = annotationIndex[j];
+void GroupManager::finish()
+{
+   std::sort(group.begin(), group.end(), GroupCompare());
 
-	    if (k < numPatternAnnotations)
-               groupAnnotation.push_back(patternAnnotation[k]);
-	    else
-               groupAnnotation.push_back(" ");
-	 }
+   int numGroups = group.size();
 
-	 gmap.insert(std::make_pair(groupName, Group(groupName, groupAnnotation)));
+   for (int i = 0; i < numGroups; i++)
+      group[i].finish();
 
-	 gpos = gmap.find(groupName);
-      }
+   patternGroup.clear();
+   groupIndex.clear();
+}
 
-      Group& group = gpos->second;
-      group.addHit(hit);
+//------------------------------------------------------------------------------------
+// GroupManager::findGroup() returns the index of the group of a pattern having the
+// given annotations, adding the group if it is new, or returns -1 if the pattern
+// has no group name
+
+int GroupManager::findGroup(const StringVector& patternAnnotation)
+{
+   int numPatternAnnotations = patternAnnotation.size();
+
+   if (keyIndex >= numPatternAnnotations)
+      return -1; // no group name
+
+   std::string groupName = patternAnnotation[keyIndex];
+
+   int first = groupName.find_first_not_of(' ');
+   if (first == std::string::npos)
+      return -1; // no group name
+
+   int last  = groupName.find_last_not_of(' ');
+   groupName = groupName.substr(first, last - first + 1); // trim blanks from name
+
+   std::unordered_map<std::string, int>::iterator gpos = groupIndex.find(groupName);
+
+   if (gpos != groupIndex.end())
+      return gpos->second;
+
+   StringVector groupAnnotation;
+
+   int numGroupAnnotations = annotationIndex.size();
+
+   for (int j = 0; j < numGroupAnnotations; j++)
+   {
+      int k = annotationIndex[j];
+
+      if (k < numPatternAnnotations)
+         groupAnnotation.push_back(patternAnnotation[k]);
+      else
+         groupAnnotation.push_back(" ");
    }
+
+   int index = group.size();
+
+   group.push_back(Group(groupName, groupAnnotation));
+   groupIndex.insert(std::make_pair(groupName, index));
+
+   return index;
 }
 
 //------------------------------------------------------------------------------------
-// GroupManager::readPairCount() returns the number of read pairs in the group
+// GroupManager::readPairCount() returns the number of read pairs in the groups
 
 int GroupManager::readPairCount()
 {
    int count = 0;
+   int numGroups = group.size();
 
-   for (GroupMap::iterator gpos = gmap.begin(); gpos != gmap.end(); ++gpos)
-   {
-      const Group& group = gpos->second;
-      count += group.rmap.size();
-   }
+   for (int i = 0; i < numGroups; i++)
+      count += group[i].readPairCount();
 
    return count;
 }
@@ -12,9 +12,7 @@
 #define GROUP_H
 
 #include "summary.h"
-#include <map>
-
-typedef std::map<std::string, HitVector> ReadMap; // key is read1 name
+#include <unordered_map>
 
 //------------------------------------------------------------------------------------
 
@@ -22,11 +20,22 @@ class Group // represents a pattern group
 {
 public:
    Group(const std::string& inName, const StringVector& inAnnotation)
-      : name(inName), annotation(inAnnotation), rmap() { }
+      : name(inName), annotation(inAnnotation), hitVector(), readIndex(),
+        readBest() { }
 
    virtual ~Group() { }
 
-   void addHit(Hit *hit);
+   void addHit(Hit *hit) { hitVector.push_back(hit); }
+
+   void tallyHit(const Hit& hit, int minStrong);
+
+   void finish();
+
+   int readPairCount()     const
+   { return (readBest.empty() ? readIndex.size() : readBest.size()); }
+   int readBegin(int pair) const { return readIndex[pair]; }
+   int readEnd  (int pair) const
+   { return (pair + 1 < readIndex.size() ? readIndex[pair + 1] : hitVector.size()); }
 
    Summary *summarize(int minStrong, std::string sampleID="");
 
@@ -34,26 +43,50 @@ public:
 
    std::string name;        // name of the pattern group
    StringVector annotation; // group annotations
-   ReadMap rmap;            // hits of patterns in the group, by read1 name
+   HitVector hitVector;     // hits of patterns in the group, ordered by read1 name
+   IntVector readIndex;     // index in hitVector of the first hit of each read pair
+
+   // when hits are tallied rather than added, this holds the category of the best
+   // hit of each read pair, by read1 name
+   std::unordered_map<std::string, int> readBest;
 };
 
-typedef std::map<std::string, Group> GroupMap; // key is group name
+typedef std::vector<Group> GroupVector; // ordered by group name
 
 //------------------------------------------------------------------------------------
 
 class GroupManager
 {
 public:
+   GroupManager(const std::string& groupColList,
+                const StringVector& patternAnnotationHeading);
+
    GroupManager(const std::string& groupColList,
                 const StringVector& patternAnnotationHeading,
 		const HitVector& hitVector);
 
    virtual ~GroupManager() { }
 
+   int groupOf(const Hit& hit);
+
+   void finish();
+
    int readPairCount();
 
    StringVector annotationHeading; // group annotation headings
-   GroupMap gmap;                  // groups with hits, by group name
+   GroupVector  group;             // groups with hits, by group name once finished
+
+private:
+   int findGroup(const StringVector& patternAnnotation);
+
+   int keyIndex;                // pattern annotation holding the group name
+   IntVector annotationIndex;   // pattern annotations holding the group annotations
+
+   // the group of each pattern, indexed by pattern; -1 means no group and -2 means
+   // not yet determined
+   IntVector patternGroup;
+
+   std::unordered_map<std::string, int> groupIndex; // by group name
 };
 
 #endif
@@ -10,7 +10,9 @@
 
 #include "hit.h"
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <deque>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -39,28 +41,208 @@ const int OVRIGHT_COL        = 7;
 const int ISIZE_COL          = 8;
 const int FIRST_ANNOT_COL    = 9; // first annotation column, if any
 
+//------------------------------------------------------------------------------------
+// appendInt() appends the decimal representation of an integer to a buffer
+
+static void appendInt(std::string& buffer, int i)
+{
+   char digits[16];
+   int  n = 0;
+
+   unsigned int u = (i < 0 ? 0u - static_cast<unsigned int>(i) :
+                             static_cast<unsigned int>(i));
+   do
+   {
+      digits[n++] = '0' + u % 10;
+      u /= 10;
+   }
+   while (u > 0);
+
+   if (i < 0)
+      buffer += '-';
+
+   while (n > 0)
+      buffer += digits[--n];
+}
+
+//------------------------------------------------------------------------------------
+// appendPercent() appends a percentage of matching bases to a buffer, formatted like
+// doubleToString()
+
+static void appendPercent(std::string& buffer, int matchingBases, int possible)
+{
+   char digits[100];
+
+   int len = std::snprintf(digits, sizeof(digits), "%.1f",
+                           100.0 * matchingBases / possible);
+
+   buffer.append(digits, len);
+}
+
+//------------------------------------------------------------------------------------
+// appendHitPattern() appends one line to a buffer describing the pattern matched by a
+// read pair; the display sequence is given by its first character and length so that
+// a portion of a longer sequence can be written without copying it
+
+void appendHitPattern(std::string& buffer, const std::string& name,
+                      const char *displaySequence, int displayLength,
+		      const StringVector& annotation, int matchingBases,
+		      int possible, int spanningCount, int insertSize)
+{
+   buffer += PATTERN;
+   buffer += name;
+   buffer += TAB;
+   buffer.append(displaySequence, displayLength);
+   buffer += TAB;
+   appendInt(buffer, matchingBases);
+   buffer += TAB;
+   appendInt(buffer, possible);
+   buffer += TAB;
+   appendPercent(buffer, matchingBases, possible);
+   buffer += TAB;
+   appendInt(buffer, spanningCount);
+   buffer += TAB; // no entry in this column
+   buffer += TAB; // no entry in this column
+   buffer += TAB;
+   appendInt(buffer, insertSize);
+
+   int numAnnotations = annotation.size();
+
+   for (int i = 0; i < numAnnotations; i++)
+   {
+      buffer += TAB;
+      buffer += annotation[i];
+   }
+
+   buffer += NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// appendHitRead() appends one line to a buffer describing one read of a read pair
+// that matches a pattern
+
+void appendHitRead(std::string& buffer, const std::string& name, int leadingBlanks,
+                   const std::string& sequence, int matchingBases, bool isSpanning,
+		   int leftOverlap, int rightOverlap)
+{
+   int possible = sequence.length();
+
+   buffer += READ;
+   buffer += name;
+   buffer += TAB;
+   buffer.append(leadingBlanks, ' ');
+   buffer += sequence;
+   buffer += TAB;
+   appendInt(buffer, matchingBases);
+   buffer += TAB;
+   appendInt(buffer, possible);
+   buffer += TAB;
+   appendPercent(buffer, matchingBases, possible);
+   buffer += TAB;
+   buffer += (isSpanning ? '1' : '0');
+   buffer += TAB;
+   appendInt(buffer, leftOverlap);
+   buffer += TAB;
+   appendInt(buffer, rightOverlap);
+   buffer += NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// PatternTable::intern() returns the entry having the given name and annotations,
+// which is added to the table if not already present
+
+const InternedPattern *PatternTable::intern(const std::string& name,
+                                            const StringVector& annotation)
+{
+   std::unordered_map<std::string, int>::iterator pos = firstIndex.find(name);
+
+   if (pos != firstIndex.end())
+      for (int i = pos->second; i != -1; i = nextIndex[i])
+         if (entry[i].annotation == annotation)
+            return &entry[i];
+
+   if (name.length() == 0)
+      throw std::runtime_error("zero-length pattern name");
+
+   if (name.find(' ') != std::string::npos)
+      throw std::runtime_error("space not allowed in pattern name \"" + name + "\"");
+
+   int index = entry.size();
+
+   entry.push_back(InternedPattern());
+   entry.back().index      = index;
+   entry.back().name       = name;
+   entry.back().annotation = annotation;
+
+   if (pos == firstIndex.end())
+   {
+      firstIndex.insert(std::make_pair(name, index));
+      nextIndex.push_back(-1);
+   }
+   else // the new entry becomes the first of those having its name
+   {
+      nextIndex.push_back(pos->second);
+      pos->second = index;
+   }
+
+   return &entry.back();
+}
+
+//------------------------------------------------------------------------------------
+// HitPattern::set() sets the pattern of a hit, whose display sequence is given by a
+// pointer and a length; an exception is raised if it lacks valid delimiters
+
+void HitPattern::set(const InternedPattern *inInterned, const char *inDisplaySequence,
+                     int displayLength, int inMatchingBases, int inPossible,
+		     int inSpanningCount, int inInsertSize)
+{
+   interned = inInterned;
+   displaySequence.assign(inDisplaySequence, displayLength);
+
+   bool hasBraces;
+   int  middleBases;
+
+   if (!hasDelimiters(displaySequence, hasBraces, delim2, leftBases, middleBases,
+                      rightBases))
+      throw std::runtime_error("invalid pattern " + displaySequence);
+
+   matchingBases = inMatchingBases;
+   possible      = inPossible;
+   spanningCount = inSpanningCount;
+   insertSize    = inInsertSize;
+}
+
+//------------------------------------------------------------------------------------
+// HitPattern::append() appends one line to a buffer describing the pattern matched
+// by a read pair
+
+void HitPattern::append(std::string& buffer) const
+{
+   appendHitPattern(buffer, name(), displaySequence.c_str(), displaySequence.length(),
+                    annotation(), matchingBases, possible, spanningCount, insertSize);
+}
+
 //------------------------------------------------------------------------------------
 // HitPattern::write() writes one line to stdout describing the pattern matched by a
 // read pair
 
 void HitPattern::write() const
 {
-   std::cout << PATTERN << name
-             << TAB << displaySequence
-	     << TAB << matchingBases
-	     << TAB << possible
-	     << TAB << doubleToString(percentMatch())
-	     << TAB << spanningCount
-	     << TAB // no entry in this column
-	     << TAB // no entry in this column
-	     << TAB << insertSize;
+   std::string line;
 
-   int numAnnotations = annotation.size();
+   append(line);
 
-   for (int i = 0; i < numAnnotations; i++)
-      std::cout << TAB << annotation[i];
+   std::cout << line;
+}
 
-   std::cout << NEWLINE;
+//------------------------------------------------------------------------------------
+// HitRead::append() appends one line to a buffer describing one read of a read pair
+// that matches a pattern
+
+void HitRead::append(std::string& buffer) const
+{
+   appendHitRead(buffer, name, leadingBlanks, sequence, matchingBases, isSpanning,
+                 leftOverlap, rightOverlap);
 }
 
 //------------------------------------------------------------------------------------
@@ -69,15 +251,11 @@ void HitPattern::write() const
 
 void HitRead::write() const
 {
-   std::cout << READ << name
-             << TAB << std::string(leadingBlanks, ' ') << sequence
-	     << TAB << matchingBases
-	     << TAB << possible()
-	     << TAB << doubleToString(percentMatch())
-	     << TAB << (isSpanning ? 1 : 0)
-	     << TAB << leftOverlap
-	     << TAB << rightOverlap
-	     << NEWLINE;
+   std::string line;
+
+   append(line);
+
+   std::cout << line;
 }
 
 //------------------------------------------------------------------------------------
@@ -85,9 +263,10 @@ void HitRead::write() const
 
 bool Hit::sameAs(const Hit& other) const
 {
-   return (pattern->name == other.pattern->name &&
-           pattern->leftBases  == other.pattern->leftBases &&
-	   pattern->rightBases == other.pattern->rightBases);
+   return ((pattern.interned == other.pattern.interned ||
+            pattern.name()   == other.pattern.name()) &&
+           pattern.leftBases  == other.pattern.leftBases &&
+	   pattern.rightBases == other.pattern.rightBases);
 }
 
 //------------------------------------------------------------------------------------
@@ -95,8 +274,40 @@ bool Hit::sameAs(const Hit& other) const
 
 bool Hit::isStrong(int minStrong) const
 {
-   return (std::max(read1->leftOverlap,  read2->leftOverlap)  >= minStrong &&
-           std::max(read1->rightOverlap, read2->rightOverlap) >= minStrong);
+   return (std::max(read1.leftOverlap,  read2.leftOverlap)  >= minStrong &&
+           std::max(read1.rightOverlap, read2.rightOverlap) >= minStrong);
+}
+
+//------------------------------------------------------------------------------------
+// HitPool::~HitPool() de-allocates the chunks of hits
+
+HitPool::~HitPool()
+{
+   int numAllocated = chunk.size();
+
+   for (int i = 0; i < numAllocated; i++)
+      delete[] chunk[i];
+}
+
+//------------------------------------------------------------------------------------
+// HitPool::add() returns a pointer to an unused hit of the pool, which the caller is
+// expected to fill in; the hit remains owned by the pool
+
+Hit *HitPool::add()
+{
+   if (numUsed == HIT_POOL_CHUNK_SIZE) // the last chunk in use is full
+   {
+      if (numChunks == chunk.size())
+         chunk.push_back(new Hit[HIT_POOL_CHUNK_SIZE]);
+
+      numChunks++;
+      numUsed = 0;
+   }
+
+   Hit *hit = &chunk[numChunks - 1][numUsed++];
+   hit->duplicate = false;
+
+   return hit;
 }
 
 //------------------------------------------------------------------------------------
@@ -117,27 +328,41 @@ std::string Hit::label(int minStrong) const
 }
 
 //------------------------------------------------------------------------------------
-// writeHitHeadingLine() writes a heading line to stdout
+// appendHitHeadingLine() appends a heading line to a buffer
 
-void writeHitHeadingLine(const std::string& version,
-                         const StringVector& annotationHeading)
+void appendHitHeadingLine(std::string& buffer, const std::string& version,
+                          const StringVector& annotationHeading)
 {
-   std::cout << FUZZION2 << version
-             << TAB << SEQUENCE
-	     << TAB << MBASES
-	     << TAB << POSSIBLE
-	     << TAB << PERCENT
-	     << TAB << SPANNING
-	     << TAB << OVLEFT
-	     << TAB << OVRIGHT
-	     << TAB << ISIZE;
+   buffer += FUZZION2 + version;
+
+   buffer += TAB + SEQUENCE;
+   buffer += TAB + MBASES;
+   buffer += TAB + POSSIBLE;
+   buffer += TAB + PERCENT;
+   buffer += TAB + SPANNING;
+   buffer += TAB + OVLEFT;
+   buffer += TAB + OVRIGHT;
+   buffer += TAB + ISIZE;
 
    int numAnnotations = annotationHeading.size();
 
    for (int i = 0; i < numAnnotations; i++)
-      std::cout << TAB << annotationHeading[i];
+      buffer += TAB + annotationHeading[i];
+
+   buffer += NEWLINE;
+}
+
+//------------------------------------------------------------------------------------
+// writeHitHeadingLine() writes a heading line to stdout
+
+void writeHitHeadingLine(const std::string& version,
+                         const StringVector& annotationHeading)
+{
+   std::string line;
 
-   std::cout << NEWLINE;
+   appendHitHeadingLine(line, version, annotationHeading);
+
+   std::cout << line;
 }
 
 //------------------------------------------------------------------------------------
@@ -225,10 +450,12 @@ static bool isPatternLine(const std::string& line)
 }
 
 //------------------------------------------------------------------------------------
-// getPattern() returns a pointer to a newly-allocated HitPattern describing the
-// pattern identified by the given line, or returns NULL if the input is invalid
+// getPattern() sets hitPattern to describe the pattern identified by the given line,
+// whose name and annotations are interned in patternTable, or returns false if the
+// input is invalid
 
-static HitPattern *getPattern(const std::string& line)
+static bool getPattern(const std::string& line, PatternTable& patternTable,
+                       HitPattern& hitPattern)
 {
    StringVector col;
    int numCols  = splitString(line, col);
@@ -241,11 +468,11 @@ static HitPattern *getPattern(const std::string& line)
        (spanningCount  = stringToNonnegInt(col[SPANNING_COL])) <  0 ||
        spanningCount > 2 ||
        (insertSize     = stringToNonnegInt(col[ISIZE_COL]))    <= 0)
-      return NULL;
+      return false;
 
    StringVector patternCol;
    if (splitString(col[0], patternCol, ' ') != 2 || patternCol[1] == "")
-      return NULL;
+      return false;
 
    const std::string& name     = patternCol[1];
    const std::string& sequence = col[SEQUENCE_COL];
@@ -255,8 +482,10 @@ static HitPattern *getPattern(const std::string& line)
    for (int i = FIRST_ANNOT_COL; i < numCols; i++)
       annotation.push_back(col[i]);
 
-   return new HitPattern(name, sequence, annotation, matchingBases, possible,
-                         spanningCount, insertSize);
+   hitPattern.set(patternTable.intern(name, annotation), sequence.c_str(),
+                  sequence.length(), matchingBases, possible, spanningCount,
+		  insertSize);
+   return true;
 }
 
 //------------------------------------------------------------------------------------
@@ -269,10 +498,10 @@ static bool isReadLine(const std::string& line)
 }
 
 //------------------------------------------------------------------------------------
-// getRead() returns a pointer to a newly-allocated HitRead describing the read
-// identified by the given line, or returns NULL if the input is invalid
+// getRead() sets hitRead to describe the read identified by the given line, or
+// returns false if the input is invalid
 
-static HitRead *getRead(const std::string& line)
+static bool getRead(const std::string& line, HitRead& hitRead)
 {
    StringVector col;
    int numCols = splitString(line, col);
@@ -286,13 +515,13 @@ static HitRead *getRead(const std::string& line)
        spanningCount > 1 ||
        (leftOverlap    = stringToNonnegInt(col[OVLEFT_COL]))   <  0 ||
        (rightOverlap   = stringToNonnegInt(col[OVRIGHT_COL]))  <  0)
-      return NULL;
+      return false;
 
    bool isSpanning = (spanningCount == 1);
 
    StringVector readCol;
    if (splitString(col[0], readCol, ' ') != 2 || readCol[1] == "")
-      return NULL;
+      return false;
 
    const std::string& name     = readCol[1];
    const std::string& sequence = col[SEQUENCE_COL];
@@ -300,107 +529,378 @@ static HitRead *getRead(const std::string& line)
    int leadingBlanks = sequence.find_first_not_of(' '); // find first non-blank
    if (leadingBlanks == std::string::npos ||
        sequence.length() != leadingBlanks + possible)
-      return NULL;
+      return false;
 
-   std::string trimmedSequence = sequence.substr(leadingBlanks);
+   hitRead.name.assign(name);
+   hitRead.leadingBlanks = leadingBlanks;
+   hitRead.sequence.assign(sequence, leadingBlanks, possible);
+   hitRead.matchingBases = matchingBases;
+   hitRead.isSpanning    = isSpanning;
+   hitRead.leftOverlap   = leftOverlap;
+   hitRead.rightOverlap  = rightOverlap;
 
-   return new HitRead(name, leadingBlanks, trimmedSequence, matchingBases,
-                      isSpanning, leftOverlap, rightOverlap);
+   return true;
 }
 
 //------------------------------------------------------------------------------------
-// getHit() returns a pointer to a newly-allocated Hit describing the hit identified
-// by the given line (the pattern) and the next two lines (the read pair), or returns
-// NULL if the input is invalid
+// getHit() sets hit to describe the hit identified by the given line (the pattern)
+// and the next two lines (the read pair), or returns false if the input is invalid
 
-static Hit *getHit(std::istream& istream, const std::string& patternLine)
+static bool getHit(std::istream& istream, const std::string& patternLine,
+                   PatternTable& patternTable, Hit& hit)
 {
-   HitPattern *hitPattern = NULL;
-   HitRead    *hitRead1   = NULL, *hitRead2;
-
    std::string readLine1, readLine2;
 
-   if ((hitPattern = getPattern(patternLine)) &&
-       getline(istream, readLine1) && (hitRead1 = getRead(readLine1)) &&
-       getline(istream, readLine2) && (hitRead2 = getRead(readLine2)))
-      return new Hit(hitPattern, hitRead1, hitRead2);
+   return (getPattern(patternLine, patternTable, hit.pattern) &&
+           getline(istream, readLine1) && getRead(readLine1, hit.read1) &&
+	   getline(istream, readLine2) && getRead(readLine2, hit.read2));
+}
+
+//------------------------------------------------------------------------------------
+// sortHits() sorts the hits in the given vector
+
+static void sortHits(HitVector& hitVector)
+{
+   std::sort(hitVector.begin(), hitVector.end(), HitCompare());
+}
+
+//------------------------------------------------------------------------------------
+// markDuplicates() marks duplicate hits in the given vector, which is assumed to be
+// sorted
+
+static void markDuplicates(HitVector& hitVector)
+{
+   int numHits = hitVector.size();
+
+   for (int i = 1; i < numHits; i++)
+      if (hitVector[i]->sameAs(*hitVector[i - 1]))
+         hitVector[i]->duplicate = true;
+}
+
+//------------------------------------------------------------------------------------
+// appendUint32() and appendUint64() append an unsigned integer to a buffer in
+// little-endian byte order, and appendBinaryString() appends the length of a string
+// followed by its characters
+
+static void appendUint32(std::string& buffer, uint32_t value)
+{
+   for (int i = 0; i < 4; i++, value >>= 8)
+      buffer += static_cast<char>(value & 0xFF);
+}
+
+static void appendUint64(std::string& buffer, uint64_t value)
+{
+   for (int i = 0; i < 8; i++, value >>= 8)
+      buffer += static_cast<char>(value & 0xFF);
+}
+
+static void appendBinaryString(std::string& buffer, const char *s, int length)
+{
+   appendUint32(buffer, length);
+   buffer.append(s, length);
+}
+
+static void appendBinaryString(std::string& buffer, const std::string& s)
+{
+   appendBinaryString(buffer, s.c_str(), s.length());
+}
+
+//------------------------------------------------------------------------------------
+// writeBinaryHitHeading() writes the start of a binary hit stream to stdout: the
+// signature, the format version, the fuzzion2 version and the annotation headings
+
+void writeBinaryHitHeading(const std::string& version,
+                           const StringVector& annotationHeading)
+{
+   std::string buffer(BINARY_HITS_SIGNATURE, sizeof(BINARY_HITS_SIGNATURE));
+
+   buffer += static_cast<char>(BINARY_HITS_VERSION);
+
+   appendBinaryString(buffer, version);
+
+   int numAnnotations = annotationHeading.size();
+
+   appendUint32(buffer, numAnnotations);
+
+   for (int i = 0; i < numAnnotations; i++)
+      appendBinaryString(buffer, annotationHeading[i]);
+
+   std::cout.write(buffer.data(), buffer.size());
+}
+
+//------------------------------------------------------------------------------------
+// appendBinaryPattern() appends a record to a buffer defining the pattern that hits
+// in the binary stream refer to by the given identifier; a stream has one such record
+// for each pattern that has hits, preceding or following them
+
+void appendBinaryPattern(std::string& buffer, int id, const Pattern& pattern)
+{
+   buffer += BINARY_PATTERN_RECORD;
+
+   appendUint32(buffer, id);
+   appendBinaryString(buffer, pattern.name);
+   appendBinaryString(buffer, pattern.displaySequence);
+
+   int numAnnotations = pattern.annotation.size();
+
+   appendUint32(buffer, numAnnotations);
+
+   for (int i = 0; i < numAnnotations; i++)
+      appendBinaryString(buffer, pattern.annotation[i]);
+}
+
+//------------------------------------------------------------------------------------
+// appendBinaryHitPattern() appends the start of a binary hit record to a buffer; the
+// displayed portion of the pattern is given by its offset and length within the
+// display sequence of the identified pattern; appendBinaryHitRead() must be called
+// for each read of the pair to complete the record
+
+void appendBinaryHitPattern(std::string& buffer, int id, int displayOffset,
+                            int displayLength, int matchingBases, int possible,
+			    int spanningCount, int insertSize)
+{
+   buffer += BINARY_HIT_RECORD;
+
+   appendUint32(buffer, id);
+   appendUint32(buffer, displayOffset);
+   appendUint32(buffer, displayLength);
+   appendUint32(buffer, matchingBases);
+   appendUint32(buffer, possible);
+   appendUint32(buffer, spanningCount);
+   appendUint32(buffer, insertSize);
+}
+
+//------------------------------------------------------------------------------------
+// appendBinaryHitRead() appends one read of a read pair to a binary hit record
+
+void appendBinaryHitRead(std::string& buffer, const std::string& name,
+                         int leadingBlanks, const std::string& sequence,
+			 int matchingBases, bool isSpanning, int leftOverlap,
+			 int rightOverlap)
+{
+   appendBinaryString(buffer, name);
+   appendBinaryString(buffer, sequence);
+   appendUint32(buffer, leadingBlanks);
+   appendUint32(buffer, matchingBases);
+   appendUint32(buffer, isSpanning ? 1 : 0);
+   appendUint32(buffer, leftOverlap);
+   appendUint32(buffer, rightOverlap);
+}
+
+//------------------------------------------------------------------------------------
+// writeBinaryReadPairs() writes a record to stdout giving the total number of read
+// pairs processed
+
+void writeBinaryReadPairs(uint64_t numReadPairs)
+{
+   std::string buffer(1, BINARY_READ_PAIRS_RECORD);
 
-   delete hitPattern;
-   delete hitRead1;
+   appendUint64(buffer, numReadPairs);
 
-   return NULL;
+   std::cout.write(buffer.data(), buffer.size());
 }
 
 //------------------------------------------------------------------------------------
-// HitCompare defines the sort order of hits; duplicate hits are placed consecutively
-// in the ordering
 
-struct HitCompare
+class BinaryHitReader // reads the values of a binary hit stream
 {
-   bool operator()(Hit* const& a, Hit* const& b) const
+public:
+   BinaryHitReader(std::istream& inStream) : istream(inStream) { }
+
+   virtual ~BinaryHitReader() { }
+
+   void getBytes(void *buffer, int numBytes)
+   {
+      if (!istream.read(static_cast<char *>(buffer), numBytes))
+         throw std::runtime_error("truncated binary hits");
+   }
+
+   uint8_t getUint8() { uint8_t value; getBytes(&value, 1); return value; }
+
+   uint32_t getUint32()
+   {
+      uint8_t byte[4];
+      getBytes(byte, 4);
+
+      return byte[0] | (byte[1] << 8) | (byte[2] << 16) |
+             (static_cast<uint32_t>(byte[3]) << 24);
+   }
+
+   uint64_t getUint64()
    {
-      // sort by ascending pattern name,
-      // then by ascending number of left bases,
-      // then by ascending number of right bases,
-      // then by descending number of junction-spanning reads,
-      // then by ascending read1 name
+      uint64_t low = getUint32();
+      return low | (static_cast<uint64_t>(getUint32()) << 32);
+   }
 
-      int key1 = std::strcmp(a->pattern->name.c_str(), b->pattern->name.c_str());
-      if (key1 != 0)
-         return (key1 < 0);
+   // getInt() gets an integer that must not exceed the maximum int
+   int getInt()
+   {
+      uint32_t value = getUint32();
 
-      int key2 = a->pattern->leftBases - b->pattern->leftBases;
-      if (key2 != 0)
-         return (key2 < 0);
+      if (value > static_cast<uint32_t>(std::numeric_limits<int>::max()))
+         throw std::runtime_error("invalid binary hits");
 
-      int key3 = a->pattern->rightBases - b->pattern->rightBases;
-      if (key3 != 0)
-         return (key3 < 0);
+      return value;
+   }
 
-      int key4 = a->pattern->spanningCount - b->pattern->spanningCount;
-      if (key4 != 0)
-         return (key4 > 0);
+   void getString(std::string& s)
+   {
+      s.resize(getInt());
 
-      return (a->read1->name < b->read1->name);
+      if (s.length() > 0)
+         getBytes(&s[0], s.length());
    }
+
+   void getStrings(StringVector& v)
+   {
+      v.resize(getInt());
+
+      for (size_t i = 0; i < v.size(); i++)
+         getString(v[i]);
+   }
+
+   std::istream& istream;
 };
 
 //------------------------------------------------------------------------------------
-// sortHits() sorts the hits in the given vector
 
-static void sortHits(HitVector& hitVector)
+struct BinaryPattern // a pattern defined in a binary hit stream
 {
-   std::sort(hitVector.begin(), hitVector.end(), HitCompare());
+   BinaryPattern() : interned(NULL), displaySequence() { }
+
+   const InternedPattern *interned; // NULL until the pattern is defined
+   std::string displaySequence;
+};
+
+struct BinaryHit // a hit read from a binary hit stream, not yet joined to its pattern
+{
+   size_t  id;
+   int     displayOffset, displayLength;
+   int     matchingBases, possible, spanningCount, insertSize;
+   HitRead read1, read2;
+};
+
+//------------------------------------------------------------------------------------
+// getBinaryHitRead() sets hitRead to the next read of a binary hit record, or throws
+// an exception if it is invalid
+
+static void getBinaryHitRead(BinaryHitReader& reader, HitRead& hitRead)
+{
+   reader.getString(hitRead.name);
+   reader.getString(hitRead.sequence);
+
+   hitRead.leadingBlanks = reader.getInt();
+   hitRead.matchingBases = reader.getInt();
+   int spanning          = reader.getInt();
+   hitRead.leftOverlap   = reader.getInt();
+   hitRead.rightOverlap  = reader.getInt();
+
+   if (hitRead.name == "" || hitRead.sequence == "" || spanning > 1)
+      throw std::runtime_error("invalid binary hit for read " + hitRead.name);
+
+   hitRead.isSpanning = (spanning == 1);
 }
 
 //------------------------------------------------------------------------------------
-// markDuplicates() marks duplicate hits in the given vector, which is assumed to be
-// sorted
+// getBinaryHeading() reads the signature and heading at the start of a binary hit
+// stream, or throws an exception if they are invalid
 
-static void markDuplicates(HitVector& hitVector)
+static void getBinaryHeading(BinaryHitReader& reader, std::string& version,
+                             StringVector& annotationHeading)
 {
-   int numHits = hitVector.size();
+   char signature[sizeof(BINARY_HITS_SIGNATURE)];
 
-   for (int i = 1; i < numHits; i++)
-      if (hitVector[i]->sameAs(*hitVector[i - 1]))
-         hitVector[i]->duplicate = true;
+   reader.getBytes(signature, sizeof(signature));
+
+   if (std::memcmp(signature, BINARY_HITS_SIGNATURE, sizeof(signature)) != 0)
+      throw std::runtime_error("unexpected input in binary hits");
+
+   if (reader.getUint8() != BINARY_HITS_VERSION)
+      throw std::runtime_error("unsupported version of binary hits");
+
+   reader.getString(version);
+   reader.getStrings(annotationHeading);
 }
 
 //------------------------------------------------------------------------------------
-// readHits() reads hits and stores them in sorted order in hitVector; duplicate hits
-// are marked; the return value is the total number of read pairs processed
+// setBinaryPattern() sets the pattern of a hit from the fields of a binary hit and
+// the definition of its pattern, or throws an exception if they are inconsistent
 
-uint64_t readHits(std::istream& istream, std::string& version,
-                  StringVector& annotationHeading, HitVector& hitVector)
+static void setBinaryPattern(const BinaryHit& b, const BinaryPattern& pattern,
+                             Hit& hit)
+{
+   if (b.displayOffset + static_cast<uint64_t>(b.displayLength) >
+       pattern.displaySequence.length())
+      throw std::runtime_error("invalid binary hit");
+
+   hit.pattern.set(pattern.interned, pattern.displaySequence.data() + b.displayOffset,
+                   b.displayLength, b.matchingBases, b.possible, b.spanningCount,
+		   b.insertSize);
+}
+
+//------------------------------------------------------------------------------------
+
+struct BinaryHitState // the state of a HitReader for a binary hit stream
+{
+   BinaryHitState(std::istream& istream)
+      : reader(istream), pattern(), pending(), ready() { }
+
+   virtual ~BinaryHitState() { }
+
+   BinaryHitReader            reader;
+   std::vector<BinaryPattern> pattern; // of the current stream, indexed by id
+   std::vector<BinaryHit>     pending; // hits whose pattern is not yet defined
+   std::deque<BinaryHit>      ready;   // pending hits whose pattern is now defined
+};
+
+//------------------------------------------------------------------------------------
+// HitReader::HitReader() reads the heading of a text or binary hit stream
+
+HitReader::HitReader(std::istream& inStream, PatternTable& inPatternTable)
+   : version(), annotationHeading(), numReadPairs(0), istream(inStream),
+     patternTable(inPatternTable), headingLine(), binary(NULL)
+{
+   if (istream.peek() == static_cast<unsigned char>(BINARY_HITS_SIGNATURE[0]))
+   {
+      BinaryHitReader reader(istream);
+      getBinaryHeading(reader, version, annotationHeading);
+
+      binary = new BinaryHitState(istream);
+   }
+   else
+   {
+      if (!getline(istream, headingLine))
+         throw std::runtime_error("no input");
+
+      if (!isValidHeadingLine(headingLine, version, annotationHeading))
+         throw std::runtime_error("unexpected heading line");
+   }
+}
+
+//------------------------------------------------------------------------------------
+// HitReader::~HitReader() de-allocates the state of a binary stream
+
+HitReader::~HitReader()
+{
+   delete binary;
+}
+
+//------------------------------------------------------------------------------------
+// HitReader::next() sets hit to the next hit of the stream and returns true, or
+// returns false at the end of the stream
+
+bool HitReader::next(Hit& hit)
 {
-   uint64_t totalReadPairs = 0;
-   std::string headingLine, line;
+   return (binary ? nextBinary(hit) : nextText(hit));
+}
 
-   if (!getline(istream, headingLine))
-      throw std::runtime_error("no input");
+//------------------------------------------------------------------------------------
+// HitReader::nextText() gets the next hit of a text stream, which may be the
+// concatenation of the outputs of several runs, whose heading lines must agree
 
-   if (!isValidHeadingLine(headingLine, version, annotationHeading))
-      throw std::runtime_error("unexpected heading line");
+bool HitReader::nextText(Hit& hit)
+{
+   std::string line;
 
    while (getline(istream, line))
       if (isHeadingLine(line)) // found another heading line
@@ -410,33 +910,180 @@ uint64_t readHits(std::istream& istream, std::string& version,
       }
       else if (isReadPairLine(line))
       {
-         uint64_t numReadPairs;
+         uint64_t count;
 
-	 if (isValidReadPairLine(line, numReadPairs))
-            totalReadPairs += numReadPairs;
+	 if (isValidReadPairLine(line, count))
+            numReadPairs += count;
 	 else
             throw std::runtime_error("unexpected input line: " + line);
       }
       else // this must be the first of three lines describing a hit
       {
-         Hit *hit = getHit(istream, line);
+	 if (!getHit(istream, line, patternTable, hit))
+            throw std::runtime_error("unexpected hit format: " + line);
+
+	 return true;
+      }
+
+   return false;
+}
+
+//------------------------------------------------------------------------------------
+// HitReader::nextBinary() gets the next hit of a binary stream, which may be the
+// concatenation of the binary streams of several runs, whose headings must agree; a
+// hit whose pattern is defined later in its stream is held until the definition is
+// read
+
+bool HitReader::nextBinary(Hit& hit)
+{
+   BinaryHitReader& reader = binary->reader;
+
+   std::vector<BinaryPattern>& pattern = binary->pattern;
+   std::vector<BinaryHit>&     pending = binary->pending;
+   std::deque<BinaryHit>&      ready   = binary->ready;
+
+   while (ready.empty())
+   {
+      int next = istream.peek();
+
+      if (next == EOF || next == static_cast<unsigned char>(BINARY_HITS_SIGNATURE[0]))
+      {
+         // the current stream has ended
+	 if (!pending.empty())
+            throw std::runtime_error("binary hit refers to an undefined pattern");
 
-	 if (hit)
-            if (hitVector.size() < MAX_HITS)
-               hitVector.push_back(hit);
+	 if (next == EOF)
+            return false;
+
+         std::string  streamVersion;
+         StringVector streamHeading;
+
+	 getBinaryHeading(reader, streamVersion, streamHeading);
+
+	 if (streamVersion != version || streamHeading != annotationHeading)
+	    throw std::runtime_error("inconsistent heading lines");
+
+	 pattern.clear();
+	 continue;
+      }
+
+      char tag = reader.getUint8();
+
+      if (tag == BINARY_PATTERN_RECORD)
+      {
+         size_t id = reader.getInt();
+
+	 if (id >= pattern.size())
+	    pattern.resize(id + 1);
+
+	 BinaryPattern& p = pattern[id];
+
+         std::string  name;
+         StringVector annotation;
+
+	 reader.getString(name);
+	 reader.getString(p.displaySequence);
+	 reader.getStrings(annotation);
+
+	 p.interned = patternTable.intern(name, annotation);
+
+	 // move the pending hits of this pattern, keeping the others in order
+
+	 size_t numKept = 0;
+
+	 for (size_t i = 0; i < pending.size(); i++)
+            if (pending[i].id == id)
+               ready.push_back(pending[i]);
 	    else
-               throw std::runtime_error("too many hits");
-	 else
-            throw std::runtime_error("unexpected hit format: " + line);
+               pending[numKept++] = pending[i];
+
+	 pending.resize(numKept);
+      }
+      else if (tag == BINARY_HIT_RECORD)
+      {
+         BinaryHit b;
+
+	 b.id            = reader.getInt();
+	 b.displayOffset = reader.getInt();
+	 b.displayLength = reader.getInt();
+	 b.matchingBases = reader.getInt();
+	 b.possible      = reader.getInt();
+	 b.spanningCount = reader.getInt();
+	 b.insertSize    = reader.getInt();
+
+	 if (b.matchingBases == 0 || b.possible == 0 || b.spanningCount > 2 ||
+	     b.insertSize == 0)
+	    throw std::runtime_error("invalid binary hit");
+
+	 getBinaryHitRead(reader, hit.read1);
+	 getBinaryHitRead(reader, hit.read2);
+
+	 if (b.id < pattern.size() && pattern[b.id].interned)
+	 {
+            setBinaryPattern(b, pattern[b.id], hit);
+	    return true;
+	 }
+
+	 b.read1 = hit.read1;
+	 b.read2 = hit.read2;
+	 pending.push_back(b);
       }
+      else if (tag == BINARY_READ_PAIRS_RECORD)
+         numReadPairs += reader.getUint64();
+      else
+         throw std::runtime_error("unexpected input in binary hits");
+   }
+
+   const BinaryHit& b = ready.front();
+
+   setBinaryPattern(b, pattern[b.id], hit);
+   hit.read1 = b.read1;
+   hit.read2 = b.read2;
+
+   ready.pop_front();
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// readHits() reads hits in text or binary format into hitPool and stores pointers to
+// them in sorted order in hitVector, sorting them unless the input is already in
+// order; duplicate hits are marked; the return value is the total number of read
+// pairs processed
+
+uint64_t readHits(std::istream& istream, std::string& version,
+                  StringVector& annotationHeading, HitPool& hitPool,
+		  HitVector& hitVector)
+{
+   HitReader reader(istream, hitPool.patternTable);
+
+   version           = reader.version;
+   annotationHeading = reader.annotationHeading;
+
+   while (true)
+   {
+      Hit *hit = hitPool.add();
+
+      if (!reader.next(*hit))
+      {
+         hitPool.removeLast();
+	 break;
+      }
+
+      if (hitVector.size() == MAX_HITS)
+         throw std::runtime_error("too many hits");
+
+      hitVector.push_back(hit);
+   }
 
    if (hitVector.size() > 1)
    {
-      sortHits(hitVector);
+      if (!std::is_sorted(hitVector.begin(), hitVector.end(), HitCompare()))
+         sortHits(hitVector); // not already sorted, e.g., by fuzzion2 -sorted=1
+
       markDuplicates(hitVector);
    }
 
-   return totalReadPairs;
+   return reader.numReadPairs;
 }
 
 //------------------------------------------------------------------------------------
@@ -454,7 +1101,8 @@ void getPatternIndices(const HitVector& hitVector, IntVector& index)
    index.push_back(0);
 
    for (int i = 1; i < numHits; i++)
-      if (hitVector[i]->pattern->name != hitVector[i - 1]->pattern->name)
+      if (hitVector[i]->pattern.interned != hitVector[i - 1]->pattern.interned &&
+          hitVector[i]->pattern.name()   != hitVector[i - 1]->pattern.name())
          index.push_back(i);
 }
 
@@ -468,7 +1116,7 @@ int maxDisplayLength(const HitVector& hitVector, int begin, int end)
 
    for (int i = begin; i < end; i++)
    {
-      int length = hitVector[i]->pattern->displaySequence.length();
+      int length = hitVector[i]->pattern.displaySequence.length();
       if (length > maxLength)
          maxLength = length;
    }
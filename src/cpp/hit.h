@@ -12,11 +12,23 @@
 #define HIT_H
 
 #include "pattern.h"
+#include <deque>
 #include <istream>
 #include <limits>
+#include <unordered_map>
 
 const std::string FUZZION2 = "fuzzion2 ";
 
+// a binary hit stream starts with this signature, whose first byte distinguishes it
+// from text, followed by the format version
+const char    BINARY_HITS_SIGNATURE[4] = { '\x89', 'F', 'Z', 'H' };
+const uint8_t BINARY_HITS_VERSION      = 1;
+
+// each record of a binary hit stream starts with one of these tags
+const char BINARY_PATTERN_RECORD    = 'P';
+const char BINARY_HIT_RECORD        = 'H';
+const char BINARY_READ_PAIRS_RECORD = 'R';
+
 const std::string HIT_DUPLICATE     = "dup";
 const std::string HIT_WEAK          = "weak";
 const std::string HIT_STRONG_NOSPAN = "strong-";
@@ -28,23 +40,71 @@ const int DEFAULT_MIN_STRONG = 15; // default minimum overlap for a strong match
 
 //------------------------------------------------------------------------------------
 
-class HitPattern : public Pattern
+struct InternedPattern // the name and annotations shared by the hits of a pattern
+{
+   int          index;      // position in the PatternTable
+   std::string  name;       // pattern name
+   StringVector annotation; // zero or more annotations
+};
+
+// this holds a single copy of the name and annotations of each pattern having hits;
+// the addresses of its entries do not change as entries are added
+
+class PatternTable
+{
+public:
+   PatternTable() : entry(), firstIndex(), nextIndex() { }
+
+   virtual ~PatternTable() { }
+
+   const InternedPattern *intern(const std::string& name,
+                                 const StringVector& annotation);
+
+   int size() const { return entry.size(); }
+
+   const InternedPattern& operator[](int index) const { return entry[index]; }
+
+private:
+   PatternTable(const PatternTable&);            // not copyable
+   PatternTable& operator=(const PatternTable&);
+
+   std::deque<InternedPattern> entry;
+   std::unordered_map<std::string, int> firstIndex; // first entry having each name
+   IntVector nextIndex; // next entry having the same name but other annotations
+};
+
+//------------------------------------------------------------------------------------
+
+class HitPattern // describes the pattern matched by a read pair
 {
 public:
-   HitPattern(const std::string& inName, const std::string& inSequence,
-              const StringVector& inAnnotation, int inMatchingBases, int inPossible,
-	      int inSpanningCount, int inInsertSize)
-      : Pattern(inName, inSequence, inAnnotation), matchingBases(inMatchingBases),
-        possible(inPossible), spanningCount(inSpanningCount),
-	insertSize(inInsertSize) { }
+   HitPattern()
+      : interned(NULL), displaySequence(), delim2(0), leftBases(0), rightBases(0),
+        matchingBases(0), possible(0), spanningCount(0), insertSize(0) { }
 
    virtual ~HitPattern() { }
 
+   void set(const InternedPattern *inInterned, const char *inDisplaySequence,
+            int displayLength, int inMatchingBases, int inPossible,
+	    int inSpanningCount, int inInsertSize);
+
+   const std::string&  name()       const { return interned->name; }
+   const StringVector& annotation() const { return interned->annotation; }
+   int                 index()      const { return interned->index; }
+
    double percentMatch() const { return (100.0 * matchingBases / possible); }
    bool   isSpanning()   const { return (spanningCount > 0); }
 
+   void append(std::string& buffer) const;
    void write() const;
 
+   const InternedPattern *interned; // name and annotations of the pattern
+   std::string displaySequence;     // sequence w/ brackets or braces
+
+   int delim2;        // offset of second delimiter: [ or {
+   int leftBases;     // #bases in left side of sequence
+   int rightBases;    // #bases in right side of sequence
+
    int matchingBases; // total number of matching bases in read1 and read2
    int possible;      // possible number of matching bases
    int spanningCount; // number of junction-spanning reads (0, 1 or 2)
@@ -56,18 +116,16 @@ public:
 class HitRead
 {
 public:
-   HitRead(const std::string& inName, int inLeadingBlanks,
-           const std::string& inSequence, int inMatchingBases, bool inIsSpanning,
-	   int inLeftOverlap, int inRightOverlap)
-      : name(inName), leadingBlanks(inLeadingBlanks), sequence(inSequence),
-	matchingBases(inMatchingBases), isSpanning(inIsSpanning),
-	leftOverlap(inLeftOverlap), rightOverlap(inRightOverlap) { }
+   HitRead()
+      : name(), leadingBlanks(0), sequence(), matchingBases(0), isSpanning(false),
+        leftOverlap(0), rightOverlap(0) { }
 
    virtual ~HitRead() { }
 
    int    possible()     const { return sequence.length(); }
    double percentMatch() const { return (100.0 * matchingBases / possible()); }
 
+   void append(std::string& buffer) const;
    void write() const;
 
    std::string name;     // read name
@@ -84,22 +142,24 @@ public:
 class Hit
 {
 public:
-   Hit(HitPattern *inPattern, HitRead *inRead1, HitRead *inRead2)
-      : pattern(inPattern), read1(inRead1), read2(inRead2), duplicate(false) { }
+   Hit() : pattern(), read1(), read2(), duplicate(false) { }
 
-   virtual ~Hit() { delete pattern; delete read1; delete read2; }
+   virtual ~Hit() { }
 
    bool sameAs(const Hit& other) const;
    bool isStrong(int minStrong)  const;
-   bool isSpanning()             const { return pattern->isSpanning(); }
+   bool isSpanning()             const { return pattern.isSpanning(); }
 
    std::string label(int minStrong) const;
 
-   void write() const { pattern->write(); read1->write(); read2->write(); }
+   void append(std::string& buffer) const
+   { pattern.append(buffer); read1.append(buffer); read2.append(buffer); }
 
-   HitPattern *pattern; // describes the pattern that was matched by a read pair
-   HitRead    *read1;   // describes the first  read of the read pair
-   HitRead    *read2;   // describes the second read of the read pair
+   void write() const { pattern.write(); read1.write(); read2.write(); }
+
+   HitPattern pattern;  // describes the pattern that was matched by a read pair
+   HitRead    read1;    // describes the first  read of the read pair
+   HitRead    read2;    // describes the second read of the read pair
    bool duplicate;      // true if this hit is a duplicate of another hit
 };
 
@@ -107,13 +167,144 @@ typedef std::vector<Hit *> HitVector;
 
 //------------------------------------------------------------------------------------
 
+const int HIT_POOL_CHUNK_SIZE = 4096; // number of hits allocated at a time
+
+// this allocates hits in contiguous chunks and owns them along with the table of
+// their patterns; clear() makes all of the hits available for reuse, but the
+// patterns remain
+
+class HitPool
+{
+public:
+   HitPool()
+      : patternTable(), chunk(), numChunks(0), numUsed(HIT_POOL_CHUNK_SIZE) { }
+
+   virtual ~HitPool();
+
+   Hit *add();                          // returns an unused hit
+   void removeLast() { numUsed--; }     // returns the last hit added to the pool
+   void clear() { numChunks = 0; numUsed = HIT_POOL_CHUNK_SIZE; }
+
+   PatternTable patternTable; // patterns of the hits
+
+private:
+   HitPool(const HitPool&);            // not copyable
+   HitPool& operator=(const HitPool&);
+
+   std::vector<Hit *> chunk; // arrays of HIT_POOL_CHUNK_SIZE hits
+   size_t numChunks;         // number of chunks in use
+   int    numUsed;           // number of hits in use in the last chunk in use
+};
+
+//------------------------------------------------------------------------------------
+// HitCompare defines the sort order of hits; duplicate hits are placed consecutively
+// in the ordering
+
+struct HitCompare
+{
+   bool operator()(Hit* const& a, Hit* const& b) const
+   {
+      // sort by ascending pattern name,
+      // then by ascending number of left bases,
+      // then by ascending number of right bases,
+      // then by descending number of junction-spanning reads,
+      // then by ascending read1 name
+
+      if (a->pattern.interned != b->pattern.interned)
+      {
+         int key1 = a->pattern.name().compare(b->pattern.name());
+         if (key1 != 0)
+            return (key1 < 0);
+      }
+
+      int key2 = a->pattern.leftBases - b->pattern.leftBases;
+      if (key2 != 0)
+         return (key2 < 0);
+
+      int key3 = a->pattern.rightBases - b->pattern.rightBases;
+      if (key3 != 0)
+         return (key3 < 0);
+
+      int key4 = a->pattern.spanningCount - b->pattern.spanningCount;
+      if (key4 != 0)
+         return (key4 > 0);
+
+      return (a->read1.name < b->read1.name);
+   }
+};
+
+//------------------------------------------------------------------------------------
+
+struct BinaryHitState; // defined in hit.cpp
+
+// this reads the hits of a text or binary hit stream one at a time, interning their
+// patterns in the given table; the constructor reads the heading, and numReadPairs
+// is complete once next() has returned false
+
+class HitReader
+{
+public:
+   HitReader(std::istream& inStream, PatternTable& inPatternTable);
+
+   virtual ~HitReader();
+
+   bool next(Hit& hit); // gets the next hit, or returns false at the end of stream
+
+   std::string  version;           // fuzzion2 version in the heading
+   StringVector annotationHeading; // annotation column headings
+   uint64_t     numReadPairs;      // total number of read pairs processed
+
+private:
+   HitReader(const HitReader&);            // not copyable
+   HitReader& operator=(const HitReader&);
+
+   bool nextText(Hit& hit);
+   bool nextBinary(Hit& hit);
+
+   std::istream&   istream;
+   PatternTable&   patternTable;
+   std::string     headingLine; // of a text stream
+   BinaryHitState *binary;      // state of a binary stream, or NULL if text
+};
+
+//------------------------------------------------------------------------------------
+
+void appendHitPattern(std::string& buffer, const std::string& name,
+                      const char *displaySequence, int displayLength,
+		      const StringVector& annotation, int matchingBases,
+		      int possible, int spanningCount, int insertSize);
+
+void appendHitRead(std::string& buffer, const std::string& name, int leadingBlanks,
+                   const std::string& sequence, int matchingBases, bool isSpanning,
+		   int leftOverlap, int rightOverlap);
+
+void writeBinaryHitHeading(const std::string& version,
+                           const StringVector& annotationHeading);
+
+void appendBinaryPattern(std::string& buffer, int id, const Pattern& pattern);
+
+void appendBinaryHitPattern(std::string& buffer, int id, int displayOffset,
+                            int displayLength, int matchingBases, int possible,
+			    int spanningCount, int insertSize);
+
+void appendBinaryHitRead(std::string& buffer, const std::string& name,
+                         int leadingBlanks, const std::string& sequence,
+			 int matchingBases, bool isSpanning, int leftOverlap,
+			 int rightOverlap);
+
+void writeBinaryReadPairs(uint64_t numReadPairs);
+
+void appendHitHeadingLine(std::string& buffer, const std::string& version,
+                          const StringVector& annotationHeading);
+
 void writeHitHeadingLine(const std::string& version,
                          const StringVector& annotationHeading);
 
 void writeReadPairLine(uint64_t numReadPairs);
 
 uint64_t readHits(std::istream& istream, std::string& version,
-		  StringVector& annotationHeading, HitVector& hitVector);
+		  StringVector& annotationHeading, HitPool& hitPool,
+		  HitVector& hitVector);
 
 void getPatternIndices(const HitVector& hitVector, IntVector& index);
 
@@ -0,0 +1,262 @@
+//------------------------------------------------------------------------------------
+//
+// index.cpp - module for storing a pattern map in a binary file that fuzzion2 can
+//             memory-map at startup
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "index.h"
+#include "bin.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the signature identifies a pattern index file and its byte ordering
+const uint32_t PATTERN_INDEX_SIGNATURE_NOSWAP = 0x46A2C95D;
+const uint32_t PATTERN_INDEX_SIGNATURE_SWAP   = 0x5DC9A246;
+
+const uint32_t PATTERN_INDEX_VERSION = 1; // incremented when the layout changes
+
+const int PATTERN_INDEX_HEADER_SIZE = 4096; // header and padding before the arrays
+
+const int PATTERN_HASH_BUFFER_SIZE = 1024 * 1024; // bytes read at a time for hashing
+
+//------------------------------------------------------------------------------------
+
+struct PatternIndexHeader // the start of a pattern index file; the slots, bitset and
+			  // locations of the map follow the padded header
+{
+   uint32_t signature;
+   uint32_t version;
+   uint64_t patternHash;
+   uint64_t rankFingerprint;
+   uint32_t numPatterns;
+   uint32_t maxMinimizer;
+   uint8_t  windowLength;
+   uint8_t  windowScheme;
+   uint8_t  unused1[2];
+   uint32_t tableShift;
+   uint32_t filterShift;
+   uint32_t unused2;
+   uint64_t numKeys;
+   uint64_t numSlots;
+   uint64_t numFilterWords;
+   uint64_t numLocations;
+};
+
+//------------------------------------------------------------------------------------
+// align8() rounds a number of bytes up to a multiple of 8
+
+static uint64_t align8(uint64_t numBytes)
+{
+   return (numBytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+//------------------------------------------------------------------------------------
+// hashPatternFile() returns a hash of the contents of the named pattern file
+
+static uint64_t hashPatternFile(const std::string& patternFilename)
+{
+   std::ifstream infile(patternFilename.c_str(), std::ios::in | std::ios::binary);
+   if (!infile.is_open())
+      throw std::runtime_error("unable to open " + patternFilename);
+
+   std::vector<char> buffer(PATTERN_HASH_BUFFER_SIZE);
+   uint64_t hash = FNV_OFFSET_BASIS;
+
+   while (infile)
+   {
+      infile.read(&buffer[0], buffer.size());
+      hash = hashBytes(&buffer[0], infile.gcount(), hash);
+   }
+
+   return hash;
+}
+
+//------------------------------------------------------------------------------------
+// getPatternIndexKey() returns the key identifying the inputs of a pattern map
+
+PatternIndexKey getPatternIndexKey(const std::string& patternFilename,
+                                   const PatternVector *patternVector,
+				   const KmerRankTable *rankTable,
+				   MinimizerWindowLength w, Minimizer maxMinimizer,
+				   WindowScheme scheme)
+{
+   PatternIndexKey key;
+
+   key.patternHash     = hashPatternFile(patternFilename);
+   key.rankFingerprint = rankTable->fingerprint();
+   key.numPatterns     = patternVector->size();
+   key.maxMinimizer    = maxMinimizer;
+   key.windowLength    = w;
+   key.windowScheme    = scheme;
+
+   return key;
+}
+
+//------------------------------------------------------------------------------------
+// writeArray() writes an array of the given number of bytes, which may exceed the
+// largest number that can be passed to BinWriter::writeBuffer() at one time, followed
+// by zeros up to a multiple of 8 bytes
+
+static void writeArray(BinWriter& writer, const void *array, uint64_t numBytes)
+{
+   const uint64_t MAX_WRITE = 1 << 30;
+
+   const uint8_t *bytes = static_cast<const uint8_t *>(array);
+
+   for (uint64_t i = 0; i < numBytes; i += MAX_WRITE)
+      writer.writeBuffer(&bytes[i], std::min(numBytes - i, MAX_WRITE));
+
+   for (uint64_t i = numBytes; i < align8(numBytes); i++)
+      writer.writeUint8(0);
+}
+
+//------------------------------------------------------------------------------------
+// writePatternIndex() writes the given pattern map and the key of its inputs to the
+// named pattern index file
+
+void writePatternIndex(const std::string& indexFilename,
+                       const PatternMap *patternMap, const PatternIndexKey& key)
+{
+   PatternIndexHeader header;
+   std::memset(&header, 0, sizeof(header));
+
+   header.signature       = PATTERN_INDEX_SIGNATURE_NOSWAP;
+   header.version         = PATTERN_INDEX_VERSION;
+   header.patternHash     = key.patternHash;
+   header.rankFingerprint = key.rankFingerprint;
+   header.numPatterns     = key.numPatterns;
+   header.maxMinimizer    = key.maxMinimizer;
+   header.windowLength    = key.windowLength;
+   header.windowScheme    = key.windowScheme;
+   header.tableShift      = patternMap->tableShift;
+   header.filterShift     = patternMap->filterShift;
+   header.numKeys         = patternMap->numKeys;
+   header.numSlots        = patternMap->numSlots;
+   header.numFilterWords  = patternMap->filter.size();
+   header.numLocations    = patternMap->location.size();
+
+   BinWriter writer;
+   writer.open(indexFilename);
+
+   writer.writeBuffer(&header, sizeof(header));
+
+   for (int i = sizeof(header); i < PATTERN_INDEX_HEADER_SIZE; i++)
+      writer.writeUint8(0);
+
+   writeArray(writer, patternMap->slotData,
+              header.numSlots * sizeof(PatternMap::Slot));
+   writeArray(writer, patternMap->filterData,
+              header.numFilterWords * sizeof(uint64_t));
+   writeArray(writer, patternMap->locationData,
+              header.numLocations * sizeof(MapLocation));
+
+   writer.close();
+}
+
+//------------------------------------------------------------------------------------
+// mapPatternIndex() returns a pattern map residing in the named pattern index file,
+// which is memory-mapped read-only; an exception is raised if the file was not built
+// from inputs matching the given key; it is the caller's obligation to de-allocate
+// the returned object
+
+PatternMap *mapPatternIndex(const std::string& indexFilename,
+                            const PatternIndexKey& key)
+{
+   int fd = ::open(indexFilename.c_str(), O_RDONLY);
+   if (fd == -1)
+      throw std::runtime_error("unable to open " + indexFilename);
+
+   struct stat status;
+
+   if (fstat(fd, &status) == -1)
+   {
+      ::close(fd);
+      throw std::runtime_error("unable to get size of " + indexFilename);
+   }
+
+   uint64_t length = status.st_size;
+
+   if (length < PATTERN_INDEX_HEADER_SIZE)
+   {
+      ::close(fd);
+      throw std::runtime_error(indexFilename + " is not a pattern index file");
+   }
+
+   void *address = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+
+   ::close(fd); // the mapping remains valid after the file is closed
+
+   if (address == MAP_FAILED)
+      throw std::runtime_error("unable to memory-map " + indexFilename);
+
+   PatternIndexHeader header;
+   std::memcpy(&header, address, sizeof(header));
+
+   std::string error = "";
+
+   uint64_t slotBytes     = align8(header.numSlots * sizeof(PatternMap::Slot));
+   uint64_t filterBytes   = header.numFilterWords * sizeof(uint64_t);
+   uint64_t locationBytes = header.numLocations   * sizeof(MapLocation);
+
+   if (header.signature == PATTERN_INDEX_SIGNATURE_SWAP)
+      error = indexFilename + " was built on a machine of different byte ordering";
+   else if (header.signature != PATTERN_INDEX_SIGNATURE_NOSWAP)
+      error = indexFilename + " is not a pattern index file";
+   else if (header.version != PATTERN_INDEX_VERSION)
+      error = "unsupported version of pattern index file " + indexFilename;
+   else if (header.patternHash     != key.patternHash     ||
+            header.rankFingerprint != key.rankFingerprint ||
+	    header.numPatterns     != key.numPatterns     ||
+	    header.maxMinimizer    != key.maxMinimizer    ||
+	    header.windowLength    != key.windowLength    ||
+	    header.windowScheme    != key.windowScheme)
+      error = indexFilename + " was built from a different pattern file, rank " +
+              "table or options; rebuild it with -buildindex";
+   else if (header.numSlots == 0 || header.numSlots > (1ULL << 31) ||
+            (header.numSlots & (header.numSlots - 1)) != 0 ||
+	    header.tableShift != 32 - __builtin_ctzll(header.numSlots) ||
+	    header.numFilterWords == 0 || header.numFilterWords > (1ULL << 26) ||
+	    (header.numFilterWords & (header.numFilterWords - 1)) != 0 ||
+	    header.filterShift != 26 - __builtin_ctzll(header.numFilterWords) ||
+	    length != PATTERN_INDEX_HEADER_SIZE + slotBytes + filterBytes +
+	              locationBytes)
+      error = "invalid pattern index file " + indexFilename;
+
+   if (error != "")
+   {
+      munmap(address, length);
+      throw std::runtime_error(error);
+   }
+
+   const uint8_t *base = static_cast<const uint8_t *>(address);
+
+   PatternMap *patternMap = new PatternMap();
+
+   patternMap->numKeys      = header.numKeys;
+   patternMap->tableShift   = header.tableShift;
+   patternMap->filterShift  = header.filterShift;
+   patternMap->numSlots     = header.numSlots;
+   patternMap->slotData     = reinterpret_cast<const PatternMap::Slot *>(
+                                 base + PATTERN_INDEX_HEADER_SIZE);
+   patternMap->filterData   = reinterpret_cast<const uint64_t *>(
+                                 base + PATTERN_INDEX_HEADER_SIZE + slotBytes);
+   patternMap->locationData = reinterpret_cast<const MapLocation *>(
+                                 base + PATTERN_INDEX_HEADER_SIZE + slotBytes +
+				 filterBytes);
+   patternMap->mapAddress   = address;
+   patternMap->mapLength    = length;
+
+   return patternMap;
+}
@@ -0,0 +1,43 @@
+//------------------------------------------------------------------------------------
+//
+// index.h - module for storing a pattern map in a binary file that fuzzion2 can
+//           memory-map at startup
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "pattern.h"
+#include "rank.h"
+
+//------------------------------------------------------------------------------------
+
+struct PatternIndexKey // identifies the inputs from which a pattern map is built; an
+		       // index file may be used only with the same inputs
+{
+   uint64_t patternHash;     // hash of the contents of the pattern file
+   uint64_t rankFingerprint; // fingerprint of the k-mer rank table
+   uint32_t numPatterns;     // number of patterns in the pattern file
+   uint32_t maxMinimizer;    // limit used to identify common minimizers
+   uint8_t  windowLength;    // length of each minimizer window
+   uint8_t  windowScheme;    // WindowScheme of the minimizer windows
+};
+
+PatternIndexKey getPatternIndexKey(const std::string& patternFilename,
+                                   const PatternVector *patternVector,
+				   const KmerRankTable *rankTable,
+				   MinimizerWindowLength w, Minimizer maxMinimizer,
+				   WindowScheme scheme);
+
+void writePatternIndex(const std::string& indexFilename,
+                       const PatternMap *patternMap, const PatternIndexKey& key);
+
+PatternMap *mapPatternIndex(const std::string& indexFilename,
+                            const PatternIndexKey& key);
+
+#endif
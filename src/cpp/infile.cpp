@@ -0,0 +1,921 @@
+//------------------------------------------------------------------------------------
+//
+// infile.cpp - module for reading input files that may be gzipped
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "infile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+const size_t CHUNK_SIZE      = 1 << 20; // bytes of input per chunk
+const size_t BGZF_HEADER_LEN = 18;      // bytes in the header of a BGZF block
+const size_t BGZF_BLOCK_MAX  = 1 << 16; // maximum bytes in a BGZF block
+const size_t SYNC_DATA_LEN   = 1 << 20; // bytes first inflated at a shard boundary
+const size_t SYNC_DATA_MAX   = 1 << 26; // limit on bytes inflated at a boundary
+const size_t GZIP_FOOTER_LEN = 8;       // CRC32 and ISIZE at the end of a member
+const int    MAX_GET_LINES   = 8;       // limit on lines requested from getLines()
+
+int InputFile::inflateThreads = 1;
+
+//------------------------------------------------------------------------------------
+// getLE16() and getLE32() return little-endian integers stored at the given address
+
+static inline uint32_t getLE16(const char *p)
+{
+   const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+   return u[0] | (u[1] << 8);
+}
+
+static inline uint32_t getLE32(const char *p)
+{
+   const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+   return u[0] | (u[1] << 8) | (u[2] << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+//------------------------------------------------------------------------------------
+// isGzip() returns true if the data begins a gzip member; isBgzf() returns true if
+// the data begins a BGZF block, which is a gzip member whose extra field gives the
+// size of the block
+
+static bool isGzip(const std::string& data)
+{
+   return (data.length() >= 2 && static_cast<unsigned char>(data[0]) == 0x1F &&
+                                 static_cast<unsigned char>(data[1]) == 0x8B);
+}
+
+static bool isBgzf(const char *data, size_t length)
+{
+   return (length >= BGZF_HEADER_LEN && static_cast<unsigned char>(data[0]) == 0x1F &&
+           static_cast<unsigned char>(data[1]) == 0x8B && data[2] == 8 &&
+           (data[3] & 4) && getLE16(&data[10]) == 6 && data[12] == 'B' &&
+	   data[13] == 'C' && getLE16(&data[14]) == 2);
+}
+
+static bool isBgzf(const std::string& data)
+{
+   return isBgzf(data.data(), data.length());
+}
+
+//------------------------------------------------------------------------------------
+
+struct GzipChunk // a chunk of a gzipped file
+{
+   GzipChunk() : outputLen(0), keepLen(0), ready(false) { }
+
+   std::string input;     // compressed BGZF blocks; unused for other gzipped files
+   size_t      outputLen; // total uncompressed length of the BGZF blocks
+   size_t      keepLen;   // length of output kept, less at the end of a range
+   std::string output;    // uncompressed data
+   std::string error;     // non-empty if the chunk could not be decompressed
+   bool        ready;     // true when output or error has been set
+};
+
+//------------------------------------------------------------------------------------
+
+class GzipInflater // decompresses a gzipped file using background threads
+{
+public:
+   GzipInflater(std::FILE *inF, const std::string& inFilename,
+                const std::string& head, int numThreads, const BgzfRange *inRange);
+
+   virtual ~GzipInflater();
+
+   bool next(std::string& data); // gets the next block of uncompressed data
+
+private:
+   void readerWork(std::string head);
+   bool readBgzfBlock(GzipChunk *chunk, std::string& head);
+   void inflateGzip(std::string head);
+   void inflaterWork();
+   void inflateBgzf(GzipChunk *chunk, z_stream& stream);
+
+   bool waitForRoom();
+   void addChunk(GzipChunk *chunk, bool needsInflating);
+
+   std::FILE   *f;
+   std::string  filename;
+   bool         bgzf;         // true if the file is BGZF-compressed
+   size_t       maxChunks;    // limit on the number of chunks in memory
+   BgzfRange    range;        // the part of a BGZF-compressed file that is read
+   uint64_t     skip;         // uncompressed bytes still to drop from the front
+   uint64_t     offset;       // file offset of the next BGZF block to read
+   uint64_t     total;        // uncompressed bytes of the blocks read so far
+   uint64_t     limit;        // total at the end of the range, once it is known
+
+   std::mutex                mutex;
+   std::condition_variable   changed;
+   std::deque<GzipChunk *>   order;    // chunks in file order, awaiting next()
+   std::deque<GzipChunk *>   work;     // BGZF chunks awaiting inflation
+   bool                      finished; // true when the whole file has been read
+   bool                      stopping; // true when the threads must stop
+   std::vector<std::thread>  thread;
+};
+
+//------------------------------------------------------------------------------------
+// GzipInflater::GzipInflater() starts a thread to read the file; head contains the
+// bytes already read from the beginning of the file, or from the start of the range
+// of a BGZF-compressed file
+
+GzipInflater::GzipInflater(std::FILE *inF, const std::string& inFilename,
+                           const std::string& head, int numThreads,
+			   const BgzfRange *inRange)
+   : f(inF), filename(inFilename), bgzf(isBgzf(head)), skip(0), offset(0), total(0),
+     limit(UINT64_MAX), finished(false), stopping(false)
+{
+   if (numThreads < 1)
+      numThreads = 1;
+
+   range.start.block = range.start.skip = range.stop.skip = 0;
+   range.stop.block  = BGZF_END;
+
+   if (inRange)
+   {
+      range  = *inRange;
+      skip   = range.start.skip;
+      offset = range.start.block;
+   }
+
+   maxChunks = (bgzf ? 2 * numThreads + 2 : 2);
+
+   thread.push_back(std::thread(&GzipInflater::readerWork, this, head));
+
+   if (bgzf)
+      for (int i = 0; i < numThreads; i++)
+         thread.push_back(std::thread(&GzipInflater::inflaterWork, this));
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::~GzipInflater() stops the threads and frees the remaining chunks
+
+GzipInflater::~GzipInflater()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+   }
+
+   changed.notify_all();
+
+   int numThreads = thread.size();
+
+   for (int i = 0; i < numThreads; i++)
+      thread[i].join();
+
+   for (size_t i = 0; i < order.size(); i++)
+      delete order[i];
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::next() waits for the next chunk in file order and moves its
+// uncompressed data to the caller; false is returned at end-of-file
+
+bool GzipInflater::next(std::string& data)
+{
+   std::unique_lock<std::mutex> lock(mutex);
+
+   while (order.empty() || !order.front()->ready)
+   {
+      if (order.empty() && finished)
+         return false;
+
+      changed.wait(lock);
+   }
+
+   GzipChunk *chunk = order.front();
+   order.pop_front();
+
+   lock.unlock();
+   changed.notify_all(); // there is room for another chunk
+
+   if (chunk->error != "")
+   {
+      std::string error = chunk->error;
+      delete chunk;
+      throw std::runtime_error(error + " in " + filename);
+   }
+
+   data.swap(chunk->output);
+   delete chunk;
+
+   if (skip > 0) // the range starts within this data or beyond it
+   {
+      size_t n = std::min<uint64_t>(skip, data.length());
+
+      data.erase(0, n);
+      skip -= n;
+   }
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::waitForRoom() waits until another chunk may be added, and returns
+// false if the threads are stopping
+
+bool GzipInflater::waitForRoom()
+{
+   std::unique_lock<std::mutex> lock(mutex);
+
+   while (order.size() >= maxChunks && !stopping)
+      changed.wait(lock);
+
+   return !stopping;
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::addChunk() appends a chunk to the file order and, if needed, to the
+// work of the inflater threads
+
+void GzipInflater::addChunk(GzipChunk *chunk, bool needsInflating)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      order.push_back(chunk);
+
+      if (needsInflating)
+         work.push_back(chunk);
+   }
+
+   changed.notify_all();
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::readerWork() reads the file; the blocks of a BGZF-compressed file are
+// grouped into chunks for the inflater threads, and any other gzipped file is
+// inflated by this thread
+
+void GzipInflater::readerWork(std::string head)
+{
+   if (!bgzf)
+      inflateGzip(head);
+   else
+      while (waitForRoom())
+      {
+         GzipChunk *chunk = new GzipChunk();
+         bool more;
+
+         while ((more = readBgzfBlock(chunk, head)) && chunk->error == "" &&
+                chunk->input.length() < CHUNK_SIZE)
+            ;
+
+         if (chunk->error != "")
+	 {
+            chunk->ready = true;
+            addChunk(chunk, false);
+	    break;
+	 }
+
+         if (chunk->input.length() > 0)
+            addChunk(chunk, true);
+         else
+            delete chunk;
+
+         if (!more)
+            break;
+      }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = true;
+   }
+
+   changed.notify_all();
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::readBgzfBlock() appends the next BGZF block of the file to a chunk
+// and returns true, or returns false at end-of-file or at the end of the range; head
+// holds bytes that have been read from the file but not yet consumed
+
+bool GzipInflater::readBgzfBlock(GzipChunk *chunk, std::string& head)
+{
+   if (offset == range.stop.block)
+      limit = total + range.stop.skip;
+
+   if (total >= limit)
+      return false; // end of the range
+
+   char header[BGZF_HEADER_LEN];
+
+   size_t n = head.length();
+   std::memcpy(header, head.data(), n);
+   head.clear();
+
+   n += std::fread(&header[n], 1, BGZF_HEADER_LEN - n, f);
+
+   if (n == 0)
+      return false; // end-of-file
+
+   std::string block(header, n);
+
+   if (!isBgzf(block))
+   {
+      chunk->error = (n < BGZF_HEADER_LEN ? "unexpected end of BGZF data" :
+                                            "invalid BGZF block");
+      return false;
+   }
+
+   size_t blockLen = getLE16(&header[16]) + 1;
+
+   if (blockLen < BGZF_HEADER_LEN + GZIP_FOOTER_LEN)
+   {
+      chunk->error = "invalid BGZF block";
+      return false;
+   }
+
+   size_t start = chunk->input.length();
+   chunk->input.resize(start + blockLen);
+
+   std::memcpy(&chunk->input[start], header, BGZF_HEADER_LEN);
+
+   if (std::fread(&chunk->input[start + BGZF_HEADER_LEN], 1,
+                  blockLen - BGZF_HEADER_LEN, f) != blockLen - BGZF_HEADER_LEN)
+   {
+      chunk->error = "unexpected end of BGZF data";
+      return false;
+   }
+
+   uint32_t size = getLE32(&chunk->input[start + blockLen - 4]);
+
+   offset += blockLen;
+   total  += size;
+
+   chunk->outputLen += size;
+   chunk->keepLen    = chunk->outputLen - (total > limit ? total - limit : 0);
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::inflateGzip() inflates a gzipped file that is not BGZF-compressed,
+// producing chunks of uncompressed data; the file may contain concatenated gzip
+// members, and any trailing bytes that do not begin a member are ignored
+
+void GzipInflater::inflateGzip(std::string head)
+{
+   std::vector<char> input(CHUNK_SIZE);
+
+   z_stream stream;
+   std::memset(&stream, 0, sizeof(stream));
+
+   std::string error = "";
+
+   if (inflateInit2(&stream, 15 + 16) != Z_OK) // expect a gzip wrapper
+      error = "unable to initialize zlib";
+
+   size_t headLen = head.length();
+   std::memcpy(&input[0], head.data(), headLen);
+
+   stream.next_in  = reinterpret_cast<Bytef *>(&input[0]);
+   stream.avail_in = headLen;
+
+   bool endOfFile = false, endOfMember = false;
+
+   while (error == "" && waitForRoom())
+   {
+      GzipChunk *chunk = new GzipChunk();
+      chunk->output.resize(CHUNK_SIZE);
+
+      stream.next_out  = reinterpret_cast<Bytef *>(&chunk->output[0]);
+      stream.avail_out = CHUNK_SIZE;
+
+      while (stream.avail_out > 0)
+      {
+         if (stream.avail_in == 0 && !endOfFile)
+	 {
+            stream.next_in  = reinterpret_cast<Bytef *>(&input[0]);
+            stream.avail_in = std::fread(&input[0], 1, CHUNK_SIZE, f);
+	    endOfFile       = (stream.avail_in == 0);
+	 }
+
+	 if (endOfMember)
+	 {
+            // another member may follow the one just inflated
+	    if (stream.avail_in == 0 || *stream.next_in != 0x1F)
+	       break; // no more members
+
+            inflateReset(&stream);
+	    endOfMember = false;
+	 }
+
+	 if (stream.avail_in == 0)
+	 {
+            error = "unexpected end of gzipped data";
+            break;
+	 }
+
+	 int status = inflate(&stream, Z_NO_FLUSH);
+
+	 if (status == Z_STREAM_END)
+            endOfMember = true;
+	 else if (status != Z_OK)
+	 {
+            error = "invalid gzipped data";
+	    break;
+	 }
+      }
+
+      bool more = (stream.avail_out == 0 && error == "");
+
+      chunk->output.resize(CHUNK_SIZE - stream.avail_out);
+      chunk->error = error;
+      chunk->ready = true;
+
+      if (chunk->output.length() > 0 || chunk->error != "")
+         addChunk(chunk, false);
+      else
+         delete chunk;
+
+      if (!more)
+         break;
+   }
+
+   inflateEnd(&stream);
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::inflaterWork() contains the work of each inflater thread, which
+// inflates chunks of BGZF blocks until the reader thread is finished
+
+void GzipInflater::inflaterWork()
+{
+   z_stream stream;
+   std::memset(&stream, 0, sizeof(stream));
+
+   bool initialized = (inflateInit2(&stream, -15) == Z_OK); // raw deflate data
+
+   for (;;)
+   {
+      GzipChunk *chunk;
+
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+
+         while (work.empty() && !finished && !stopping)
+            changed.wait(lock);
+
+	 if (stopping || work.empty())
+            break;
+
+	 chunk = work.front();
+	 work.pop_front();
+      }
+
+      if (initialized)
+         inflateBgzf(chunk, stream);
+      else
+         chunk->error = "unable to initialize zlib";
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+	 chunk->ready = true;
+      }
+
+      changed.notify_all();
+   }
+
+   if (initialized)
+      inflateEnd(&stream);
+}
+
+//------------------------------------------------------------------------------------
+// GzipInflater::inflateBgzf() inflates the BGZF blocks of a chunk, verifying the
+// length and CRC32 of each block
+
+void GzipInflater::inflateBgzf(GzipChunk *chunk, z_stream& stream)
+{
+   chunk->output.resize(chunk->outputLen);
+
+   const char *in     = chunk->input.data();
+   size_t      inLen  = chunk->input.length();
+   size_t      inPos  = 0;
+   size_t      outPos = 0;
+
+   while (inPos < inLen)
+   {
+      const char *block    = &in[inPos];
+      size_t      blockLen = getLE16(&block[16]) + 1;
+      uint32_t    crc      = getLE32(&block[blockLen - 8]);
+      uint32_t    size     = getLE32(&block[blockLen - 4]);
+
+      if (size > 0)
+      {
+         inflateReset(&stream);
+
+         stream.next_in   = reinterpret_cast<Bytef *>(
+                               const_cast<char *>(&block[BGZF_HEADER_LEN]));
+         stream.avail_in  = blockLen - BGZF_HEADER_LEN - GZIP_FOOTER_LEN;
+         stream.next_out  = reinterpret_cast<Bytef *>(&chunk->output[outPos]);
+         stream.avail_out = size;
+
+         if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out != 0 ||
+             crc32(0, reinterpret_cast<const Bytef *>(&chunk->output[outPos]),
+		   size) != crc)
+         {
+            chunk->error = "invalid BGZF block";
+	    chunk->output.clear();
+	    break;
+         }
+      }
+
+      inPos  += blockLen;
+      outPos += size;
+   }
+
+   if (chunk->error == "")
+      chunk->output.resize(chunk->keepLen);
+
+   std::string().swap(chunk->input); // release memory
+}
+
+//------------------------------------------------------------------------------------
+// InputFile::InputFile() opens the named file; if the file begins with gzip "magic"
+// bytes, it is decompressed as it is read; otherwise, a regular file is
+// memory-mapped and parsed in place; a range of a BGZF-compressed file is read from
+// the block where it starts
+
+InputFile::InputFile(const std::string& inFilename, const BgzfRange *range)
+   : filename(inFilename), f(NULL), inflater(NULL), mapAddress(NULL), mapLength(0),
+     buffer(""), data(NULL), dataLen(0), pos(0)
+{
+   f = std::fopen(filename.c_str(), "rb");
+   if (!f)
+      throw std::runtime_error("unable to open " + filename);
+
+   if (range && (range->start.block == BGZF_END ? // the range is empty
+                 fseeko(f, 0, SEEK_END) : fseeko(f, range->start.block, SEEK_SET)))
+   {
+      std::fclose(f);
+      throw std::runtime_error("unable to seek in " + filename);
+   }
+
+   char head[BGZF_HEADER_LEN];
+
+   buffer.assign(head, std::fread(head, 1, BGZF_HEADER_LEN, f));
+
+   if (range && buffer.length() > 0 && !isBgzf(buffer))
+   {
+      std::fclose(f);
+      throw std::runtime_error("invalid BGZF range in " + filename);
+   }
+
+   if (isGzip(buffer))
+   {
+      inflater = new GzipInflater(f, filename, buffer, inflateThreads, range);
+      buffer.clear();
+   }
+   else if (!range)
+   {
+      struct stat st;
+
+      if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) &&
+          st.st_size > static_cast<off_t>(buffer.length()))
+      {
+         void *address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+	                      fileno(f), 0);
+
+         if (address != MAP_FAILED)
+	 {
+            madvise(address, st.st_size, MADV_SEQUENTIAL);
+
+            mapAddress = address;
+	    mapLength  = st.st_size;
+	 }
+      }
+   }
+
+   if (mapAddress)
+   {
+      buffer.clear();
+      data    = static_cast<const char *>(mapAddress);
+      dataLen = mapLength;
+   }
+   else
+   {
+      data    = buffer.data();
+      dataLen = buffer.length();
+   }
+}
+
+//------------------------------------------------------------------------------------
+// InputFile::~InputFile() closes the file
+
+InputFile::~InputFile()
+{
+   delete inflater; // stops its threads before the file is closed
+
+   if (mapAddress)
+      munmap(mapAddress, mapLength);
+
+   std::fclose(f);
+}
+
+//------------------------------------------------------------------------------------
+// InputFile::fill() discards the data already parsed, appends the next block of
+// data from the file and returns true, or returns false at end-of-file
+
+bool InputFile::fill()
+{
+   if (mapAddress)
+      return false; // the whole file is mapped
+
+   buffer.erase(0, pos);
+   pos = 0;
+
+   size_t oldLen = buffer.length();
+
+   if (inflater)
+   {
+      std::string block;
+
+      while (block.length() == 0)
+         if (!inflater->next(block))
+            break;
+
+      if (oldLen == 0)
+         buffer.swap(block);
+      else
+         buffer.append(block);
+   }
+   else
+   {
+      buffer.resize(oldLen + CHUNK_SIZE);
+      buffer.resize(oldLen + std::fread(&buffer[oldLen], 1, CHUNK_SIZE, f));
+   }
+
+   data    = buffer.data();
+   dataLen = buffer.length();
+
+   return (dataLen > oldLen);
+}
+
+//------------------------------------------------------------------------------------
+// InputFile::getLines() gets the next n lines as spans of the data; all n lines are
+// made contiguous in the data, reading more of the file as needed; a final line that
+// lacks a newline is still a line
+
+int InputFile::getLines(int n, LineSpan *line)
+{
+   if (n > MAX_GET_LINES)
+      throw std::runtime_error("too many lines requested from " + filename);
+
+   size_t lineEnd[MAX_GET_LINES]; // offset from pos of the end of each line
+   int    count = 0;
+   size_t end   = 0;              // offset from pos of the first unsearched byte
+
+   while (count < n)
+   {
+      const char *start   = data + pos + end;
+      const char *newline = static_cast<const char *>(
+                               std::memchr(start, '\n', dataLen - pos - end));
+      if (newline)
+      {
+         lineEnd[count++] = end + (newline - start);
+	 end = lineEnd[count - 1] + 1;
+      }
+      else if (!fill()) // the unparsed data moves to the front of the buffer
+      {
+         if (pos + end < dataLen) // final line lacks a newline
+	 {
+            lineEnd[count++] = dataLen - pos;
+	    end = dataLen - pos;
+	 }
+
+	 break;
+      }
+   }
+
+   size_t begin = 0;
+
+   for (int i = 0; i < count; i++)
+   {
+      line[i].data   = data + pos + begin;
+      line[i].length = lineEnd[i] - begin;
+      begin = lineEnd[i] + 1;
+   }
+
+   pos += end;
+
+   return count;
+}
+
+//------------------------------------------------------------------------------------
+// readBgzfBlockAt() reads the BGZF block at the given offset of a file and returns
+// true, or returns false if a complete BGZF block is not there
+
+static bool readBgzfBlockAt(std::FILE *f, uint64_t offset, std::string& block)
+{
+   block.resize(BGZF_HEADER_LEN);
+
+   if (fseeko(f, offset, SEEK_SET) != 0 ||
+       std::fread(&block[0], 1, BGZF_HEADER_LEN, f) != BGZF_HEADER_LEN ||
+       !isBgzf(block))
+      return false;
+
+   size_t blockLen = getLE16(&block[16]) + 1;
+
+   if (blockLen < BGZF_HEADER_LEN + GZIP_FOOTER_LEN)
+      return false;
+
+   block.resize(blockLen);
+
+   return (std::fread(&block[BGZF_HEADER_LEN], 1, blockLen - BGZF_HEADER_LEN, f) ==
+           blockLen - BGZF_HEADER_LEN);
+}
+
+//------------------------------------------------------------------------------------
+// inflateBlock() appends the uncompressed data of a BGZF block to output and returns
+// true, or returns false if the data does not match the length and CRC32 of the block
+
+static bool inflateBlock(const std::string& block, std::string& output)
+{
+   size_t   blockLen = block.length();
+   uint32_t crc      = getLE32(&block[blockLen - 8]);
+   uint32_t size     = getLE32(&block[blockLen - 4]);
+
+   if (size > BGZF_BLOCK_MAX)
+      return false;
+
+   if (size == 0)
+      return true;
+
+   z_stream stream;
+   std::memset(&stream, 0, sizeof(stream));
+
+   if (inflateInit2(&stream, -15) != Z_OK) // raw deflate data
+      throw std::runtime_error("unable to initialize zlib");
+
+   size_t outPos = output.length();
+   output.resize(outPos + size);
+
+   stream.next_in   = reinterpret_cast<Bytef *>(
+                         const_cast<char *>(&block[BGZF_HEADER_LEN]));
+   stream.avail_in  = blockLen - BGZF_HEADER_LEN - GZIP_FOOTER_LEN;
+   stream.next_out  = reinterpret_cast<Bytef *>(&output[outPos]);
+   stream.avail_out = size;
+
+   bool valid = (inflate(&stream, Z_FINISH) == Z_STREAM_END &&
+                 stream.avail_out == 0 &&
+                 crc32(0, reinterpret_cast<const Bytef *>(&output[outPos]),
+		       size) == crc);
+   inflateEnd(&stream);
+
+   if (!valid)
+      output.resize(outPos);
+
+   return valid;
+}
+
+//------------------------------------------------------------------------------------
+// findBgzfBlock() returns the offset of the first BGZF block that begins at or after
+// the given offset of a file, or the file size if there is none; a candidate found
+// by its header must inflate to the length and CRC32 in its footer and be followed
+// by another block or by end-of-file, so compressed data resembling a header is
+// passed over
+
+static uint64_t findBgzfBlock(std::FILE *f, uint64_t offset, uint64_t fileSize)
+{
+   std::string window(BGZF_BLOCK_MAX + BGZF_HEADER_LEN, '\0');
+
+   if (offset >= fileSize || fseeko(f, offset, SEEK_SET) != 0)
+      return fileSize;
+
+   window.resize(std::fread(&window[0], 1, window.length(), f));
+
+   std::string block, next, output;
+
+   for (size_t i = 0; i + BGZF_HEADER_LEN <= window.length(); i++)
+   {
+      output.clear();
+
+      if (isBgzf(&window[i], window.length() - i) &&
+          readBgzfBlockAt(f, offset + i, block) && inflateBlock(block, output))
+      {
+         uint64_t nextOffset = offset + i + block.length();
+
+         if (nextOffset == fileSize || readBgzfBlockAt(f, nextOffset, next))
+            return offset + i;
+      }
+   }
+
+   return fileSize; // every block begins within BGZF_BLOCK_MAX bytes of another
+}
+
+//------------------------------------------------------------------------------------
+// isBgzfFile() returns true if the named file is BGZF-compressed
+
+bool isBgzfFile(const std::string& filename)
+{
+   std::FILE *f = std::fopen(filename.c_str(), "rb");
+   if (!f)
+      return false;
+
+   std::string head(BGZF_HEADER_LEN, '\0');
+   head.resize(std::fread(&head[0], 1, BGZF_HEADER_LEN, f));
+
+   std::fclose(f);
+
+   return isBgzf(head);
+}
+
+//------------------------------------------------------------------------------------
+// findBgzfShard() returns the position where shard i of N (numbered from 0) begins
+// in the uncompressed data of a BGZF-compressed file, which is where shard i - 1
+// ends; shard 0 begins at the start of the file, and shard N at end-of-file; other
+// shards begin at the first record found by the sync function after the first block
+// at or beyond i/N of the file size, so the shards read disjoint parts of the file
+// and all shards find their common boundaries alike
+
+BgzfPosition findBgzfShard(const std::string& filename, int shard, int numShards,
+                           BgzfSyncFunction sync)
+{
+   BgzfPosition position;
+   position.block = (shard <= 0 ? 0 : BGZF_END);
+   position.skip  = 0;
+
+   if (shard <= 0 || shard >= numShards)
+      return position;
+
+   std::FILE *f = std::fopen(filename.c_str(), "rb");
+   if (!f)
+      throw std::runtime_error("unable to open " + filename);
+
+   struct stat st;
+   if (fstat(fileno(f), &st) != 0)
+   {
+      std::fclose(f);
+      throw std::runtime_error("unable to get the size of " + filename);
+   }
+
+   uint64_t fileSize = st.st_size;
+   uint64_t offset   = findBgzfBlock(f, fileSize / numShards * shard +
+                                        fileSize % numShards * shard / numShards,
+                                     fileSize);
+
+   std::string              data, block;
+   std::vector<uint64_t>    blockOffset;
+   std::vector<size_t>      blockStart;  // offset in data of each block, and the end
+   bool                     atEnd = true;
+   bool                     found = false;
+   size_t                   start = 0;
+
+   for (size_t minLen = SYNC_DATA_LEN; offset < fileSize && !found; minLen *= 2)
+   {
+      data.clear();
+      blockOffset.clear();
+      blockStart.assign(1, 0);
+
+      uint64_t blockOff = offset;
+
+      while (data.length() < minLen && blockOff < fileSize)
+      {
+         if (!readBgzfBlockAt(f, blockOff, block) || !inflateBlock(block, data))
+	 {
+            std::fclose(f);
+            throw std::runtime_error("invalid BGZF block in " + filename);
+	 }
+
+         blockOffset.push_back(blockOff);
+	 blockStart.push_back(data.length());
+	 blockOff += block.length();
+      }
+
+      atEnd = (blockOff >= fileSize);
+      found = sync(data, atEnd, start);
+
+      if (!found && (atEnd || minLen >= SYNC_DATA_MAX))
+         break;
+   }
+
+   std::fclose(f);
+
+   if (!found && !atEnd)
+      throw std::runtime_error("unable to find a shard boundary in " + filename);
+
+   if (found)
+      for (size_t i = 0; i < blockOffset.size(); i++)
+         if (start < blockStart[i + 1])
+	 {
+            position.block = blockOffset[i];
+	    position.skip  = start - blockStart[i];
+	    break;
+	 }
+
+   return position; // remains at end-of-file if the record starts at the end
+}
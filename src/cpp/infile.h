@@ -0,0 +1,91 @@
+//------------------------------------------------------------------------------------
+//
+// infile.h - module for reading input files that may be gzipped
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef INFILE_H
+#define INFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+class GzipInflater; // defined in infile.cpp
+
+//------------------------------------------------------------------------------------
+
+struct LineSpan // the characters of a line within the buffer of an InputFile
+{
+   const char *data;   // first character of the line
+   int         length; // number of characters, not counting the newline
+};
+
+//------------------------------------------------------------------------------------
+
+const uint64_t BGZF_END = UINT64_MAX; // block of the position at end-of-file
+
+struct BgzfPosition // a position in the uncompressed data of a BGZF-compressed file
+{
+   uint64_t block; // file offset of a BGZF block, or BGZF_END
+   uint64_t skip;  // uncompressed bytes from the start of the block to the position
+};
+
+struct BgzfRange // the uncompressed data from one position up to another
+{
+   BgzfPosition start, stop;
+};
+
+// a BgzfSyncFunction finds the first record, or pair of records, that begins in data
+// inflated from a BGZF block in the middle of a file; it sets start to the offset of
+// the record in the data and returns true, or returns false if there is none; atEnd
+// is true if the data reaches end-of-file, and start may then be the data length
+typedef bool (*BgzfSyncFunction)(const std::string& data, bool atEnd, size_t& start);
+
+//------------------------------------------------------------------------------------
+
+class InputFile // reads a file, decompressing it if it is gzipped
+{
+public:
+   // the constructor opens the file; if a range is given, the file must be
+   // BGZF-compressed and only the data in the range is read
+   InputFile(const std::string& inFilename, const BgzfRange *range = NULL);
+
+   virtual ~InputFile();                     // closes the file
+
+   // getLines() gets the next n lines and returns how many were obtained, which is
+   // less than n only at end-of-file; the spans remain valid until the next call
+   int getLines(int n, LineSpan *line);
+
+   std::string filename; // name of file to read
+
+   // number of threads that inflate a BGZF-compressed file, whose blocks can be
+   // decompressed independently; a file compressed by gzip is inflated by one
+   // thread that runs ahead of the thread calling getLines()
+   static int inflateThreads;
+
+private:
+   bool fill(); // appends the next block of data and returns false at end-of-file
+
+   std::FILE    *f;
+   GzipInflater *inflater;  // is non-NULL when the file is gzipped
+   void         *mapAddress; // is non-NULL when the file is memory-mapped
+   size_t        mapLength;
+   std::string   buffer;    // holds uncompressed data when not memory-mapped
+   const char   *data;      // the data being parsed, in buffer or in the mapping
+   size_t        dataLen;   // number of bytes of data
+   size_t        pos;       // offset of the next unread byte of data
+};
+
+//------------------------------------------------------------------------------------
+
+bool isBgzfFile(const std::string& filename);
+
+BgzfPosition findBgzfShard(const std::string& filename, int shard, int numShards,
+                           BgzfSyncFunction sync);
+
+#endif
@@ -68,10 +68,79 @@ Kmer stringToKmer(const std::string& s);
 
 Kmer kmerReverseComplement(KmerLength k, Kmer kmer);
 
+// this is equivalent to kmerReverseComplement() but uses bit manipulation and does
+// not check k; it is intended for use in performance-critical loops
+inline Kmer fastKmerReverseComplement(KmerLength k, Kmer kmer)
+{
+   kmer = ~kmer; // complement each base
+
+   // reverse the order of the bases
+   kmer = ((kmer >> 2) & 0x33333333) | ((kmer & 0x33333333) << 2);
+   kmer = ((kmer >> 4) & 0x0F0F0F0F) | ((kmer & 0x0F0F0F0F) << 4);
+   kmer = __builtin_bswap32(kmer);
+
+   return kmer >> (32 - 2 * k);
+}
+
+// when k is odd, the middle bases of a k-mer and its reverse complement are
+// complementary, so exactly one of the two has A or C in the middle; that one is
+// the "canonical" k-mer, and deleting the high-order bit of its middle base gives a
+// unique index from 0 to numKmers(k) / 2 - 1 shared by the pair of k-mers
+
+inline Kmer canonicalKmerIndex(KmerLength k, Kmer kmer)
+{
+   if ((kmer >> (k - 1)) & 2) // middle base is G or T
+      kmer = fastKmerReverseComplement(k, kmer);
+
+   return ((kmer >> (k + 1)) << k) | (kmer & ((1 << k) - 1));
+}
+
+inline Kmer canonicalIndexToKmer(KmerLength k, Kmer index)
+{
+   return ((index >> k) << (k + 1)) | (index & ((1 << k) - 1));
+}
+
 char *charReverseComplement(const char *s, int slen);
 
 std::string stringReverseComplement(const std::string& s);
 
+//------------------------------------------------------------------------------------
+// findKmers() finds the k-mers in a sequence and passes each one with its start index
+// to consumer.addKmer(), then calls consumer.finish() with the number of start
+// indexes; unlike KmerFinder, the consumer is a template parameter whose calls can
+// be inlined; if K is not 0, it is the value of k known at compile time, so that the
+// mask and the start index of each k-mer are constants
+
+template <class Consumer, KmerLength K = 0>
+void findKmers(const char *sequence, int sequenceLen, KmerLength k,
+	       Consumer& consumer)
+{
+   if (K > 0)
+      k = K;
+
+   const Kmer mask = numKmers(k) - 1;
+
+   Kmer kmer = 0;
+   int  len  = 0; // number of consecutive defined bases
+
+   for (int i = 0; i < sequenceLen; i++)
+   {
+      Base base = charToBase(sequence[i]);
+
+      if (base < NUM_BASES)
+      {
+         kmer = ((kmer << 2) | base) & mask;
+
+	 if (++len >= k)
+            consumer.addKmer(kmer, i - k + 1);
+      }
+      else
+         len = 0;
+   }
+
+   consumer.finish(sequenceLen >= k ? sequenceLen - k + 1 : 0);
+}
+
 //------------------------------------------------------------------------------------
 
 class KmerFinder // abstract class for finding k-mers in a sequence
@@ -1,7 +1,8 @@
 //------------------------------------------------------------------------------------
 //
 // kmerank.cpp - this program reads a reference genome file in 2-bit format, counts
-//               the k-mers in the reference genome, and produces a k-mer rank table
+//               the k-mers in the reference genome, and produces a k-mer rank table;
+//               it can also convert an existing k-mer rank table to another layout
 //
 // Author: Stephen V. Rice, Ph.D.
 //
@@ -18,9 +19,17 @@
 const std::string VERSION_NAME = "kmerank " + CURRENT_VERSION;
 
 const int DEFAULT_KMER_LENGTH  = 15;
-int k = DEFAULT_KMER_LENGTH;         // k-mer length
+const int DEFAULT_MMAP         = 0;
+const int DEFAULT_CANONICAL    = 0;
+const int DEFAULT_THREADS      = 8;
+
+int k         = DEFAULT_KMER_LENGTH; // k-mer length
+int mappable  = DEFAULT_MMAP;        // 1 = write a table that can be memory-mapped
+int canonical = DEFAULT_CANONICAL;   // 1 = write a table of canonical k-mers only
+int numThreads = DEFAULT_THREADS;    // number of threads counting and ranking k-mers
 
 std::string refGenFilename     = ""; // name of reference genome input file
+std::string rankFilename       = ""; // name of k-mer rank table input file
 std::string binaryFilename     = ""; // name of binary output file
 std::string textFilename       = ""; // name of text output file
 
@@ -42,12 +51,31 @@ void showUsage(const char *progname)
       << "  -bin=filename   "
              << "name of binary output file" << NEWLINE;
 
+   std::cerr
+      << NEWLINE
+      << "To convert an existing k-mer rank table, specify -krt instead of -ref:"
+      << NEWLINE
+      << "  -krt=filename   "
+             << "name of binary input file containing the k-mer rank table"
+	     << NEWLINE;
+
    std::cerr
       << NEWLINE
       << "The following are optional:" << NEWLINE
+      << "  -canonical=N    "
+             << "write a half-size table of canonical k-mers (1) or not (0), "
+	     << "default is " << DEFAULT_CANONICAL << NEWLINE
+      << "                  a canonical table requires odd k and is mappable"
+             << NEWLINE
       << "  -k=N            "
              << "k-mer length, default is " << DEFAULT_KMER_LENGTH
 	     << ", maximum is " << static_cast<int>(MAX_KMER_LENGTH) << NEWLINE
+      << "  -mmap=N         "
+             << "write a table fuzzion2 can memory-map (1) or not (0), default is "
+	     << DEFAULT_MMAP << NEWLINE
+      << "  -threads=N      "
+             << "number of threads counting k-mers, default is " << DEFAULT_THREADS
+	     << NEWLINE
       << "  -txt=filename   "
              << "name of text output file, default is none" << NEWLINE;
 }
@@ -72,7 +100,11 @@ bool parseArgs(int argc, char *argv[])
          return false; // incorrect option format
 
       if (intOpt(opt, "k", k) ||
+          intOpt(opt, "mmap", mappable) ||
+          intOpt(opt, "canonical", canonical) ||
+          intOpt(opt, "threads", numThreads) ||
           stringOpt(opt, "ref", refGenFilename) ||
+          stringOpt(opt, "krt", rankFilename) ||
 	  stringOpt(opt, "bin", binaryFilename) ||
 	  stringOpt(opt, "txt", textFilename))
          continue;  // this option has been recognized
@@ -80,7 +112,9 @@ bool parseArgs(int argc, char *argv[])
       return false; // unrecognized option
    }
 
-   if (k < 1 || k > MAX_KMER_LENGTH || refGenFilename == "" || binaryFilename == "")
+   if (k < 1 || k > MAX_KMER_LENGTH || (mappable != 0 && mappable != 1) ||
+       (canonical != 0 && canonical != 1) || numThreads < 1 ||
+       (refGenFilename == "") == (rankFilename == "") || binaryFilename == "")
       return false; // missing or invalid option
 
    return true;
@@ -98,9 +132,23 @@ int main(int argc, char *argv[])
 
    try
    {
-      KmerRankTable *table = createRankTable(k, refGenFilename);
-
-      table->writeBinary(binaryFilename);
+      KmerRankTable *table;
+
+      if (rankFilename == "")
+         table = createRankTable(k, refGenFilename, (canonical == 1), numThreads);
+      else
+      {
+         table = readRankTable(rankFilename);
+
+	 if (canonical == 1 && !table->canonical)
+	 {
+            KmerRankTable *fullTable = table;
+	    table = createCanonicalRankTable(fullTable);
+	    delete fullTable;
+	 }
+      }
+
+      table->writeBinary(binaryFilename, (mappable == 1));
 
       if (textFilename != "")
          table->writeText(textFilename);
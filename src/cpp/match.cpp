@@ -15,7 +15,7 @@
 
 //------------------------------------------------------------------------------------
 
-struct LocationCompare // for sorting a LocationVector
+struct LocationCompare // for sorting a CandidateVector by location
 {
    bool operator()(const Location& a, const Location& b) const
    {
@@ -48,21 +48,14 @@ struct MatchCompare // for sorting a MatchVector
 };
 
 //------------------------------------------------------------------------------------
-// lengthOfLCS() returns the length of a longest common subsequence of substrings of
-// two strings; it is a measure of similarity of these substrings
+// dynamicLCS() returns the length of a longest common subsequence of two substrings
+// using dynamic programming; it is the reference implementation, used for any
+// substrings the bit-parallel implementation does not handle; it abandons the
+// computation and returns a smaller value once the length cannot reach minMatches
 
-static int lengthOfLCS(const std::string& strA, int offsetA, int lenA,
-		       const std::string& strB, int offsetB, int lenB)
+static int dynamicLCS(const char *a, int lenA, const char *b, int lenB,
+                      int minMatches)
 {
-   if (lenA <= 0 || lenB <= 0)
-      return 0;
-
-   const char *cstrA = strA.c_str();
-   const char *cstrB = strB.c_str();
-
-   const char *a = &cstrA[offsetA];
-   const char *b = &cstrB[offsetB];
-
    int *previous = new int[lenB + 1]();
    int *current  = new int[lenB + 1]();
 
@@ -77,6 +70,9 @@ static int lengthOfLCS(const std::string& strA, int offsetA, int lenA,
       int *temp = previous;
       previous  = current;
       current   = temp;
+
+      if (previous[lenB] + (lenA - 1 - i) < minMatches)
+         break; // the remaining rows cannot add enough matches
    }
 
    int matches = previous[lenB];
@@ -87,6 +83,193 @@ static int lengthOfLCS(const std::string& strA, int offsetA, int lenA,
    return matches;
 }
 
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+// countLCS() returns the number of zero bits among the first lenB bits of v, which
+// is the LCS length represented by the bit vector
+
+template<int NumWords>
+inline int countLCS(const uint64_t *v, int lenB)
+{
+   int matches  = 0;
+   int lastBits = lenB - 64 * (NumWords - 1);
+
+   for (int w = 0; w < NumWords - 1; w++)
+      matches += __builtin_popcountll(~v[w]);
+
+   uint64_t lastMask = (lastBits == 64 ? ~static_cast<uint64_t>(0) :
+                        (static_cast<uint64_t>(1) << lastBits) - 1);
+
+   return matches + __builtin_popcountll(~v[NumWords - 1] & lastMask);
+}
+
+//------------------------------------------------------------------------------------
+// prefixLCS() returns the number of zero bits among the first numColumns bits of v,
+// which is the LCS length of the rows processed so far and those columns
+
+inline int prefixLCS(const uint64_t *v, int numColumns)
+{
+   int matches = 0, w = 0;
+
+   for ( ; numColumns >= 64; numColumns -= 64)
+      matches += __builtin_popcountll(~v[w++]);
+
+   if (numColumns > 0)
+      matches += __builtin_popcountll(~v[w] &
+                                      ((static_cast<uint64_t>(1) << numColumns) - 1));
+
+   return matches;
+}
+
+//------------------------------------------------------------------------------------
+// advanceLCS() updates bit vector v for one character of a, given the bits of the
+// columns of b that match the character
+
+template<int NumWords>
+inline void advanceLCS(uint64_t *v, const uint64_t *m)
+{
+   uint64_t carry = 0;
+
+   for (int w = 0; w < NumWords; w++)
+   {
+      uint64_t u   = v[w] & m[w];
+      uint64_t sum = v[w] + u;
+      uint64_t out = (sum < v[w]);
+
+      sum  += carry;
+      carry = out | (sum < carry);
+
+      v[w] = sum | (v[w] - u);
+   }
+}
+
+//------------------------------------------------------------------------------------
+// bitParallelLCS() returns the length of a longest common subsequence of two
+// substrings, or -1 if b has a character outside of the alphabet; a is given by the
+// LCS codes of its characters, and b must have at most 64 * NumWords characters;
+// like dynamicLCS(), it returns a value less than minMatches as soon as the length
+// cannot reach minMatches; if split is given, the LCS lengths of its sides are also
+// obtained when the whole is computed
+
+// This is the bit-vector algorithm of Allison and Dix as formulated by Hyyro: bit j
+// of V is zero where column j of the DP matrix increases, and each character of a
+// updates all of V with one addition, so the result is the number of zero bits.
+// The left side of a split is read from V once its rows are done.  The right side
+// starts with its own vector at its first row, and the columns to its left are
+// masked out of the matches so that their bits of the vector stay set.
+
+template<int NumWords>
+static int bitParallelLCS(const LcsCode *a, int lenA, const char *b, int lenB,
+                          int minMatches, LcsSplit *split)
+{
+   // the row for LCS_OTHER stays zero since such a character matches nothing in b
+   uint64_t match[LCS_ALPHABET_SIZE + 1][NumWords] = { };
+
+   for (int j = 0; j < lenB; j++)
+   {
+      LcsCode code = lcsCode(b[j]);
+      if (code == LCS_OTHER)
+         return -1;
+
+      match[code][j >> 6] |= static_cast<uint64_t>(1) << (j & 63);
+   }
+
+   uint64_t v[NumWords];
+
+   for (int w = 0; w < NumWords; w++)
+      v[w] = ~static_cast<uint64_t>(0);
+
+   int leftRow  = -1; // row completing the left side of the split, if any
+   int rightRow = lenB; // first row of the right side of the split, if any
+
+   uint64_t rightV[NumWords];
+   uint64_t rightMatch[LCS_ALPHABET_SIZE + 1][NumWords];
+
+   if (split)
+   {
+      if (split->leftLength > 0)
+         leftRow = split->leftLength - 1;
+
+      if (split->rightStart >= 0)
+      {
+         rightRow = split->rightStart;
+
+         for (int w = 0; w < NumWords; w++)
+	 {
+            int first = std::min(std::max(rightRow - 64 * w, 0), 64);
+            uint64_t mask = (first == 64 ? 0 :
+	                     ~static_cast<uint64_t>(0) << first);
+
+	    rightV[w] = ~static_cast<uint64_t>(0);
+
+            for (int code = 0; code <= LCS_ALPHABET_SIZE; code++)
+               rightMatch[code][w] = match[code][w] & mask;
+	 }
+      }
+   }
+
+   for (int i = 0; i < lenA; i++)
+   {
+      advanceLCS<NumWords>(v, match[a[i]]);
+
+      if (i == leftRow)
+         split->leftMatches = prefixLCS(v, split->leftLength);
+
+      if (i >= rightRow && i < lenB) // the right side ends at the last row of b
+         advanceLCS<NumWords>(rightV, rightMatch[a[i]]);
+
+      // every 16 rows, abandon if the remaining rows cannot add enough matches
+      if ((i & 15) == 15 && countLCS<NumWords>(v, lenB) + (lenA - 1 - i) < minMatches)
+         return 0;
+   }
+
+   if (rightRow < lenB)
+      split->rightMatches = countLCS<NumWords>(rightV, lenB);
+
+   return countLCS<NumWords>(v, lenB);
+}
+
+//------------------------------------------------------------------------------------
+// lengthOfLCS() returns the length of a longest common subsequence of a substring of
+// a read strand and a substring of a pattern sequence; it is a measure of similarity
+// of these substrings; if minMatches is specified, the result is exact only when it
+// is at least minMatches, and otherwise the computation may stop early and return
+// any smaller value; if split is given, the LCS lengths of its sides, which are
+// relative to the substrings, are obtained unless the substrings are too long for
+// the bit-parallel implementation
+
+int lengthOfLCS(const ReadStrand& read, int offsetA, int lenA,
+		const std::string& strB, int offsetB, int lenB, int minMatches,
+		LcsSplit *split)
+{
+   if (lenA <= 0 || lenB <= 0 || std::min(lenA, lenB) < minMatches)
+      return 0;
+
+   const LcsCode *codeA = &read.code[offsetA];
+   const char    *b     = strB.c_str() + offsetB;
+
+   int matches = -1;
+
+   switch ((lenB + 63) >> 6)
+   {
+      case 1: matches = bitParallelLCS<1>(codeA, lenA, b, lenB, minMatches, split);
+              break;
+      case 2: matches = bitParallelLCS<2>(codeA, lenA, b, lenB, minMatches, split);
+              break;
+      case 3: matches = bitParallelLCS<3>(codeA, lenA, b, lenB, minMatches, split);
+              break;
+      case 4: matches = bitParallelLCS<4>(codeA, lenA, b, lenB, minMatches, split);
+              break;
+      default: break; // too long for the bit-parallel implementation
+   }
+
+   if (matches >= 0)
+      return matches;
+
+   return dynamicLCS(read.sequence.c_str() + offsetA, lenA, b, lenB, minMatches);
+}
+
 //------------------------------------------------------------------------------------
 // computeMinMatches() returns the minimum number of matching bases for the given
 // sequence length
@@ -97,34 +280,24 @@ static int computeMinMatches(int seqlen, double minBases)
 }
 
 //------------------------------------------------------------------------------------
-// Candidate::setLeftRight() determines the number of overlapping and matching bases
-// on the left and right sides
+// Candidate::setOverlaps() determines the number of overlapping bases on the left and
+// right sides of the given pattern, to which the read is aligned
 
-void Candidate::setLeftRight(const std::string& sequence,
-                             const PatternVector *patternVector)
+void Candidate::setOverlaps(const Pattern& pattern)
 {
-   if (matchingBases == 0) // this is an unmatched mate
-      return;
-
-   const Pattern&     pattern   = (*patternVector)[index];
-   const std::string& psequence = pattern.sequence;
-
-   int pseqlen = psequence.length();
+   int pseqlen = pattern.sequence.length();
    int extent  = offset + length;
 
+   leftOverlap = rightOverlap = 0;
+
    if (extent <= pattern.leftBases) // full overlap of left side
    {
-      leftOverlap  = length;
-      leftMatching = matchingBases;
+      leftOverlap = length;
       return;
    }
 
    if (offset < pattern.leftBases)  // partial overlap of left side
-   {
-      leftOverlap  = pattern.leftBases - offset;
-      leftMatching = lengthOfLCS(sequence, 0, leftOverlap,
-                                 psequence, offset, leftOverlap);
-   }
+      leftOverlap = pattern.leftBases - offset;
    else; // no overlap of left side
 
    if (extent > pseqlen - pattern.rightBases)
@@ -133,16 +306,42 @@ void Candidate::setLeftRight(const std::string& sequence,
       int rightOfRight = std::max(0, extent - pseqlen);
 
       rightOverlap = length - leftOfRight - rightOfRight;
-
-      if (rightOverlap == length)   // full overlap of right side
-         rightMatching = matchingBases;
-      else                          // partial overlap of right side
-         rightMatching = lengthOfLCS(sequence, leftOfRight, rightOverlap,
-                                     psequence, offset + leftOfRight, rightOverlap);
    }
    else; // no overlap of right side
 }
 
+//------------------------------------------------------------------------------------
+// Candidate::setLeftRight() determines the number of matching bases on the left and
+// right sides, unless they were obtained when the candidate was found; the overlaps
+// have been set
+
+void Candidate::setLeftRight(const ReadStrand& read,
+                             const PatternVector *patternVector)
+{
+   if (matchingBases == 0 || sidesMatched) // this is an unmatched mate, or the
+      return;                              // matching bases are known
+
+   const std::string& psequence = (*patternVector)[index].sequence;
+
+   if (leftOverlap == length)      // full overlap of left side
+      leftMatching = matchingBases;
+   else if (leftOverlap > 0)       // partial overlap of left side
+      leftMatching = lengthOfLCS(read, 0, leftOverlap,
+                                 psequence, offset, leftOverlap);
+
+   if (rightOverlap == length)     // full overlap of right side
+      rightMatching = matchingBases;
+   else if (rightOverlap > 0)      // partial overlap of right side
+   {
+      int pcmplen     = std::min(length, static_cast<int>(psequence.length()) -
+                                         offset);
+      int leftOfRight = pcmplen - rightOverlap;
+
+      rightMatching = lengthOfLCS(read, leftOfRight, rightOverlap,
+                                  psequence, offset + leftOfRight, rightOverlap);
+   }
+}
+
 //------------------------------------------------------------------------------------
 // Candidate::setJunctionSpanning() decides whether this is a juncton-spanning read
 
@@ -195,35 +394,111 @@ int Match::insertSize() const
 }
 
 //------------------------------------------------------------------------------------
-// getLocations() extracts minimizers from a sequence, looks them up in a pattern map,
-// and obtains locations of the minimizers within patterns; only eligible patterns are
-// considered; passing NULL in the last parameter means all patterns are eligible
+// LocationCounter::clear() empties the slots in use, which is cheaper than resetting
+// the whole table when few locations were counted
 
-static void getLocations(const std::string& sequence, PatternMap *patternMap,
-                         MinimizerWindowLength w, const KmerRankTable *rankTable,
-			 Minimizer maxMinimizer, LocationVector& locationVector,
-			 BoolVector *eligiblePattern=NULL)
+void LocationCounter::clear()
+{
+   int n = entry.size();
+
+   for (int i = 0; i < n; i++)
+      table[entry[i].slot] = -1;
+
+   entry.clear();
+}
+
+//------------------------------------------------------------------------------------
+// LocationCounter::grow() doubles the number of slots in the table and re-inserts
+// the entries
+
+void LocationCounter::grow()
+{
+   const size_t MIN_SLOTS = 64;
+
+   size_t numSlots = std::max(2 * table.size(), MIN_SLOTS);
+
+   table.assign(numSlots, -1);
+
+   tableShift = 32;
+   while ((static_cast<size_t>(1) << (32 - tableShift)) < numSlots)
+      tableShift--;
+
+   uint32_t mask = numSlots - 1;
+   int n = entry.size();
+
+   for (int e = 0; e < n; e++)
+   {
+      uint32_t i = hash(entry[e].index, entry[e].offset);
+
+      while (table[i] >= 0)
+         i = (i + 1) & mask;
+
+      table[i]      = e;
+      entry[e].slot = i;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// MatchStats::add() adds the counts of another thread to these counts
+
+void MatchStats::add(const MatchStats& other)
+{
+   strands           += other.strands;
+   windows           += other.windows;
+   lookups           += other.lookups;
+   lookupHits        += other.lookupHits;
+   commonLookups     += other.commonLookups;
+   locations         += other.locations;
+   lcsTests          += other.lcsTests;
+   minMatchesRejects += other.minMatchesRejects;
+}
+
+//------------------------------------------------------------------------------------
+// getLocations() extracts minimizers from a read, looks them up in a pattern map,
+// and counts the locations of the minimizers within patterns; only eligible patterns
+// are considered; passing NULL in the last parameter means all patterns are eligible;
+// the minimizers common in the patterns are counted afterward, and only at the
+// locations found by the other minimizers, so a read of a partner gene shared by
+// many patterns adds no locations of its own
+
+static void getLocations(const ReadStrand& read, PatternMap *patternMap,
+                         MinimizerWindowLength w, WindowScheme scheme,
+			 const KmerRankTable *rankTable,
+			 Minimizer maxMinimizer, LocationCounter& locationCounter,
+			 MatchStats& stats, const BoolVector *eligiblePattern=NULL)
 {
    bool allPatternsEligible = (eligiblePattern == NULL);
+   bool haveCommon          = false; // true if a minimizer is common in patterns
 
-   WindowVector windowVector;
+   locationCounter.clear();
 
-   getWindows(sequence, w, rankTable, windowVector);
+   const WindowVector& windowVector = read.getWindows(w, rankTable, scheme);
 
    int numWindows = windowVector.size();
 
+   stats.strands++;
+   stats.windows += numWindows;
+
    for (int i = 0; i < numWindows; i++)
    {
       Minimizer minimizer = windowVector[i].minimizer;
       if (minimizer > maxMinimizer)
          continue; // ignore common minimizer
 
-      PatternMap::iterator ppos = patternMap->find(minimizer);
-      if (ppos == patternMap->end())
-         continue; // minimizer is not in map
+      const MapLocation *location;
+      int numLocations = patternMap->find(minimizer, location);
 
-      const LocationVector& location = ppos->second;
-      int numLocations = location.size();
+      stats.lookups++;
+
+      if (numLocations > 0)
+         stats.lookupHits++;
+
+      if (patternMap->commonInPatterns(numLocations))
+      {
+         stats.commonLookups++;
+	 haveCommon = true;
+	 continue; // counted below
+      }
 
       for (int j = 0; j < numLocations; j++)
       {
@@ -234,51 +509,71 @@ static void getLocations(const std::string& sequence, PatternMap *patternMap,
             // determine starting offset of pattern's matching substring
 	    int offset = std::max(0, location[j].offset - windowVector[i].offset);
 
-	    locationVector.push_back(Location(index, offset));
+	    locationCounter.add(index, offset);
 	 }
       }
    }
 
-   if (locationVector.size() > 1)
-      std::sort(locationVector.begin(), locationVector.end(), LocationCompare());
+   if (haveCommon && locationCounter.size() > 0)
+      for (int i = 0; i < numWindows; i++)
+      {
+         Minimizer minimizer = windowVector[i].minimizer;
+	 if (minimizer > maxMinimizer)
+            continue; // ignore common minimizer
+
+	 const MapLocation *location;
+	 int numLocations = patternMap->find(minimizer, location);
+
+	 if (!patternMap->commonInPatterns(numLocations))
+            continue; // counted above
+
+	 for (int j = 0; j < numLocations; j++)
+	 {
+            int index = location[j].index;
+
+	    if (allPatternsEligible || (*eligiblePattern)[index])
+	       locationCounter.addIfPresent(index,
+	                                    std::max(0, location[j].offset -
+					                windowVector[i].offset));
+	 }
+      }
+
+   stats.locations += locationCounter.size();
 }
 
 //------------------------------------------------------------------------------------
-// getCandidates() identifies candidate matches of a sequence and stores them in a
-// map; only eligible patterns are considered; passing NULL in the last parameter
-// means all patterns are eligible
+// getCandidates() identifies candidate matches of a read and stores them in a
+// vector, ordered by pattern index and offset; only eligible patterns are
+// considered; passing NULL in the last parameter means all patterns are eligible
 
-static void getCandidates(const std::string& sequence,
+static void getCandidates(const ReadStrand& read,
                           const PatternVector *patternVector, PatternMap *patternMap,
-			  MinimizerWindowLength w, const KmerRankTable *rankTable,
+			  MinimizerWindowLength w, WindowScheme scheme,
+			  const KmerRankTable *rankTable,
 			  Minimizer maxMinimizer, double minBases, int minMins,
-			  CandidateMap& cmap, BoolVector *eligiblePattern=NULL)
+			  LocationCounter& locationCounter, MatchStats& stats,
+			  CandidateVector& candidateVector,
+			  const BoolVector *eligiblePattern=NULL)
 {
-   LocationVector locationVector;
+   candidateVector.clear();
 
-   getLocations(sequence, patternMap, w, rankTable, maxMinimizer, locationVector,
-                eligiblePattern);
+   getLocations(read, patternMap, w, scheme, rankTable, maxMinimizer,
+                locationCounter, stats, eligiblePattern);
 
-   int seqlen     = sequence.length();
+   int seqlen     = read.length();
    int minMatches = computeMinMatches(seqlen, minBases);
 
-   int i = 0, numLocations = locationVector.size();
+   int numLocations = locationCounter.size();
 
-   while (i < numLocations)
+   for (int i = 0; i < numLocations; i++)
    {
-      const Location& location = locationVector[i];
-
-      int count = 1;
-
-      while (++i < numLocations &&
-             locationVector[i].index  == location.index &&
-	     locationVector[i].offset == location.offset)
-         count++;
-
-      if (count < minMins)
+      if (locationCounter.count(i) < minMins)
          continue; // not enough matching minimizers
 
-      const std::string& psequence = (*patternVector)[location.index].sequence;
+      Location location = locationCounter.location(i);
+
+      const Pattern&     pattern   = (*patternVector)[location.index];
+      const std::string& psequence = pattern.sequence;
 
       int pseqlen = psequence.length();
 
@@ -286,25 +581,58 @@ static void getCandidates(const std::string& sequence,
       // the pattern extends beyond the right end of the pattern
       int pcmplen = std::min(seqlen, pseqlen - location.offset);
 
-      int matchingBases = lengthOfLCS(sequence, 0, seqlen,
-                                      psequence, location.offset, pcmplen);
+      Candidate candidate(location, seqlen, 0);
+      candidate.setOverlaps(pattern);
 
-      if (matchingBases < minMatches)
-         continue; // not enough matching bases
+      // the sides of the junction partially overlapped by the read are aligned
+      // along with the whole read
+      LcsSplit split((candidate.leftOverlap  < seqlen ? candidate.leftOverlap : 0),
+                     (candidate.rightOverlap > 0 && candidate.rightOverlap < seqlen ?
+		      pcmplen - candidate.rightOverlap : -1));
 
-      // found a candidate; put it in the map
-      CandidateMap::iterator cpos = cmap.find(location.index);
+      candidate.matchingBases = lengthOfLCS(read, 0, seqlen,
+                                            psequence, location.offset, pcmplen,
+				            minMatches, &split);
+      stats.lcsTests++;
 
-      if (cpos == cmap.end())
+      if (candidate.matchingBases < minMatches)
       {
-         cmap.insert(std::make_pair(location.index, CandidateVector()));
-	 cpos = cmap.find(location.index);
+         stats.minMatchesRejects++;
+         continue; // not enough matching bases
       }
 
-      CandidateVector& candidateVector = cpos->second;
+      // found a candidate; the matching bases of a side fully overlapped by the read
+      // are those of the whole read
+      int whole = candidate.matchingBases;
+
+      candidate.leftMatching  = (split.leftLength > 0   ? split.leftMatches  :
+                                 candidate.leftOverlap  > 0 ? whole : 0);
+      candidate.rightMatching = (split.rightStart >= 0  ? split.rightMatches :
+                                 candidate.rightOverlap > 0 ? whole : 0);
+      candidate.sidesMatched  = (candidate.leftMatching  >= 0 &&
+                                 candidate.rightMatching >= 0);
 
-      candidateVector.push_back(Candidate(location, seqlen, matchingBases));
+      candidateVector.push_back(candidate);
    }
+
+   // the locations were counted in no particular order; order the candidates, which
+   // are far fewer than the locations, by pattern index and offset
+   if (candidateVector.size() > 1)
+      std::sort(candidateVector.begin(), candidateVector.end(), LocationCompare());
+}
+
+//------------------------------------------------------------------------------------
+// groupEnd() returns the index following the candidates that share the pattern of
+// the candidate at the given index
+
+static int groupEnd(const CandidateVector& cv, int i)
+{
+   int index = cv[i].index, n = cv.size();
+
+   while (++i < n && cv[i].index == index)
+      ;
+
+   return i;
 }
 
 //------------------------------------------------------------------------------------
@@ -312,22 +640,31 @@ static void getCandidates(const std::string& sequence,
 // false, or the best overall read-pair match, across all patterns, if bestOverall is
 // true
 
-static void getBestPair(CandidateMap& cmap1, CandidateMap& cmap2, int maxInsert,
-                        int maxTrim, bool bestOverall, MatchVector& matchVector)
+static void getBestPair(const CandidateVector& cv1, const CandidateVector& cv2,
+                        int maxInsert, int maxTrim, bool bestOverall,
+			MatchVector& matchVector)
 {
    int best = 0;
 
-   for (CandidateMap::iterator cpos1 = cmap1.begin(); cpos1 != cmap1.end(); ++cpos1)
+   int n1 = cv1.size(), n2 = cv2.size();
+   int begin2 = 0; // first candidate of the second read not yet passed over
+
+   for (int begin1 = 0, end1; begin1 < n1; begin1 = end1)
    {
-      CandidateMap::iterator cpos2 = cmap2.find(cpos1->first);
-      if (cpos2 == cmap2.end())
+      end1 = groupEnd(cv1, begin1);
+
+      int index = cv1[begin1].index;
+
+      while (begin2 < n2 && cv2[begin2].index < index)
+         begin2++;
+
+      if (begin2 == n2 || cv2[begin2].index != index)
          continue;
 
-      const CandidateVector& cv1 = cpos1->second; int n1 = cv1.size();
-      const CandidateVector& cv2 = cpos2->second; int n2 = cv2.size();
+      int end2 = groupEnd(cv2, begin2);
 
-      for (int i = 0; i < n1; i++)
-         for (int j = 0; j < n2; j++)
+      for (int i = begin1; i < end1; i++)
+         for (int j = begin2; j < end2; j++)
 	 {
             Match match(cv1[i], cv2[j]);
 
@@ -352,6 +689,8 @@ static void getBestPair(CandidateMap& cmap1, CandidateMap& cmap2, int maxInsert,
 
       if (!bestOverall && best < matchVector.size())
          best++; // advance for next pattern
+
+      begin2 = end2;
    }
 }
 
@@ -360,34 +699,35 @@ static void getBestPair(CandidateMap& cmap1, CandidateMap& cmap2, int maxInsert,
 // false, or the best overall single-read match, across all patterns, if bestOverall
 // is true
 
-static void getBestSingle(CandidateMap& cmap, bool bestOverall, bool firstRead,
-                          int mateLength, MatchVector& matchVector)
+static void getBestSingle(const CandidateVector& cv, bool bestOverall,
+                          bool firstRead, int mateLength, MatchVector& matchVector)
 {
    int best = (bestOverall ? 0 : matchVector.size());
 
-   for (CandidateMap::iterator cpos = cmap.begin(); cpos != cmap.end(); ++cpos)
+   int n = cv.size();
+
+   for (int i = 0; i < n; i++)
    {
-      const CandidateVector& cv = cpos->second; int n = cv.size();
+      if (best == matchVector.size() ||
+          cv[i].matchingBases > matchVector[best].matchingBases())
+      {
+         Location location(cv[i].index, cv[i].offset);
+	 Candidate mate(location, mateLength, 0); // unmatched mate
 
-      for (int i = 0; i < n; i++)
-         if (best == matchVector.size() ||
-             cv[i].matchingBases > matchVector[best].matchingBases())
-	 {
-            Location location(cv[i].index, cv[i].offset);
-	    Candidate mate(location, mateLength, 0); // unmatched mate
+	 const Candidate& c1 = (firstRead ? cv[i] : mate);
+	 const Candidate& c2 = (firstRead ? mate  : cv[i]);
 
-	    const Candidate& c1 = (firstRead ? cv[i] : mate);
-	    const Candidate& c2 = (firstRead ? mate  : cv[i]);
+	 Match match(c1, c2);
 
-	    Match match(c1, c2);
+	 if (best == matchVector.size())
+            matchVector.push_back(match); // save first match, best so far
+	 else
+            matchVector[best] = match;    // overwrite best match with new best
+      }
 
-	    if (best == matchVector.size())
-               matchVector.push_back(match); // save first match, best so far
-	    else
-               matchVector[best] = match;    // overwrite best match with new best
-	 }
+      bool lastOfPattern = (i + 1 == n || cv[i + 1].index != cv[i].index);
 
-      if (!bestOverall && best < matchVector.size())
+      if (!bestOverall && lastOfPattern && best < matchVector.size())
          best++; // advance for next pattern
    }
 }
@@ -396,51 +736,63 @@ static void getBestSingle(CandidateMap& cmap, bool bestOverall, bool firstRead,
 // getMatches() finds pattern matches for the given read pair and sorts them by
 // descending number of matching bases; if bestOverall is true, only the best overall
 // match is identified; if findSingle is true, single-read matches are sought when
-// there are no read-pair matches
+// there are no read-pair matches; the storage in scratch is reused
 
-void getMatches(const std::string& sequence1, const std::string& sequence2,
+void getMatches(const EncodedRead& read1, const EncodedRead& read2,
                 const PatternVector *patternVector, PatternMap *patternMap,
-		MinimizerWindowLength w, const KmerRankTable *rankTable,
+		MinimizerWindowLength w, WindowScheme scheme,
+		const KmerRankTable *rankTable,
 		Minimizer maxMinimizer, double minBases, int minMins, int maxInsert,
 		int maxTrim, bool bestOverall, bool findSingle,
-		MatchVector& matchVector)
+		MatchScratch& scratch, MatchVector& matchVector)
 {
-   CandidateMap cmap1, cmap2;
+   CandidateVector& cv1 = scratch.candidate1;
+   CandidateVector& cv2 = scratch.candidate2;
 
-   getCandidates(sequence1, patternVector, patternMap, w, rankTable, maxMinimizer,
-                 minBases, minMins, cmap1);
+   getCandidates(read1.forward, patternVector, patternMap, w, scheme,
+                 rankTable, maxMinimizer, minBases, minMins,
+		 scratch.locationCounter, scratch.stats, cv1);
 
-   if (cmap1.size() == 0 && !findSingle)
+   if (cv1.size() == 0 && !findSingle)
       return;
 
-   std::string revcomp = stringReverseComplement(sequence2);
-
    if (findSingle)
-      getCandidates(revcomp, patternVector, patternMap, w, rankTable, maxMinimizer,
-                    minBases, minMins, cmap2);
+      getCandidates(read2.reverse, patternVector, patternMap, w, scheme,
+                    rankTable, maxMinimizer, minBases, minMins,
+		    scratch.locationCounter, scratch.stats, cv2);
    else // we only need to find candidates in certain patterns
    {
-      BoolVector eligiblePattern(patternVector->size(), false);
+      BoolVector& eligiblePattern = scratch.eligiblePattern;
+
+      if (eligiblePattern.size() < patternVector->size())
+         eligiblePattern.resize(patternVector->size(), false);
+
+      int n1 = cv1.size();
+
+      for (int i = 0; i < n1; i++)
+         eligiblePattern[cv1[i].index] = true;
 
-      for (CandidateMap::iterator cpos1 = cmap1.begin();
-           cpos1 != cmap1.end(); ++cpos1)
-         eligiblePattern[cpos1->first] = true;
+      getCandidates(read2.reverse, patternVector, patternMap, w, scheme,
+                    rankTable, maxMinimizer, minBases, minMins,
+		    scratch.locationCounter, scratch.stats, cv2, &eligiblePattern);
 
-      getCandidates(revcomp, patternVector, patternMap, w, rankTable, maxMinimizer,
-                    minBases, minMins, cmap2, &eligiblePattern);
+      for (int i = 0; i < n1; i++) // reset only the entries that were set
+         eligiblePattern[cv1[i].index] = false;
    }
 
-   if (cmap1.size() > 0 && cmap2.size() > 0)
-      getBestPair(cmap1, cmap2, maxInsert, maxTrim, bestOverall, matchVector);
+   if (cv1.size() > 0 && cv2.size() > 0)
+      getBestPair(cv1, cv2, maxInsert, maxTrim, bestOverall, matchVector);
 
    if (matchVector.size() == 0 && findSingle)
    {
       // didn't find a matching read-pair; look for single-read matches
-      if (cmap1.size() > 0)
-         getBestSingle(cmap1, bestOverall, true,  sequence2.length(), matchVector);
+      if (cv1.size() > 0)
+         getBestSingle(cv1, bestOverall, true,  read2.reverse.length(),
+	               matchVector);
 
-      if (cmap2.size() > 0)
-         getBestSingle(cmap2, bestOverall, false, sequence1.length(), matchVector);
+      if (cv2.size() > 0)
+         getBestSingle(cv2, bestOverall, false, read1.forward.length(),
+	               matchVector);
    }
 
    if (matchVector.size() > 1)
@@ -451,12 +803,12 @@ void getMatches(const std::string& sequence1, const std::string& sequence2,
 // Match::validOverlaps() returns true if the given match satisfies the overlap
 // requirements
 
-bool Match::validOverlaps(const std::string& sequence1, const std::string& sequence2,
+bool Match::validOverlaps(const ReadStrand& read1, const ReadStrand& read2,
                           const PatternVector *patternVector, double minBases,
                           int minOverlap)
 {
-   c1.setLeftRight(sequence1, patternVector);
-   c2.setLeftRight(sequence2, patternVector);
+   c1.setLeftRight(read1, patternVector);
+   c2.setLeftRight(read2, patternVector);
 
    // must have sufficient overlap on the left side and on the right side
    if (std::max(c1.leftOverlap,  c2.leftOverlap)  < minOverlap ||
@@ -12,7 +12,7 @@
 #define MATCH_H
 
 #include "pattern.h"
-#include <map>
+#include "read.h"
 
 //------------------------------------------------------------------------------------
 
@@ -22,24 +22,27 @@ public:
    Candidate(const Location& location, int inLength, int inMatchingBases)
       : Location(location), length(inLength), matchingBases(inMatchingBases),
 	leftOverlap(0), leftMatching(0), rightOverlap(0), rightMatching(0),
-	junctionSpanning(false) { }
+	sidesMatched(false), junctionSpanning(false) { }
 
    virtual ~Candidate() { }
 
    int  length;                      // read length
    int  matchingBases;               // #matching bases (zero for an unmatched mate)
 
-   void setLeftRight(const std::string& sequence, const PatternVector *patternVector);
+   void setOverlaps(const Pattern& pattern);
+   void setLeftRight(const ReadStrand& read, const PatternVector *patternVector);
    int  leftOverlap,  leftMatching;  // #overlapping and matching bases on the left
    int  rightOverlap, rightMatching; // #overlapping and matching bases on the right
+   bool sidesMatched;                // true if leftMatching and rightMatching were
+                                     // obtained along with matchingBases
 
    void setJunctionSpanning(double minBases, int minOverlap);
    bool junctionSpanning;            // true if the read spans the junction
 };
 
-typedef std::vector<Candidate> CandidateVector;
-
-typedef std::map<int, CandidateVector> CandidateMap; // key is pattern index
+typedef std::vector<Candidate> CandidateVector; // the candidates of a read are
+						// ordered by pattern index and
+						// then by offset
 
 //------------------------------------------------------------------------------------
 
@@ -56,7 +59,7 @@ public:
    int numSpanning()   const;
    int insertSize()    const;
 
-   bool validOverlaps(const std::string& sequence1, const std::string& sequence2,
+   bool validOverlaps(const ReadStrand& read1, const ReadStrand& read2,
                       const PatternVector *patternVector, double minBases,
 		      int minOverlap);
 
@@ -67,11 +70,174 @@ typedef std::vector<Match> MatchVector;
 
 //------------------------------------------------------------------------------------
 
-void getMatches(const std::string& sequence1, const std::string& sequence2,
+class LocationCounter // counts the occurrences of distinct locations in an
+                      // open-addressing hash table that is reset sparsely
+{
+public:
+   LocationCounter() : tableShift(32) { }
+
+   virtual ~LocationCounter() { }
+
+   void clear(); // forgets the locations but keeps the storage
+
+   inline void add(int index, int offset)
+   {
+      if (2 * (entry.size() + 1) > table.size())
+         grow();
+
+      uint32_t mask = table.size() - 1;
+
+      for (uint32_t i = hash(index, offset); ; i = (i + 1) & mask)
+      {
+         int32_t e = table[i];
+
+	 if (e < 0) // found an empty slot; this is a new location
+	 {
+            table[i] = entry.size();
+	    entry.push_back(Entry(index, offset, i));
+	    return;
+	 }
+
+	 if (entry[e].index == index && entry[e].offset == offset)
+	 {
+            entry[e].count++;
+	    return;
+	 }
+      }
+   }
+
+   // addIfPresent() counts an occurrence of a location that has already been added,
+   // and ignores a location that has not
+   inline void addIfPresent(int index, int offset)
+   {
+      if (entry.empty())
+         return;
+
+      uint32_t mask = table.size() - 1;
+
+      for (uint32_t i = hash(index, offset); ; i = (i + 1) & mask)
+      {
+         int32_t e = table[i];
+
+	 if (e < 0)
+            return; // not a location already added
+
+	 if (entry[e].index == index && entry[e].offset == offset)
+	 {
+            entry[e].count++;
+	    return;
+	 }
+      }
+   }
+
+   // the distinct locations are numbered from 0 to size() - 1 in order of first
+   // occurrence
+   int size() const { return entry.size(); }
+
+   Location location(int i) const
+   { return Location(entry[i].index, entry[i].offset); }
+
+   int count(int i) const { return entry[i].count; }
+
+private:
+   static const uint32_t INDEX_MULTIPLIER  = 0x9E3779B1;
+   static const uint32_t OFFSET_MULTIPLIER = 0x85EBCA6B;
+
+   uint32_t hash(int index, int offset) const
+   {
+      return (static_cast<uint32_t>(index) * INDEX_MULTIPLIER ^
+              static_cast<uint32_t>(offset) * OFFSET_MULTIPLIER) >> tableShift;
+   }
+
+   void grow(); // doubles the number of slots
+
+   struct Entry
+   {
+      Entry(int inIndex, int inOffset, uint32_t inSlot)
+         : index(inIndex), offset(inOffset), count(1), slot(inSlot) { }
+
+      int      index;  // index of pattern in a PatternVector
+      int      offset; // offset within the pattern sequence
+      int      count;  // number of occurrences of the location
+      uint32_t slot;   // slot of the table holding this entry
+   };
+
+   std::vector<Entry>   entry;      // distinct locations in order of first occurrence
+   std::vector<int32_t> table;      // index into entry, or (-1) if the slot is empty
+   int                  tableShift; // 32 - log2(#slots)
+};
+
+//------------------------------------------------------------------------------------
+
+class MatchStats // counts the matching work of one thread; each thread accumulates
+                 // its own counts, which are added together at the end
+{
+public:
+   MatchStats()
+      : strands(0), windows(0), lookups(0), lookupHits(0), commonLookups(0),
+        locations(0), lcsTests(0), minMatchesRejects(0) { }
+
+   virtual ~MatchStats() { }
+
+   void add(const MatchStats& other);
+
+   uint64_t strands;           // read strands whose minimizers were looked up
+   uint64_t windows;           // minimizer windows of those strands
+   uint64_t lookups;           // PatternMap lookups of uncommon minimizers
+   uint64_t lookupHits;        // lookups that found at least one location
+   uint64_t commonLookups;     // lookup hits of minimizers common in the patterns
+   uint64_t locations;         // distinct pattern locations of the strands
+   uint64_t lcsTests;          // candidates tested with lengthOfLCS()
+   uint64_t minMatchesRejects; // tested candidates with too few matching bases
+};
+
+//------------------------------------------------------------------------------------
+
+class MatchScratch // storage reused by one thread for every read pair it matches, so
+                   // that no memory is allocated once the vectors have grown
+{
+public:
+   MatchScratch() { }
+
+   virtual ~MatchScratch() { }
+
+   LocationCounter locationCounter; // locations of the minimizers of a strand
+   CandidateVector candidate1;      // candidates of the first read
+   CandidateVector candidate2;      // candidates of the second read
+   BoolVector      eligiblePattern; // indexed by pattern; all false between calls
+   MatchVector     matchVector;     // matches of the read pair, for the caller
+   MatchStats      stats;           // counts of the work done by getMatches()
+};
+
+//------------------------------------------------------------------------------------
+
+struct LcsSplit // requests the LCS lengths of the two sides of a junction, obtained
+		// while computing the LCS of the whole substrings
+{
+   LcsSplit(int inLeftLength, int inRightStart)
+      : leftLength(inLeftLength), rightStart(inRightStart), leftMatches(-1),
+	rightMatches(-1) { }
+
+   int leftLength;   // the left side is the first leftLength characters of a and b,
+                     // or there is no left side if zero
+   int rightStart;   // the right side runs from rightStart to the end of both a and
+                     // b, or there is no right side if negative
+   int leftMatches;  // LCS length of the left side, or (-1) if not obtained
+   int rightMatches; // LCS length of the right side, or (-1) if not obtained
+};
+
+//------------------------------------------------------------------------------------
+
+int lengthOfLCS(const ReadStrand& read, int offsetA, int lenA,
+		const std::string& strB, int offsetB, int lenB, int minMatches=0,
+		LcsSplit *split=NULL);
+
+void getMatches(const EncodedRead& read1, const EncodedRead& read2,
                 const PatternVector *patternVector, PatternMap *patternMap,
-		MinimizerWindowLength w, const KmerRankTable *rankTable,
+		MinimizerWindowLength w, WindowScheme scheme,
+		const KmerRankTable *rankTable,
 		Minimizer maxMinimizer, double minBases, int minMins, int maxInsert,
 		int maxTrim, bool bestOverall, bool findSingle,
-		MatchVector& matchVector);
+		MatchScratch& scratch, MatchVector& matchVector);
 
 #endif
@@ -21,8 +21,209 @@ typedef uint8_t MinimizerWindowLength;
 inline int minimizerWindowID(int startIndex, MinimizerWindowLength windowLen)
 { return startIndex / windowLen; }
 
+enum WindowScheme // how the k-mers of a sequence are grouped to select minimizers
+{
+   FIXED_WINDOWS,  // consecutive blocks of w start indexes sharing a minimizerWindowID
+   SLIDING_WINDOWS // every run of w consecutive start indexes (classic minimizers)
+};
+
+//------------------------------------------------------------------------------------
+// The engines below find minimizers without virtual calls: Hash is a function object
+// giving the hash of a k-mer, and Sink is a function object called with each
+// minimizer and the start index of its k-mer; both are template parameters so the
+// compiler can inline them.  An engine is given the k-mers of a sequence in
+// increasing order of start index by addKmer(), skipping start indexes having no
+// k-mer, and then finish() is called with the number of start indexes; the engine
+// may then be reused for another sequence.  If the template parameter W is not 0,
+// it is the window length, known at compile time, which must equal the windowLen
+// given to the constructor; the window boundaries are then constants that the
+// compiler can fold, and W is 0 for the generic engine taking any window length.
+
+struct RankHash // hashes a k-mer to its rank
+{
+   RankHash(const KmerRankTable *rankTable) : table(rankTable) { }
+
+   KmerHash operator()(Kmer kmer) const { return table->getRank(kmer); }
+
+   const KmerRankTable *table;
+};
+
 //------------------------------------------------------------------------------------
 
+template <class Hash, class Sink, MinimizerWindowLength W = 0>
+class FixedMinimizerEngine // reports the minimizer of each block of w start indexes;
+			   // the minimizers are those found by MinimizerFinder
+{
+public:
+   FixedMinimizerEngine(MinimizerWindowLength windowLen, const Hash& inHash,
+		        Sink& inSink)
+      : w(windowLen), hash(inHash), sink(inSink), windowEnd(0), currentMinimizer(0),
+	currentStartIndex(-1) { }
+
+   virtual ~FixedMinimizerEngine() { }
+
+   void addKmer(Kmer kmer, int startIndex)
+   {
+      KmerHash kmerHash = hash(kmer);
+
+      if (startIndex >= windowEnd) // this is the first k-mer of a new window
+      {
+         if (currentStartIndex >= 0)
+            sink(currentMinimizer, currentStartIndex);
+
+	 windowEnd         = (minimizerWindowID(startIndex, width()) + 1) * width();
+	 currentMinimizer  = kmerHash;
+	 currentStartIndex = startIndex;
+      }
+      else if (kmerHash < currentMinimizer)
+      {
+         currentMinimizer  = kmerHash;
+	 currentStartIndex = startIndex;
+      }
+   }
+
+   void finish(int numStarts)
+   {
+      if (currentStartIndex >= 0) // report final minimizer
+         sink(currentMinimizer, currentStartIndex);
+
+      windowEnd         = 0;
+      currentStartIndex = -1;
+   }
+
+private:
+   MinimizerWindowLength width() const { return (W > 0 ? W : w); }
+
+   MinimizerWindowLength w; // number of start indexes in each window
+   Hash  hash;
+   Sink& sink;
+   int windowEnd;              // start index following the current window
+   Minimizer currentMinimizer; // minimum hash found so far in the current window
+   int currentStartIndex;      // start index of the k-mer having the minimum hash,
+			       // or (-1) if no k-mer has been found in the window
+};
+
+//------------------------------------------------------------------------------------
+
+template <class Hash, class Sink, MinimizerWindowLength W = 0>
+class SlidingMinimizerEngine // reports the minimizer of every run of w consecutive
+			     // start indexes, once per distinct minimizing k-mer
+{
+public:
+   SlidingMinimizerEngine(MinimizerWindowLength windowLen, const Hash& inHash,
+		          Sink& inSink)
+      : w(windowLen), hash(inHash), sink(inSink), head(0), tail(0), nextStart(0),
+	lastReported(-1) { }
+
+   virtual ~SlidingMinimizerEngine() { }
+
+   void addKmer(Kmer kmer, int startIndex)
+   {
+      advance(startIndex);
+
+      KmerHash kmerHash = hash(kmer);
+
+      // a k-mer cannot be the minimizer of any window that includes this k-mer
+      // and has a smaller hash, so discard it; ties favor the leftmost k-mer
+      while (tail != head && queue[(tail - 1) & QUEUE_MASK].hash > kmerHash)
+         tail--;
+
+      queue[tail & QUEUE_MASK].hash       = kmerHash;
+      queue[tail & QUEUE_MASK].startIndex = startIndex;
+      tail++;
+
+      endWindow(startIndex);
+
+      nextStart = startIndex + 1;
+   }
+
+   void finish(int numStarts)
+   {
+      advance(numStarts);
+
+      // a sequence having fewer than w start indexes forms a single window
+      if (lastReported < 0 && head != tail)
+         sink(queue[head & QUEUE_MASK].hash, queue[head & QUEUE_MASK].startIndex);
+
+      head = tail = nextStart = 0;
+      lastReported = -1;
+   }
+
+private:
+   // endWindow() drops k-mers that precede the window ending at start index i and
+   // reports the minimizer of the window if it differs from the one last reported
+   void endWindow(int i)
+   {
+      while (head != tail && queue[head & QUEUE_MASK].startIndex <= i - width())
+         head++;
+
+      if (i >= width() - 1 && head != tail &&
+          queue[head & QUEUE_MASK].startIndex != lastReported)
+      {
+         lastReported = queue[head & QUEUE_MASK].startIndex;
+	 sink(queue[head & QUEUE_MASK].hash, lastReported);
+      }
+   }
+
+   // advance() ends the windows at the start indexes before i having no k-mer;
+   // once the queue is empty, those windows have no minimizer
+   void advance(int i)
+   {
+      for (int j = nextStart; j < i && head != tail; j++)
+         endWindow(j);
+
+      nextStart = i;
+   }
+
+   MinimizerWindowLength width() const { return (W > 0 ? W : w); }
+
+   static const unsigned QUEUE_SIZE = 256; // holds up to w + 1 k-mers
+   static const unsigned QUEUE_MASK = QUEUE_SIZE - 1;
+
+   struct Entry
+   {
+      KmerHash hash;
+      int      startIndex;
+   };
+
+   MinimizerWindowLength w; // number of start indexes in each window
+   Hash  hash;
+   Sink& sink;
+   Entry queue[QUEUE_SIZE]; // monotone deque: hashes increase from head to tail
+   unsigned head, tail;     // queue positions, taken modulo QUEUE_SIZE
+   int nextStart;           // start index following the last one processed
+   int lastReported;        // start index of the minimizer last reported, or (-1)
+};
+
+//------------------------------------------------------------------------------------
+// findMinimizers() finds the minimizers of a sequence of characters using the
+// engine of the given scheme and passes them to sink; if K or W is not 0, it is the
+// value of k or w known at compile time
+
+template <class Hash, class Sink, KmerLength K = 0, MinimizerWindowLength W = 0>
+void findMinimizers(const char *sequence, int sequenceLen, KmerLength k,
+		    MinimizerWindowLength w, WindowScheme scheme, const Hash& hash,
+		    Sink& sink)
+{
+   if (scheme == SLIDING_WINDOWS)
+   {
+      SlidingMinimizerEngine<Hash, Sink, W> engine(w, hash, sink);
+      findKmers<SlidingMinimizerEngine<Hash, Sink, W>, K>(sequence, sequenceLen, k,
+                                                           engine);
+   }
+   else
+   {
+      FixedMinimizerEngine<Hash, Sink, W> engine(w, hash, sink);
+      findKmers<FixedMinimizerEngine<Hash, Sink, W>, K>(sequence, sequenceLen, k,
+                                                         engine);
+   }
+}
+
+//------------------------------------------------------------------------------------
+
+// MinimizerFinder and RankMinimizerFinder are virtual adapters of the fixed-window
+// scheme for tools that override their functions
+
 class MinimizerFinder : public KmerFinder // abstract class for finding minimizers
 			                  // in a sequence
 {
@@ -65,7 +266,7 @@ public:
 
    virtual ~RankMinimizerFinder() { }
 
-   virtual KmerHash hash(Kmer kmer) { return table->rank[kmer]; }
+   virtual KmerHash hash(Kmer kmer) { return table->getRank(kmer); }
 
    // override this function to do whatever you want with each rank minimizer found;
    // return true to continue, false to discontinue the search
@@ -0,0 +1,134 @@
+//------------------------------------------------------------------------------------
+//
+// numa.cpp - module for placing threads and memory on the NUMA nodes of a machine
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "numa.h"
+#include <fstream>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const std::string NODE_DIRECTORY = "/sys/devices/system/node/";
+
+// these are the values of <numaif.h>, which is not needed for a plain system call
+const int MPOL_INTERLEAVE_MODE = 3;      // pages are spread across the given nodes
+const int MPOL_MF_MOVE_FLAG    = 1 << 1; // pages already in memory are moved
+
+const int MAX_NODE_ID = 1023; // highest node ID that can be placed in a node mask
+
+//------------------------------------------------------------------------------------
+// readList() reads the first line of the named file, which is a list of numbers and
+// ranges such as "0-3,8,10-11" as written by the kernel, into the given vector; false
+// is returned if the file cannot be read or the list is invalid
+
+static bool readList(const std::string& filename, IntVector& list)
+{
+   std::ifstream infile(filename.c_str());
+   std::string line;
+
+   list.clear();
+
+   if (!infile.is_open() || !getline(infile, line))
+      return false;
+
+   StringVector item;
+   int numItems = splitString(line, item, ',');
+
+   for (int i = 0; i < numItems; i++)
+   {
+      StringVector bound;
+      int numBounds = splitString(item[i], bound, '-');
+
+      if (numBounds < 1 || numBounds > 2)
+         return false;
+
+      int first = stringToNonnegInt(bound[0]);
+      int last  = (numBounds == 2 ? stringToNonnegInt(bound[1]) : first);
+
+      if (first < 0 || last < first)
+         return false;
+
+      for (int n = first; n <= last; n++)
+         list.push_back(n);
+   }
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// NumaTopology::NumaTopology() reads the online nodes and the CPUs of each node
+
+NumaTopology::NumaTopology() : nodeID(), nodeCpu()
+{
+   IntVector online;
+
+   if (readList(NODE_DIRECTORY + "online", online))
+      for (size_t i = 0; i < online.size(); i++)
+      {
+         IntVector cpu;
+	 std::string filename = NODE_DIRECTORY + "node" + intToString(online[i]) +
+	                        "/cpulist";
+
+	 if (online[i] <= MAX_NODE_ID && readList(filename, cpu) && !cpu.empty())
+	 {
+            nodeID.push_back(online[i]);
+	    nodeCpu.push_back(cpu);
+	 }
+      }
+
+   if (nodeID.empty())
+   {
+      nodeID.push_back(0);
+      nodeCpu.push_back(IntVector());
+   }
+}
+
+//------------------------------------------------------------------------------------
+// NumaTopology::bindThread() binds the calling thread to the CPUs of the ith node; if
+// the CPUs of the node are unknown, the thread is left as it is and false is returned
+
+bool NumaTopology::bindThread(int i) const
+{
+   const IntVector& cpu = nodeCpu[i];
+
+   if (cpu.empty())
+      return false;
+
+   cpu_set_t set;
+   CPU_ZERO(&set);
+
+   for (size_t j = 0; j < cpu.size(); j++)
+      if (cpu[j] < CPU_SETSIZE)
+         CPU_SET(cpu[j], &set);
+
+   return (sched_setaffinity(0, sizeof(set), &set) == 0); // 0 is the calling thread
+}
+
+//------------------------------------------------------------------------------------
+// NumaTopology::interleave() sets the memory policy of the given page-aligned memory
+// so that its pages are interleaved across the nodes, and moves the pages already in
+// memory accordingly; this is advisory, and false is returned if it is not done
+
+bool NumaTopology::interleave(void *address, uint64_t length) const
+{
+#ifdef SYS_mbind
+   const int BITS = 8 * sizeof(unsigned long);
+
+   unsigned long mask[(MAX_NODE_ID + 1) / BITS] = { 0 };
+
+   for (int i = 0; i < numNodes(); i++)
+      mask[nodeID[i] / BITS] |= 1UL << (nodeID[i] % BITS);
+
+   // the kernel reads one less than the given number of bits of the node mask
+   return (syscall(SYS_mbind, address, length, MPOL_INTERLEAVE_MODE, mask,
+                   MAX_NODE_ID + 2, MPOL_MF_MOVE_FLAG) == 0);
+#else
+   return false;
+#endif
+}
@@ -0,0 +1,40 @@
+//------------------------------------------------------------------------------------
+//
+// numa.h - module for placing threads and memory on the NUMA nodes of a machine
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include "util.h"
+
+//------------------------------------------------------------------------------------
+
+class NumaTopology // the NUMA nodes of the machine and the CPUs of each node
+{
+public:
+   NumaTopology(); // reads the topology from /sys; a machine that does not describe
+                   // its nodes is treated as one node without a list of CPUs
+
+   virtual ~NumaTopology() { }
+
+   int numNodes() const { return nodeID.size(); }
+
+   // bindThread() binds the calling thread to the CPUs of the ith node and returns
+   // true if successful
+   bool bindThread(int i) const;
+
+   // interleave() spreads the pages of the given memory evenly across the nodes,
+   // moving the pages already in memory, and returns true if successful
+   bool interleave(void *address, uint64_t length) const;
+
+   IntVector              nodeID;  // ID of each node
+   std::vector<IntVector> nodeCpu; // CPUs of each node
+};
+
+#endif
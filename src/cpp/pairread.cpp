@@ -12,6 +12,40 @@
 #include <cstring>
 #include <stdexcept>
 
+//------------------------------------------------------------------------------------
+// PairReader::addNextPair() gets the next read pair and adds it to the batch, or
+// returns false at end of input
+
+bool PairReader::addNextPair(ReadBatch& batch)
+{
+   if (!getNextPair(name1, sequence1, name2, sequence2))
+      return false;
+
+   batch.add(name1, sequence1, name2, sequence2);
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// PairReader::skipNextPair() gets the next read pair and discards it, or returns false
+// at end of input
+
+bool PairReader::skipNextPair()
+{
+   return getNextPair(name1, sequence1, name2, sequence2);
+}
+
+//------------------------------------------------------------------------------------
+// InputReader::~InputReader() de-allocates the pair readers, which were allocated by
+// the creator of this object
+
+InputReader::~InputReader()
+{
+   int numReaders = readerVector.size();
+
+   for (int i = 0; i < numReaders; i++)
+      delete readerVector[i];
+}
+
 //------------------------------------------------------------------------------------
 // InputReader::open() opens the first pair reader
 
@@ -42,20 +76,84 @@ bool InputReader::getNextPair(std::string& name1, std::string& sequence1,
       return false;
 
    while (!readerVector[current]->getNextPair(name1, sequence1, name2, sequence2))
-      if (current + 1 < numReaders)
-      {
-         readerVector[current]->close();
-	 readerVector[++current]->open();
-      }
-      else
-      {
-         close();
-	 return false;
-      }
+      if (!advance())
+         return false;
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// InputReader::addNextPair() adds the next pair of reads in the series of files to
+// the batch, like InputReader::getNextPair()
+
+bool InputReader::addNextPair(ReadBatch& batch)
+{
+   int numReaders = readerVector.size();
+
+   if (current < 0 || current >= numReaders)
+      return false;
+
+   while (!readerVector[current]->addNextPair(batch))
+      if (!advance())
+         return false;
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// InputReader::skipNextPair() passes over the next pair of reads in the series of
+// files, like InputReader::getNextPair()
+
+bool InputReader::skipNextPair()
+{
+   int numReaders = readerVector.size();
+
+   if (current < 0 || current >= numReaders)
+      return false;
+
+   while (!readerVector[current]->skipNextPair())
+      if (!advance())
+         return false;
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// InputReader::selectShard() restricts each file in the series to shard i of N; a
+// file whose reader cannot select the shard itself has its read pairs dealt to the
+// shards in chunks
+
+bool InputReader::selectShard(int shard, int numShards)
+{
+   int numReaders = readerVector.size();
+
+   for (int i = 0; i < numReaders; i++)
+      if (!readerVector[i]->selectShard(shard, numShards))
+         readerVector[i] = new ShardPairReader(readerVector[i], shard, numShards);
 
    return true;
 }
 
+//------------------------------------------------------------------------------------
+// InputReader::advance() closes the current reader and opens the next one; if there
+// are no more readers, everything is closed and false is returned
+
+bool InputReader::advance()
+{
+   int numReaders = readerVector.size();
+
+   if (current + 1 < numReaders)
+   {
+      readerVector[current]->close();
+      readerVector[++current]->open();
+
+      return true;
+   }
+
+   close();
+   return false;
+}
+
 //------------------------------------------------------------------------------------
 // InputReader::close() closes the currently open pair reader
 
@@ -67,6 +165,51 @@ void InputReader::close()
    current = -1;
 }
 
+//------------------------------------------------------------------------------------
+// ShardPairReader::skipToShard() skips the read pairs that belong to other shards and
+// returns true if the next read pair belongs to this shard, or returns false at end
+// of input
+
+bool ShardPairReader::skipToShard()
+{
+   while (static_cast<int>((ordinal / SHARD_CHUNK_SIZE) % numShards) != shard)
+   {
+      if (!reader->skipNextPair())
+         return false;
+
+      ordinal++;
+   }
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// ShardPairReader::getNextPair() gets the next read pair of this shard and returns
+// true, or returns false at end of input
+
+bool ShardPairReader::getNextPair(std::string& name1, std::string& sequence1,
+                                  std::string& name2, std::string& sequence2)
+{
+   if (!skipToShard() || !reader->getNextPair(name1, sequence1, name2, sequence2))
+      return false;
+
+   ordinal++;
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// ShardPairReader::addNextPair() adds the next read pair of this shard to the batch
+// and returns true, or returns false at end of input
+
+bool ShardPairReader::addNextPair(ReadBatch& batch)
+{
+   if (!skipToShard() || !reader->addNextPair(batch))
+      return false;
+
+   ordinal++;
+   return true;
+}
+
 //------------------------------------------------------------------------------------
 // namesMatch() returns true if the given read names match
 
@@ -85,3 +228,28 @@ bool namesMatch(const std::string& name1, const std::string& name2)
 
    return (name1 == name2);
 }
+
+//------------------------------------------------------------------------------------
+// pairPhase() returns 0 if consecutive reads having the given names are paired from
+// the first read, 1 if they are paired from the second read, or -1 if neither; atEnd
+// is true if the last name is that of the last read of the input, which ends a pair;
+// several names are needed because namesMatch() accepts names that differ only in a
+// final "1" and "2", as the second read of one pair and the first of the next may
+
+int pairPhase(const std::vector<std::string>& name, bool atEnd)
+{
+   int n = name.size();
+
+   for (int phase = 0; phase < 2; phase++)
+   {
+      bool paired = !(atEnd && (n - phase) % 2 != 0);
+
+      for (int i = phase; paired && i + 1 < n; i += 2)
+         paired = namesMatch(name[i], name[i + 1]);
+
+      if (paired)
+         return phase;
+   }
+
+   return -1;
+}
@@ -11,9 +11,14 @@
 #ifndef PAIRREAD_H
 #define PAIRREAD_H
 
+#include "batch.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
+const int SHARD_CHUNK_SIZE = 1 << 16; // consecutive read pairs given to one shard
+const int SYNC_NAMES       = 7;       // consecutive read names examined by pairPhase()
+
 //------------------------------------------------------------------------------------
 
 class PairReader // abstract class for getting paired reads
@@ -28,7 +33,24 @@ public:
    virtual bool getNextPair(std::string& name1, std::string& sequence1,
                             std::string& name2, std::string& sequence2) = 0;
 
+   // addNextPair() adds the next read pair to the batch and returns true, or returns
+   // false at end of input; a reader may override it to decode straight into the
+   // arena of the batch
+   virtual bool addNextPair(ReadBatch& batch);
+
+   // skipNextPair() passes over the next read pair and returns true, or returns false
+   // at end of input; a reader may override it to avoid decoding the pair
+   virtual bool skipNextPair();
+
+   // selectShard() restricts the reader, before it is opened, to the read pairs in
+   // shard i of N (numbered from 0) of its input and returns true; it returns false
+   // if the reader cannot locate the shard without reading the whole input
+   virtual bool selectShard(int /*shard*/, int /*numShards*/) { return false; }
+
    virtual void close() = 0;
+
+private:
+   std::string name1, sequence1, name2, sequence2; // reused by addNextPair()
 };
 
 typedef std::vector<PairReader *> PairReaderVector;
@@ -41,21 +63,65 @@ public:
    InputReader(const PairReaderVector& inReaderVector)
       : readerVector(inReaderVector), current(-1) { }
 
-   virtual ~InputReader() { }
+   virtual ~InputReader(); // de-allocates the pair readers
 
    void open();
 
    bool getNextPair(std::string& name1, std::string& sequence1,
                     std::string& name2, std::string& sequence2);
 
+   bool addNextPair(ReadBatch& batch);
+   bool skipNextPair();
+
+   bool selectShard(int shard, int numShards);
+
    void close();
 
    PairReaderVector readerVector;
    int current; // index into readerVector of open reader, or -1 if none
+
+private:
+   bool advance(); // opens the next reader, or returns false if there is none
+};
+
+//------------------------------------------------------------------------------------
+
+// this gets the read pairs of shard i of N from a pair reader that cannot select a
+// shard itself: the pairs are taken in chunks of SHARD_CHUNK_SIZE, and chunk c
+// belongs to shard c % N, so the N shards together cover every pair exactly once,
+// but each shard reads the whole input
+
+class ShardPairReader : public PairReader
+{
+public:
+   ShardPairReader(PairReader *inReader, int inShard, int inNumShards)
+      : reader(inReader), shard(inShard), numShards(inNumShards), ordinal(0) { }
+
+   virtual ~ShardPairReader() { delete reader; }
+
+   void open() { reader->open(); ordinal = 0; }
+
+   bool getNextPair(std::string& name1, std::string& sequence1,
+                    std::string& name2, std::string& sequence2);
+
+   bool addNextPair(ReadBatch& batch);
+
+   void close() { reader->close(); }
+
+   PairReader *reader; // owned by this object
+
+private:
+   bool skipToShard(); // skips the pairs of other shards, or returns false at end
+
+   int      shard;     // 0-based index of this shard
+   int      numShards;
+   uint64_t ordinal;   // 0-based position in the input of the next read pair
 };
 
 //------------------------------------------------------------------------------------
 
 bool namesMatch(const std::string& name1, const std::string& name2);
 
+int pairPhase(const std::vector<std::string>& name, bool atEnd);
+
 #endif
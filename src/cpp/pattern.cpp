@@ -10,8 +10,10 @@
 
 #include "pattern.h"
 #include "window.h"
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
+#include <sys/mman.h>
 
 const std::string PATTERN_HEADING  = "pattern";
 const std::string SEQUENCE_HEADING = "sequence";
@@ -121,6 +123,108 @@ PatternVector *readPatterns(const std::string& filename,
    return patternVector;
 }
 
+//------------------------------------------------------------------------------------
+
+struct StagedCompare // for sorting the locations staged in a PatternMap
+{
+   bool operator()(const std::pair<Minimizer, Location>& a,
+                   const std::pair<Minimizer, Location>& b) const
+   {
+      return a.first < b.first; // sort by ascending minimizer
+   }
+};
+
+//------------------------------------------------------------------------------------
+// log2Ceiling() returns the smallest b such that 2^b >= n
+
+static int log2Ceiling(size_t n)
+{
+   int b = 0;
+
+   while ((static_cast<size_t>(1) << b) < n)
+      b++;
+
+   return b;
+}
+
+//------------------------------------------------------------------------------------
+// PatternMap::~PatternMap() unmaps the pattern index file, if any
+
+PatternMap::~PatternMap()
+{
+   if (mapAddress)
+      munmap(mapAddress, mapLength);
+}
+
+//------------------------------------------------------------------------------------
+// PatternMap::freeze() groups the added locations by minimizer and builds the hash
+// table and the bitset; the table is at most half full, and the bitset has at least
+// 16 bits per minimizer, so a minimizer not in the map passes the bitset with
+// probability 1/16 or less
+
+void PatternMap::freeze()
+{
+   // a stable sort keeps the locations of each minimizer in the order added
+   std::stable_sort(staged.begin(), staged.end(), StagedCompare());
+
+   numKeys = 0;
+   int numStaged = staged.size();
+
+   for (int i = 0; i < numStaged; i++)
+      if (i == 0 || staged[i].first != staged[i - 1].first)
+         numKeys++;
+
+   int tableBits  = std::max(log2Ceiling(2 * numKeys), 1);
+   int filterBits = std::max(log2Ceiling(16 * numKeys), 6);
+
+   if (tableBits > 31 || filterBits > 32)
+      throw std::runtime_error("too many minimizers in patterns");
+
+   tableShift  = 32 - tableBits;
+   filterShift = 32 - filterBits;
+
+   Slot empty = { 0, 0, 0 };
+   slot.assign(static_cast<size_t>(1) << tableBits, empty);
+
+   filter.assign((static_cast<size_t>(1) << filterBits) >> 6, 0);
+
+   location.clear();
+   location.reserve(numStaged);
+
+   uint32_t mask = slot.size() - 1;
+
+   for (int i = 0; i < numStaged; )
+   {
+      Minimizer minimizer = staged[i].first;
+      uint32_t  start     = location.size();
+
+      for ( ; i < numStaged && staged[i].first == minimizer; i++)
+      {
+         MapLocation mapLocation = { staged[i].second.index,
+	                             staged[i].second.offset };
+	 location.push_back(mapLocation);
+      }
+
+      uint32_t j = (minimizer * TABLE_MULTIPLIER) >> tableShift;
+      while (slot[j].count != 0)
+         j = (j + 1) & mask;
+
+      slot[j].key   = minimizer;
+      slot[j].start = start;
+      slot[j].count = location.size() - start;
+
+      uint32_t f = (minimizer * FILTER_MULTIPLIER) >> filterShift;
+      filter[f >> 6] |= static_cast<uint64_t>(1) << (f & 63);
+   }
+
+   std::vector<std::pair<Minimizer, Location> >().swap(staged); // release memory
+
+   numSlots     = slot.size();
+   slotData     = &slot[0];
+   filterData   = &filter[0];
+   locationData = (location.size() > 0 ? &location[0] : NULL);
+}
+
 //------------------------------------------------------------------------------------
 // createPatternMap() returns a map constructed from the given pattern vector; it is
 // the caller's obligation to de-allocate it
@@ -128,17 +232,20 @@ PatternVector *readPatterns(const std::string& filename,
 PatternMap *createPatternMap(const PatternVector *patternVector,
                              MinimizerWindowLength w,
 			     const KmerRankTable *rankTable,
-			     Minimizer maxMinimizer)
+			     Minimizer maxMinimizer, WindowScheme scheme)
 {
    PatternMap *patternMap = new PatternMap();
 
    int numPatterns = patternVector->size();
 
+   WindowVector windowVector; // reused for each pattern
+
    for (int i = 0; i < numPatterns; i++)
    {
-      WindowVector windowVector;
+      windowVector.clear();
 
-      getWindows((*patternVector)[i].sequence, w, rankTable, windowVector);
+      getWindows((*patternVector)[i].sequence, w, rankTable, windowVector,
+                 scheme);
 
       int numWindows = windowVector.size();
 
@@ -148,19 +255,11 @@ PatternMap *createPatternMap(const PatternVector *patternVector,
 	 if (minimizer > maxMinimizer)
             continue; // don't put common minimizer in map
 
-	 PatternMap::iterator ppos = patternMap->find(minimizer);
-
-	 if (ppos == patternMap->end())
-	 {
-            patternMap->insert(std::make_pair(minimizer, LocationVector()));
-	    ppos = patternMap->find(minimizer);
-	 }
-
-	 LocationVector& locationVector = ppos->second;
-
-	 locationVector.push_back(Location(i, windowVector[j].offset));
+	 patternMap->add(minimizer, Location(i, windowVector[j].offset));
       }
    }
 
+   patternMap->freeze();
+
    return patternMap;
 }
@@ -13,7 +13,8 @@
 
 #include "minimizer.h"
 #include "util.h"
-#include <unordered_map>
+#include <cstdint>
+#include <vector>
 
 //------------------------------------------------------------------------------------
 
@@ -57,8 +58,110 @@ public:
 
 typedef std::vector<Location> LocationVector;
 
-// this maps a minimizer to locations of the minimizer in patterns
-typedef std::unordered_map<Minimizer, LocationVector> PatternMap;
+struct MapLocation // a location as stored in a PatternMap, which may reside in a
+		   // memory-mapped pattern index file
+{
+   int32_t index;  // index of pattern in a PatternVector
+   int32_t offset; // offset within the pattern sequence
+};
+
+struct PatternIndexKey; // defined in index.h
+
+// this maps a minimizer to locations of the minimizer in patterns; after all of the
+// locations have been added, freeze() stores them in one contiguous array indexed by
+// an open-addressing hash table, and a bitset in front of the table quickly rejects
+// nearly all of the minimizers that are not in the map; alternatively, the frozen
+// arrays are found in a memory-mapped pattern index file; a minimizer having more
+// than maxLocations locations, such as one in a partner gene shared by many fusion
+// patterns, is common in the patterns: its locations are counted toward minMins but
+// never make a candidate alone
+
+class PatternMap
+{
+public:
+   PatternMap()
+      : maxLocations(0), numKeys(0), tableShift(32), filterShift(32), numSlots(0),
+	slotData(NULL), filterData(NULL), locationData(NULL), mapAddress(NULL),
+	mapLength(0) { }
+
+   virtual ~PatternMap(); // unmaps the pattern index file, if any
+
+   // call add() for each location, then call freeze() before calling find()
+   void add(Minimizer minimizer, const Location& location)
+   { staged.push_back(std::make_pair(minimizer, location)); }
+
+   void freeze();
+
+   // find() returns the number of locations of the minimizer and sets first to point
+   // to the first of them
+   inline int find(Minimizer minimizer, const MapLocation *&first) const
+   {
+      uint32_t f = (minimizer * FILTER_MULTIPLIER) >> filterShift;
+      if (!((filterData[f >> 6] >> (f & 63)) & 1))
+         return 0; // minimizer is not in map
+
+      uint32_t mask = numSlots - 1;
+
+      for (uint32_t i = (minimizer * TABLE_MULTIPLIER) >> tableShift; ;
+           i = (i + 1) & mask)
+      {
+         const Slot& s = slotData[i];
+         if (s.count == 0)
+	    return 0; // minimizer is not in map
+
+	 if (s.key == minimizer)
+	 {
+            first = &locationData[s.start];
+	    return s.count;
+	 }
+      }
+   }
+
+   size_t size() const { return numKeys; } // number of distinct minimizers
+
+   // commonInPatterns() returns true if a minimizer having the given number of
+   // locations is common in the patterns
+   bool commonInPatterns(int numLocations) const
+   { return (maxLocations > 0 && numLocations > maxLocations); }
+
+   int maxLocations; // locations of a minimizer not common in the patterns, or 0 if
+                     // no minimizer is common in the patterns
+
+private:
+   static const uint32_t TABLE_MULTIPLIER  = 0x9E3779B1; // Fibonacci hashing
+   static const uint32_t FILTER_MULTIPLIER = 0x85EBCA6B;
+
+   struct Slot
+   {
+      Minimizer key;   // minimizer
+      uint32_t  start; // index of its first location
+      uint32_t  count; // number of its locations, 0 = empty slot
+   };
+
+   std::vector<std::pair<Minimizer, Location> > staged; // locations before freeze()
+
+   size_t                   numKeys;
+   int                      tableShift;  // 32 - log2(#slots)
+   int                      filterShift; // 32 - log2(#bits in filter)
+   std::vector<Slot>        slot;
+   std::vector<uint64_t>    filter;
+   std::vector<MapLocation> location;    // locations grouped by minimizer
+
+   // find() uses these, which point to the above vectors or into a mapped file
+   uint64_t           numSlots;
+   const Slot        *slotData;
+   const uint64_t    *filterData;
+   const MapLocation *locationData;
+   void              *mapAddress; // address of mapped index file, or NULL if none
+   uint64_t           mapLength;  // number of bytes mapped
+
+   friend void writePatternIndex(const std::string& indexFilename,
+                                 const PatternMap *patternMap,
+                                 const PatternIndexKey& key);
+
+   friend PatternMap *mapPatternIndex(const std::string& indexFilename,
+                                      const PatternIndexKey& key);
+};
 
 //------------------------------------------------------------------------------------
 
@@ -70,6 +173,7 @@ PatternVector *readPatterns(const std::string& filename,
 
 PatternMap *createPatternMap(const PatternVector *patternVector,
                              MinimizerWindowLength w, const KmerRankTable *rankTable,
-			     Minimizer maxMinimizer);
+			     Minimizer maxMinimizer,
+			     WindowScheme scheme=FIXED_WINDOWS);
 
 #endif
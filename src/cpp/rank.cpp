@@ -12,25 +12,40 @@
 #include "refgen.h"
 #include "util.h"
 #include <algorithm>
+#include <atomic>
+#include <fcntl.h>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 const uint32_t RANK_FILE_SIGNATURE_NOSWAP = 0x17D26E39;
 const uint32_t RANK_FILE_SIGNATURE_SWAP   = 0x396ED217;
 
+// a "mappable" rank file has a header padded to a page boundary so that the lookup
+// table can be memory-mapped and shared by concurrent processes
+const uint32_t MAPPABLE_RANK_FILE_SIGNATURE_NOSWAP = 0x17D26E3A;
+const uint32_t MAPPABLE_RANK_FILE_SIGNATURE_SWAP   = 0x3A6ED217;
+
+const int RANK_FILE_HEADER_SIZE          = 5;    // signature and k
+const int MAPPABLE_RANK_FILE_HEADER_SIZE = 4096; // signature, k, flags and padding
+
+// flags of a mappable rank file
+const uint8_t RANK_FILE_FLAG_CANONICAL   = 0x01; // table holds canonical k-mers only
+
 //------------------------------------------------------------------------------------
 
 class KmerCount // holds #occurrences of one k-mer
 {
 public:
-   KmerCount()
-      : kmer(0), count(0) { }
+   KmerCount(Kmer kmerValue, uint32_t countValue)
+      : kmer(kmerValue), count(countValue) { }
 
    virtual ~KmerCount() { }
 
-   inline void increment() { if (count < UINT32_MAX) count++; } // avoid overflow
-
    Kmer     kmer;  // 2-bit representation of k-mer
    uint32_t count; // #occurrences of the k-mer
 };
@@ -47,38 +62,163 @@ struct CompareKmerCounts // used to sort counts in ascending order
 
 //------------------------------------------------------------------------------------
 
-class KmerFinderCounter : public KmerFinder // finds and counts k-mers
+class KmerCounter // counts the k-mers passed to it by RefGenReader::findKmers() in a
+		  // table that may be shared by several threads
 {
 public:
-   KmerFinderCounter(const char *sequence, int sequenceLen, KmerLength kmerLen,
-                     KmerCountVector *countVector)
-      : KmerFinder(sequence, sequenceLen, kmerLen), cv(countVector) { }
+   KmerCounter(KmerLength kmerLen, KmerRank *countTable, bool canonicalOnly)
+      : k(kmerLen), count(countTable), canonical(canonicalOnly) { }
 
-   virtual ~KmerFinderCounter() { }
+   virtual ~KmerCounter() { }
 
-   virtual bool reportKmer(Kmer kmer, int startIndex)
+   inline void addKmer(Kmer kmer, uint32_t position)
    {
-      Kmer revcomp = kmerReverseComplement(k, kmer);
+      if (canonical) // one count represents the k-mer and its reverse complement
+      {
+         increment(count[canonicalKmerIndex(k, kmer)]);
+	 return;
+      }
+
+      increment(count[kmer]);
+      increment(count[fastKmerReverseComplement(k, kmer)]);
+   }
 
-      (*cv)[kmer].increment();
-      (*cv)[revcomp].increment();
+   inline void finish(uint32_t numStarts) { }
 
-      return true;
+   KmerLength k;
+   KmerRank  *count;    // #occurrences indexed like the entries of the rank table
+   bool       canonical;
+
+private:
+   // increment() atomically adds one to a count without exceeding UINT32_MAX
+   inline void increment(KmerRank& value)
+   {
+      if (__atomic_fetch_add(&value, 1, __ATOMIC_RELAXED) == UINT32_MAX)
+         __atomic_store_n(&value, UINT32_MAX, __ATOMIC_RELAXED); // undo overflow
    }
+};
+
+//------------------------------------------------------------------------------------
 
-   KmerCountVector *cv;
+// k-mer counts below this value are ranked by a counting sort; the few k-mers that
+// occur more often are ranked by sorting them
+const uint32_t NUM_DENSE_COUNTS = 1 << 16;
+
+class RankChunk // a range of k-mers whose counts are converted to ranks by one thread
+{
+public:
+   RankChunk()
+      : low(0), high(0), next(NUM_DENSE_COUNTS, 0), frequent() { }
+
+   virtual ~RankChunk() { }
+
+   Kmer low;                // first k-mer of the range
+   Kmer high;               // one past the last k-mer of the range
+   std::vector<Kmer> next;  // number of k-mers having each dense count, then the
+                            // next rank to assign to a k-mer having that count
+   KmerCountVector frequent; // k-mers of the range having larger counts
 };
 
+//------------------------------------------------------------------------------------
+// checkCanonical() throws an exception if a canonical table is requested for an
+// unsupported k-mer length
+
+static void checkCanonical(KmerLength k, bool canonical)
+{
+   if (canonical && k % 2 == 0)
+      throw std::runtime_error("canonical k-mer rank table requires odd k");
+}
+
+//------------------------------------------------------------------------------------
+// allocateRanks() allocates anonymous memory for a lookup table of the given number of
+// bytes; the kernel is advised to back it with huge pages, as lookups are scattered
+// across the entire table and would otherwise miss the TLB on nearly every k-mer
+
+static KmerRank *allocateRanks(uint64_t length)
+{
+   void *address = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+   if (address == MAP_FAILED)
+      throw std::runtime_error("unable to allocate k-mer rank table");
+
+#ifdef MADV_HUGEPAGE
+   madvise(address, length, MADV_HUGEPAGE); // advisory only; failure is harmless
+#endif
+
+   return static_cast<KmerRank *>(address);
+}
+
 //------------------------------------------------------------------------------------
 // KmerRankTable::KmerRankTable() allocates but does not initialize the lookup table
 
-KmerRankTable::KmerRankTable(KmerLength kmerLen)
-   : k(kmerLen)
+KmerRankTable::KmerRankTable(KmerLength kmerLen, bool canonicalOnly)
+   : k(kmerLen), canonical(canonicalOnly)
+{
+   if (k < 4 || k > MAX_KMER_LENGTH)
+      throw std::runtime_error("unsupported k-mer length");
+
+   checkCanonical(k, canonical);
+
+   allocSize = static_cast<uint64_t>(numEntries()) * sizeof(KmerRank);
+
+   rank = allocateRanks(allocSize);
+
+   mapAddress = NULL;
+   mapLength  = 0;
+}
+
+//------------------------------------------------------------------------------------
+// KmerRankTable::KmerRankTable() constructs a lookup table residing in a memory-mapped
+// rank file; the table begins at the given byte offset within the mapped region
+
+KmerRankTable::KmerRankTable(KmerLength kmerLen, bool canonicalOnly, void *address,
+                             uint64_t length, uint64_t rankOffset)
+   : k(kmerLen), canonical(canonicalOnly), mapAddress(address), mapLength(length),
+     allocSize(0)
 {
    if (k < 4 || k > MAX_KMER_LENGTH)
       throw std::runtime_error("unsupported k-mer length");
 
-   rank = new KmerRank[numKmers(k)];
+   checkCanonical(k, canonical);
+
+   rank = reinterpret_cast<KmerRank *>(static_cast<uint8_t *>(mapAddress) +
+                                       rankOffset);
+}
+
+//------------------------------------------------------------------------------------
+// KmerRankTable::~KmerRankTable() unmaps the lookup table
+
+KmerRankTable::~KmerRankTable()
+{
+   if (isMapped())
+      munmap(mapAddress, mapLength);
+   else
+      munmap(rank, allocSize);
+}
+
+//------------------------------------------------------------------------------------
+// KmerRankTable::fingerprint() hashes k, the canonical flag and evenly spaced entries
+// of the lookup table, including the first and last; only a few thousand pages of a
+// mapped table are touched
+
+uint64_t KmerRankTable::fingerprint() const
+{
+   const uint64_t NUM_SAMPLES = 4096; // number of entries hashed
+
+   uint8_t layout[2] = { k, static_cast<uint8_t>(canonical ? 1 : 0) };
+
+   uint64_t hash = hashBytes(layout, sizeof(layout));
+
+   uint64_t n = numEntries();
+
+   for (uint64_t i = 0; i < NUM_SAMPLES; i++)
+   {
+      KmerRank entry = rank[i * (n - 1) / (NUM_SAMPLES - 1)];
+      hash = hashBytes(&entry, sizeof(entry), hash);
+   }
+
+   return hash;
 }
 
 //------------------------------------------------------------------------------------
@@ -94,26 +234,42 @@ void KmerRankTable::writeText(const std::string& textFilename) const
    Kmer n = numKmers(k);
 
    for (Kmer kmer = 0; kmer < n; kmer++)
-      outfile << kmerToString(k, kmer) << TAB << rank[kmer] << NEWLINE;
+      outfile << kmerToString(k, kmer) << TAB << getRank(kmer) << NEWLINE;
 
    outfile.close();
 }
 
 //------------------------------------------------------------------------------------
-// KmerRankTable::writeBinary() writes a binary rank file
+// KmerRankTable::writeBinary() writes a binary rank file; if mappable is true, the
+// header is padded so that fuzzion2 can memory-map the lookup table; a canonical
+// table is always written in the mappable layout because only that layout records
+// the flags
 
-void KmerRankTable::writeBinary(const std::string& binaryFilename) const
+void KmerRankTable::writeBinary(const std::string& binaryFilename,
+                                bool mappable) const
 {
    BinWriter writer;
 
    writer.open(binaryFilename);
 
-   writer.writeUint32(RANK_FILE_SIGNATURE_NOSWAP);
-   writer.writeUint8(k);
+   if (mappable || canonical)
+   {
+      writer.writeUint32(MAPPABLE_RANK_FILE_SIGNATURE_NOSWAP);
+      writer.writeUint8(k);
+      writer.writeUint8(canonical ? RANK_FILE_FLAG_CANONICAL : 0);
+
+      for (int i = RANK_FILE_HEADER_SIZE + 1; i < MAPPABLE_RANK_FILE_HEADER_SIZE; i++)
+         writer.writeUint8(0);
+   }
+   else
+   {
+      writer.writeUint32(RANK_FILE_SIGNATURE_NOSWAP);
+      writer.writeUint8(k);
+   }
 
    // write the lookup table in four equal-sized chunks
 
-   int quarter  = numKmers(k) >> 2;
+   int quarter  = numEntries() >> 2;
    int numBytes = quarter * sizeof(KmerRank);
 
    for (int i = 0; i < 4; i++)
@@ -122,11 +278,72 @@ void KmerRankTable::writeBinary(const std::string& binaryFilename) const
    writer.close();
 }
 
+//------------------------------------------------------------------------------------
+// mapRankTable() returns a lookup table residing in the named mappable rank file,
+// which is memory-mapped read-only so that its pages are shared with any other
+// process mapping the same file; if populate is true, all pages are prefaulted; it is
+// the caller's obligation to de-allocate the returned object
+
+static KmerRankTable *mapRankTable(const std::string& binaryFilename, KmerLength k,
+                                   bool canonical, bool populate)
+{
+   int fd = ::open(binaryFilename.c_str(), O_RDONLY);
+   if (fd == -1)
+      throw std::runtime_error("unable to open " + binaryFilename);
+
+   struct stat status;
+
+   if (fstat(fd, &status) == -1)
+   {
+      ::close(fd);
+      throw std::runtime_error("unable to get size of " + binaryFilename);
+   }
+
+   uint64_t length = status.st_size;
+   uint64_t entries  = (canonical ? numKmers(k) >> 1 : numKmers(k));
+   uint64_t expected = MAPPABLE_RANK_FILE_HEADER_SIZE + entries * sizeof(KmerRank);
+
+   if (length < expected)
+   {
+      ::close(fd);
+      throw std::runtime_error("truncated k-mer rank file " + binaryFilename);
+   }
+
+   if (length > expected)
+   {
+      ::close(fd);
+      throw std::runtime_error("invalid k-mer rank file " + binaryFilename);
+   }
+
+   int flags = MAP_SHARED;
+
+#ifdef MAP_POPULATE
+   if (populate)
+      flags |= MAP_POPULATE;
+#endif
+
+   void *address = mmap(NULL, length, PROT_READ, flags, fd, 0);
+
+   ::close(fd); // the mapping remains valid after the file is closed
+
+   if (address == MAP_FAILED)
+      throw std::runtime_error("unable to memory-map " + binaryFilename);
+
+#ifdef MADV_HUGEPAGE
+   madvise(address, length, MADV_HUGEPAGE); // advisory only; failure is harmless
+#endif
+
+   return new KmerRankTable(k, canonical, address, length,
+                            MAPPABLE_RANK_FILE_HEADER_SIZE);
+}
+
 //------------------------------------------------------------------------------------
 // readRankTable() returns a lookup table containing the ranks read from a binary rank
-// file; it is the caller's obligation to de-allocate it
+// file; a mappable rank file in native byte order is memory-mapped rather than read
+// into memory, and populate is passed to mapRankTable(); it is the caller's
+// obligation to de-allocate the returned object
 
-KmerRankTable *readRankTable(const std::string& binaryFilename)
+KmerRankTable *readRankTable(const std::string& binaryFilename, bool populate)
 {
    BinReader reader;
 
@@ -137,15 +354,46 @@ KmerRankTable *readRankTable(const std::string& binaryFilename)
 
    if (!reader.readUint32(signature) ||
        signature != RANK_FILE_SIGNATURE_NOSWAP &&
-       signature != RANK_FILE_SIGNATURE_SWAP ||
+       signature != RANK_FILE_SIGNATURE_SWAP &&
+       signature != MAPPABLE_RANK_FILE_SIGNATURE_NOSWAP &&
+       signature != MAPPABLE_RANK_FILE_SIGNATURE_SWAP ||
        !reader.readUint8(k))
       throw std::runtime_error(binaryFilename + " is not a k-mer rank file");
 
-   KmerRankTable *table = new KmerRankTable(k);
+   if (k < 4 || k > MAX_KMER_LENGTH)
+      throw std::runtime_error("unsupported k-mer length in " + binaryFilename);
+
+   bool mappable = (signature == MAPPABLE_RANK_FILE_SIGNATURE_NOSWAP ||
+                    signature == MAPPABLE_RANK_FILE_SIGNATURE_SWAP);
+
+   uint8_t flags = 0;
+
+   if (mappable && !reader.readUint8(flags))
+      throw std::runtime_error("truncated k-mer rank file " + binaryFilename);
+
+   if (flags & ~RANK_FILE_FLAG_CANONICAL)
+      throw std::runtime_error("unsupported k-mer rank file " + binaryFilename);
+
+   bool canonical = (flags & RANK_FILE_FLAG_CANONICAL);
+
+   if (signature == MAPPABLE_RANK_FILE_SIGNATURE_NOSWAP)
+   {
+      reader.close();
+      return mapRankTable(binaryFilename, k, canonical, populate);
+   }
+
+   bool swapRequired = (signature == RANK_FILE_SIGNATURE_SWAP ||
+                        signature == MAPPABLE_RANK_FILE_SIGNATURE_SWAP);
+
+   if (mappable &&
+       !reader.skipBytes(MAPPABLE_RANK_FILE_HEADER_SIZE - RANK_FILE_HEADER_SIZE - 1))
+      throw std::runtime_error("truncated k-mer rank file " + binaryFilename);
+
+   KmerRankTable *table = new KmerRankTable(k, canonical);
 
    // initialize the lookup table in four equal-sized chunks
 
-   Kmer n = numKmers(k);
+   Kmer n = table->numEntries();
 
    int quarter  = n >> 2;
    int numBytes = quarter * sizeof(KmerRank);
@@ -161,7 +409,7 @@ KmerRankTable *readRankTable(const std::string& binaryFilename)
 
    reader.close();
 
-   if (signature == RANK_FILE_SIGNATURE_SWAP) // fix the byte ordering
+   if (swapRequired) // fix the byte ordering
       for (Kmer kmer = 0; kmer < n; kmer++)
          swapBytes(&table->rank[kmer], sizeof(KmerRank));
 
@@ -169,43 +417,265 @@ KmerRankTable *readRankTable(const std::string& binaryFilename)
 }
 
 //------------------------------------------------------------------------------------
-// createRankTable() returns a lookup table containing the ranks derived from a
-// reference genome; it is the caller's obligation to de-allocate it
+// countWork() contains the work of each counting thread, which takes the next
+// uncounted reference of the reference genome and counts its k-mers, streamed from
+// the packed bases of the file, until all references have been taken; if an
+// exception occurs, its message is provided
+
+static void countWork(const std::string *refGenFilename, KmerLength k,
+                      KmerRank *count, bool canonical, std::atomic<int> *nextRef,
+		      std::string *message)
+{
+   try
+   {
+      RefGenReader reader; // each thread reads the file independently
+
+      reader.open(*refGenFilename);
+
+      KmerCounter counter(k, count, canonical);
+
+      for (int i = (*nextRef)++; i < reader.numref; i = (*nextRef)++)
+         reader.findKmers(i, k, counter);
+
+      reader.close();
+   }
+   catch (const std::runtime_error& error)
+   {
+      *message = error.what();
+   }
+}
+
+//------------------------------------------------------------------------------------
+// chunkIndex() returns the index of the table entry holding the count of a k-mer in
+// the range of a RankChunk, or returns false if the k-mer is not the smaller of a
+// canonical pair, in which case its entry is visited through the other k-mer; the
+// k-mers of a range are thereby visited in the order that ranks are assigned
+
+static inline bool chunkIndex(KmerLength k, bool canonical, Kmer kmer, Kmer& index)
+{
+   if (!canonical)
+   {
+      index = kmer;
+      return true;
+   }
 
-KmerRankTable *createRankTable(KmerLength k, const std::string& refGenFilename)
+   if (kmer > fastKmerReverseComplement(k, kmer))
+      return false;
+
+   index = canonicalKmerIndex(k, kmer);
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// tallyWork() contains the work of each thread tallying the counts of the k-mers in
+// a chunk; k-mers with frequent counts are set aside in the chunk for sorting
+
+static void tallyWork(KmerLength k, bool canonical, const KmerRank *count,
+                      RankChunk *chunk)
+{
+   Kmer index;
+
+   for (Kmer kmer = chunk->low; kmer < chunk->high; kmer++)
+      if (chunkIndex(k, canonical, kmer, index))
+      {
+         if (count[index] < NUM_DENSE_COUNTS)
+	    chunk->next[count[index]]++;
+	 else
+	    chunk->frequent.push_back(KmerCount(kmer, count[index]));
+      }
+}
+
+//------------------------------------------------------------------------------------
+// assignWork() contains the work of each thread replacing the count of each k-mer in
+// a chunk with its rank, except for k-mers with frequent counts
+
+static void assignWork(KmerLength k, bool canonical, KmerRank *table,
+                       RankChunk *chunk)
+{
+   Kmer index;
+
+   for (Kmer kmer = chunk->low; kmer < chunk->high; kmer++)
+      if (chunkIndex(k, canonical, kmer, index) && table[index] < NUM_DENSE_COUNTS)
+      {
+         KmerRank rank = chunk->next[table[index]]++;
+         table[index] = (canonical ? rank << 1 : rank);
+      }
+}
+
+//------------------------------------------------------------------------------------
+// createRankTable() returns a lookup table containing the ranks derived from a
+// reference genome; if canonical is true, a k-mer and its reverse complement share
+// one entry, and the entries are ranked so that canonical rank 2i is the ith pair in
+// the ordering of the full table; the k-mers are counted in place in the table by the
+// given number of threads, which then convert the counts to ranks; it is the
+// caller's obligation to de-allocate the returned object
+
+KmerRankTable *createRankTable(KmerLength k, const std::string& refGenFilename,
+                               bool canonical, int numThreads)
 {
+   checkCanonical(k, canonical);
+
+   if (numThreads < 1)
+      numThreads = 1;
+
+   KmerRankTable *table = new KmerRankTable(k, canonical);
+
+   KmerRank *count = table->rank; // the anonymous memory of the table is zeroed
+
+   std::vector<std::thread *> thread(numThreads);
+   std::vector<std::string> message(numThreads);
+
+   // count the k-mers of the references, several references at a time
+
+   std::atomic<int> nextRef(0);
+
+   for (int i = 0; i < numThreads; i++)
+      thread[i] = new std::thread(countWork, &refGenFilename, k, count, canonical,
+                                  &nextRef, &message[i]);
+
+   for (int i = 0; i < numThreads; i++)
+   {
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   for (int i = 0; i < numThreads; i++)
+      if (message[i] != "")
+      {
+         delete table;
+         throw std::runtime_error(message[i]);
+      }
+
+   // rank the k-mers by ascending count, breaking ties by ascending k-mer (the
+   // smaller k-mer of a canonical pair); the k-mers are divided into consecutive
+   // chunks, and each count is tallied by chunk
+
    Kmer n = numKmers(k);
 
-   KmerCountVector *cv = new KmerCountVector(n);
+   std::vector<RankChunk> chunk(numThreads);
 
-   for (Kmer kmer = 0; kmer < n; kmer++)
-      (*cv)[kmer].kmer = kmer;
+   for (int i = 0; i < numThreads; i++)
+   {
+      chunk[i].low  = static_cast<Kmer>(static_cast<uint64_t>(n) * i / numThreads);
+      chunk[i].high = static_cast<Kmer>(static_cast<uint64_t>(n) * (i + 1) /
+                                        numThreads);
+
+      thread[i] = new std::thread(tallyWork, k, canonical, count, &chunk[i]);
+   }
+
+   for (int i = 0; i < numThreads; i++)
+   {
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   // the first rank of a count in a chunk follows the ranks of all smaller counts
+   // and of the same count in preceding chunks
 
-   RefGenReader reader;
+   KmerRank numDense = 0; // number of k-mers with dense counts
 
-   reader.open(refGenFilename);
+   for (uint32_t c = 0; c < NUM_DENSE_COUNTS; c++)
+      for (int i = 0; i < numThreads; i++)
+      {
+         Kmer tally = chunk[i].next[c];
+	 chunk[i].next[c] = numDense;
+	 numDense += tally;
+      }
 
-   for (int i = 0; i < reader.numref; i++) // for each reference
+   for (int i = 0; i < numThreads; i++)
+      thread[i] = new std::thread(assignWork, k, canonical, table->rank, &chunk[i]);
+
+   for (int i = 0; i < numThreads; i++)
    {
-      RefGenSeq *rgs = reader.getRefGenSeq(reader.refName[i], 1, 1000000000);
+      thread[i]->join();
+      delete thread[i];
+   }
+
+   // the k-mers with frequent counts follow all others
 
-      KmerFinderCounter fc(rgs->seq, rgs->end, k, cv);
-      fc.find();
+   KmerCountVector frequent;
 
-      delete rgs;
+   for (int i = 0; i < numThreads; i++)
+   {
+      frequent.insert(frequent.end(), chunk[i].frequent.begin(),
+                      chunk[i].frequent.end());
+
+      KmerCountVector().swap(chunk[i].frequent);
    }
 
-   reader.close();
+   std::sort(frequent.begin(), frequent.end(), CompareKmerCounts());
 
-   // sort the k-mers by ascending count
-   std::sort(cv->begin(), cv->end(), CompareKmerCounts());
+   for (size_t i = 0; i < frequent.size(); i++)
+   {
+      KmerRank rank = numDense + i;
+
+      if (canonical)
+         table->rank[canonicalKmerIndex(k, frequent[i].kmer)] = rank << 1;
+      else
+         table->rank[frequent[i].kmer] = rank;
+   }
 
-   KmerRankTable *table = new KmerRankTable(k);
+   return table;
+}
 
-   for (KmerRank rank = 0; rank < n; rank++)
-      table->rank[(*cv)[rank].kmer] = rank;
+//------------------------------------------------------------------------------------
+// createCanonicalRankTable() returns a canonical lookup table equivalent to the one
+// createRankTable() would derive from the same reference genome, given the full table
+// derived from it; a k-mer and its reverse complement have the same count, so the
+// pairs are ordered by the smaller of their two ranks; it is the caller's obligation
+// to de-allocate the returned object
+
+KmerRankTable *createCanonicalRankTable(const KmerRankTable *rankTable)
+{
+   if (rankTable->canonical)
+      throw std::runtime_error("k-mer rank table is already canonical");
+
+   KmerLength k = rankTable->k;
+
+   KmerRankTable *table = new KmerRankTable(k, true);
+
+   Kmer n = numKmers(k);
+   Kmer numWords = (n + 63) >> 6;
+
+   // mark the smaller rank of each pair
+
+   uint64_t *marked = new uint64_t[numWords]();
+
+   for (Kmer index = 0; index < table->numEntries(); index++)
+   {
+      Kmer kmer = canonicalIndexToKmer(k, index);
+
+      KmerRank rank = std::min(rankTable->rank[kmer],
+                               rankTable->rank[kmerReverseComplement(k, kmer)]);
+
+      marked[rank >> 6] |= static_cast<uint64_t>(1) << (rank & 63);
+      table->rank[index] = rank; // temporarily holds the smaller rank
+   }
+
+   // count the marked ranks preceding each word
+
+   Kmer *preceding = new Kmer[numWords];
+   Kmer count = 0;
+
+   for (Kmer i = 0; i < numWords; i++)
+   {
+      preceding[i] = count;
+      count += __builtin_popcountll(marked[i]);
+   }
+
+   // convert the smaller rank of each pair to the canonical rank
+
+   for (Kmer index = 0; index < table->numEntries(); index++)
+   {
+      KmerRank rank = table->rank[index];
+      uint64_t below = marked[rank >> 6] &
+                       ((static_cast<uint64_t>(1) << (rank & 63)) - 1);
+
+      table->rank[index] = (preceding[rank >> 6] + __builtin_popcountll(below)) << 1;
+   }
 
-   delete cv;
+   delete[] preceding;
+   delete[] marked;
 
    return table;
 }
@@ -221,7 +691,7 @@ KmerRankInverter::KmerRankInverter(const KmerRankTable *rankTable)
    kmer = new Kmer[n];
 
    for (Kmer i = 0; i < n; i++)
-      kmer[rankTable->rank[i]] = i;
+      kmer[rankTable->getRank(i)] = i;
 }
 
 //------------------------------------------------------------------------------------
@@ -26,21 +26,58 @@ inline double kmerRankPercentile(KmerLength k, KmerRank rank)
 class KmerRankTable // a lookup table holding a rank for each k-mer
 {
 public:
-   KmerRankTable(KmerLength kmerLen);
+   KmerRankTable(KmerLength kmerLen, bool canonicalOnly=false);
 
-   virtual ~KmerRankTable() { delete[] rank; }
+   KmerRankTable(KmerLength kmerLen, bool canonicalOnly, void *address,
+                 uint64_t length, uint64_t rankOffset);
+
+   virtual ~KmerRankTable();
+
+   bool isMapped() const { return (mapAddress != NULL); }
+
+   // number of entries in the lookup table
+   Kmer numEntries() const { return (canonical ? numKmers(k) >> 1 : numKmers(k)); }
+
+   // a canonical table holds even ranks; the low-order bit is set for the
+   // non-canonical k-mer of a pair so that each k-mer keeps a distinct rank
+   inline KmerRank getRank(Kmer kmer) const
+   {
+      if (!canonical)
+         return rank[kmer];
+
+      return rank[canonicalKmerIndex(k, kmer)] | ((kmer >> k) & 1);
+   }
+
+   // prefetchRank() starts loading the entry of a k-mer into the cache so that a
+   // later call to getRank() for the k-mer does not wait on memory
+   inline void prefetchRank(Kmer kmer) const
+   { __builtin_prefetch(&rank[canonical ? canonicalKmerIndex(k, kmer) : kmer]); }
+
+   // fingerprint() returns a hash of k, the layout and a sample of the entries,
+   // which distinguishes rank tables without reading every entry
+   uint64_t fingerprint() const;
 
    void writeText(const std::string& textFilename) const;
 
-   void writeBinary(const std::string& binaryFilename) const;
+   void writeBinary(const std::string& binaryFilename, bool mappable=false) const;
 
-   KmerLength  k;    // length of each k-mer
-   KmerRank   *rank; // lookup table indexed by k-mer
+   KmerLength  k;          // length of each k-mer
+   bool        canonical;  // true if a k-mer and its reverse complement share an
+                           // entry of the lookup table, indexed by
+                           // canonicalKmerIndex(); this halves its size
+   KmerRank   *rank;       // lookup table indexed by k-mer; read-only if mapped
+   void       *mapAddress; // address of memory-mapped rank file, or NULL if none
+   uint64_t    mapLength;  // number of bytes mapped
+   uint64_t    allocSize;  // number of bytes allocated for the table if not mapped
 };
 
-KmerRankTable *readRankTable(const std::string& binaryFilename);
+KmerRankTable *readRankTable(const std::string& binaryFilename,
+                             bool populate=false);
+
+KmerRankTable *createRankTable(KmerLength k, const std::string& refGenFilename,
+                               bool canonical=false, int numThreads=1);
 
-KmerRankTable *createRankTable(KmerLength k, const std::string& refGenFilename);
+KmerRankTable *createCanonicalRankTable(const KmerRankTable *rankTable);
 
 //------------------------------------------------------------------------------------
 
@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------------
+//
+// read.cpp - module supporting reads encoded for matching in both orientations
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#include "read.h"
+#include <algorithm>
+
+//------------------------------------------------------------------------------------
+// encodeStrands() encodes both strands of a read in a single pass over the sequence;
+// the k-mers of the reverse complement are built alongside the forward k-mers, and
+// the storage of a previous read is reused; if K is not 0, it is the value of k
+// known at compile time, so that the mask and shifts are constants
+
+template <KmerLength K>
+static void encodeStrands(const std::string& sequence, KmerLength k,
+                          ReadStrand& forward, ReadStrand& reverse)
+{
+   if (K > 0)
+      k = K;
+
+   int seqlen    = sequence.length();
+   int numStarts = (seqlen >= k ? seqlen - k + 1 : 0);
+
+   forward.sequence = sequence;
+   reverse.sequence.resize(seqlen);
+
+   forward.code.resize(seqlen);
+   reverse.code.resize(seqlen);
+
+   forward.kmer.resize(numStarts);
+   reverse.kmer.resize(numStarts);
+
+   forward.clearWindows();
+   reverse.clearWindows();
+
+   const Kmer mask  = numKmers(k) - 1;
+   const int  shift = 2 * (k - 1); // position of the first base of a k-mer
+
+   Kmer fwd = 0, rev = 0; // forward k-mer and its reverse complement
+   int  len = 0;          // number of consecutive defined bases
+
+   for (int i = 0; i < seqlen; i++)
+   {
+      char ch   = sequence[i];
+      Base base = charToBase(ch);
+      char comp = (base < NUM_BASES ? BASE_CHAR[3 - base] : ch);
+
+      reverse.sequence[seqlen - 1 - i] = comp;
+
+      forward.code[i]              = lcsCode(ch);
+      reverse.code[seqlen - 1 - i] = lcsCode(comp);
+
+      if (base < NUM_BASES)
+      {
+         fwd = ((fwd << 2) | base) & mask;
+	 rev = (rev >> 2) | (static_cast<Kmer>(3 - base) << shift);
+	 len++;
+      }
+      else
+         len = 0;
+
+      int start = i - k + 1;
+
+      if (start >= 0) // the k-mer ending at i starts at start
+      {
+         forward.kmer[start]          = (len >= k ? fwd : NO_KMER);
+	 reverse.kmer[seqlen - 1 - i] = (len >= k ? rev : NO_KMER);
+      }
+   }
+}
+
+//------------------------------------------------------------------------------------
+// EncodedRead::encode() encodes both strands of a read, using the encodeStrands()
+// specialized for k if there is one
+
+void EncodedRead::encode(const std::string& sequence, KmerLength k)
+{
+   switch (k)
+   {
+      case 11: encodeStrands<11>(sequence, k, forward, reverse); break;
+      case 13: encodeStrands<13>(sequence, k, forward, reverse); break;
+      case 15: encodeStrands<15>(sequence, k, forward, reverse); break;
+      default: encodeStrands<0> (sequence, k, forward, reverse); break;
+   }
+}
+
+//------------------------------------------------------------------------------------
+// addKmers() passes the k-mers of a strand to a minimizer engine, skipping the start
+// indexes where no k-mer starts; the rank of each k-mer is prefetched several k-mers
+// before the engine looks it up, so that the scattered reads of the table overlap
+
+const int PREFETCH_DISTANCE = 16; // number of k-mers prefetched ahead of the engine
+
+template <class Engine>
+static void addKmers(const std::vector<Kmer>& kmer, const KmerRankTable *rankTable,
+                     Engine& engine)
+{
+   int numStarts = kmer.size();
+   int ahead     = std::min(numStarts, PREFETCH_DISTANCE);
+
+   for (int i = 0; i < ahead; i++)
+      if (kmer[i] != NO_KMER)
+         rankTable->prefetchRank(kmer[i]);
+
+   for (int i = 0; i < numStarts; i++)
+   {
+      if (i + ahead < numStarts && kmer[i + ahead] != NO_KMER)
+         rankTable->prefetchRank(kmer[i + ahead]);
+
+      if (kmer[i] != NO_KMER)
+         engine.addKmer(kmer[i], i);
+   }
+
+   engine.finish(numStarts);
+}
+
+//------------------------------------------------------------------------------------
+// findWindows() passes the k-mers of a strand to the engine of the given scheme, with
+// w known at compile time, or with the given value when W is 0
+
+template <MinimizerWindowLength W>
+static void findWindows(const std::vector<Kmer>& kmer, MinimizerWindowLength w,
+                        const KmerRankTable *rankTable, WindowScheme scheme,
+			WindowVector& window)
+{
+   RankHash   hash(rankTable);
+   WindowSink sink(window);
+
+   if (scheme == SLIDING_WINDOWS)
+   {
+      SlidingMinimizerEngine<RankHash, WindowSink, W> engine(w, hash, sink);
+      addKmers(kmer, rankTable, engine);
+   }
+   else
+   {
+      FixedMinimizerEngine<RankHash, WindowSink, W> engine(w, hash, sink);
+      addKmers(kmer, rankTable, engine);
+   }
+}
+
+//------------------------------------------------------------------------------------
+// ReadStrand::getWindows() finds the windows of the strand on the first call, using
+// the k-mers already found in the strand and the findWindows() specialized for w if
+// there is one; the windows are identical to those found by getWindows() in the
+// strand's sequence
+
+const WindowVector& ReadStrand::getWindows(MinimizerWindowLength w,
+                                           const KmerRankTable *rankTable,
+					   WindowScheme scheme) const
+{
+   if (haveWindows)
+      return window;
+
+   haveWindows = true;
+
+   switch (w)
+   {
+      case 5:  findWindows<5> (kmer, w, rankTable, scheme, window); break;
+      case 10: findWindows<10>(kmer, w, rankTable, scheme, window); break;
+      case 15: findWindows<15>(kmer, w, rankTable, scheme, window); break;
+      default: findWindows<0> (kmer, w, rankTable, scheme, window); break;
+   }
+
+   return window;
+}
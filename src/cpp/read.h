@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------------
+//
+// read.h - module supporting reads encoded for matching in both orientations
+//
+// Author: Stephen V. Rice, Ph.D.
+//
+// Copyright 2023 St. Jude Children's Research Hospital
+//
+//------------------------------------------------------------------------------------
+
+#ifndef READ_H
+#define READ_H
+
+#include "window.h"
+#include <vector>
+
+const Kmer NO_KMER = ~static_cast<Kmer>(0); // marks an offset where no k-mer starts
+
+typedef uint8_t LcsCode; // code of a base in the alphabet used for LCS scoring
+
+const LcsCode LCS_ALPHABET_SIZE = 5; // A, C, G, T and N
+const LcsCode LCS_OTHER         = 5; // code of any character outside the alphabet
+
+inline LcsCode lcsCode(char ch)
+{
+   switch (ch)
+   {
+      case 'A': return 0;
+      case 'C': return 1;
+      case 'G': return 2;
+      case 'T': return 3;
+      case 'N': return 4;
+      default : return LCS_OTHER;
+   }
+}
+
+//------------------------------------------------------------------------------------
+
+class ReadStrand // one orientation of a read
+{
+public:
+   ReadStrand() : haveWindows(false) { }
+
+   virtual ~ReadStrand() { }
+
+   int length() const { return sequence.length(); }
+
+   // getWindows() returns the minimizer windows of the strand; they are found on the
+   // first call and cached, so both orientations of a read pair share them; w and
+   // rankTable and scheme must not change while the strand is encoded
+   const WindowVector& getWindows(MinimizerWindowLength w,
+                                  const KmerRankTable *rankTable,
+				  WindowScheme scheme=FIXED_WINDOWS) const;
+
+   void clearWindows() { window.clear(); haveWindows = false; }
+
+   std::string          sequence; // bases of the strand
+   std::vector<LcsCode> code;     // LCS code of each base
+   std::vector<Kmer>    kmer;     // k-mer starting at each offset, or NO_KMER if the
+                                  // k-mer would include an undefined base
+
+private:
+   mutable WindowVector window;      // cached minimizer windows
+   mutable bool         haveWindows; // true if window holds the windows
+};
+
+//------------------------------------------------------------------------------------
+
+class EncodedRead // a read and its reverse complement
+{
+public:
+   EncodedRead() { }
+
+   virtual ~EncodedRead() { }
+
+   void encode(const std::string& sequence, KmerLength k);
+
+   ReadStrand forward; // the read as sequenced
+   ReadStrand reverse; // its reverse complement
+};
+
+#endif
@@ -64,6 +64,38 @@ void RefGenReader::open(const std::string& refGenFilename)
          throw std::runtime_error("invalid format in " + refGenFilename);
 }
 
+//------------------------------------------------------------------------------------
+// RefGenReader::readRefHeader() reads the header of the indexed reference and returns
+// the reference length; its N-blocks are obtained in order of position, and dnaOffset
+// is set to the byte offset of its packed 2-bit bases
+
+uint32_t RefGenReader::readRefHeader(int refIndex, RefGenBlockVector& nBlock,
+                                     uint32_t& dnaOffset)
+{
+   seek(refOffset[refIndex]);
+
+   uint32_t reflen = readUint32();
+
+   uint32_t nBlockCount = readUint32();
+
+   nBlock.resize(nBlockCount);
+
+   for (uint32_t i = 0; i < nBlockCount; i++)
+      nBlock[i].start = readUint32();
+
+   for (uint32_t i = 0; i < nBlockCount; i++)
+      nBlock[i].stop = nBlock[i].start + readUint32();
+
+   std::sort(nBlock.begin(), nBlock.end());
+
+   uint32_t maskBlockCount = readUint32();
+
+   dnaOffset = refOffset[refIndex] +
+      2 * sizeof(uint32_t) * (nBlockCount + maskBlockCount + 2);
+
+   return reflen;
+}
+
 //------------------------------------------------------------------------------------
 // RefGenReader::getRefGenSeq() reads a sequence of the named reference and returns it
 // in a newly allocated object; the caller is obligated to de-allocate it; the
@@ -83,9 +115,10 @@ RefGenSeq *RefGenReader::getRefGenSeq(const std::string& selectedRefName,
       throw std::runtime_error("unrecognized reference name \"" + selectedRefName +
                                "\"");
 
-   seek(refOffset[i]);
+   RefGenBlockVector nBlock;
+   uint32_t dnaOffset;
 
-   uint32_t reflen = readUint32();
+   uint32_t reflen = readRefHeader(i, nBlock, dnaOffset);
 
    if (endPos > reflen)
       endPos = reflen;
@@ -95,25 +128,6 @@ RefGenSeq *RefGenReader::getRefGenSeq(const std::string& selectedRefName,
 
    char *sequence = new char[endPos - beginPos + 1];
 
-   uint32_t nBlockCount = readUint32();
-
-   IntVector nstart(nBlockCount); // vector of N-block first positions,
-                                         // 1-based, inclusive
-
-   for (uint32_t i = 0; i < nBlockCount; i++)
-      nstart[i] = readUint32() + 1;      // make it 1-based
-
-   IntVector nstop(nBlockCount);  // vector of N-block last positions,
-                                         // 1-based, inclusive
-
-   for (uint32_t i = 0; i < nBlockCount; i++)
-      nstop[i] = nstart[i] + readUint32() - 1;
-
-   uint32_t maskBlockCount = readUint32();
-
-   uint32_t dnaOffset = refOffset[i] +
-      2 * sizeof(uint32_t) * (nBlockCount + maskBlockCount + 2);
-
    seek(dnaOffset + ((beginPos - 1) >> 2)); // jump to first DNA byte
 
    // read the 2-bit sequence data and convert it to characters
@@ -136,17 +150,22 @@ RefGenSeq *RefGenReader::getRefGenSeq(const std::string& selectedRefName,
       readByte = (shift == 0);
    }
 
-   // now insert N's
+   // now insert N's; the 0-based exclusive stop of a block is its 1-based last
+   // position
 
-   for (uint32_t i = 0; i < nBlockCount; i++)
-      if (nstart[i] <= endPos && nstop[i] >= beginPos)
+   for (size_t j = 0; j < nBlock.size(); j++)
+   {
+      int nstart = nBlock[j].start + 1, nstop = nBlock[j].stop;
+
+      if (nstart <= endPos && nstop >= beginPos)
       {
-         int start = std::max(nstart[i], beginPos);
-	 int stop  = std::min(nstop[i],  endPos);
+         int start = std::max(nstart, beginPos);
+	 int stop  = std::min(nstop,  endPos);
 
 	 for (int pos = start; pos <= stop; pos++)
             sequence[pos - beginPos] = 'N';
       }
+   }
 
    return new RefGenSeq(beginPos, endPos, sequence);
 }
@@ -12,8 +12,14 @@
 #define REFGEN_H
 
 #include "bin.h"
+#include "kmer.h"
+#include <algorithm>
+#include <stdexcept>
 #include <vector>
 
+// number of bytes of packed bases read at a time by RefGenReader::findKmers()
+const int REF_GEN_CHUNK_SIZE = 64 * 1024;
+
 //------------------------------------------------------------------------------------
 
 class RefGenSeq // represents a sequence of a reference
@@ -35,6 +41,18 @@ public:
 
 //------------------------------------------------------------------------------------
 
+struct RefGenBlock // a block of N's in a reference
+{
+   uint32_t start; // first position, 0-based, inclusive
+   uint32_t stop;  // last  position, 0-based, exclusive
+
+   bool operator<(const RefGenBlock& other) const { return start < other.start; }
+};
+
+typedef std::vector<RefGenBlock> RefGenBlockVector;
+
+//------------------------------------------------------------------------------------
+
 class RefGenReader : public BinReader
 {
 public:
@@ -48,6 +66,9 @@ public:
    RefGenSeq *getRefGenSeq(const std::string& selectedRefName,
                            int beginPos, int endPos);
 
+   template <class Consumer>
+   void findKmers(int refIndex, KmerLength k, Consumer& consumer);
+
    void close();
 
    int numref;                         // number of references
@@ -56,7 +77,75 @@ public:
 
 protected:
    uint32_t readUint32();
+
+   uint32_t readRefHeader(int refIndex, RefGenBlockVector& nBlock,
+                          uint32_t& dnaOffset);
 };
 
+//------------------------------------------------------------------------------------
+// RefGenReader::findKmers() finds the k-mers of the indexed reference by decoding its
+// packed 2-bit bases a chunk at a time, without converting the reference to
+// characters; each k-mer is passed with its 0-based start position to
+// consumer.addKmer(), then consumer.finish() is called with the number of start
+// positions; k-mers overlapping a block of N's are skipped
+
+template <class Consumer>
+void RefGenReader::findKmers(int refIndex, KmerLength k, Consumer& consumer)
+{
+   // the 2-bit file encodes T, C, A and G as 0 to 3
+   const Base BASE[4] = { BASE_T, BASE_C, BASE_A, BASE_G };
+
+   RefGenBlockVector nBlock;
+   uint32_t dnaOffset;
+
+   uint32_t reflen = readRefHeader(refIndex, nBlock, dnaOffset);
+
+   seek(dnaOffset);
+
+   std::vector<uint8_t> chunk(REF_GEN_CHUNK_SIZE);
+
+   const Kmer mask = numKmers(k) - 1;
+
+   Kmer kmer = 0;
+   uint32_t len = 0; // number of consecutive defined bases
+
+   size_t   block  = 0; // index of the next N-block
+   uint32_t nStart = (block < nBlock.size() ? nBlock[block].start : UINT32_MAX);
+
+   for (uint32_t pos = 0; pos < reflen; )
+   {
+      int numBytes = static_cast<int>(std::min(static_cast<uint32_t>(chunk.size()),
+                                               (reflen - pos + 3) >> 2));
+
+      if (!readBuffer(&chunk[0], numBytes))
+         throw std::runtime_error("truncated 2-bit file " + filename);
+
+      for (int i = 0; i < numBytes; i++)
+         for (int shift = 6; shift >= 0 && pos < reflen; shift -= 2, pos++)
+	 {
+            if (pos >= nStart) // within or past the current N-block
+	    {
+               while (block < nBlock.size() && nBlock[block].stop <= pos)
+	          block++;
+
+               nStart = (block < nBlock.size() ? nBlock[block].start : UINT32_MAX);
+
+	       if (pos >= nStart)
+	       {
+                  len = 0;
+	          continue;
+	       }
+	    }
+
+            kmer = ((kmer << 2) | BASE[(chunk[i] >> shift) & 3]) & mask;
+
+            if (++len >= k)
+	       consumer.addKmer(kmer, pos - k + 1);
+	 }
+   }
+
+   consumer.finish(reflen >= k ? reflen - k + 1 : 0);
+}
+
 //------------------------------------------------------------------------------------
 #endif
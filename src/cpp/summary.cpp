@@ -99,8 +99,8 @@ Summary *summarizeHits(const HitVector& hitVector, int begin, int end, int minSt
    }
 
    return new Summary(sampleID, readPairs, weak, strongNospan, strongSpan,
-                      hitVector[begin]->pattern->name,
-		      hitVector[begin]->pattern->annotation);
+                      hitVector[begin]->pattern.name(),
+		      hitVector[begin]->pattern.annotation());
 }
 
 //------------------------------------------------------------------------------------
@@ -166,78 +166,46 @@ static Summary *getSummary(const std::string& line)
 }
 
 //------------------------------------------------------------------------------------
-// SummaryCompare defines the sort order of hit summaries
+// readSummaryFile() reads the hit summaries in the named file and stores them in
+// sorted order in summaryVector; headingLine is set to the first line of the file as
+// soon as it is validated
 
-struct SummaryCompare
+void readSummaryFile(const std::string& filename, std::string& headingLine,
+                     StringVector& annotationHeading, SummaryVector& summaryVector)
 {
-   bool operator()(Summary* const& a, Summary* const& b) const
-   {
-      // sort by ascending name of pattern or group, then by ascending sample ID
+   std::string line;
 
-      int key1 = std::strcmp(a->name.c_str(), b->name.c_str());
-      if (key1 != 0)
-         return (key1 < 0);
+   std::ifstream infile(filename.c_str());
+   if (!infile.is_open())
+      throw std::runtime_error("unable to open " + filename);
 
-      return (a->sampleID < b->sampleID);
-   }
-};
+   if (!getline(infile, line))
+      throw std::runtime_error("empty file " + filename);
 
-//------------------------------------------------------------------------------------
-// sortSummaries() sorts the summaries in the given vector
+   if (!isValidHeadingLine(line, annotationHeading))
+      throw std::runtime_error("unexpected heading line in " + filename);
 
-static void sortSummaries(SummaryVector& summaryVector)
-{
-   std::sort(summaryVector.begin(), summaryVector.end(), SummaryCompare());
-}
+   headingLine = line;
 
-//------------------------------------------------------------------------------------
-// readSummaries() reads hit summaries from one or more input files and stores them in
-// sorted order in summaryVector
+   while (getline(infile, line))
+      if (isHeadingLine(line)) // found another heading line in this file
+      {
+         if (line != headingLine)
+            throw std::runtime_error("inconsistent heading lines in " + filename);
+      }
+      else
+      {
+         Summary *summary = getSummary(line);
 
-void readSummaries(const StringVector& filename, StringVector& annotationHeading,
-                   SummaryVector& summaryVector)
-{
-   std::string headingLine, line;
-   int numFiles = filename.size();
+	 if (summary)
+            summaryVector.push_back(summary);
+	 else
+            throw std::runtime_error("unexpected summary format in " + filename +
+                                     ": " + line);
+      }
 
-   for (int i = 0; i < numFiles; i++)
-   {
-      std::ifstream infile(filename[i].c_str());
-      if (!infile.is_open())
-         throw std::runtime_error("unable to open " + filename[i]);
-
-      if (!getline(infile, line))
-         throw std::runtime_error("empty file " + filename[i]);
-
-      if (!isValidHeadingLine(line, annotationHeading))
-         throw std::runtime_error("unexpected heading line in " + filename[i]);
-
-      if (i == 0)
-         headingLine = line;
-      else if (line != headingLine)
-         throw std::runtime_error("inconsistent heading lines in input files");
-
-      while (getline(infile, line))
-         if (isHeadingLine(line)) // found another heading line in this file
-	 {
-            if (line != headingLine)
-               throw std::runtime_error("inconsistent heading lines in " +
-                                        filename[i]);
-	 }
-         else
-	 {
-            Summary *summary = getSummary(line);
-
-	    if (summary)
-               summaryVector.push_back(summary);
-	    else
-               throw std::runtime_error("unexpected summary format in " +
-                                        filename[i] + ": " + line);
-	 }
-
-      infile.close();
-   }
+   infile.close();
 
    if (summaryVector.size() > 1)
-      sortSummaries(summaryVector);
+      std::sort(summaryVector.begin(), summaryVector.end(), SummaryCompare());
 }
@@ -12,6 +12,7 @@
 #define SUMMARY_H
 
 #include "hit.h"
+#include <cstring>
 
 const std::string FUZZUM = "fuzzum ";
 
@@ -44,6 +45,23 @@ public:
 
 typedef std::vector<Summary *> SummaryVector;
 
+//------------------------------------------------------------------------------------
+// SummaryCompare defines the sort order of hit summaries
+
+struct SummaryCompare
+{
+   bool operator()(Summary* const& a, Summary* const& b) const
+   {
+      // sort by ascending name of pattern or group, then by ascending sample ID
+
+      int key1 = std::strcmp(a->name.c_str(), b->name.c_str());
+      if (key1 != 0)
+         return (key1 < 0);
+
+      return (a->sampleID < b->sampleID);
+   }
+};
+
 //------------------------------------------------------------------------------------
 
 void writeSummaryHeadingLine(const std::string& version, bool grouping,
@@ -52,7 +70,7 @@ void writeSummaryHeadingLine(const std::string& version, bool grouping,
 Summary *summarizeHits(const HitVector& hitVector, int begin, int end, int minStrong,
                        std::string sampleID="");
 
-void readSummaries(const StringVector& filename, StringVector& annotationHeading,
-                   SummaryVector& summaryVector);
+void readSummaryFile(const std::string& filename, std::string& headingLine,
+                     StringVector& annotationHeading, SummaryVector& summaryVector);
 
 #endif
@@ -9,19 +9,160 @@
 //------------------------------------------------------------------------------------
 
 #include "ubam.h"
+#include "infile.h"
+#include <cctype>
 #include <stdexcept>
+#include <vector>
+
+const size_t BAM_FIXED_LEN = 36; // bytes of a Bam record preceding the read name
 
 //------------------------------------------------------------------------------------
-// UbamPairReader::getNextPair() gets the next read pair and returns true, or returns
-// false when end-of-file is reached
+// getLE() returns the little-endian integer of the given number of bytes stored at
+// the given address
 
-bool UbamPairReader::getNextPair(std::string& name1, std::string& sequence1,
-                                 std::string& name2, std::string& sequence2)
+static inline uint32_t getLE(const char *p, int numBytes)
 {
-   BamRead read1, read2;
+   const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+   uint32_t value = 0;
+
+   for (int i = numBytes - 1; i >= 0; i--)
+      value = (value << 8) | u[i];
+
+   return value;
+}
+
+//------------------------------------------------------------------------------------
+// bamRecordLength() returns the length of the Bam record that could begin at the
+// given offset of the uncompressed data, or zero if none could: the fixed fields
+// must be in range, the read name must be printable and end with a NUL, and the
+// length must allow for the read name, CIGAR, bases and qualities
+
+static size_t bamRecordLength(const std::string& data, size_t offset)
+{
+   if (offset + BAM_FIXED_LEN > data.length())
+      return 0;
+
+   const char *p = &data[offset];
+
+   int64_t  blockSize   = static_cast<int32_t>(getLE(&p[0],  4));
+   int32_t  refID       = static_cast<int32_t>(getLE(&p[4],  4));
+   int32_t  position    = static_cast<int32_t>(getLE(&p[8],  4));
+   uint32_t nameLen     = getLE(&p[12], 1);
+   uint32_t numCigarOps = getLE(&p[16], 2);
+   int64_t  seqLen      = static_cast<int32_t>(getLE(&p[20], 4));
+   int32_t  mateRefID   = static_cast<int32_t>(getLE(&p[24], 4));
+   int32_t  matePos     = static_cast<int32_t>(getLE(&p[28], 4));
+
+   int64_t  minSize     = static_cast<int64_t>(BAM_FIXED_LEN) - 4 + nameLen +
+                          4 * numCigarOps + (seqLen + 1) / 2 + seqLen;
+
+   if (refID < -1 || position < -1 || mateRefID < -1 || matePos < -1 ||
+       nameLen < 2 || seqLen < 0 || blockSize < minSize ||
+       offset + BAM_FIXED_LEN + nameLen > data.length() ||
+       p[BAM_FIXED_LEN + nameLen - 1] != '\0')
+      return 0;
+
+   for (uint32_t i = 0; i < nameLen - 1; i++)
+      if (!isgraph(static_cast<unsigned char>(p[BAM_FIXED_LEN + i])))
+         return 0;
+
+   return 4 + blockSize;
+}
+
+//------------------------------------------------------------------------------------
+// findBamPair() is the BgzfSyncFunction of an unaligned Bam file: a record begins
+// where SYNC_NAMES plausible records follow one another, or fewer that end the file,
+// and pairPhase() tells whether a read pair begins at this record or at the next one
 
-   if (!reader.getNext(read1))
-      return false; // reached EOF
+static bool findBamPair(const std::string& data, bool atEnd, size_t& start)
+{
+   size_t length = data.length();
+
+   std::vector<std::string> name;
+   std::vector<size_t>      recordStart;
+
+   for (size_t offset = 0; offset < length; offset++)
+   {
+      size_t next = offset, len;
+
+      name.clear();
+      recordStart.clear();
+
+      while (name.size() < SYNC_NAMES &&
+             (len = bamRecordLength(data, next)) > 0 && next + len <= length)
+      {
+         name.push_back(&data[next + BAM_FIXED_LEN]);
+	 recordStart.push_back(next);
+	 next += len;
+      }
+
+      bool toEnd = (name.size() > 0 && next == length && atEnd);
+
+      if (name.size() < SYNC_NAMES && !toEnd)
+         continue;
+
+      int numNames = name.size();
+
+      int phase = pairPhase(name, toEnd && numNames < SYNC_NAMES);
+      if (phase < 0)
+         continue;
+
+      start = (phase < numNames ? recordStart[phase] : length);
+      return true;
+   }
+
+   return false;
+}
+
+//------------------------------------------------------------------------------------
+// UbamPairReader::open() opens the file; if a shard is selected, the reader moves to
+// the first read pair of the shard and notes the virtual file offset where it ends
+
+void UbamPairReader::open()
+{
+   reader.open(filename);
+
+   if (numShards == 1)
+      return;
+
+   BgzfPosition start = findBgzfShard(filename, shard,     numShards, findBamPair);
+   BgzfPosition stop  = findBgzfShard(filename, shard + 1, numShards, findBamPair);
+
+   stopOffset = (stop.block == BGZF_END ? UINT64_MAX :
+                                          (stop.block << 16) | stop.skip);
+
+   if (start.block == BGZF_END)
+      stopOffset = 0; // the shard is empty
+   else if (shard > 0) // the first shard begins after the header
+      reader.seek((start.block << 16) | start.skip);
+}
+
+//------------------------------------------------------------------------------------
+// UbamPairReader::selectShard() selects shard i of N of a BGZF-compressed Bam file,
+// whose shards are found by file offset
+
+bool UbamPairReader::selectShard(int inShard, int inNumShards)
+{
+   if (!isBgzfFile(filename))
+      return false;
+
+   shard     = inShard;
+   numShards = inNumShards;
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// UbamPairReader::readPair() reads the next read pair into read1 and read2 and sets
+// their names, or returns false when end-of-file or the end of the shard is reached;
+// a read that begins at the end of the shard may be reported to begin at the end of
+// the previous BGZF block, so it is known to be past the end only once it is read
+
+bool UbamPairReader::readPair()
+{
+   if (reader.tell() >= stopOffset || !reader.getNext(read1) ||
+       reader.tell() > stopOffset)
+      return false; // reached the end of the shard or EOF
 
    if (!reader.getNext(read2))
       throw std::runtime_error("odd number of reads in" + filename);
@@ -33,15 +174,56 @@ bool UbamPairReader::getNextPair(std::string& name1, std::string& sequence1,
       throw std::runtime_error("mismatched read names " + name1 + " and " + name2 +
                                " in " + filename);
 
-   std::string *seq1 = read1.sequence();
-   std::string *seq2 = read2.sequence();
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// UbamPairReader::getNextPair() gets the next read pair and returns true, or returns
+// false when end-of-file is reached
+
+bool UbamPairReader::getNextPair(std::string& name1, std::string& sequence1,
+                                 std::string& name2, std::string& sequence2)
+{
+   if (!readPair())
+      return false;
+
+   name1 = this->name1;
+   name2 = this->name2;
+
+   sequence1.clear();
+   sequence2.clear();
+
+   read1.appendSequence(sequence1);
+   read2.appendSequence(sequence2);
+
+   return true;
+}
+
+//------------------------------------------------------------------------------------
+// UbamPairReader::addNextPair() adds the next read pair to the batch, decoding the
+// packed bases of each read straight into the arena of the batch, or returns false
+// when end-of-file is reached
+
+bool UbamPairReader::addNextPair(ReadBatch& batch)
+{
+   if (!readPair())
+      return false;
+
+   std::string& arena = batch.fieldArena();
+
+   arena.append(name1);
+   batch.endField();
+
+   read1.appendSequence(arena);
+   batch.endField();
 
-   sequence1 = *seq1;
-   sequence2 = *seq2;
+   arena.append(name2);
+   batch.endField();
 
-   delete seq1;
-   delete seq2;
+   read2.appendSequence(arena);
+   batch.endField();
 
+   batch.endPair();
    return true;
 }
 
@@ -20,19 +20,36 @@ class UbamPairReader : public PairReader
 {
 public:
    UbamPairReader(const std::string& inFilename)
-      : filename(inFilename), reader() { }
+      : filename(inFilename), reader(), shard(0), numShards(1),
+        stopOffset(UINT64_MAX), read1(), read2(), name1(), name2() { }
 
    virtual ~UbamPairReader() { }
 
-   void open()  { reader.open(filename); }
+   void open();
 
    bool getNextPair(std::string& name1, std::string& sequence1,
                     std::string& name2, std::string& sequence2);
 
+   bool addNextPair(ReadBatch& batch);
+
+   bool skipNextPair() { return readPair(); } // the bases are not decoded
+
+   bool selectShard(int inShard, int inNumShards);
+
    void close() { reader.close(); }
 
    std::string filename;
    BamReader  reader;
+
+private:
+   bool readPair(); // reads the next pair into read1 and read2, and their names
+
+   int      shard;      // 0-based index of the shard read
+   int      numShards;  // 1 unless a shard is selected
+   uint64_t stopOffset; // virtual file offset where the shard ends
+
+   BamRead     read1, read2; // reused for each read pair
+   std::string name1, name2;
 };
 
 //------------------------------------------------------------------------------------
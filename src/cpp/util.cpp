@@ -174,6 +174,18 @@ std::string doubleToString(double d)
    return buffer;
 }
 
+//------------------------------------------------------------------------------------
+// uint64ToString() returns a string representation of the given unsigned 64-bit
+// integer
+
+std::string uint64ToString(uint64_t u)
+{
+   std::ostringstream stream;
+   stream << u;
+
+   return stream.str();
+}
+
 //------------------------------------------------------------------------------------
 // intToStringLeadingZeros() returns a string representation of the given integer of
 // the specified width, with leading zeros
@@ -198,3 +210,19 @@ bool hasPrefix(const std::string& s, const std::string& prefix)
 
    return (s.substr(0, prefixLen) == prefix);
 }
+
+//------------------------------------------------------------------------------------
+// hashBytes() continues a 64-bit FNV-1a hash over the given bytes and returns the new
+// value of the hash
+
+uint64_t hashBytes(const void *data, size_t length, uint64_t hash)
+{
+   const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+   const uint8_t *byte = static_cast<const uint8_t *>(data);
+
+   for (size_t i = 0; i < length; i++)
+      hash = (hash ^ byte[i]) * FNV_PRIME;
+
+   return hash;
+}
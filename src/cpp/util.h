@@ -11,6 +11,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -35,10 +36,16 @@ bool intOpt   (const StringVector& opt, std::string optname, int& optvalue);
 bool doubleOpt(const StringVector& opt, std::string optname, double& optvalue);
 
 std::string intToString(int i);
+std::string uint64ToString(uint64_t u);
 std::string doubleToString(double d);
 
 std::string intToStringLeadingZeros(int i, int width);
 
 bool hasPrefix(const std::string& s, const std::string& prefix);
 
+const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL; // initial value of a hash
+
+// hashBytes() continues a 64-bit FNV-1a hash over the given bytes
+uint64_t hashBytes(const void *data, size_t length, uint64_t hash=FNV_OFFSET_BASIS);
+
 #endif
@@ -11,34 +11,61 @@
 #include "window.h"
 
 //------------------------------------------------------------------------------------
+// findWindows() finds the windows of a sequence with k and w known at compile time,
+// or with the given values when K or W is 0
 
-class Finder : public RankMinimizerFinder
+template <KmerLength K, MinimizerWindowLength W>
+static void findWindows(const std::string& sequence, MinimizerWindowLength w,
+                        const KmerRankTable *rankTable, WindowVector& windowVector,
+			WindowScheme scheme)
 {
-public:
-   Finder(const std::string& sequence, MinimizerWindowLength w,
-          const KmerRankTable *rankTable, WindowVector& inWindowVector)
-      : RankMinimizerFinder(sequence.c_str(), sequence.length(), w, rankTable),
-	windowVector(inWindowVector) { }
+   WindowSink sink(windowVector);
 
-   virtual ~Finder() { }
+   findMinimizers<RankHash, WindowSink, K, W>(sequence.c_str(), sequence.length(),
+                                              rankTable->k, w, scheme,
+					      RankHash(rankTable), sink);
+}
+
+//------------------------------------------------------------------------------------
+// findWindowsK() calls the findWindows() specialized for w if there is one
 
-   virtual bool reportMinimizer(Minimizer minimizer, int startIndex, int windowID,
-                                bool finalMinimizer)
+template <KmerLength K>
+static void findWindowsK(const std::string& sequence, MinimizerWindowLength w,
+                         const KmerRankTable *rankTable, WindowVector& windowVector,
+			 WindowScheme scheme)
+{
+   switch (w)
    {
-      windowVector.push_back(Window(minimizer, startIndex));
-      return true;
+      case 5:
+         findWindows<K, 5> (sequence, w, rankTable, windowVector, scheme);
+	 break;
+      case 10:
+         findWindows<K, 10>(sequence, w, rankTable, windowVector, scheme);
+	 break;
+      case 15:
+         findWindows<K, 15>(sequence, w, rankTable, windowVector, scheme);
+	 break;
+      default:
+         findWindows<K, 0> (sequence, w, rankTable, windowVector, scheme);
+	 break;
    }
-
-   WindowVector& windowVector;
-};
+}
 
 //------------------------------------------------------------------------------------
-// getWindows() partitions a sequence into consecutive windows and stores them in a
-// vector
+// getWindows() finds the windows of a sequence under the given scheme and appends
+// them to a vector; the caller may reuse the vector after clearing it; the common
+// values of k and w have kernels specialized for them, and any others are handled by
+// the generic kernel
 
 void getWindows(const std::string& sequence, MinimizerWindowLength w,
-                const KmerRankTable *rankTable, WindowVector& windowVector)
+                const KmerRankTable *rankTable, WindowVector& windowVector,
+		WindowScheme scheme)
 {
-   Finder finder(sequence, w, rankTable, windowVector);
-   finder.find();
+   switch (rankTable->k)
+   {
+      case 11: findWindowsK<11>(sequence, w, rankTable, windowVector, scheme); break;
+      case 13: findWindowsK<13>(sequence, w, rankTable, windowVector, scheme); break;
+      case 15: findWindowsK<15>(sequence, w, rankTable, windowVector, scheme); break;
+      default: findWindowsK<0> (sequence, w, rankTable, windowVector, scheme); break;
+   }
 }
@@ -30,9 +30,20 @@ public:
 
 typedef std::vector<Window> WindowVector;
 
+struct WindowSink // appends each minimizer found by an engine to a vector of windows
+{
+   WindowSink(WindowVector& inWindowVector) : windowVector(inWindowVector) { }
+
+   void operator()(Minimizer minimizer, int startIndex)
+   { windowVector.push_back(Window(minimizer, startIndex)); }
+
+   WindowVector& windowVector;
+};
+
 //------------------------------------------------------------------------------------
 
 void getWindows(const std::string& sequence, MinimizerWindowLength w,
-                const KmerRankTable *rankTable, WindowVector& windowVector);
+                const KmerRankTable *rankTable, WindowVector& windowVector,
+		WindowScheme scheme=FIXED_WINDOWS);
 
 #endif